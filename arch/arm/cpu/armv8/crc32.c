@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * CRC32 and CRC32C using the ARMv8 CRC32 instructions
+ *
+ * This file is built with the CRC32 instructions enabled; callers check
+ * ID_AA64ISAR0_EL1 before calling in, so that one binary also runs on CPUs
+ * without them.
+ */
+
+#include <efi_loader.h>
+#include <asm/byteorder.h>
+#include <u-boot/crc.h>
+
+/*
+ * Handle single bytes until @p is 8-byte aligned, since unaligned loads fault
+ * with the MMU off, then 8 bytes at a time
+ */
+#define CRC32_ARMV8(insn, crc, p, len)					\
+	do {								\
+		for (; len && ((ulong)p & 7); len--)			\
+			asm(insn "b %w0, %w0, %w1"			\
+			    : "+r" (crc) : "r" ((u32)*p++));		\
+		for (; len >= 8; len -= 8, p += 8)			\
+			asm(insn "x %w0, %w0, %x1"			\
+			    : "+r" (crc)				\
+			    : "r" (le64_to_cpu(*(const u64 *)p)));	\
+		for (; len; len--)					\
+			asm(insn "b %w0, %w0, %w1"			\
+			    : "+r" (crc) : "r" ((u32)*p++));		\
+	} while (0)
+
+uint32_t __efi_runtime crc32_armv8(uint32_t crc, const unsigned char *p,
+				   uint len)
+{
+	CRC32_ARMV8("crc32", crc, p, len);
+
+	return crc;
+}
+
+uint32_t crc32c_armv8(uint32_t crc, const unsigned char *p, uint len)
+{
+	CRC32_ARMV8("crc32c", crc, p, len);
+
+	return crc;
+}
@@ -6,6 +6,7 @@
  */
 
 #include <u-boot/sha1.h>
+#include <asm/system.h>
 
 extern void sha1_armv8_ce_process(uint32_t state[5], uint8_t const *src,
 				  uint32_t blocks);
@@ -16,5 +17,8 @@ void sha1_process(sha1_context *ctx, const unsigned char *data,
 	if (!blocks)
 		return;
 
-	sha1_armv8_ce_process(ctx->state, data, blocks);
+	if (read_id_aa64isar0() & ID_AA64ISAR0_EL1_SHA1)
+		sha1_armv8_ce_process(ctx->state, data, blocks);
+	else
+		sha1_process_generic(ctx, data, blocks);
 }
@@ -6,6 +6,7 @@
  */
 
 #include <u-boot/sha256.h>
+#include <asm/system.h>
 
 extern void sha256_armv8_ce_process(uint32_t state[8], uint8_t const *src,
 				    uint32_t blocks);
@@ -16,5 +17,8 @@ void sha256_process(sha256_context *ctx, const unsigned char *data,
 	if (!blocks)
 		return;
 
-	sha256_armv8_ce_process(ctx->state, data, blocks);
+	if (read_id_aa64isar0() & ID_AA64ISAR0_EL1_SHA2)
+		sha256_armv8_ce_process(ctx->state, data, blocks);
+	else
+		sha256_process_generic(ctx, data, blocks);
 }
@@ -85,8 +85,13 @@
 #define HCR_EL2_RW_AARCH32	(0 << 31) /* Lower levels are AArch32         */
 #define HCR_EL2_HCD_DIS		(1 << 29) /* Hypervisor Call disabled         */
 #define HCR_EL2_AMO_EL2		(1 <<  5) /* Route SErrors to EL2             */
+#define HCR_EL2_IMO_EL2		(1 <<  4) /* Route IRQs to EL2                */
 
 #define ID_AA64ISAR0_EL1_RNDR	(0xFUL << 60) /* RNDR random registers */
+#define ID_AA64ISAR0_EL1_CRC32	(0xFUL << 16) /* CRC32/CRC32C instructions */
+#define ID_AA64ISAR0_EL1_SHA2	(0xFUL << 12) /* SHA-256 instructions */
+#define ID_AA64ISAR0_EL1_SHA512	(0x2UL << 12) /* SHA2 value with SHA-512 */
+#define ID_AA64ISAR0_EL1_SHA1	(0xFUL << 8)  /* SHA-1 instructions */
 /*
  * ID_AA64ISAR1_EL1 bits definitions
  */
@@ -211,6 +216,16 @@ static inline unsigned long read_mpidr(void)
 	return val;
 }
 
+/* The optional instructions implemented, see ID_AA64ISAR0_EL1_... */
+static inline unsigned long read_id_aa64isar0(void)
+{
+	unsigned long val;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (val));
+
+	return val;
+}
+
 #define BSP_COREID	0
 
 void __asm_flush_dcache_all(void);
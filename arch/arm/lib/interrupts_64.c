@@ -4,12 +4,22 @@
  * David Feng <fenghua@phytium.com.cn>
  */
 
+#include <config.h>
+#include <asm/armv8/mmu.h>
 #include <asm/esr.h>
+#include <asm/gic.h>
 #include <asm/global_data.h>
+#include <asm/io.h>
 #include <asm/ptrace.h>
+#include <asm/system.h>
 #include <irq_func.h>
+#include <linux/bitops.h>
 #include <linux/compiler.h>
+#include <linux/errno.h>
+#include <linux/sizes.h>
+#include <linux/stringify.h>
 #include <efi_loader.h>
+#include <profile.h>
 #include <semihosting.h>
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -206,12 +216,137 @@ void do_sync(struct pt_regs *pt_regs)
 	panic("Resetting CPU ...\n");
 }
 
+#if CONFIG_IS_ENABLED(PROFILE) && defined(GICD_BASE) && \
+	((defined(CONFIG_GICV3) && defined(GICR_BASE)) || defined(GICC_BASE))
+/*
+ * The sampling profiler uses the EL1 physical timer, whose interrupt is PPI 14
+ * (interrupt ID 30). This relies on the GIC having been set up by earlier
+ * firmware, or by gic_init_secure(), with the PPIs in non-secure group 1.
+ */
+#define PROFILE_TIMER_IRQ	30
+#define GIC_SPURIOUS_IRQ	1020
+
+#if defined(CONFIG_GICV3) && defined(GICR_BASE)
+#define PROFILE_SGI_BASE	(GICR_BASE + SZ_64K)
+#endif
+
+static ulong profile_ticks;
+/* HCR_EL2 before profiling started, when running at EL2 */
+static ulong profile_hcr;
+
+static void profile_timer_set(void)
+{
+	asm volatile("msr cntp_tval_el0, %0" : : "r" (profile_ticks));
+	asm volatile("msr cntp_ctl_el0, %0" : : "r" (1UL));
+	isb();
+}
+
+int arch_profile_start(uint freq)
+{
+	ulong rate;
+
+	/*
+	 * start.S sets SCR_EL3.IRQ, so IRQs are taken at EL3, but the timer
+	 * interrupt is in non-secure group 1, which a GICv3 signals as an FIQ
+	 * in secure state, and there is no FIQ handler
+	 */
+	if (current_el() == 3)
+		return -ENOSYS;
+	if (current_el() == 2) {
+		asm volatile("mrs %0, hcr_el2" : "=r" (profile_hcr));
+		/* with E2H the cntp registers are the EL2 timer, on another PPI */
+		if (profile_hcr & BIT_ULL(HCR_EL2_E2H_BIT))
+			return -ENOSYS;
+	}
+	asm volatile("mrs %0, cntfrq_el0" : "=r" (rate));
+	profile_ticks = rate / freq;
+	if (!profile_ticks)
+		return -EINVAL;
+
+	/* physical IRQs are only taken at EL2 if routed there */
+	if (current_el() == 2) {
+		asm volatile("msr hcr_el2, %0" : :
+			     "r" (profile_hcr | HCR_EL2_IMO_EL2));
+		isb();
+	}
+
+#ifdef PROFILE_SGI_BASE
+	writel(BIT(PROFILE_TIMER_IRQ), PROFILE_SGI_BASE + GICR_ISENABLERn);
+	asm volatile("msr " __stringify(ICC_PMR_EL1) ", %0" : : "r" (0xffUL));
+	asm volatile("msr " __stringify(ICC_IGRPEN1_EL1) ", %0" : : "r" (1UL));
+#else
+	writel(BIT(PROFILE_TIMER_IRQ), GICD_BASE + GICD_ISENABLERn);
+	writel(0xff, GICC_BASE + GICC_PMR);
+	setbits_le32(GICC_BASE + GICC_CTLR, 1);
+#endif
+	profile_timer_set();
+	asm volatile("msr daifclr, #2");
+
+	return 0;
+}
+
+void arch_profile_stop(void)
+{
+	asm volatile("msr daifset, #2");
+	asm volatile("msr cntp_ctl_el0, %0" : : "r" (0UL));
+	isb();
+#ifdef PROFILE_SGI_BASE
+	writel(BIT(PROFILE_TIMER_IRQ), PROFILE_SGI_BASE + GICR_ICENABLERn);
+#else
+	writel(BIT(PROFILE_TIMER_IRQ), GICD_BASE + GICD_ICENABLERn);
+#endif
+	if (current_el() == 2) {
+		asm volatile("msr hcr_el2, %0" : : "r" (profile_hcr));
+		isb();
+	}
+}
+
+/* Take a sample if this is the profiler's timer, returning true if so */
+static bool profile_irq(struct pt_regs *pt_regs)
+{
+	ulong *fp = (ulong *)pt_regs->regs[29];
+	ulong caller = 0;
+	ulong irq;
+
+#ifdef PROFILE_SGI_BASE
+	asm volatile("mrs %0, " __stringify(ICC_IAR1_EL1) : "=r" (irq));
+	irq &= 0xffffff;
+#else
+	irq = readl(GICC_BASE + GICC_IAR) & 0x3ff;
+#endif
+	if (irq >= GIC_SPURIOUS_IRQ && irq < GIC_SPURIOUS_IRQ + 4)
+		return true;
+	if (irq == PROFILE_TIMER_IRQ) {
+		/* the frame record holds the caller's fp then the return address */
+		if ((ulong)fp >= (ulong)pt_regs && !((ulong)fp & 7) &&
+		    (ulong)(fp + 2) <= gd->start_addr_sp)
+			caller = fp[1];
+		profile_sample(pt_regs->elr, caller);
+		profile_timer_set();
+	}
+#ifdef PROFILE_SGI_BASE
+	asm volatile("msr " __stringify(ICC_EOIR1_EL1) ", %0" : : "r" (irq));
+#else
+	writel(irq, GICC_BASE + GICC_EOIR);
+#endif
+
+	return irq == PROFILE_TIMER_IRQ;
+}
+#else
+static bool profile_irq(struct pt_regs *pt_regs)
+{
+	return false;
+}
+#endif
+
 /*
  * do_irq handles the Irq exception.
  */
 void do_irq(struct pt_regs *pt_regs)
 {
 	efi_restore_gd();
+	if (profile_irq(pt_regs))
+		return;
 	printf("\"Irq\" handler, esr 0x%08lx\n", pt_regs->esr);
 	show_regs(pt_regs);
 	show_efi_loaded_images(pt_regs);
@@ -166,6 +166,74 @@ void os_raise_sigalrm(void)
 	raise(SIGALRM);
 }
 
+/* Top of the main thread's stack, from glibc */
+extern void *__libc_stack_end;
+
+static void (*os_profile_handler)(unsigned long pc, unsigned long caller);
+static pthread_t os_profile_thread;
+
+static void os_profile_signal(int sig, siginfo_t *info, void *con)
+{
+	ucontext_t __maybe_unused *context = con;
+	unsigned long pc = 0, sp = 0, caller = 0;
+	unsigned long *fp = NULL;
+
+#if defined(__x86_64__)
+	pc = context->uc_mcontext.gregs[REG_RIP];
+	sp = context->uc_mcontext.gregs[REG_RSP];
+	fp = (unsigned long *)context->uc_mcontext.gregs[REG_RBP];
+#elif defined(__aarch64__)
+	pc = context->uc_mcontext.pc;
+	sp = context->uc_mcontext.sp;
+	fp = (unsigned long *)context->uc_mcontext.regs[29];
+#endif
+	/*
+	 * The frame record holds the caller's frame pointer and then the
+	 * return address. Only read it if it is within the part of the stack
+	 * in use, since the frame pointer may be used for something else in
+	 * code built without frame pointers, such as the C library
+	 */
+	if (pthread_equal(pthread_self(), os_profile_thread) &&
+	    (unsigned long)fp >= sp && !((unsigned long)fp & 7) &&
+	    (void *)(fp + 2) <= __libc_stack_end)
+		caller = fp[1];
+
+	os_profile_handler(pc, caller);
+}
+
+int os_profile_start(unsigned int usec,
+		     void (*handler)(unsigned long pc, unsigned long caller))
+{
+	struct itimerval timer = {};
+	struct sigaction act = {};
+
+	os_profile_handler = handler;
+	os_profile_thread = pthread_self();
+	act.sa_sigaction = os_profile_signal;
+	sigemptyset(&act.sa_mask);
+	act.sa_flags = SA_SIGINFO | SA_RESTART;
+	if (sigaction(SIGPROF, &act, NULL))
+		return -1;
+
+	timer.it_interval.tv_sec = usec / 1000000;
+	timer.it_interval.tv_usec = usec % 1000000;
+	timer.it_value = timer.it_interval;
+	if (setitimer(ITIMER_PROF, &timer, NULL))
+		return -1;
+
+	return 0;
+}
+
+void os_profile_stop(void)
+{
+	struct itimerval timer = {};
+
+	setitimer(ITIMER_PROF, &timer, NULL);
+
+	/* a signal may still be pending, so don't use the default action */
+	signal(SIGPROF, SIG_IGN);
+}
+
 int os_write_file(const char *fname, const void *buf, int size)
 {
 	int fd;
@@ -77,6 +77,7 @@ typedef int sandbox_eth_tx_hand_f(struct udevice *dev, void *pkt,
  * fake_host_hwaddr - MAC address of mocked machine
  * fake_host_ipaddr - IP address of mocked machine
  * disabled - Will not respond
+ * no_batch - Packets are received one at a time, not in batches
  * irs - tcp initial receive sequence
  * iss - tcp initial send sequence
  * recv_packet_buffer - buffers of the packet returned as received
@@ -89,6 +90,7 @@ struct eth_sandbox_priv {
 	uchar fake_host_hwaddr[ARP_HLEN];
 	struct in_addr fake_host_ipaddr;
 	bool disabled;
+	bool no_batch;
 	u32 irs;
 	u32 iss;
 	uchar * recv_packet_buffer[PKTBUFSRX];
@@ -112,4 +114,14 @@ void sandbox_eth_set_tx_handler(int index, sandbox_eth_tx_hand_f *handler);
  */
 void sandbox_eth_set_priv(int index, void *priv);
 
+/*
+ * sandbox_eth_set_batch()
+ *
+ * Allow or prevent receiving packets in batches
+ *
+ * @index: The alias index (also DM seq number)
+ * @enable: true to hand up packets in batches, false for one at a time
+ */
+void sandbox_eth_set_batch(int index, bool enable);
+
 #endif /* __ETH_H */
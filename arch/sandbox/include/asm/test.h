@@ -154,6 +154,25 @@ int sandbox_pwm_get_config(struct udevice *dev, uint channel, uint *period_nsp,
  */
 void sandbox_sf_set_block_protect(struct udevice *dev, int bp_mask);
 
+/**
+ * sandbox_sf_get_op_count() - Get the number of times an opcode was received
+ *
+ * Each operation is counted once, however much data it transfers, so this
+ * shows how a request was split up by the SPI flash and controller layers.
+ *
+ * @dev: SPI flash emulator device
+ * @opcode: Opcode to check (e.g. SPINOR_OP_READ_FAST)
+ * Return: number of operations with that opcode since the last reset
+ */
+uint sandbox_sf_get_op_count(struct udevice *dev, u8 opcode);
+
+/**
+ * sandbox_sf_reset_op_count() - Reset the operation counts of an emulator
+ *
+ * @dev: SPI flash emulator device
+ */
+void sandbox_sf_reset_op_count(struct udevice *dev);
+
 /**
  * sandbox_get_codec_params() - Read back codec parameters
  *
@@ -6,8 +6,10 @@
  */
 
 #include <efi_loader.h>
+#include <errno.h>
 #include <irq_func.h>
 #include <os.h>
+#include <profile.h>
 #include <asm/global_data.h>
 #include <asm-generic/signal.h>
 #include <asm/u-boot-sandbox.h>
@@ -28,6 +30,23 @@ int disable_interrupts(void)
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(PROFILE)
+int arch_profile_start(uint freq)
+{
+	if (freq > 1000000)
+		return -EINVAL;
+	if (os_profile_start(1000000 / freq, profile_sample))
+		return -EIO;
+
+	return 0;
+}
+
+void arch_profile_stop(void)
+{
+	os_profile_stop();
+}
+#endif
+
 void os_signal_action(int sig, unsigned long pc)
 {
 	efi_restore_gd();
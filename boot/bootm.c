@@ -13,6 +13,7 @@
 #include <env.h>
 #include <errno.h>
 #include <fdt_support.h>
+#include <fit_stream.h>
 #include <irq_func.h>
 #include <lmb.h>
 #include <log.h>
@@ -1146,6 +1147,40 @@ int booti_run(struct bootm_info *bmi)
 	return boot_run(bmi, "booti", 0);
 }
 
+#if CONFIG_IS_ENABLED(FIT_STREAM)
+int bootm_stream_run(struct bootm_info *bmi, struct fit_stream *strm,
+		     const char *conf_uname)
+{
+	struct bootm_headers *images = bmi->images;
+	int ret;
+
+	ret = bootm_run_states(bmi, BOOTM_STATE_START);
+	if (ret)
+		return ret;
+
+	/*
+	 * This does the FINDOS, FINDOTHER and LOADOS states in one go. Each
+	 * image is reserved with lmb before it is loaded, and stays reserved
+	 */
+	ret = fit_stream_load_config(strm, conf_uname, images->verify, images);
+	if (ret)
+		return ret;
+	if (!images->os.image_len) {
+		puts("No kernel in configuration\n");
+		return -ENOENT;
+	}
+
+	if (CONFIG_IS_ENABLED(OF_LIBFDT) && IS_ENABLED(CONFIG_CMD_FDT) &&
+	    images->ft_addr)
+		set_working_fdt_addr(map_to_sysmem(images->ft_addr));
+
+	/* As LOADOS is done here, interrupts must be disabled here too */
+	bootm_disable_interrupts();
+
+	return boot_run(bmi, "bootm", 0);
+}
+#endif
+
 int bootm_boot_start(ulong addr, const char *cmdline)
 {
 	char addr_str[30];
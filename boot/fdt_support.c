@@ -9,6 +9,7 @@
 #include <dm.h>
 #include <abuf.h>
 #include <env.h>
+#include <fdt_index.h>
 #include <log.h>
 #include <mapmem.h>
 #include <net.h>
@@ -1716,6 +1717,8 @@ int fdt_set_phandle(void *fdt, int nodeoffset, uint32_t phandle)
 #endif
 
 	ret = fdt_setprop_cell(fdt, nodeoffset, "phandle", phandle);
+	/* an existing phandle is replaced in place */
+	fdt_index_invalidate(fdt);
 
 	return ret;
 }
@@ -2184,6 +2187,8 @@ int fdt_overlay_apply_verbose(void *fdt, void *fdto)
 	err = fdt_path_offset(fdt, "/__symbols__");
 	has_symbols = err >= 0;
 
+	/* phandles in the base tree may be changed in place */
+	fdt_index_invalidate(fdt);
 	err = fdt_overlay_apply(fdt, fdto);
 	if (err < 0) {
 		printf("failed on fdt_overlay_apply(): %s\n",
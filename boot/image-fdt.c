@@ -9,6 +9,7 @@
  */
 
 #include <command.h>
+#include <fdt_index.h>
 #include <fdt_support.h>
 #include <fdtdec.h>
 #include <efi.h>
@@ -590,6 +591,9 @@ int image_setup_libfdt(struct bootm_headers *images, void *blob, bool lmb)
 	bool skip_board_fixup = false;
 	int ret, fdt_ret, of_size;
 
+	/* this may be the control FDT, which the fixups change in place */
+	fdt_index_invalidate(blob);
+
 	if (IS_ENABLED(CONFIG_OF_ENV_SETUP)) {
 		const char *fdt_fixup;
 
@@ -0,0 +1,1123 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Loading FIT images in chunks, so that each image is hashed and
+ * decompressed while it is read and lands at its load address in one pass
+ */
+
+#define LOG_CATEGORY	LOGC_BOOT
+
+#include <alist.h>
+#include <blk.h>
+#include <fit_stream.h>
+#include <fs.h>
+#include <gzip.h>
+#include <hash.h>
+#include <image.h>
+#include <lmb.h>
+#include <log.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <memalign.h>
+#include <part.h>
+#include <watchdog.h>
+#include <asm/unaligned.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/libfdt.h>
+#include <linux/zstd.h>
+#include <u-boot/zlib.h>
+
+/* Maximum number of hash nodes checked in each image */
+#define FIT_STREAM_MAX_HASHES	4
+
+/**
+ * struct fit_stream_hash - state of a hash node being checked
+ *
+ * For a hash tree (a hash node with a 'chunk-size' property) @ctx covers the
+ * current chunk only, so that each chunk is checked against 'chunk-hashes' as
+ * soon as it has been read.
+ *
+ * @algo: Hash algorithm
+ * @ctx: Hash context
+ * @noffset: Hash node offset
+ * @chunk_size: Chunk size of a hash tree, 0 for a plain hash
+ * @leaves: Chunk hashes of a hash tree
+ * @leaves_len: Length of @leaves in bytes
+ * @index: Index of the current chunk
+ * @fill: Number of bytes hashed in the current chunk
+ */
+struct fit_stream_hash {
+	struct hash_algo *algo;
+	void *ctx;
+	int noffset;
+	ulong chunk_size;
+	const u8 *leaves;
+	int leaves_len;
+	ulong index;
+	ulong fill;
+};
+
+/**
+ * struct fit_stream_image - state of an image being loaded
+ *
+ * @hash: Hashes being calculated
+ * @nhash: Number of entries in @hash
+ * @comp: Compression type (IH_COMP_...)
+ * @dst: Where the image is written
+ * @max_len: Maximum number of bytes to write at @dst
+ * @in: Number of (compressed) bytes processed so far
+ * @out: Number of bytes written to @dst so far
+ * @done: true once the end of the compressed stream has been seen
+ * @zs: zlib state, for IH_COMP_GZIP
+ * @zds: zstd state, for IH_COMP_ZSTD
+ * @zws: Workspace for @zds
+ * @stage: Buffer collecting the data, which is copied or decompressed to
+ *	@dst once it has all been read and checked
+ * @gate: Chunk size of the hash tree which data must pass before it is
+ *	decompressed, 0 if none
+ * @pend: Data of the current hash-tree chunk, held back until it is checked
+ * @pend_fill: Number of bytes in @pend
+ */
+struct fit_stream_image {
+	struct fit_stream_hash hash[FIT_STREAM_MAX_HASHES];
+	int nhash;
+	u8 comp;
+	void *dst;
+	ulong max_len;
+	ulong in;
+	ulong out;
+	bool done;
+	z_stream zs;
+	zstd_dstream *zds;
+	void *zws;
+	void *stage;
+	ulong gate;
+	void *pend;
+	ulong pend_fill;
+};
+
+struct fit_stream_blk {
+	struct blk_desc *desc;
+	lbaint_t start;
+	struct blk_async req;
+	bool pending;
+	void *bounce;
+};
+
+struct fit_stream_fs {
+	struct blk_desc *desc;
+	int part;
+	char *ifname;
+	char *dev_part_str;
+	char *filename;
+};
+
+static int fit_stream_blk_read(struct fit_stream *strm, ulong offset,
+			       ulong size, void *buf)
+{
+	struct fit_stream_blk *priv = strm->priv;
+	struct blk_desc *desc = priv->desc;
+	ulong blksz = desc->blksz;
+	lbaint_t blk = priv->start + offset / blksz;
+	ulong skip = offset % blksz;
+	ulong len;
+
+	while (size) {
+		if (skip || size < blksz) {
+			len = min(size, blksz - skip);
+			if (blk_dread(desc, blk, 1, priv->bounce) != 1)
+				return -EIO;
+			memcpy(buf, priv->bounce + skip, len);
+			skip = 0;
+			blk++;
+		} else {
+			lbaint_t cnt = size / blksz;
+
+			if (blk_dread(desc, blk, cnt, buf) != cnt)
+				return -EIO;
+			len = cnt * blksz;
+			blk += cnt;
+		}
+		buf += len;
+		size -= len;
+	}
+
+	return 0;
+}
+
+static int fit_stream_blk_start(struct fit_stream *strm, ulong offset,
+				ulong size, void *buf)
+{
+	struct fit_stream_blk *priv = strm->priv;
+	ulong blksz = priv->desc->blksz;
+	int ret;
+
+	if (offset % blksz || size % blksz)
+		return fit_stream_blk_read(strm, offset, size, buf);
+
+	ret = blk_dread_async(priv->desc, priv->start + offset / blksz,
+			      size / blksz, buf, &priv->req);
+	if (ret)
+		return ret;
+	priv->pending = true;
+
+	return 0;
+}
+
+static int fit_stream_blk_wait(struct fit_stream *strm)
+{
+	struct fit_stream_blk *priv = strm->priv;
+	long ret;
+
+	if (!priv->pending)
+		return 0;
+	priv->pending = false;
+	ret = blk_async_wait(&priv->req);
+	if (ret < 0)
+		return ret;
+
+	return ret == priv->req.blkcnt ? 0 : -EIO;
+}
+
+static void fit_stream_blk_release(struct fit_stream *strm)
+{
+	struct fit_stream_blk *priv = strm->priv;
+
+	free(priv->bounce);
+	free(priv);
+}
+
+int fit_stream_init_blk(struct fit_stream *strm, struct blk_desc *desc,
+			ulong start)
+{
+	struct fit_stream_blk *priv;
+
+	memset(strm, '\0', sizeof(*strm));
+	priv = calloc(1, sizeof(*priv));
+	if (!priv)
+		return -ENOMEM;
+	priv->bounce = malloc_cache_aligned(desc->blksz);
+	if (!priv->bounce) {
+		free(priv);
+		return -ENOMEM;
+	}
+	priv->desc = desc;
+	priv->start = start;
+
+	if (start < desc->lba)
+		strm->size = (desc->lba - start) * desc->blksz;
+	strm->read = fit_stream_blk_read;
+	strm->read_start = fit_stream_blk_start;
+	strm->read_wait = fit_stream_blk_wait;
+	strm->release = fit_stream_blk_release;
+	strm->priv = priv;
+	strm->align = desc->blksz;
+
+	return 0;
+}
+
+/* Select the filesystem, which fs_read() and fs_size() forget each time */
+static int fit_stream_fs_set(struct fit_stream_fs *priv)
+{
+	int ret;
+
+	/* hostfs has no block device, so needs its name */
+	if (priv->desc)
+		ret = fs_set_blk_dev_with_part(priv->desc, priv->part);
+	else
+		ret = fs_set_blk_dev(priv->ifname, priv->dev_part_str,
+				     FS_TYPE_ANY);
+
+	return ret ? -ENODEV : 0;
+}
+
+static int fit_stream_fs_read(struct fit_stream *strm, ulong offset,
+			      ulong size, void *buf)
+{
+	struct fit_stream_fs *priv = strm->priv;
+	loff_t actread;
+	int ret;
+
+	ret = fit_stream_fs_set(priv);
+	if (ret)
+		return ret;
+	ret = fs_read(priv->filename, map_to_sysmem(buf), offset, size,
+		      &actread);
+	if (ret)
+		return ret;
+
+	return actread == size ? 0 : -EIO;
+}
+
+static void fit_stream_fs_release(struct fit_stream *strm)
+{
+	struct fit_stream_fs *priv = strm->priv;
+
+	free(priv->ifname);
+	free(priv->dev_part_str);
+	free(priv->filename);
+	free(priv);
+}
+
+int fit_stream_init_fs(struct fit_stream *strm, const char *ifname,
+		       const char *dev_part_str, const char *filename)
+{
+	struct fit_stream_fs *priv;
+	struct disk_partition info;
+	struct blk_desc *desc;
+	loff_t size;
+	int part;
+
+	memset(strm, '\0', sizeof(*strm));
+	part = part_get_info_by_dev_and_name_or_num(ifname, dev_part_str,
+						    &desc, &info, 1);
+	if (part < 0)
+		return -ENODEV;
+	priv = calloc(1, sizeof(*priv));
+	if (!priv)
+		return -ENOMEM;
+	priv->desc = desc;
+	priv->part = part;
+	priv->ifname = strdup(ifname);
+	priv->dev_part_str = strdup(dev_part_str);
+	priv->filename = strdup(filename);
+	strm->read = fit_stream_fs_read;
+	strm->release = fit_stream_fs_release;
+	strm->priv = priv;
+	if (!priv->ifname || !priv->dev_part_str || !priv->filename) {
+		fit_stream_close(strm);
+		return -ENOMEM;
+	}
+	if (fit_stream_fs_set(priv) || fs_size(filename, &size)) {
+		fit_stream_close(strm);
+		return -ENOENT;
+	}
+	strm->size = size;
+
+	return 0;
+}
+
+int fit_stream_open(struct fit_stream *strm)
+{
+	struct fdt_header hdr;
+	ulong size;
+	int ret;
+
+	if (!strm->align)
+		strm->align = 1;
+	if (!strm->chunk_size)
+		strm->chunk_size = CONFIG_FIT_STREAM_CHUNK_SIZE;
+	strm->chunk_size = roundup(strm->chunk_size, strm->align);
+
+	ret = strm->read(strm, 0, sizeof(hdr), &hdr);
+	if (ret)
+		return ret;
+	if (fdt_check_header(&hdr))
+		return -ENOEXEC;
+
+	/* the header is not checked yet, so do not trust its size */
+	size = fdt_totalsize(&hdr);
+	if (size > CONFIG_FIT_STREAM_MAX_STRUCT_SIZE ||
+	    (strm->size && size > strm->size)) {
+		log_debug("FIT structure too large (%lx bytes)\n", size);
+		return -E2BIG;
+	}
+	strm->fit = malloc(size);
+	if (!strm->fit)
+		return -ENOMEM;
+	ret = strm->read(strm, 0, size, strm->fit);
+	if (ret)
+		return ret;
+	ret = fit_check_format(strm->fit, size);
+	if (ret) {
+		log_debug("Bad FIT format (err=%d)\n", ret);
+		return -ENOEXEC;
+	}
+
+	return 0;
+}
+
+void fit_stream_close(struct fit_stream *strm)
+{
+	if (strm->release)
+		strm->release(strm);
+	free(strm->buf);
+	free(strm->fit);
+	strm->priv = NULL;
+	strm->buf = NULL;
+	strm->fit = NULL;
+}
+
+static int fit_stream_start(struct fit_stream *strm, ulong offset, ulong size,
+			    void *buf)
+{
+	if (strm->read_start)
+		return strm->read_start(strm, offset, size, buf);
+
+	return strm->read(strm, offset, size, buf);
+}
+
+static int fit_stream_wait(struct fit_stream *strm)
+{
+	return strm->read_wait ? strm->read_wait(strm) : 0;
+}
+
+/* Set up a hash context for each hash node of an image */
+static int fit_stream_hash_init(const void *fit, int noffset,
+				struct fit_stream_image *img)
+{
+	int node;
+
+	fdt_for_each_subnode(node, fit, noffset) {
+		const char *name = fit_get_name(fit, node, NULL);
+		struct fit_stream_hash *hash;
+		const char *algo;
+		int ret;
+
+		if (FIT_IMAGE_ENABLE_VERIFY &&
+		    !strncmp(name, FIT_SIG_NODENAME, strlen(FIT_SIG_NODENAME))) {
+			log_err("Image signatures need the whole image\n");
+			return -ENOSYS;
+		}
+		if (strncmp(name, FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (fdt_getprop(fit, node, FIT_IGNORE_PROP, NULL))
+			continue;
+		if (img->nhash == FIT_STREAM_MAX_HASHES)
+			return -E2BIG;
+		if (fit_image_hash_get_algo(fit, node, &algo))
+			return -EINVAL;
+
+		hash = &img->hash[img->nhash];
+		ret = hash_progressive_lookup_algo(algo, &hash->algo);
+		if (ret) {
+			log_err("Unsupported hash algorithm '%s'\n", algo);
+			return ret;
+		}
+		ret = fit_image_hash_get_chunk_size(fit, node,
+						    &hash->chunk_size);
+		if (ret == -EINVAL)
+			return ret;
+		if (!ret) {
+			hash->leaves = fdt_getprop(fit, node,
+						   FIT_CHUNK_HASHES_PROP,
+						   &hash->leaves_len);
+			if (!hash->leaves)
+				return -EINVAL;
+		}
+		ret = hash->algo->hash_init(hash->algo, &hash->ctx);
+		if (ret)
+			return ret;
+		hash->noffset = node;
+		img->nhash++;
+	}
+
+	return 0;
+}
+
+/*
+ * Finish a hash, giving the value in the form stored in the FIT. The
+ * progressive crc32 is in CPU order but FIT holds it big-endian, as
+ * calculated by crc32_wd_buf()
+ */
+static int fit_stream_hash_finish(struct fit_stream_hash *hash, u8 *value)
+{
+	struct hash_algo *algo = hash->algo;
+	int ret;
+
+	ret = algo->hash_finish(algo, hash->ctx, value, FIT_MAX_HASH_LEN);
+	hash->ctx = NULL;
+	if (ret)
+		return -EIO;
+	if (!strcmp(algo->name, "crc32"))
+		put_unaligned_be32(get_unaligned((u32 *)value), value);
+
+	return 0;
+}
+
+/* Finish the current chunk of a hash tree and check it */
+static int fit_stream_hash_leaf(struct fit_stream_hash *hash, u8 *value)
+{
+	struct hash_algo *algo = hash->algo;
+	ulong pos = hash->index * algo->digest_size;
+
+	if (fit_stream_hash_finish(hash, value))
+		return -EIO;
+	if (pos + algo->digest_size > hash->leaves_len ||
+	    memcmp(value, hash->leaves + pos, algo->digest_size)) {
+		printf("%s- ", algo->name);
+		return -EACCES;
+	}
+	hash->index++;
+	hash->fill = 0;
+
+	return 0;
+}
+
+/*
+ * Add data to a hash. Each complete chunk of a hash tree is checked straight
+ * away, so that bad data is caught before the rest of the image is read.
+ */
+static int fit_stream_hash_update(struct fit_stream_hash *hash,
+				  const void *buf, ulong len)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, value, FIT_MAX_HASH_LEN);
+	struct hash_algo *algo = hash->algo;
+	ulong todo;
+	int ret;
+
+	if (!hash->chunk_size)
+		return algo->hash_update(algo, hash->ctx, buf, len, 0) ?
+			-EIO : 0;
+
+	while (len) {
+		if (!hash->ctx && algo->hash_init(algo, &hash->ctx))
+			return -EIO;
+		todo = min(len, hash->chunk_size - hash->fill);
+		if (algo->hash_update(algo, hash->ctx, buf, todo, 0))
+			return -EIO;
+		hash->fill += todo;
+		buf += todo;
+		len -= todo;
+		if (hash->fill == hash->chunk_size) {
+			ret = fit_stream_hash_leaf(hash, value);
+			if (ret)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Finish a hash tree: check the last chunk and that all chunks were seen,
+ * then hash the chunk hashes
+ */
+static int fit_stream_hash_tree(struct fit_stream_hash *hash, u8 *value)
+{
+	struct hash_algo *algo = hash->algo;
+	int len, ret;
+
+	if (hash->fill) {
+		ret = fit_stream_hash_leaf(hash, value);
+		if (ret)
+			return ret;
+	} else if (hash->ctx) {
+		algo->hash_finish(algo, hash->ctx, value, FIT_MAX_HASH_LEN);
+		hash->ctx = NULL;
+	}
+	if (hash->index * algo->digest_size != hash->leaves_len) {
+		printf("%s- ", algo->name);
+		return -EACCES;
+	}
+
+	return calculate_hash(hash->leaves, hash->leaves_len, algo->name,
+			      value, &len) ? -EIO : 0;
+}
+
+/* Finish all hashes and compare them with the values in the FIT */
+static int fit_stream_hash_check(const void *fit, struct fit_stream_image *img,
+				 bool check)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, value, FIT_MAX_HASH_LEN);
+	int ret = 0;
+	int i;
+
+	for (i = 0; i < img->nhash; i++) {
+		struct fit_stream_hash *hash = &img->hash[i];
+		struct hash_algo *algo = hash->algo;
+		u8 *fit_value;
+		int fit_len;
+
+		if (!check || ret) {
+			if (hash->ctx)
+				algo->hash_finish(algo, hash->ctx, value,
+						  FIT_MAX_HASH_LEN);
+			hash->ctx = NULL;
+			continue;
+		}
+		if (hash->chunk_size) {
+			ret = fit_stream_hash_tree(hash, value);
+			if (ret)
+				continue;
+		} else {
+			ret = fit_stream_hash_finish(hash, value);
+			if (ret)
+				continue;
+		}
+
+		printf("%s", algo->name);
+		if (fit_image_hash_get_value(fit, hash->noffset, &fit_value,
+					     &fit_len) ||
+		    fit_len != algo->digest_size ||
+		    memcmp(value, fit_value, fit_len)) {
+			puts("- ");
+			ret = -EACCES;
+			continue;
+		}
+		puts("+ ");
+	}
+	img->nhash = 0;
+
+	return ret;
+}
+
+static int fit_stream_gunzip(struct fit_stream_image *img, const void *buf,
+			     ulong len)
+{
+	z_stream *s = &img->zs;
+	int ret;
+
+	if (!img->in) {
+		ret = gzip_parse_header(buf, len);
+		if (ret < 0)
+			return -EINVAL;
+		s->zalloc = gzalloc;
+		s->zfree = gzfree;
+		if (inflateInit2(s, -MAX_WBITS) != Z_OK)
+			return -ENOMEM;
+		buf += ret;
+		len -= ret;
+	}
+	if (!len)
+		return 0;
+
+	s->next_in = (void *)buf;
+	s->avail_in = len;
+	s->next_out = img->dst + img->out;
+	s->avail_out = img->max_len - img->out;
+	ret = inflate(s, Z_SYNC_FLUSH);
+	img->out = img->max_len - s->avail_out;
+	if (ret == Z_STREAM_END) {
+		/* the gzip trailer follows, which the hashes cover anyway */
+		img->done = true;
+		return 0;
+	}
+	if (!s->avail_out && s->avail_in)
+		return -E2BIG;
+
+	return ret == Z_OK ? 0 : -EINVAL;
+}
+
+static int fit_stream_unzstd(struct fit_stream_image *img, const void *buf,
+			     ulong len)
+{
+	zstd_in_buffer in = { .src = buf, .size = len };
+	zstd_out_buffer out = {
+		.dst = img->dst,
+		.size = img->max_len,
+		.pos = img->out,
+	};
+	size_t ret;
+
+	if (!img->zds) {
+		zstd_frame_header fh;
+		size_t wsize;
+
+		/* the frame header fits in any reasonable first chunk */
+		if (zstd_get_frame_header(&fh, buf, len))
+			return -EINVAL;
+		wsize = zstd_dstream_workspace_bound(fh.windowSize);
+		img->zws = malloc(wsize);
+		if (!img->zws)
+			return -ENOMEM;
+		img->zds = zstd_init_dstream(fh.windowSize, img->zws, wsize);
+		if (!img->zds)
+			return -EINVAL;
+	}
+
+	while (in.pos < in.size) {
+		ret = zstd_decompress_stream(img->zds, &out, &in);
+		img->out = out.pos;
+		if (zstd_is_error(ret)) {
+			log_debug("zstd error %d\n", zstd_get_error_code(ret));
+			return -EINVAL;
+		}
+		if (!ret) {
+			img->done = true;
+			break;
+		}
+		if (out.pos == out.size)
+			return -E2BIG;
+	}
+
+	return 0;
+}
+
+/* Pass image data on to the decompressor, or to the load address */
+static int fit_stream_commit(struct fit_stream_image *img, const void *buf,
+			     ulong len)
+{
+	int ret = 0;
+
+	if (img->stage) {
+		if (buf != img->stage + img->in)
+			memcpy(img->stage + img->in, buf, len);
+	} else if (img->comp == IH_COMP_NONE) {
+		if (img->out + len > img->max_len)
+			return -E2BIG;
+		if (buf != img->dst + img->out)
+			memcpy(img->dst + img->out, buf, len);
+		img->out += len;
+	} else if (img->done) {
+		/* trailing data after the compressed stream */
+	} else if (CONFIG_IS_ENABLED(GZIP) && img->comp == IH_COMP_GZIP) {
+		ret = fit_stream_gunzip(img, buf, len);
+	} else if (CONFIG_IS_ENABLED(ZSTD) && img->comp == IH_COMP_ZSTD) {
+		ret = fit_stream_unzstd(img, buf, len);
+	}
+	img->in += len;
+
+	return ret;
+}
+
+/*
+ * Hash a chunk of image data and pass it on. With a hash-tree gate, data is
+ * held back until its chunk of the tree has been checked, so that the
+ * decompressor only ever sees checked data.
+ */
+static int fit_stream_feed(struct fit_stream_image *img, const void *buf,
+			   ulong len)
+{
+	ulong todo;
+	int ret;
+	int i;
+
+	for (i = 0; i < img->nhash; i++) {
+		ret = fit_stream_hash_update(&img->hash[i], buf, len);
+		if (ret)
+			return ret;
+	}
+	if (!img->gate)
+		return fit_stream_commit(img, buf, len);
+
+	while (len) {
+		todo = min(len, img->gate - img->pend_fill);
+		memcpy(img->pend + img->pend_fill, buf, todo);
+		img->pend_fill += todo;
+		buf += todo;
+		len -= todo;
+		if (img->pend_fill == img->gate) {
+			img->pend_fill = 0;
+			ret = fit_stream_commit(img, img->pend, img->gate);
+			if (ret)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Where to read the chunk at @pos: straight to the staging buffer if there is
+ * one, or to the image if it is uncompressed and not being checked
+ */
+static void *fit_stream_chunk(struct fit_stream *strm,
+			      struct fit_stream_image *img, ulong pos, int idx)
+{
+	if (img->stage)
+		return img->stage + pos;
+	if (img->comp == IH_COMP_NONE && !img->nhash)
+		return img->dst + pos;
+
+	return strm->buf + idx * strm->chunk_size;
+}
+
+/*
+ * Read @size bytes of image data at @offset, starting to read each chunk
+ * before processing the previous one so that the two can overlap
+ */
+static int fit_stream_read_data(struct fit_stream *strm,
+				struct fit_stream_image *img, ulong offset,
+				ulong size)
+{
+	ulong len, next_len, pos;
+	void *cur, *next;
+	int idx = 0;
+	int ret;
+
+	len = min(size, strm->chunk_size - offset % strm->align);
+	cur = fit_stream_chunk(strm, img, 0, idx);
+	ret = fit_stream_start(strm, offset, len, cur);
+	if (ret)
+		return ret;
+
+	for (pos = 0; pos < size; pos += len, len = next_len, cur = next) {
+		ret = fit_stream_wait(strm);
+		if (ret)
+			return ret;
+
+		next_len = min(strm->chunk_size, size - pos - len);
+		next = NULL;
+		if (next_len) {
+			idx ^= 1;
+			next = fit_stream_chunk(strm, img, pos + len, idx);
+			ret = fit_stream_start(strm, offset + pos + len,
+					       next_len, next);
+			if (ret)
+				return ret;
+		}
+
+		ret = fit_stream_feed(img, cur, len);
+		if (ret) {
+			if (next_len)
+				fit_stream_wait(strm);
+			return ret;
+		}
+		schedule();
+	}
+
+	return 0;
+}
+
+/* Complete the image once all data has been fed in and checked */
+static int fit_stream_finish(struct fit_stream_image *img, ulong load,
+			     int type, ulong size)
+{
+	ulong load_end;
+	int ret;
+
+	if (img->pend_fill) {
+		ret = fit_stream_commit(img, img->pend, img->pend_fill);
+		if (ret)
+			return ret;
+	}
+	if (img->stage && img->comp == IH_COMP_NONE) {
+		memcpy(img->dst, img->stage, size);
+		img->out = size;
+		return 0;
+	}
+	if (img->comp == IH_COMP_NONE)
+		return 0;
+	if (!img->stage)
+		return img->done ? 0 : -EINVAL;
+
+	ret = image_decomp(img->comp, load, map_to_sysmem(img->stage), type,
+			   img->dst, img->stage, size, img->max_len, &load_end);
+	if (ret)
+		return ret;
+	img->out = load_end - load;
+
+	return 0;
+}
+
+static void fit_stream_image_free(struct fit_stream_image *img)
+{
+	if (img->comp == IH_COMP_GZIP && img->zs.state)
+		inflateEnd(&img->zs);
+	free(img->zws);
+	free(img->stage);
+	free(img->pend);
+}
+
+/* Whether data of this compression type can be decompressed as it arrives */
+static bool fit_stream_can_inflate(u8 comp)
+{
+	return (comp == IH_COMP_GZIP && CONFIG_IS_ENABLED(GZIP)) ||
+	       (comp == IH_COMP_ZSTD && CONFIG_IS_ENABLED(ZSTD));
+}
+
+/*
+ * Set up the buffers for an image. When verifying, data is only passed on as
+ * it arrives if it is covered by a hash tree, whose chunks are checked before
+ * they are passed on, and for a compressed image only if it can be
+ * decompressed as it arrives (gzip, zstd). Otherwise the data is collected
+ * and checked before it is copied or decompressed to the load address.
+ */
+static int fit_stream_prepare(struct fit_stream *strm,
+			      struct fit_stream_image *img, bool external,
+			      ulong size)
+{
+	int i;
+
+	for (i = 0; i < img->nhash; i++) {
+		if (img->hash[i].chunk_size) {
+			img->gate = img->hash[i].chunk_size;
+			break;
+		}
+	}
+	if ((img->comp != IH_COMP_NONE && !fit_stream_can_inflate(img->comp)) ||
+	    (img->nhash && !img->gate)) {
+		img->gate = 0;
+		img->stage = malloc(size);
+		if (!img->stage)
+			return -ENOMEM;
+	} else if (img->gate) {
+		img->pend = malloc(img->gate);
+		if (!img->pend)
+			return -ENOMEM;
+	}
+	if (!external || img->stage ||
+	    (img->comp == IH_COMP_NONE && !img->nhash))
+		return 0;
+
+	if (!strm->buf) {
+		strm->buf = malloc_cache_aligned(2 * strm->chunk_size);
+		if (!strm->buf)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+int fit_stream_load_image(struct fit_stream *strm, int noffset, ulong load,
+			  ulong max_len, bool verify, ulong *lenp)
+{
+	struct fit_stream_image img = {};
+	const void *fit = strm->fit;
+	bool external = true;
+	const void *data;
+	u8 type = IH_TYPE_INVALID;
+	int offset, len;
+	size_t size;
+	int ret;
+
+	if (fdt_subnode_offset(fit, noffset, FIT_CIPHER_NODENAME) >= 0) {
+		log_err("Ciphered images need the whole image\n");
+		return -ENOSYS;
+	}
+	if (fit_image_get_comp(fit, noffset, &img.comp))
+		img.comp = IH_COMP_NONE;
+	fit_image_get_type(fit, noffset, &type);
+
+	if (fit_image_get_data_position(fit, noffset, &offset)) {
+		if (!fit_image_get_data_offset(fit, noffset, &offset))
+			offset += ALIGN(fdt_totalsize(fit), 4);
+		else
+			external = false;
+	}
+	if (external) {
+		if (fit_image_get_data_size(fit, noffset, &len))
+			return -ENOENT;
+		size = len;
+		if (strm->size && (offset < 0 || len < 0 ||
+				   (ulong)offset + size > strm->size))
+			return -EINVAL;
+	} else if (fit_image_get_emb_data(fit, noffset, &data, &size)) {
+		return -ENOENT;
+	}
+
+	if (img.comp == IH_COMP_NONE && size > max_len)
+		return -E2BIG;
+
+	img.dst = map_sysmem(load, max_len);
+	img.max_len = max_len;
+	ret = 0;
+	if (verify)
+		ret = fit_stream_hash_init(fit, noffset, &img);
+	if (!ret)
+		ret = fit_stream_prepare(strm, &img, external, size);
+	if (!ret) {
+		if (!external)
+			ret = fit_stream_feed(&img, data, size);
+		else
+			ret = fit_stream_read_data(strm, &img, offset, size);
+	}
+	if (fit_stream_hash_check(fit, &img, !ret) && !ret)
+		ret = -EACCES;
+	if (!ret)
+		ret = fit_stream_finish(&img, load, type, size);
+	if (!ret && type == IH_TYPE_FLATDT && fdt_check_header(img.dst))
+		ret = -ENOEXEC;
+	/* do not leave unchecked data at the load address */
+	if (ret && verify)
+		memset(img.dst, '\0', img.out);
+	unmap_sysmem(img.dst);
+	fit_stream_image_free(&img);
+	if (ret)
+		return ret;
+	*lenp = img.out;
+
+	return 0;
+}
+
+static const char *const fit_stream_props[] = {
+	FIT_KERNEL_PROP,
+	FIT_FDT_PROP,
+	FIT_RAMDISK_PROP,
+	FIT_FIRMWARE_PROP,
+	FIT_LOADABLE_PROP,
+};
+
+/* Record a loaded image in @images, so that bootm can boot it */
+static int fit_stream_record(const void *fit, int noffset, const char *prop,
+			     ulong load, ulong len,
+			     struct bootm_headers *images)
+{
+	if (!strcmp(prop, FIT_KERNEL_PROP)) {
+		if (!fit_image_check_target_arch(fit, noffset) ||
+		    fit_image_get_type(fit, noffset, &images->os.type) ||
+		    fit_image_get_os(fit, noffset, &images->os.os) ||
+		    fit_image_get_arch(fit, noffset, &images->os.arch)) {
+			puts("Unsupported kernel image\n");
+			return -EPROTOTYPE;
+		}
+		/* the kernel is already decompressed at its load address */
+		images->os.comp = IH_COMP_NONE;
+		images->os.load = load;
+		images->os.start = load;
+		images->os.end = load + len;
+		images->os.image_start = load;
+		images->os.image_len = len;
+		if (fit_image_get_entry(fit, noffset, &images->ep))
+			images->ep = load;
+	} else if (!strcmp(prop, FIT_RAMDISK_PROP)) {
+		images->rd_start = load;
+		images->rd_end = load + len;
+	} else if (!strcmp(prop, FIT_FDT_PROP) && !images->ft_addr) {
+		images->ft_addr = map_sysmem(load, len);
+		images->ft_len = len;
+	}
+
+	return 0;
+}
+
+/*
+ * Reserve the destination of an image before anything is written to it, as
+ * much as is free up to CONFIG_SYS_BOOTM_LEN if the size is not known yet.
+ * The region is added to @resv, which holds those of the images loaded so
+ * far: lmb does not stop two ordinary reservations from overlapping.
+ */
+static int fit_stream_reserve(struct alist *resv, const void *fit,
+			      int noffset, ulong load, ulong *max_lenp)
+{
+	struct lmb_region rgn = { .base = load, .flags = LMB_NONE };
+	const struct lmb_region *old;
+	int len;
+	u8 comp;
+
+	if (fit_image_get_comp(fit, noffset, &comp))
+		comp = IH_COMP_NONE;
+	rgn.size = CONFIG_SYS_BOOTM_LEN;
+	if (comp == IH_COMP_NONE) {
+		if (!fit_image_get_data_size(fit, noffset, &len) ||
+		    fdt_getprop(fit, noffset, FIT_DATA_PROP, &len))
+			rgn.size = min_t(phys_size_t, rgn.size, len);
+	} else if (CONFIG_IS_ENABLED(LMB)) {
+		rgn.size = min(rgn.size, lmb_get_free_size(load));
+		if (!rgn.size)
+			return -EEXIST;
+	}
+
+	alist_for_each(old, resv) {
+		if (load < old->base + old->size &&
+		    old->base < load + rgn.size)
+			return -EEXIST;
+	}
+	if (CONFIG_IS_ENABLED(LMB) &&
+	    lmb_alloc_mem(LMB_MEM_ALLOC_ADDR, 0, &rgn.base, rgn.size,
+			  rgn.flags))
+		return -EEXIST;
+	if (!alist_add(resv, rgn)) {
+		if (CONFIG_IS_ENABLED(LMB))
+			lmb_free(rgn.base, rgn.size, rgn.flags);
+		return -ENOMEM;
+	}
+	*max_lenp = rgn.size;
+
+	return 0;
+}
+
+/* Shrink the last reservation to the size of the loaded image */
+static void fit_stream_reserve_trim(struct alist *resv, ulong len)
+{
+	struct lmb_region *rgn = alist_getw(resv, resv->count - 1,
+					    struct lmb_region);
+
+	if (len >= rgn->size)
+		return;
+	if (CONFIG_IS_ENABLED(LMB))
+		lmb_free(rgn->base + len, rgn->size - len, rgn->flags);
+	rgn->size = len;
+}
+
+static void fit_stream_unreserve(struct alist *resv)
+{
+	const struct lmb_region *rgn;
+
+	if (CONFIG_IS_ENABLED(LMB)) {
+		alist_for_each(rgn, resv) {
+			if (rgn->size)
+				lmb_free(rgn->base, rgn->size, rgn->flags);
+		}
+	}
+	alist_uninit(resv);
+}
+
+int fit_stream_load_config(struct fit_stream *strm, const char *conf_uname,
+			   bool verify, struct bootm_headers *images)
+{
+	const void *fit = strm->fit;
+	struct alist resv;
+	int cfg_noffset;
+	int i, ret;
+
+	cfg_noffset = fit_conf_get_node(fit, conf_uname);
+	if (cfg_noffset < 0)
+		return -ENOENT;
+	printf("   Using '%s' configuration\n",
+	       fdt_get_name(fit, cfg_noffset, NULL));
+
+	if (verify && FIT_IMAGE_ENABLE_VERIFY) {
+		puts("   Verifying Hash Integrity ... ");
+		if (fit_config_verify(fit, cfg_noffset)) {
+			puts("Bad Data Hash\n");
+			return -EACCES;
+		}
+		puts("OK\n");
+	}
+
+	alist_init_struct(&resv, struct lmb_region);
+	for (i = 0, ret = 0; !ret && i < ARRAY_SIZE(fit_stream_props); i++) {
+		const char *prop = fit_stream_props[i];
+		int count, j;
+
+		count = fit_conf_get_prop_node_count(fit, cfg_noffset, prop);
+		for (j = 0; !ret && j < count; j++) {
+			ulong load, len, max_len;
+			const char *name;
+			int noffset;
+
+			noffset = fit_conf_get_prop_node_index(fit, cfg_noffset,
+							       prop, j);
+			if (noffset < 0) {
+				ret = -ENOENT;
+				break;
+			}
+			name = fit_get_name(fit, noffset, NULL);
+			if (fit_image_get_load(fit, noffset, &load)) {
+				printf("   Skipping '%s': no load address\n",
+				       name);
+				continue;
+			}
+
+			printf("   Loading %s '%s' to %08lx ... ", prop, name,
+			       load);
+			ret = fit_stream_reserve(&resv, fit, noffset, load,
+						 &max_len);
+			if (ret) {
+				printf("memory in use (err=%d)\n", ret);
+				break;
+			}
+			ret = fit_stream_load_image(strm, noffset, load,
+						    max_len, verify, &len);
+			if (ret) {
+				printf("error %d\n", ret);
+				break;
+			}
+			fit_stream_reserve_trim(&resv, len);
+			printf("OK (%lx bytes)\n", len);
+			if (images)
+				ret = fit_stream_record(fit, noffset, prop,
+							load, len, images);
+		}
+	}
+
+	/* the images stay reserved for booting, as bootm_load_os() does */
+	if (ret || !images)
+		fit_stream_unreserve(&resv);
+	else
+		alist_uninit(&resv);
+
+	return ret;
+}
@@ -190,6 +190,7 @@ static void fit_image_print_data(const void *fit, int noffset, const char *p,
 	int value_len;
 	const char *algo;
 	const char *padding;
+	ulong chunk_size;
 	bool required;
 	int ret, i;
 
@@ -213,6 +214,9 @@ static void fit_image_print_data(const void *fit, int noffset, const char *p,
 	if (padding)
 		printf("%s  %s padding: %s\n", p, type, padding);
 
+	if (!fit_image_hash_get_chunk_size(fit, noffset, &chunk_size))
+		printf("%s  %s chunks:  %lx bytes\n", p, type, chunk_size);
+
 	ret = fit_image_hash_get_value(fit, noffset, &value,
 				       &value_len);
 	printf("%s  %s value:   ", p, type);
@@ -1165,6 +1169,37 @@ static int fit_image_hash_get_ignore(const void *fit, int noffset, int *ignore)
 	return 0;
 }
 
+/**
+ * fit_image_hash_get_chunk_size - get the chunk size of a hash tree
+ * @fit: pointer to the FIT format image header
+ * @noffset: hash node offset
+ * @chunk_size: pointer to ulong, will hold the chunk size
+ *
+ * A hash node with a 'chunk-size' property holds a hash tree: the
+ * 'chunk-hashes' property holds the hash of each chunk of the image data and
+ * 'value' holds the hash of 'chunk-hashes'.
+ *
+ * returns:
+ *     0, on success
+ *     -ENOENT, if the hash node does not hold a hash tree
+ *     -EINVAL, if the chunk size is invalid
+ */
+int fit_image_hash_get_chunk_size(const void *fit, int noffset,
+				  ulong *chunk_size)
+{
+	const fdt32_t *val;
+	int len;
+
+	val = fdt_getprop(fit, noffset, FIT_CHUNK_SIZE_PROP, &len);
+	if (!val)
+		return -ENOENT;
+	if (len != sizeof(*val) || !fdt32_to_cpu(*val))
+		return -EINVAL;
+	*chunk_size = fdt32_to_cpu(*val);
+
+	return 0;
+}
+
 /**
  * fit_image_cipher_get_algo - get cipher algorithm name
  * @fit: pointer to the FIT format image header
@@ -1290,11 +1325,108 @@ int calculate_hash(const void *data, int data_len, const char *name,
 	return 0;
 }
 
+int fit_calc_hash_tree(const void *data, size_t size, const char *algo,
+		       ulong chunk_size, uint8_t *leaves, int *leaves_len,
+		       uint8_t *value, int *value_len)
+{
+	size_t offset;
+	int len = 0;
+
+	for (offset = 0; offset < size; offset += chunk_size) {
+		size_t chunk = size - offset;
+
+		if (chunk > chunk_size)
+			chunk = chunk_size;
+
+		if (calculate_hash(data + offset, chunk, algo, leaves + len,
+				   value_len))
+			return -1;
+		len += *value_len;
+	}
+	*leaves_len = len;
+
+	return calculate_hash(leaves, len, algo, value, value_len);
+}
+
+int fit_image_check_chunk(const void *fit, int noffset, ulong index,
+			  const void *data, size_t size)
+{
+	uint8_t value[FIT_MAX_HASH_LEN];
+	const uint8_t *leaves;
+	const char *algo;
+	ulong chunk_size;
+	int leaves_len;
+	int value_len;
+
+	if (fit_image_hash_get_chunk_size(fit, noffset, &chunk_size) ||
+	    size > chunk_size || fit_image_hash_get_algo(fit, noffset, &algo))
+		return -EINVAL;
+	leaves = fdt_getprop(fit, noffset, FIT_CHUNK_HASHES_PROP, &leaves_len);
+	if (!leaves)
+		return -EINVAL;
+	if (calculate_hash(data, size, algo, value, &value_len))
+		return -EPROTONOSUPPORT;
+	if ((index + 1) * value_len > leaves_len)
+		return -ERANGE;
+	if (memcmp(value, leaves + index * value_len, value_len))
+		return -EACCES;
+
+	return 0;
+}
+
+/*
+ * Check each chunk of the data against the chunk hashes of a hash tree and
+ * calculate the root hash into @value
+ */
+static int fit_image_check_hash_tree(const void *fit, int noffset,
+				     const void *data, size_t size,
+				     const char *algo, ulong chunk_size,
+				     uint8_t *value, int *value_len,
+				     char **err_msgp)
+{
+	const uint8_t *leaves;
+	size_t offset;
+	int leaves_len;
+	int len = 0;
+
+	leaves = fdt_getprop(fit, noffset, FIT_CHUNK_HASHES_PROP, &leaves_len);
+	if (!leaves) {
+		*err_msgp = "Can't get chunk hashes property";
+		return -1;
+	}
+
+	for (offset = 0; offset < size; offset += chunk_size) {
+		size_t chunk = size - offset;
+
+		if (chunk > chunk_size)
+			chunk = chunk_size;
+
+		if (calculate_hash(data + offset, chunk, algo, value,
+				   value_len)) {
+			*err_msgp = "Unsupported hash algorithm";
+			return -1;
+		}
+		if (len + *value_len > leaves_len ||
+		    memcmp(value, leaves + len, *value_len)) {
+			*err_msgp = "Bad chunk hash value";
+			return -1;
+		}
+		len += *value_len;
+	}
+	if (len != leaves_len) {
+		*err_msgp = "Bad chunk hashes len";
+		return -1;
+	}
+
+	return calculate_hash(leaves, leaves_len, algo, value, value_len);
+}
+
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 				size_t size, char **err_msgp)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(uint8_t, value, FIT_MAX_HASH_LEN);
 	int value_len;
+	ulong chunk_size;
 	const char *algo;
 	uint8_t *fit_value;
 	int fit_value_len;
@@ -1322,7 +1454,12 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
+	if (!fit_image_hash_get_chunk_size(fit, noffset, &chunk_size)) {
+		if (fit_image_check_hash_tree(fit, noffset, data, size, algo,
+					      chunk_size, value, &value_len,
+					      err_msgp))
+			return -1;
+	} else if (calculate_hash(data, size, algo, value, &value_len)) {
 		*err_msgp = "Unsupported hash algorithm";
 		return -1;
 	}
@@ -4,25 +4,59 @@
  * Author: Eric Nelson<eric@nelint.com>
  *
  */
+#include <blk.h>
 #include <command.h>
 #include <config.h>
 #include <malloc.h>
 #include <part.h>
 #include <vsprintf.h>
 
+static int blkc_get_dev(char *const argv[], struct blk_desc **descp)
+{
+	struct blk_desc *desc;
+
+	desc = blk_get_devnum_by_uclass_idname(argv[0],
+					       simple_strtoul(argv[1], 0, 0));
+	if (!desc) {
+		printf("No such block device: %s %s\n", argv[0], argv[1]);
+		return CMD_RET_FAILURE;
+	}
+	*descp = desc;
+
+	return 0;
+}
+
 static int blkc_show(struct cmd_tbl *cmdtp, int flag,
 		     int argc, char *const argv[])
 {
 	struct block_cache_stats stats;
-	blkcache_stats(&stats);
+	struct blk_desc *desc;
+
+	if (argc == 3) {
+		if (blkc_get_dev(argv + 1, &desc))
+			return CMD_RET_FAILURE;
+		if (blkcache_dev_stats(desc->uclass_id, desc->devnum,
+				       &stats)) {
+			printf("%s %s: not cached yet\n", argv[1], argv[2]);
+			return 0;
+		}
+	} else if (argc == 1) {
+		blkcache_stats(&stats);
+	} else {
+		return CMD_RET_USAGE;
+	}
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
+	       "evictions: %u\n"
+	       "bytes saved: %llu\n"
 	       "entries: %u\n"
 	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
-	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       "max cache entries: %u\n"
+	       "entries/set: %u\n",
+	       stats.hits, stats.misses, stats.evictions,
+	       (unsigned long long)stats.bytes_saved, stats.entries,
+	       stats.max_blocks_per_entry, stats.max_entries, stats.ways);
 	return 0;
 }
 
@@ -30,20 +64,31 @@ static int blkc_configure(struct cmd_tbl *cmdtp, int flag,
 			  int argc, char *const argv[])
 {
 	unsigned blocks_per_entry, max_entries;
-	if (argc != 3)
+	struct blk_desc *desc;
+
+	if (argc != 3 && argc != 5)
 		return CMD_RET_USAGE;
 
 	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
 	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
+	if (argc == 5) {
+		if (blkc_get_dev(argv + 3, &desc))
+			return CMD_RET_FAILURE;
+		if (blkcache_configure_dev(desc->uclass_id, desc->devnum,
+					   blocks_per_entry, max_entries))
+			return CMD_RET_FAILURE;
+		printf("%s %s: ", argv[3], argv[4]);
+	} else {
+		blkcache_configure(blocks_per_entry, max_entries);
+	}
 	printf("changed to max of %u entries of %u blocks each\n",
 	       max_entries, blocks_per_entry);
 	return 0;
 }
 
 static struct cmd_tbl cmd_blkc_sub[] = {
-	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
-	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(show, 3, 0, blkc_show, "", ""),
+	U_BOOT_CMD_MKENT(configure, 5, 0, blkc_configure, "", ""),
 };
 
 static int do_blkcache(struct cmd_tbl *cmdtp, int flag,
@@ -67,9 +112,9 @@ static int do_blkcache(struct cmd_tbl *cmdtp, int flag,
 }
 
 U_BOOT_CMD(
-	blkcache, 4, 0, do_blkcache,
+	blkcache, 6, 0, do_blkcache,
 	"block cache diagnostics and control",
-	"show - show and reset statistics\n"
-	"blkcache configure <blocks> <entries> "
+	"show [<interface> <dev>] - show and reset statistics\n"
+	"blkcache configure <blocks> <entries> [<interface> <dev>] "
 	"- set max blocks per entry and max cache entries\n"
 );
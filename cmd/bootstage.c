@@ -5,6 +5,8 @@
 
 #include <bootstage.h>
 #include <command.h>
+#include <env.h>
+#include <mapmem.h>
 #include <vsprintf.h>
 #include <linux/string.h>
 
@@ -16,6 +18,34 @@ static int do_bootstage_report(struct cmd_tbl *cmdtp, int flag, int argc,
 	return 0;
 }
 
+static int do_bootstage_export(struct cmd_tbl *cmdtp, int flag, int argc,
+			       char *const argv[])
+{
+	ulong addr, size;
+	char *buf;
+	int len;
+
+	if (argc == 1) {
+		bootstage_export(NULL, 0);
+		return 0;
+	}
+	if (argc != 3)
+		return CMD_RET_USAGE;
+
+	addr = hextoul(argv[1], NULL);
+	size = hextoul(argv[2], NULL);
+	buf = map_sysmem(addr, size);
+	len = bootstage_export(buf, size);
+	unmap_sysmem(buf);
+	if (len >= size) {
+		printf("Need %x bytes for the export\n", len + 1);
+		return CMD_RET_FAILURE;
+	}
+	env_set_hex("filesize", len);
+
+	return 0;
+}
+
 #if IS_ENABLED(CONFIG_BOOTSTAGE_STASH)
 static int get_base_size(int argc, char *const argv[], ulong *basep,
 			 ulong *sizep)
@@ -64,6 +94,7 @@ static int do_bootstage_stash(struct cmd_tbl *cmdtp, int flag, int argc,
 
 static struct cmd_tbl cmd_bootstage_sub[] = {
 	U_BOOT_CMD_MKENT(report, 2, 1, do_bootstage_report, "", ""),
+	U_BOOT_CMD_MKENT(export, 3, 1, do_bootstage_export, "", ""),
 #if IS_ENABLED(CONFIG_BOOTSTAGE_STASH)
 	U_BOOT_CMD_MKENT(stash, 4, 0, do_bootstage_stash, "", ""),
 	U_BOOT_CMD_MKENT(unstash, 4, 0, do_bootstage_stash, "", ""),
@@ -95,6 +126,7 @@ U_BOOT_CMD(bootstage, 4, 1, do_boostage,
 	"Boot stage command",
 	" - check boot progress and timing\n"
 	"report                      - Print a report\n"
+	"export [<addr> <size>]      - Write all records as text, for proftool\n"
 #if IS_ENABLED(CONFIG_BOOTSTAGE_STASH)
 	"stash [<start> [<size>]]    - Stash data into memory\n"
 	"unstash [<start> [<size>]]  - Unstash data from memory\n"
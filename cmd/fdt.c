@@ -9,6 +9,7 @@
 
 #include <command.h>
 #include <env.h>
+#include <fdt_index.h>
 #include <image.h>
 #include <linux/ctype.h>
 #include <linux/types.h>
@@ -284,6 +285,14 @@ static int do_fdt(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 		return CMD_RET_FAILURE;
 	}
 
+	/*
+	 * The working FDT may be the control FDT, so drop its index before any
+	 * command which may change it in place
+	 */
+	if (argv[1][0] != 'g' && argv[1][0] != 'p' && argv[1][0] != 'l' &&
+	    argv[1][0] != 'h' && strncmp(argv[1], "che", 3))
+		fdt_index_invalidate(working_fdt);
+
 #ifdef CONFIG_OF_SYSTEM_SETUP
 	/* Call the board-specific fixup routine */
 	if (strncmp(argv[1], "sys", 3) == 0) {
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Load the images of a FIT from storage without reading the whole FIT
+ */
+
+#include <blk.h>
+#include <bootm.h>
+#include <command.h>
+#include <env.h>
+#include <fit_stream.h>
+#include <part.h>
+#include <vsprintf.h>
+
+static int do_fitload(struct cmd_tbl *cmdtp, int flag, int argc,
+		      char *const argv[])
+{
+	struct fit_stream strm;
+	const char *conf = NULL;
+	bool raw = false;
+	bool boot = false;
+	int ret;
+
+	for (; argc > 1 && *argv[1] == '-'; argc--, argv++) {
+		if (!strcmp(argv[1], "-r"))
+			raw = true;
+		else if (!strcmp(argv[1], "-b"))
+			boot = true;
+		else
+			return CMD_RET_USAGE;
+	}
+	if (argc < 4 || argc > 5)
+		return CMD_RET_USAGE;
+	if (argc == 5)
+		conf = argv[4];
+
+	if (raw) {
+		struct blk_desc *desc;
+
+		if (blk_get_device_by_str(argv[1], argv[2], &desc) < 0)
+			return CMD_RET_FAILURE;
+		ret = fit_stream_init_blk(&strm, desc,
+					  hextoul(argv[3], NULL));
+	} else {
+		ret = fit_stream_init_fs(&strm, argv[1], argv[2], argv[3]);
+	}
+	if (ret) {
+		printf("Cannot set up FIT stream (err=%d)\n", ret);
+		return CMD_RET_FAILURE;
+	}
+
+	printf("## Loading FIT from %s %s %s\n", argv[1], argv[2], argv[3]);
+	ret = fit_stream_open(&strm);
+	if (ret) {
+		printf("Cannot read FIT (err=%d)\n", ret);
+	} else if (boot) {
+		struct bootm_info bmi;
+
+		bootm_init(&bmi);
+		ret = bootm_stream_run(&bmi, &strm, conf);
+	} else {
+		ret = fit_stream_load_config(&strm, conf,
+					     env_get_yesno("verify") != 0,
+					     NULL);
+	}
+	fit_stream_close(&strm);
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(fitload, 7, 0, do_fitload,
+	   "load the images of a FIT from storage",
+	   "[-b] <interface> <dev[:part]> <filename> [<config>]\n"
+	   "    - load from a file\n"
+	   "fitload [-b] -r <interface> <dev> <blk#> [<config>]\n"
+	   "    - load from a block device, starting at block <blk#> (hex)\n"
+	   "    -b: boot the configuration, as bootm does, once loaded"
+);
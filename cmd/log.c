@@ -375,6 +375,71 @@ static int do_log_rec(struct cmd_tbl *cmdtp, int flag, int argc,
 	return 0;
 }
 
+static int do_log_dump(struct cmd_tbl *cmdtp, int flag, int argc,
+		       char *const argv[])
+{
+	enum log_category_t cat_list[LOGF_MAX_CATEGORIES + 1];
+	enum log_level_t level = LOGL_MAX;
+	bool to_bloblist = false;
+	bool clear = false;
+	int cat_count = 0;
+	struct getopt_state gs;
+	int opt, ret;
+
+	if (!IS_ENABLED(CONFIG_LOG_RING)) {
+		printf("Log ring buffer is not enabled\n");
+		return CMD_RET_FAILURE;
+	}
+
+	getopt_init_state(&gs);
+	while ((opt = getopt(&gs, argc, argv, "bc:Cl:")) > 0) {
+		switch (opt) {
+		case 'b':
+			to_bloblist = true;
+			break;
+		case 'c':
+			if (cat_count >= LOGF_MAX_CATEGORIES) {
+				printf("Too many categories\n");
+				return CMD_RET_FAILURE;
+			}
+			cat_list[cat_count] = log_get_cat_by_name(gs.arg);
+			if (cat_list[cat_count] == LOGC_NONE) {
+				printf("Unknown category \"%s\"\n", gs.arg);
+				return CMD_RET_FAILURE;
+			}
+			cat_count++;
+			break;
+		case 'C':
+			clear = true;
+			break;
+		case 'l':
+			level = parse_log_level(gs.arg);
+			if (level == LOGL_NONE)
+				return CMD_RET_FAILURE;
+			break;
+		default:
+			return CMD_RET_USAGE;
+		}
+	}
+	if (gs.index != argc)
+		return CMD_RET_USAGE;
+	cat_list[cat_count] = LOGC_END;
+
+	if (to_bloblist) {
+		ret = log_ring_to_bloblist(level, cat_count ? cat_list : NULL);
+		if (ret) {
+			printf("Could not write to bloblist (err = %d)\n", ret);
+			return CMD_RET_FAILURE;
+		}
+	} else {
+		log_ring_dump(level, cat_count ? cat_list : NULL, NULL, 0);
+	}
+	if (clear)
+		log_ring_clear();
+
+	return CMD_RET_SUCCESS;
+}
+
 U_BOOT_LONGHELP(log,
 	"level [<level>] - get/set log level\n"
 	"categories - list log categories\n"
@@ -405,7 +470,13 @@ U_BOOT_LONGHELP(log,
 	"\tc=category, l=level, F=file, L=line number, f=function, m=msg\n"
 	"\tor 'default', or 'all' for all\n"
 	"log rec <category> <level> <file> <line> <func> <message> - "
-		"output a log record");
+		"output a log record\n"
+	"log dump [OPTIONS] - write out the records in the ring buffer\n"
+	"\t-b - Write them into the bloblist, rather than the console\n"
+	"\t-c <category> - Category to write out; may be specified multiple\n"
+	"\t                times\n"
+	"\t-C - Drop the records afterwards\n"
+	"\t-l <level> - Write out log levels less than or equal to <level>");
 
 U_BOOT_CMD_WITH_SUBCMDS(log, "log system", log_help_text,
 	U_BOOT_SUBCMD_MKENT(level, 2, 1, do_log_level),
@@ -417,4 +488,5 @@ U_BOOT_CMD_WITH_SUBCMDS(log, "log system", log_help_text,
 	U_BOOT_SUBCMD_MKENT(filter-remove, 4, 1, do_log_filter_remove),
 	U_BOOT_SUBCMD_MKENT(format, 2, 1, do_log_format),
 	U_BOOT_SUBCMD_MKENT(rec, 7, 1, do_log_rec),
+	U_BOOT_SUBCMD_MKENT(dump, CONFIG_SYS_MAXARGS, 1, do_log_dump),
 );
@@ -159,6 +159,7 @@ static struct mmc *__init_mmc_device(int dev, bool force_init,
 	struct blk_desc *bd = mmc_get_blk_desc(mmc);
 	blkcache_invalidate(bd->uclass_id, bd->devnum);
 #endif
+	blk_readahead_invalidate(mmc_get_blk_desc(mmc));
 
 	return mmc;
 }
@@ -18,6 +18,7 @@
 #include <log.h>
 #include <net.h>
 #include <net6.h>
+#include <net/sink.h>
 #include <net/udp.h>
 #include <net/sntp.h>
 #include <net/ncsi.h>
@@ -176,6 +177,45 @@ U_BOOT_CMD(
 );
 #endif
 
+#if defined(CONFIG_CMD_NETSINK)
+static int do_netsink(struct cmd_tbl *cmdtp, int flag, int argc,
+		      char *const argv[])
+{
+	struct net_sink *sink;
+	ulong buf_size = 0;
+
+	if (argc == 1) {
+		sink = net_sink_get();
+		printf("Next download goes to %s\n", sink ? sink->name : "memory");
+		return CMD_RET_SUCCESS;
+	}
+
+	if (argc == 2 && !strcmp(argv[1], "off")) {
+		net_sink_set(NULL, 0);
+		return CMD_RET_SUCCESS;
+	}
+
+	if (argc < 4 || strcmp(argv[1], "blk"))
+		return CMD_RET_USAGE;
+	if (argc > 4)
+		buf_size = hextoul(argv[4], NULL);
+	if (net_sink_set_blk(argv[2], argv[3], buf_size))
+		return CMD_RET_FAILURE;
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	netsink,   5,      0,      do_netsink,
+	"write the next download to a block device",
+	"blk <interface> <dev[:part]> [bufsize]\n"
+	"    - write the next tftpboot or wget download to 'dev' on\n"
+	"      'interface', using a staging buffer of 'bufsize' bytes\n"
+	"netsink off - load the next download into memory\n"
+	"netsink - show where the next download goes"
+);
+#endif
+
 static void netboot_update_env(void)
 {
 	char tmp[46];
@@ -356,6 +396,7 @@ static int netboot_common(enum proto_t proto, struct cmd_tbl *cmdtp, int argc,
 	char *s;
 	int   rcode = 0;
 	int   size;
+	bool  sink = net_sink_active();
 
 	net_boot_file_name_explicit = false;
 	*net_boot_file_name = '\0';
@@ -414,6 +455,10 @@ static int netboot_common(enum proto_t proto, struct cmd_tbl *cmdtp, int argc,
 
 	bootstage_mark(BOOTSTAGE_ID_NET_LOADED);
 
+	/* the file was written to storage, so there is nothing to boot */
+	if (sink)
+		return CMD_RET_SUCCESS;
+
 	rcode = bootm_maybe_autostart(cmdtp, argv[0]);
 
 	if (rcode == CMD_RET_SUCCESS)
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Command to control the sampling profiler
+ */
+
+#include <command.h>
+#include <env.h>
+#include <errno.h>
+#include <mapmem.h>
+#include <profile.h>
+#include <trace.h>
+#include <vsprintf.h>
+#include <linux/kernel.h>
+
+static int do_profile_start(struct cmd_tbl *cmdtp, int flag, int argc,
+			    char *const argv[])
+{
+	uint freq = CONFIG_PROFILE_FREQ;
+	int ret;
+
+	if (argc > 1)
+		freq = dectoul(argv[1], NULL);
+	ret = profile_start(freq);
+	if (ret) {
+		printf("Cannot start profiling (err=%d)\n", ret);
+		return CMD_RET_FAILURE;
+	}
+
+	return 0;
+}
+
+static int do_profile_stop(struct cmd_tbl *cmdtp, int flag, int argc,
+			   char *const argv[])
+{
+	if (profile_stop()) {
+		printf("Profiling is not running\n");
+		return CMD_RET_FAILURE;
+	}
+
+	return 0;
+}
+
+static int do_profile_stats(struct cmd_tbl *cmdtp, int flag, int argc,
+			    char *const argv[])
+{
+	profile_print_stats();
+
+	return 0;
+}
+
+/*
+ * This uses the same environment variables as 'trace calls', so that the
+ * samples can be put in the same buffer as the function trace
+ */
+static int do_profile_samples(struct cmd_tbl *cmdtp, int flag, int argc,
+			      char *const argv[])
+{
+	size_t buff_size, avail, buff_ptr, needed, used;
+	char *buff;
+
+	if (argc == 2)
+		return CMD_RET_USAGE;
+	if (argc < 3) {
+		buff_size = env_get_ulong("profsize", 16, 0);
+		buff = map_sysmem(env_get_ulong("profbase", 16, 0), buff_size);
+		buff_ptr = env_get_ulong("profoffset", 16, 0);
+	} else {
+		buff_size = hextoul(argv[2], NULL);
+		buff = map_sysmem(hextoul(argv[1], NULL), buff_size);
+		buff_ptr = 0;
+	}
+	if (buff_ptr > buff_size) {
+		printf("No space in buffer\n");
+		return CMD_RET_FAILURE;
+	}
+
+	avail = buff_size - buff_ptr;
+	if (profile_list_samples(buff + buff_ptr, avail, &needed))
+		printf("Error: truncated (%#zx bytes needed)\n", needed);
+	used = min(avail, needed);
+	printf("Samples dumped to %08lx, size %#zx\n",
+	       (ulong)map_to_sysmem(buff + buff_ptr), used);
+
+	env_set_hex("profbase", map_to_sysmem(buff));
+	env_set_hex("profsize", buff_size);
+	env_set_hex("profoffset", buff_ptr + used);
+
+	return 0;
+}
+
+U_BOOT_LONGHELP(profile,
+	"start [<freq>]          - start sampling, <freq> times a second\n"
+	"profile stop                    - stop sampling\n"
+	"profile stats                   - display sampling statistics\n"
+	"profile samples [<addr> <size>] - dump samples into buffer");
+
+U_BOOT_CMD_WITH_SUBCMDS(profile, "sampling profiler", profile_help_text,
+	U_BOOT_SUBCMD_MKENT(start, 2, 1, do_profile_start),
+	U_BOOT_SUBCMD_MKENT(stop, 1, 1, do_profile_stop),
+	U_BOOT_SUBCMD_MKENT(stats, 1, 1, do_profile_stats),
+	U_BOOT_SUBCMD_MKENT(samples, 3, 1, do_profile_samples));
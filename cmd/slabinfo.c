@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Show how the malloc() slabs are used
+ */
+
+#include <command.h>
+#include <malloc.h>
+
+static int do_slabinfo(struct cmd_tbl *cmdtp, int flag, int argc,
+		       char *const argv[])
+{
+	malloc_slab_info();
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	slabinfo,	1,	1,	do_slabinfo,
+	"show malloc() slab usage",
+	""
+);
@@ -40,3 +40,35 @@ U_BOOT_CMD(sqfsload, 7, 0, do_sqfs_load,
 	   "      ARCH_DMA_MINALIGN then a misaligned buffer warning will\n"
 	   "      be printed and performance will suffer for the load."
 );
+
+#if IS_ENABLED(CONFIG_SQUASHFS_CACHE)
+static int do_sqfs_cache_show(struct cmd_tbl *cmdtp, int flag, int argc,
+			      char *const argv[])
+{
+	struct sqfs_cache_stats stats;
+
+	sqfs_cache_stats(&stats);
+	printf("               hits     misses\n");
+	printf("tables   %10lu %10lu\n", stats.table_hits, stats.table_misses);
+	printf("entries  %10lu %10lu\n", stats.index_hits, stats.index_misses);
+	printf("frags    %10lu %10lu\n", stats.frag_hits, stats.frag_misses);
+	printf("drops: %lu\n", stats.drops);
+	printf("size: %lu bytes\n", stats.size);
+
+	return 0;
+}
+
+static int do_sqfs_cache_drop(struct cmd_tbl *cmdtp, int flag, int argc,
+			      char *const argv[])
+{
+	sqfs_cache_drop();
+
+	return 0;
+}
+
+U_BOOT_CMD_WITH_SUBCMDS(sqfscache, "SquashFS metadata cache",
+	"show - show and reset statistics\n"
+	"sqfscache drop - discard the cache",
+	U_BOOT_SUBCMD_MKENT(show, 1, 1, do_sqfs_cache_show),
+	U_BOOT_SUBCMD_MKENT(drop, 1, 1, do_sqfs_cache_drop));
+#endif
@@ -22,6 +22,7 @@
 #include <env.h>
 #include <env_internal.h>
 #include <event.h>
+#include <fdt_index.h>
 #include <fdtdec.h>
 #include <fs.h>
 #include <hang.h>
@@ -674,6 +675,9 @@ static int init_post(void)
 
 static int reloc_fdt(void)
 {
+	/* the index is in the pre-relocation malloc() area */
+	fdt_index_invalidate(gd->fdt_blob);
+
 	if (!IS_ENABLED(CONFIG_OF_EMBED)) {
 		if (gd->boardf->new_fdt) {
 			memcpy(gd->boardf->new_fdt, gd->fdt_blob,
@@ -764,6 +768,9 @@ static int setup_reloc(void)
 #if CONFIG_IS_ENABLED(OF_BOARD_FIXUP)
 static int fix_fdt(void)
 {
+	/* the board may change the tree in place */
+	fdt_index_invalidate(gd->fdt_blob);
+
 	return board_fix_fdt((void *)gd->fdt_blob);
 }
 #endif
@@ -827,6 +834,21 @@ static int initf_bootstage(void)
 	return 0;
 }
 
+static int initf_of_index(void)
+{
+	if (CONFIG_IS_ENABLED(OF_INDEX_PRE_RELOC)) {
+		int ret;
+
+		bootstage_start(BOOTSTAGE_ID_ACCUM_OF_INDEX, "of_index");
+		ret = fdt_index_build(gd->fdt_blob);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_OF_INDEX);
+		if (ret)
+			log_warning("Cannot index devicetree (err=%d)\n", ret);
+	}
+
+	return 0;
+}
+
 static int initf_dm(void)
 {
 	int ret;
@@ -915,6 +937,7 @@ static void initcall_run_f(void)
 	INITCALL_EVT(EVT_FSP_INIT_F);
 	INITCALL(arch_cpu_init);	/* basic arch cpu dependent setup */
 	INITCALL(mach_cpu_init);	/* SoC/machine dependent CPU setup */
+	INITCALL(initf_of_index);
 	INITCALL(initf_dm);
 #if CONFIG_IS_ENABLED(BOARD_EARLY_INIT_F)
 	INITCALL(board_early_init_f);
@@ -16,6 +16,7 @@
 #include <cyclic.h>
 #include <display_options.h>
 #include <exports.h>
+#include <fdt_index.h>
 #ifdef CONFIG_MTD_NOR_FLASH
 #include <flash.h>
 #endif
@@ -252,6 +253,22 @@ static int initr_of_live(void)
 	return 0;
 }
 
+static int initr_of_index(void)
+{
+	/* with a live tree, the ofnode functions do not use the flat tree */
+	if (CONFIG_IS_ENABLED(OF_INDEX) && !of_live_active()) {
+		int ret;
+
+		bootstage_start(BOOTSTAGE_ID_ACCUM_OF_INDEX, "of_index");
+		ret = fdt_index_build(gd->fdt_blob);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_OF_INDEX);
+		if (ret)
+			log_warning("Cannot index devicetree (err=%d)\n", ret);
+	}
+
+	return 0;
+}
+
 #ifdef CONFIG_DM
 static int initr_dm(void)
 {
@@ -632,6 +649,7 @@ static void initcall_run_r(void)
 	INITCALL(noncached_init);
 #endif
 	INITCALL(initr_of_live);
+	INITCALL(initr_of_index);
 #if CONFIG_IS_ENABLED(DM)
 	INITCALL(initr_dm);
 #endif
@@ -17,6 +17,7 @@
 #include <sort.h>
 #include <spl.h>
 #include <asm/global_data.h>
+#include <dm/uclass.h>
 #include <linux/compiler.h>
 #include <linux/libfdt.h>
 
@@ -24,24 +25,67 @@ DECLARE_GLOBAL_DATA_PTR;
 
 enum {
 	RECORD_COUNT = CONFIG_VAL(BOOTSTAGE_RECORD_COUNT),
+
+	/* Records kept back from device probes, for marks and accumulators */
+	RECORD_RESERVE = RECORD_COUNT / 8,
+
+	/* Hash table: two entries per device record, kept at most half full */
+	HASH_SIZE = RECORD_COUNT * 4,
+
+	/* Maximum nesting of bootstage_start() / bootstage_accum() pairs */
+	SCOPE_DEPTH = 16,
 };
 
+/**
+ * struct bootstage_record - a mark, an accumulator or a device probe
+ *
+ * @time_us: Time of the mark, or total time for an accumulator
+ * @start_us: Time of the last bootstage_start(), 0 for a mark
+ * @name: Name of the record, or NULL to use the ID
+ * @flags: see enum bootstage_flags
+ * @id: ID of the record
+ * @parent: ID of the accumulator which was running when this accumulator was
+ *	first started, or 0 if none
+ * @first_us: Time of the first bootstage_start()
+ * @child_us: Time spent in nested accumulators, included in @time_us
+ * @count: Number of bootstage_accum() calls, stopping at U16_MAX
+ * @uclass_id: Uclass of the device, for BOOTSTAGEF_PROBE records
+ */
 struct bootstage_record {
 	ulong time_us;
 	uint32_t start_us;
 	const char *name;
 	int flags;		/* see enum bootstage_flags */
 	enum bootstage_id id;
+	enum bootstage_id parent;
+	uint32_t first_us;
+	uint32_t child_us;
+	u16 count;
+	s16 uclass_id;
 };
 
+/**
+ * struct bootstage_data - all bootstage information
+ *
+ * @rec_count: Number of records in use
+ * @next_id: Next ID to allocate
+ * @depth: Number of accumulators currently running
+ * @scope: Record index of each running accumulator, innermost last
+ * @hash: Index + 1 of the record for each hash slot, 0 if empty. Records are
+ *	hashed by ID and device records by name as well
+ * @record: Records, in the order they were added
+ */
 struct bootstage_data {
 	uint rec_count;
 	uint next_id;
+	uint depth;
+	u16 scope[SCOPE_DEPTH];
+	u16 hash[HASH_SIZE];
 	struct bootstage_record record[RECORD_COUNT];
 };
 
 enum {
-	BOOTSTAGE_VERSION	= 0,
+	BOOTSTAGE_VERSION	= 1,
 	BOOTSTAGE_MAGIC		= 0xb00757a3,
 	BOOTSTAGE_DIGITS	= 9,
 };
@@ -83,14 +127,45 @@ int bootstage_relocate(void *to)
 	return 0;
 }
 
+static uint hash_name(const char *name, int uclass_id)
+{
+	uint hash = uclass_id;
+
+	while (*name)
+		hash = hash * 31 + *name++;
+
+	return hash;
+}
+
+/* Put record @idx in the first free slot from the one for @key */
+static void hash_add(struct bootstage_data *data, uint key, uint idx)
+{
+	uint slot;
+
+	for (slot = key % HASH_SIZE; data->hash[slot];
+	     slot = (slot + 1) % HASH_SIZE)
+		;
+	data->hash[slot] = idx + 1;
+}
+
+static void hash_record(struct bootstage_data *data, uint idx)
+{
+	struct bootstage_record *rec = &data->record[idx];
+
+	hash_add(data, rec->id, idx);
+	if (rec->flags & BOOTSTAGEF_PROBE)
+		hash_add(data, hash_name(rec->name, rec->uclass_id), idx);
+}
+
 struct bootstage_record *find_id(struct bootstage_data *data,
 				 enum bootstage_id id)
 {
 	struct bootstage_record *rec;
-	struct bootstage_record *end;
+	uint slot;
 
-	for (rec = data->record, end = rec + data->rec_count; rec < end;
-	     rec++) {
+	for (slot = (uint)id % HASH_SIZE; data->hash[slot];
+	     slot = (slot + 1) % HASH_SIZE) {
+		rec = &data->record[data->hash[slot] - 1];
 		if (rec->id == id)
 			return rec;
 	}
@@ -98,21 +173,63 @@ struct bootstage_record *find_id(struct bootstage_data *data,
 	return NULL;
 }
 
+static struct bootstage_record *find_probe(struct bootstage_data *data,
+					   const char *name, int uclass_id)
+{
+	struct bootstage_record *rec;
+	uint slot;
+
+	for (slot = hash_name(name, uclass_id) % HASH_SIZE; data->hash[slot];
+	     slot = (slot + 1) % HASH_SIZE) {
+		rec = &data->record[data->hash[slot] - 1];
+		if ((rec->flags & BOOTSTAGEF_PROBE) &&
+		    rec->uclass_id == uclass_id && !strcmp(rec->name, name))
+			return rec;
+	}
+
+	return NULL;
+}
+
+/* Add a record and hash it by ID, returning NULL if there is no space */
+static struct bootstage_record *new_record(struct bootstage_data *data,
+					   enum bootstage_id id,
+					   const char *name, int flags)
+{
+	struct bootstage_record *rec;
+
+	if (data->rec_count >= RECORD_COUNT)
+		return NULL;
+	rec = &data->record[data->rec_count];
+	memset(rec, '\0', sizeof(*rec));
+	rec->id = id;
+	rec->name = name;
+	rec->flags = flags;
+	hash_add(data, id, data->rec_count++);
+
+	return rec;
+}
+
 struct bootstage_record *ensure_id(struct bootstage_data *data,
 				   enum bootstage_id id)
 {
 	struct bootstage_record *rec;
 
 	rec = find_id(data, id);
-	if (!rec && data->rec_count < RECORD_COUNT) {
-		rec = &data->record[data->rec_count++];
-		rec->id = id;
-		return rec;
-	}
+	if (!rec)
+		rec = new_record(data, id, NULL, 0);
 
 	return rec;
 }
 
+/* Get the innermost running accumulator, or NULL if none */
+static struct bootstage_record *scope_top(struct bootstage_data *data)
+{
+	if (!data->depth || data->depth > SCOPE_DEPTH)
+		return NULL;
+
+	return &data->record[data->scope[data->depth - 1]];
+}
+
 ulong bootstage_add_record(enum bootstage_id id, const char *name,
 			   int flags, ulong mark)
 {
@@ -132,15 +249,11 @@ ulong bootstage_add_record(enum bootstage_id id, const char *name,
 	/* Only record the first event for each */
 	rec = find_id(data, id);
 	if (!rec) {
-		if (data->rec_count < RECORD_COUNT) {
-			rec = &data->record[data->rec_count++];
+		rec = new_record(data, id, name, flags);
+		if (rec)
 			rec->time_us = mark;
-			rec->name = name;
-			rec->flags = flags;
-			rec->id = id;
-		} else {
+		else
 			log_warning("Bootstage space exhausted\n");
-		}
 	}
 
 	/* Tell the board about this progress */
@@ -192,30 +305,92 @@ ulong bootstage_mark_code(const char *file, const char *func, int linenum)
 	return bootstage_mark_name(BOOTSTAGE_ID_ALLOC, str);
 }
 
+/* Start the accumulator @rec, nested inside whatever is running now */
+static uint32_t start_record(struct bootstage_data *data,
+			     struct bootstage_record *rec)
+{
+	struct bootstage_record *top = scope_top(data);
+	ulong start_us = timer_get_boot_us();
+
+	rec->start_us = start_us;
+	if (!rec->first_us) {
+		rec->first_us = start_us;
+		if (top && top != rec)
+			rec->parent = top->id;
+	}
+	if (data->depth < SCOPE_DEPTH)
+		data->scope[data->depth] = rec - data->record;
+	data->depth++;
+
+	return start_us;
+}
+
 uint32_t bootstage_start(enum bootstage_id id, const char *name)
 {
 	struct bootstage_data *data = gd->bootstage;
 	struct bootstage_record *rec = ensure_id(data, id);
-	ulong start_us = timer_get_boot_us();
 
-	if (rec) {
-		rec->start_us = start_us;
-		rec->name = name;
+	if (!rec)
+		return timer_get_boot_us();
+	rec->name = name;
+
+	return start_record(data, rec);
+}
+
+int bootstage_probe_start(const char *name, int uclass_id)
+{
+	struct bootstage_data *data = gd->bootstage;
+	struct bootstage_record *rec;
+
+	if (!data)
+		return -ENOENT;
+	rec = find_probe(data, name, uclass_id);
+	if (!rec) {
+		if (data->rec_count >= RECORD_COUNT - RECORD_RESERVE)
+			return -ENOSPC;
+		name = strdup(name);
+		if (!name)
+			return -ENOMEM;
+		rec = new_record(data, data->next_id++, name,
+				 BOOTSTAGEF_PROBE);
+		rec->uclass_id = uclass_id;
+		hash_add(data, hash_name(name, uclass_id), rec - data->record);
 	}
+	start_record(data, rec);
 
-	return start_us;
+	return rec->id;
 }
 
 uint32_t bootstage_accum(enum bootstage_id id)
 {
 	struct bootstage_data *data = gd->bootstage;
-	struct bootstage_record *rec = ensure_id(data, id);
+	struct bootstage_record *rec = scope_top(data);
 	uint32_t duration;
+	int i;
 
-	if (!rec)
-		return 0;
+	if (!rec || rec->id != id) {
+		rec = ensure_id(data, id);
+		if (!rec)
+			return 0;
+	}
 	duration = (uint32_t)timer_get_boot_us() - rec->start_us;
 	rec->time_us += duration;
+	if (rec->count < U16_MAX)
+		rec->count++;
+
+	/* Drop this accumulator and any inside it which were not ended */
+	for (i = min_t(int, data->depth, SCOPE_DEPTH) - 1; i >= 0; i--) {
+		if (&data->record[data->scope[i]] == rec) {
+			data->depth = i;
+			break;
+		}
+	}
+	if (i < 0 && data->depth > SCOPE_DEPTH)
+		data->depth--;
+
+	rec = scope_top(data);
+	if (rec)
+		rec->child_us += duration;
 
 	return duration;
 }
@@ -245,15 +420,10 @@ static uint32_t print_time_record(struct bootstage_record *rec, uint32_t prev)
 {
 	char buf[20];
 
-	if (prev == -1U) {
-		printf("%11s", "");
-		print_grouped_ull(rec->time_us, BOOTSTAGE_DIGITS);
-	} else {
-		if (prev > rec->time_us)
-			prev = 0;
-		print_grouped_ull(rec->time_us, BOOTSTAGE_DIGITS);
-		print_grouped_ull(rec->time_us - prev, BOOTSTAGE_DIGITS);
-	}
+	if (prev > rec->time_us)
+		prev = 0;
+	print_grouped_ull(rec->time_us, BOOTSTAGE_DIGITS);
+	print_grouped_ull(rec->time_us - prev, BOOTSTAGE_DIGITS);
 	printf("  %s\n", get_record_name(buf, sizeof(buf), rec));
 
 	return rec->time_us;
@@ -324,6 +494,97 @@ int bootstage_fdt_add_report(void)
 }
 #endif
 
+/*
+ * Get the parent of an accumulator, or 0 if it was not started inside another
+ * accumulator
+ */
+static enum bootstage_id scope_parent(struct bootstage_data *data,
+				      const struct bootstage_record *rec)
+{
+	if (!rec->parent || !find_id(data, rec->parent))
+		return 0;
+
+	return rec->parent;
+}
+
+/* Print the accumulators inside @parent, indented to show their nesting */
+static void print_scopes(struct bootstage_data *data, enum bootstage_id parent,
+			 int depth)
+{
+	struct bootstage_record *rec;
+	char buf[20];
+	int i;
+
+	for (i = 0, rec = data->record; i < data->rec_count; i++, rec++) {
+		if (!rec->start_us || (rec->flags & BOOTSTAGEF_PROBE))
+			continue;
+		if (scope_parent(data, rec) != parent)
+			continue;
+		printf("%11s", "");
+		print_grouped_ull(rec->time_us, BOOTSTAGE_DIGITS);
+		printf("  %*s%s\n", depth * 2, "",
+		       get_record_name(buf, sizeof(buf), rec));
+		if (depth < SCOPE_DEPTH)
+			print_scopes(data, rec->id, depth + 1);
+	}
+}
+
+/**
+ * struct uclass_total - probe time for the devices in a uclass
+ *
+ * @uclass_id: Uclass ID
+ * @devices: Number of devices which were probed
+ * @time_us: Time spent probing them, leaving out other devices probed at the
+ *	same time, such as their parents
+ */
+struct uclass_total {
+	int uclass_id;
+	int devices;
+	ulong time_us;
+};
+
+static int h_cmp_total(const void *v1, const void *v2)
+{
+	const struct uclass_total *t1 = v1, *t2 = v2;
+
+	return t1->time_us < t2->time_us ? 1 : t1->time_us > t2->time_us ? -1 : 0;
+}
+
+/* Print the probe time for each uclass, slowest first */
+static void print_probe_totals(struct bootstage_data *data)
+{
+	struct bootstage_record *rec;
+	struct uclass_total *totals;
+	int count = 0;
+	int i, j;
+
+	totals = calloc(data->rec_count, sizeof(*totals));
+	if (!totals)
+		return;
+	for (i = 0, rec = data->record; i < data->rec_count; i++, rec++) {
+		if (!(rec->flags & BOOTSTAGEF_PROBE))
+			continue;
+		for (j = 0; j < count; j++) {
+			if (totals[j].uclass_id == rec->uclass_id)
+				break;
+		}
+		if (j == count)
+			totals[count++].uclass_id = rec->uclass_id;
+		totals[j].devices++;
+		totals[j].time_us += rec->time_us - rec->child_us;
+	}
+	qsort(totals, count, sizeof(*totals), h_cmp_total);
+
+	puts("\nDevice probe time by uclass:\n");
+	printf("%11s%8s  %s\n", "Self", "Devices", "Uclass");
+	for (i = 0; i < count; i++) {
+		print_grouped_ull(totals[i].time_us, BOOTSTAGE_DIGITS);
+		printf("%8d  %s\n", totals[i].devices,
+		       uclass_get_name(totals[i].uclass_id) ?: "?");
+	}
+	free(totals);
+}
+
 void bootstage_report(void)
 {
 	struct bootstage_data *data = gd->bootstage;
@@ -347,10 +608,74 @@ void bootstage_report(void)
 		       data->rec_count - RECORD_COUNT);
 
 	puts("\nAccumulated time:\n");
+	print_scopes(data, 0, 0);
+
+	if (CONFIG_IS_ENABLED(BOOTSTAGE_PROBE))
+		print_probe_totals(data);
+}
+
+/* Text written by bootstage_export() */
+struct export_out {
+	char *buf;
+	int size;
+	int len;
+};
+
+static __printf(2, 3) void export_printf(struct export_out *out,
+					 const char *fmt, ...)
+{
+	va_list args;
+	int len;
+
+	va_start(args, fmt);
+	if (!out->buf) {
+		len = vprintf(fmt, args);
+	} else {
+		len = vsnprintf(out->buf + min(out->len, out->size),
+				out->size - min(out->len, out->size), fmt,
+				args);
+	}
+	va_end(args);
+	out->len += len;
+}
+
+int bootstage_export(char *buf, int size)
+{
+	struct bootstage_data *data = gd->bootstage;
+	struct export_out out = { .buf = buf, .size = size };
+	struct bootstage_record *rec;
+	char name[20];
+	int i;
+
+	if (buf && size)
+		*buf = '\0';
+	export_printf(&out, "# type id parent start_us total_us self_us count uclass name\n");
 	for (i = 0, rec = data->record; i < data->rec_count; i++, rec++) {
-		if (rec->start_us)
-			prev = print_time_record(rec, -1);
+		const char *uc_name = "-";
+		const char *type = "m";
+
+		if (rec->flags & BOOTSTAGEF_PROBE) {
+			type = "p";
+			if (CONFIG_IS_ENABLED(BOOTSTAGE_PROBE))
+				uc_name = uclass_get_name(rec->uclass_id);
+		} else if (rec->start_us) {
+			type = "a";
+		}
+		if (*type == 'm') {
+			export_printf(&out, "m %d 0 %lu 0 0 0 - %s\n", rec->id,
+				      rec->time_us,
+				      get_record_name(name, sizeof(name), rec));
+		} else {
+			export_printf(&out, "%s %d %d %u %lu %lu %u %s %s\n",
+				      type, rec->id, scope_parent(data, rec),
+				      rec->first_us, rec->time_us,
+				      rec->time_us - rec->child_us, rec->count,
+				      uc_name ?: "-",
+				      get_record_name(name, sizeof(name), rec));
+		}
 	}
+
+	return out.len;
 }
 
 /**
@@ -478,7 +803,7 @@ int bootstage_unstash(const void *base, int size)
 
 	/* Read the name strings */
 	ptr += rec_size;
-	for (rec = data->record + data->next_id, i = 0; i < hdr->count;
+	for (rec = data->record + data->rec_count, i = 0; i < hdr->count;
 	     i++, rec++) {
 		rec->name = ptr;
 		if (xpl_phase() == PHASE_SPL)
@@ -489,6 +814,8 @@ int bootstage_unstash(const void *base, int size)
 	}
 
 	/* Mark the records as read */
+	for (i = 0; i < hdr->count; i++)
+		hash_record(data, data->rec_count + i);
 	data->rec_count += hdr->count;
 	data->next_id = hdr->next_id;
 	debug("Unstashed %d records\n", hdr->count);
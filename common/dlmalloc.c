@@ -39,6 +39,9 @@ DECLARE_GLOBAL_DATA_PTR;
  #undef MALLOC_ZERO
 static inline void MALLOC_ZERO(void *p, size_t sz) { memset(p, 0, sz); }
 static inline void MALLOC_COPY(void *dest, const void *src, size_t sz) { memcpy(dest, src, sz); }
+#elif CONFIG_IS_ENABLED(SYS_MALLOC_SLAB)
+ /* The public functions try the slabs first; see the end of this file */
+ #define STATIC_IF_MCHECK static
 #else
  #define STATIC_IF_MCHECK
  #define mALLOc_impl mALLOc
@@ -607,6 +610,10 @@ void mem_malloc_init(ulong start, ulong size)
 #ifdef CONFIG_SYS_MALLOC_DEFAULT_TO_INIT
 	malloc_init();
 #endif
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SLAB)
+	/* any slabs so far are in the pre-relocation pool */
+	gd->malloc_slab = NULL;
+#endif
 
 	debug("using memory %#lx-%#lx for malloc()\n", mem_malloc_start,
 	      mem_malloc_end);
@@ -2242,6 +2249,68 @@ void mcheck_check_all(void) { mcheck_pedantic_check(); }
 
 enum mcheck_status mprobe(void *__ptr) { return mcheck_mprobe(__ptr); }
 // mcheck API }
+#elif CONFIG_IS_ENABLED(SYS_MALLOC_SLAB)
+/*
+ * Small allocations are served from the slabs, if possible. Allocations made
+ * while malloc() is in test mode are left to dlmalloc, so that failures happen
+ * when the test expects them.
+ */
+Void_t *mALLOc(size_t bytes)
+{
+	void *p = NULL;
+
+	if (!malloc_testing)
+		p = malloc_slab_alloc(bytes);
+
+	return p ? p : mALLOc_impl(bytes);
+}
+
+void fREe(Void_t *mem)
+{
+	if (!malloc_slab_free(mem))
+		fREe_impl(mem);
+}
+
+Void_t *rEALLOc(Void_t *oldmem, size_t bytes)
+{
+	size_t size = malloc_slab_usable_size(oldmem);
+	void *p;
+
+	if (!size)
+		return rEALLOc_impl(oldmem, bytes);
+	if (bytes <= size)
+		return oldmem;
+
+	p = mALLOc(bytes);
+	if (p) {
+		memcpy(p, oldmem, size);
+		malloc_slab_free(oldmem);
+	}
+
+	return p;
+}
+
+/* Slab objects are only aligned to MALLOC_ALIGNMENT, so leave this to dlmalloc */
+Void_t *mEMALIGn(size_t alignment, size_t bytes)
+{
+	return mEMALIGn_impl(alignment, bytes);
+}
+
+Void_t *cALLOc(size_t n, size_t elem_size)
+{
+	size_t sz = n * elem_size;
+	void *p = NULL;
+
+	if (!malloc_testing && (!elem_size || sz / elem_size == n))
+		p = malloc_slab_alloc(sz);
+	if (!p)
+		return cALLOc_impl(n, elem_size);
+
+	/* clear the whole slot, as dlmalloc does for its chunks */
+	memset(p, '\0', malloc_slab_usable_size(p));
+
+	return p;
+}
 #endif
 
 /*
@@ -2343,6 +2412,10 @@ size_t malloc_usable_size(mem) Void_t* mem;
   mchunkptr p;
   if (mem == NULL)
     return 0;
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SLAB)
+  if (malloc_slab_usable_size(mem))
+    return malloc_slab_usable_size(mem);
+#endif
   else
   {
     p = mem2chunk(mem);
@@ -2438,6 +2511,17 @@ void malloc_stats(void)
 struct mallinfo mALLINFo(void)
 {
   malloc_update_mallinfo();
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SLAB)
+  {
+    ulong spare;
+    uint arenas = malloc_slab_usage(&spare);
+
+    /* count the objects in the slabs, not the arena chunks holding them */
+    spare += arenas * SIZE_SZ;
+    current_mallinfo.uordblks -= spare;
+    current_mallinfo.fordblks += spare;
+  }
+#endif
   return current_mallinfo;
 }
 #endif	/* DEBUG */
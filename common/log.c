@@ -169,9 +169,12 @@ static bool log_passes_filters(struct log_device *ldev, struct log_rec *rec)
 	if (rec->flags & LOGRECF_FORCE_DEBUG)
 		return true;
 
-	/* If there are no filters, filter on the default log level */
+	/*
+	 * If there are no filters, filter on the driver's level, or the default
+	 * log level
+	 */
 	if (list_empty(&ldev->filter_head)) {
-		if (rec->level > gd->default_log_level)
+		if (rec->level > (ldev->drv->level ?: gd->default_log_level))
 			return false;
 		return true;
 	}
@@ -220,6 +223,8 @@ static int log_dispatch(struct log_rec *rec, const char *fmt, va_list args)
 {
 	struct log_device *ldev;
 	char buf[CONFIG_SYS_CBSIZE];
+	bool emitted = false;
+	int len;
 
 	/*
 	 * When a log driver writes messages (e.g. via the network stack) this
@@ -234,16 +239,24 @@ static int log_dispatch(struct log_rec *rec, const char *fmt, va_list args)
 	list_for_each_entry(ldev, &gd->log_head, sibling_node) {
 		if ((ldev->flags & LOGDF_ENABLE) &&
 		    log_passes_filters(ldev, rec)) {
-			if (!rec->msg) {
-				int len;
+			if (!rec->msg && !(ldev->flags & LOGDF_DEFER)) {
+				va_list copy;
 
-				len = vsnprintf(buf, sizeof(buf), fmt, args);
+				va_copy(copy, args);
+				len = vsnprintf(buf, sizeof(buf), fmt, copy);
+				va_end(copy);
 				rec->msg = buf;
 				gd->log_cont = len && buf[len - 1] != '\n';
 			}
 			ldev->drv->emit(ldev, rec);
+			emitted = true;
 		}
 	}
+	/* If no device needed the message, go by the format string */
+	if (emitted && !rec->msg) {
+		len = strlen(fmt);
+		gd->log_cont = len && fmt[len - 1] != '\n';
+	}
 	gd->processing_msg = false;
 	return 0;
 }
@@ -274,6 +287,7 @@ int _log(enum log_category_t cat, enum log_level_t level, const char *file,
 	rec.line = line;
 	rec.func = func;
 	rec.msg = NULL;
+	rec.fmt = fmt;
 
 	if (!(gd->flags & GD_FLG_LOG_READY)) {
 		gd->log_drop_count++;
@@ -292,6 +306,7 @@ int _log(enum log_category_t cat, enum log_level_t level, const char *file,
 		return -ENOSYS;
 	}
 	va_start(args, fmt);
+	rec.args = &args;
 	if (!log_dispatch(&rec, fmt, args)) {
 		gd->logc_prev = cat;
 		gd->logl_prev = level;
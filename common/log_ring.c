@@ -0,0 +1,595 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Log to a ring buffer in memory, formatting the records only when they are
+ * written out
+ */
+
+#include <bloblist.h>
+#include <errno.h>
+#include <event.h>
+#include <log.h>
+#include <time.h>
+#include <vsprintf.h>
+#include <asm/global_data.h>
+#include <linux/ctype.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define RING_SIZE	CONFIG_LOG_RING_SIZE
+
+/* Space for the arguments, or the message, in a record */
+#define RING_DATA_SIZE	CONFIG_SYS_CBSIZE
+
+/* Longest conversion which can be kept, e.g. "%-08lx" */
+#define RING_SPEC_MAX	16
+
+/* Space for the file or function name in a record, including the nul */
+#define RING_NAME_MAX	64
+
+/**
+ * struct ring_rec - a log record in the ring buffer
+ *
+ * The arguments for the format string follow the header. Each integer and
+ * pointer takes 8 bytes and each string is copied in, with a nul terminator.
+ * If @fmt is NULL the message was formatted when the record was created and
+ * follows the header instead. The file and function names come last, since
+ * the caller's strings may not last as long as the record, e.g. with 'log rec'.
+ *
+ * @size: Size of the record in bytes, including this header
+ * @level: Log level
+ * @flags: Flags for the record (enum log_rec_flags)
+ * @cat: Log category
+ * @line: Line number where the record was generated
+ * @names: Offset in @data of the name of the file where the record was
+ *	generated, followed by the name of the function, which is empty if not
+ *	known
+ * @ticks: Timer ticks when the record was generated
+ * @fmt: Format string, or NULL if the message is already formatted
+ * @data: Arguments, or message, then the names
+ */
+struct ring_rec {
+	u16 size;
+	u8 level;
+	u8 flags;
+	u16 cat;
+	u16 line;
+	u16 names;
+	u64 ticks;
+	const char *fmt;
+	char data[];
+};
+
+/* Largest possible record */
+#define RING_REC_MAX	(sizeof(struct ring_rec) + RING_DATA_SIZE + \
+			 2 * RING_NAME_MAX)
+
+/**
+ * struct ring_spec - a conversion in a format string
+ *
+ * @len: Length of the conversion, from the '%'
+ * @qual_pos: Offset of the size qualifier, if any
+ * @conv_pos: Offset of the conversion character
+ * @conv: Conversion character, e.g. 'd', or 0 if the format string ends first
+ * @qual: Size qualifier, as used by vsprintf(): 'h', 'l', 'L' (for "ll"), 'Z',
+ *	'z', 't' or 0 if none
+ * @width_star: true if the field width is an argument
+ * @prec_star: true if the precision is an argument
+ * @prec: Precision, or -1 if none
+ */
+struct ring_spec {
+	int len;
+	int qual_pos;
+	int conv_pos;
+	char conv;
+	char qual;
+	bool width_star;
+	bool prec_star;
+	int prec;
+};
+
+/**
+ * struct ring_out - where the records are written out
+ *
+ * @console: true to write to the console, false to write to @buf
+ * @buf: Buffer to write to, or NULL to just count the bytes
+ * @size: Size of @buf
+ * @len: Number of bytes written out so far
+ */
+struct ring_out {
+	bool console;
+	char *buf;
+	int size;
+	int len;
+};
+
+static char ring[RING_SIZE] __aligned(sizeof(u64));
+/* Offsets of the oldest record and the next record to be added */
+static uint ring_tail;
+static uint ring_head;
+/* Number of bytes used by records */
+static uint ring_used;
+/* Number of records dropped to make room for newer ones */
+static uint ring_lost;
+/* Set while the records are written out, so that the ring does not change */
+static bool ring_busy;
+
+/**
+ * ring_next_spec() - Find the next conversion in a format string
+ *
+ * @fmt: Format string
+ * @spec: Returns information about the conversion
+ * Return: pointer to the '%' which starts the conversion, or NULL if none
+ */
+static const char *ring_next_spec(const char *fmt, struct ring_spec *spec)
+{
+	const char *start, *p;
+
+	start = strchr(fmt, '%');
+	if (!start)
+		return NULL;
+	memset(spec, '\0', sizeof(*spec));
+	spec->prec = -1;
+
+	/* this follows vsnprintf_internal() */
+	for (p = start + 1; *p && strchr("-+ #0", *p); p++)
+		;
+	if (*p == '*') {
+		spec->width_star = true;
+		p++;
+	} else {
+		while (isdigit(*p))
+			p++;
+	}
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			spec->prec_star = true;
+			p++;
+		} else {
+			spec->prec = 0;
+			while (isdigit(*p))
+				spec->prec = spec->prec * 10 + *p++ - '0';
+		}
+	}
+	spec->qual_pos = p - start;
+	if (*p && strchr("hlLZzt", *p)) {
+		spec->qual = *p++;
+		if (spec->qual == 'l' && *p == 'l') {
+			spec->qual = 'L';
+			p++;
+		}
+	}
+	spec->conv_pos = p - start;
+	spec->conv = *p;
+	if (*p)
+		p++;
+	/* %dE shows the error string too */
+	if (spec->conv == 'd' && *p == 'E')
+		p++;
+	spec->len = p - start;
+
+	return start;
+}
+
+static bool ring_is_num(char conv)
+{
+	return conv && strchr("diouxX", conv);
+}
+
+static int ring_put(char **ptrp, char *end, u64 val)
+{
+	if (*ptrp + sizeof(val) > end)
+		return -E2BIG;
+	memcpy(*ptrp, &val, sizeof(val));
+	*ptrp += sizeof(val);
+
+	return 0;
+}
+
+static u64 ring_get(const char **ptrp)
+{
+	u64 val;
+
+	memcpy(&val, *ptrp, sizeof(val));
+	*ptrp += sizeof(val);
+
+	return val;
+}
+
+/**
+ * ring_pack() - Pack the arguments for a format string into a record
+ *
+ * @buf: Buffer for the arguments
+ * @size: Size of @buf
+ * @fmt: Format string
+ * @args: Arguments for @fmt
+ * Return: number of bytes used, -E2BIG if the arguments do not fit, or
+ *	-EOPNOTSUPP if they cannot be kept and the message must be formatted
+ *	now, e.g. %pU which needs the data pointed to
+ */
+static int ring_pack(char *buf, int size, const char *fmt, va_list args)
+{
+	char *ptr = buf, *end = buf + size;
+	struct ring_spec spec;
+	const char *start, *str;
+	bool sign;
+	u64 val;
+	int len;
+
+	while ((start = ring_next_spec(fmt, &spec))) {
+		fmt = start + spec.len;
+		if (spec.len > RING_SPEC_MAX)
+			return -EOPNOTSUPP;
+		if (spec.width_star &&
+		    ring_put(&ptr, end, va_arg(args, int)))
+			return -E2BIG;
+		if (spec.prec_star) {
+			spec.prec = va_arg(args, int);
+			if (ring_put(&ptr, end, spec.prec))
+				return -E2BIG;
+			if (spec.prec < 0)
+				spec.prec = 0;
+		}
+		if (ring_is_num(spec.conv)) {
+			/* convert the value in the same way as vsprintf() */
+			sign = spec.conv == 'd' || spec.conv == 'i';
+			switch (spec.qual) {
+			case 'L':
+				val = va_arg(args, unsigned long long);
+				break;
+			case 'l':
+				val = va_arg(args, unsigned long);
+				if (sign)
+					val = (long)val;
+				break;
+			case 'Z':
+			case 'z':
+				val = va_arg(args, size_t);
+				break;
+			case 't':
+				val = va_arg(args, ptrdiff_t);
+				break;
+			case 'h':
+				val = (unsigned short)va_arg(args, int);
+				if (sign)
+					val = (short)val;
+				break;
+			default:
+				val = va_arg(args, unsigned int);
+				if (sign)
+					val = (int)val;
+				break;
+			}
+			if (ring_put(&ptr, end, val))
+				return -E2BIG;
+			continue;
+		}
+		switch (spec.conv) {
+		case 'c':
+			if (ring_put(&ptr, end, va_arg(args, int)))
+				return -E2BIG;
+			break;
+		case 's':
+			if (spec.qual == 'l')
+				return -EOPNOTSUPP;
+			str = va_arg(args, const char *) ?: "<NULL>";
+			if (ptr == end)
+				return -E2BIG;
+			/* keep as much of the string as fits */
+			len = strnlen(str, spec.prec >= 0 ? spec.prec : size);
+			len = min(len, (int)(end - ptr) - 1);
+			memcpy(ptr, str, len);
+			ptr[len] = '\0';
+			ptr += len + 1;
+			break;
+		case 'p':
+			if (isalnum(*fmt))
+				return -EOPNOTSUPP;
+			if (ring_put(&ptr, end, (ulong)va_arg(args, void *)))
+				return -E2BIG;
+			break;
+		case 'n':
+			return -EOPNOTSUPP;
+		}
+	}
+
+	return ptr - buf;
+}
+
+static void ring_append(char *buf, int size, int *posp, const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	*posp += vscnprintf(buf + *posp, size - *posp, fmt, args);
+	va_end(args);
+}
+
+/**
+ * ring_format() - Format the message for a record
+ *
+ * @rec: Record to format
+ * @buf: Buffer for the message
+ * @size: Size of @buf
+ */
+static void ring_format(const struct ring_rec *rec, char *buf, int size)
+{
+	const char *fmt = rec->fmt, *data = rec->data, *start, *end;
+	char tmp[RING_SPEC_MAX + 32];
+	struct ring_spec spec;
+	int pos = 0;
+	char *ptr;
+
+	if (!fmt) {
+		strlcpy(buf, data, size);
+		return;
+	}
+	*buf = '\0';
+	while ((start = ring_next_spec(fmt, &spec))) {
+		ring_append(buf, size, &pos, "%.*s", (int)(start - fmt), fmt);
+		fmt = start + spec.len;
+
+		/*
+		 * Put the field width and precision into the conversion, and
+		 * pass all integers as long long
+		 */
+		ptr = tmp;
+		for (end = start + spec.qual_pos; start < end; start++) {
+			if (*start == '*')
+				ptr += sprintf(ptr, "%d", (int)ring_get(&data));
+			else
+				*ptr++ = *start;
+		}
+		if (ring_is_num(spec.conv)) {
+			*ptr++ = 'l';
+			*ptr++ = 'l';
+		}
+		start += spec.conv_pos - spec.qual_pos;
+		end += spec.len - spec.qual_pos;
+		while (start < end)
+			*ptr++ = *start++;
+		*ptr = '\0';
+
+		if (ring_is_num(spec.conv)) {
+			ring_append(buf, size, &pos, tmp,
+				    (unsigned long long)ring_get(&data));
+		} else if (spec.conv == 'c') {
+			ring_append(buf, size, &pos, tmp, (int)ring_get(&data));
+		} else if (spec.conv == 's') {
+			ring_append(buf, size, &pos, tmp, data);
+			data += strlen(data) + 1;
+		} else if (spec.conv == 'p') {
+			ring_append(buf, size, &pos, tmp,
+				    (void *)(ulong)ring_get(&data));
+		} else {
+			ring_append(buf, size, &pos, tmp);
+		}
+	}
+	ring_append(buf, size, &pos, "%s", fmt);
+}
+
+/* Copy in a file or function name, as much as fits */
+static int ring_put_name(char *ptr, const char *name)
+{
+	int len;
+
+	name = name ?: "";
+	len = strnlen(name, RING_NAME_MAX - 1);
+	memcpy(ptr, name, len);
+	ptr[len] = '\0';
+
+	return len + 1;
+}
+
+static void ring_copy_in(uint pos, const void *src, uint len)
+{
+	uint first = min(len, RING_SIZE - pos);
+
+	memcpy(ring + pos, src, first);
+	memcpy(ring, src + first, len - first);
+}
+
+static void ring_copy_out(void *dst, uint pos, uint len)
+{
+	uint first = min(len, RING_SIZE - pos);
+
+	memcpy(dst, ring + pos, first);
+	memcpy(dst + first, ring, len - first);
+}
+
+/* Drop the oldest record */
+static void ring_drop(void)
+{
+	u16 size;
+
+	ring_copy_out(&size, ring_tail, sizeof(size));
+	ring_tail = (ring_tail + size) % RING_SIZE;
+	ring_used -= size;
+	ring_lost++;
+}
+
+static int log_ring_emit(struct log_device *ldev, struct log_rec *rec)
+{
+	char space[RING_REC_MAX] __aligned(sizeof(u64));
+	struct ring_rec *rrec = (struct ring_rec *)space;
+	va_list args;
+	int len;
+
+	/* The ring is in BSS, which may not be usable before relocation */
+	if (!(gd->flags & GD_FLG_RELOC) || ring_busy)
+		return 0;
+
+	rrec->fmt = rec->fmt;
+	len = -EOPNOTSUPP;
+	if (!rec->msg) {
+		va_copy(args, *rec->args);
+		len = ring_pack(rrec->data, RING_DATA_SIZE, rec->fmt, args);
+		va_end(args);
+	}
+	if (len < 0) {
+		/* keep the message instead, formatting it if needed */
+		rrec->fmt = NULL;
+		if (rec->msg) {
+			strlcpy(rrec->data, rec->msg, RING_DATA_SIZE);
+		} else {
+			va_copy(args, *rec->args);
+			vscnprintf(rrec->data, RING_DATA_SIZE, rec->fmt, args);
+			va_end(args);
+		}
+		len = strlen(rrec->data) + 1;
+	}
+	rrec->names = len;
+	len += ring_put_name(rrec->data + len, rec->file);
+	len += ring_put_name(rrec->data + len, rec->func);
+	rrec->size = sizeof(*rrec) + len;
+	rrec->level = rec->level;
+	rrec->flags = rec->flags;
+	rrec->cat = rec->cat;
+	rrec->line = rec->line;
+	rrec->ticks = gd->timer || !CONFIG_IS_ENABLED(TIMER) ? get_ticks() : 0;
+
+	while (ring_used + rrec->size > RING_SIZE)
+		ring_drop();
+	ring_copy_in(ring_head, rrec, rrec->size);
+	ring_head = (ring_head + rrec->size) % RING_SIZE;
+	ring_used += rrec->size;
+
+	return 0;
+}
+
+static void ring_printf(struct ring_out *out, const char *fmt, ...)
+{
+	va_list args;
+	int pos;
+
+	va_start(args, fmt);
+	if (out->console) {
+		out->len += vprintf(fmt, args);
+	} else {
+		pos = min(out->len, out->size);
+		out->len += vsnprintf(out->buf ? out->buf + pos : NULL,
+				      out->size - pos, fmt, args);
+	}
+	va_end(args);
+}
+
+/* Write out a record in the same way as log_console_emit() */
+static void ring_out_rec(struct ring_out *out, const struct ring_rec *rec,
+			 ulong rate)
+{
+	const char *file = rec->data + rec->names;
+	const char *func = file + strlen(file) + 1;
+	char msg[CONFIG_SYS_CBSIZE];
+	int fmt = gd->log_fmt;
+	bool add_space = false;
+	u64 us;
+
+	ring_format(rec, msg, sizeof(msg));
+	if (!(rec->flags & LOGRECF_CONT)) {
+		us = rate ? (rec->ticks % rate) * 1000000 / rate : 0;
+		ring_printf(out, "[%5llu.%06llu]",
+			    rate ? rec->ticks / rate : 0ULL, us);
+		add_space = true;
+		if (fmt != BIT(LOGF_MSG))
+			ring_printf(out, " ");
+		if (fmt & BIT(LOGF_LEVEL))
+			ring_printf(out, "%s.", log_get_level_name(rec->level));
+		if (fmt & BIT(LOGF_CAT))
+			ring_printf(out, "%s,", log_get_cat_name(rec->cat));
+		if (fmt & BIT(LOGF_FILE))
+			ring_printf(out, "%s:", file);
+		if (fmt & BIT(LOGF_LINE))
+			ring_printf(out, "%d-", rec->line);
+		if (fmt & BIT(LOGF_FUNC))
+			ring_printf(out, "%*s()", CONFIG_LOGF_FUNC_PAD,
+				    *func ? func : "?");
+	}
+	if (fmt & BIT(LOGF_MSG))
+		ring_printf(out, "%s%s", add_space ? " " : "", msg);
+}
+
+static int ring_dump(enum log_level_t level, enum log_category_t cat_list[],
+		     struct ring_out *out)
+{
+	char space[RING_REC_MAX] __aligned(sizeof(u64));
+	struct ring_rec *rec = (struct ring_rec *)space;
+	uint pos, left;
+	ulong rate;
+	u16 len;
+
+	rate = gd->timer || !CONFIG_IS_ENABLED(TIMER) ? get_tbclk() : 0;
+	ring_busy = true;
+	if (ring_lost)
+		ring_printf(out, "(%u older records lost)\n", ring_lost);
+	for (pos = ring_tail, left = ring_used; left; left -= len) {
+		ring_copy_out(&len, pos, sizeof(len));
+		ring_copy_out(rec, pos, len);
+		pos = (pos + len) % RING_SIZE;
+		if (rec->level > level ||
+		    (cat_list && !log_has_cat(cat_list, rec->cat)))
+			continue;
+		ring_out_rec(out, rec, rate);
+	}
+	ring_busy = false;
+
+	return out->len;
+}
+
+int log_ring_dump(enum log_level_t level, enum log_category_t cat_list[],
+		  char *buf, int size)
+{
+	struct ring_out out = { .console = !buf, .buf = buf, .size = size };
+
+	return ring_dump(level, cat_list, &out);
+}
+
+int log_ring_to_bloblist(enum log_level_t level,
+			 enum log_category_t cat_list[])
+{
+	struct ring_out out = {};
+	char *buf;
+	int size;
+	int ret;
+
+	size = ring_dump(level, cat_list, &out) + 1;
+	buf = bloblist_find(BLOBLISTT_U_BOOT_LOG, 0);
+	if (buf)
+		ret = bloblist_resize(BLOBLISTT_U_BOOT_LOG, size);
+	else
+		ret = bloblist_ensure_size(BLOBLISTT_U_BOOT_LOG, size, 0,
+					   (void **)&buf);
+	if (ret)
+		return ret;
+	log_ring_dump(level, cat_list, buf, size);
+
+	return 0;
+}
+
+void log_ring_clear(void)
+{
+	ring_tail = 0;
+	ring_head = 0;
+	ring_used = 0;
+	ring_lost = 0;
+}
+
+#if IS_ENABLED(CONFIG_LOG_RING_HANDOFF)
+static int log_ring_handoff(void)
+{
+	int ret;
+
+	ret = log_ring_to_bloblist(CONFIG_LOG_RING_LEVEL, NULL);
+	if (ret)
+		log_warning("Cannot hand off log records (err=%d)\n", ret);
+
+	return 0;
+}
+EVENT_SPY_SIMPLE(EVT_FT_FIXUP, log_ring_handoff);
+#endif
+
+LOG_DRIVER(ring) = {
+	.name	= "ring",
+	.emit	= log_ring_emit,
+	.flags	= LOGDF_ENABLE | LOGDF_DEFER,
+	.level	= CONFIG_LOG_RING_LEVEL,
+};
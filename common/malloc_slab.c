@@ -0,0 +1,315 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Slab front-end for malloc()
+ *
+ * Small allocations are served from pages which each hold objects of a single
+ * size, with a free list for each size. Pages are handed out from arenas
+ * obtained from the underlying allocator: dlmalloc once it is ready, or the
+ * simple pre-relocation pool before that.
+ *
+ * A byte map covering the whole malloc() region records the size class of each
+ * slab page, so free() can tell in constant time whether a pointer belongs to a
+ * slab. Pages are never given back, so an object's size never changes while it
+ * is in use.
+ */
+
+#define LOG_CATEGORY LOGC_ALLOC
+
+#include <log.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <asm/global_data.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Page size and number of pages in each arena, once dlmalloc is ready */
+#define SLAB_PAGE_SHIFT		12
+#define SLAB_ARENA_PAGES	16
+
+/* The same, for the (much smaller) pool used before relocation */
+#define SLAB_F_PAGE_SHIFT	9
+#define SLAB_F_ARENA_PAGES	8
+
+/* Largest allocation handled by the slabs */
+#define SLAB_MAX_SIZE		256
+
+/* Size of each class of object, each a multiple of the malloc() alignment */
+static const u16 slab_size[] = { 16, 32, 48, 64, 96, 128, 192, 256 };
+
+#define SLAB_CLASSES		ARRAY_SIZE(slab_size)
+
+/* Class to use for each size, in 16-byte units rounded up, less one */
+static const u8 slab_class_for[SLAB_MAX_SIZE / 16] = {
+	0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7
+};
+
+/**
+ * struct slab_class - Objects of one size
+ *
+ * @free: Most recently freed object, whose first word points to the next
+ * @next: Next unused object in the newest page, or NULL if none
+ * @end: End of the newest page
+ * @pages: Number of pages holding objects of this size
+ * @in_use: Number of objects currently allocated
+ * @allocs: Total number of allocations
+ * @frees: Total number of frees
+ */
+struct slab_class {
+	void *free;
+	char *next;
+	char *end;
+	uint pages;
+	uint in_use;
+	ulong allocs;
+	ulong frees;
+};
+
+/**
+ * struct malloc_slab - State of the slab front-end
+ *
+ * This is stored in global data so that it can be used before relocation. It
+ * is dropped when the full malloc() pool is set up, along with the slabs in the
+ * pre-relocation pool.
+ *
+ * @full: true if the slabs come from dlmalloc, false if from the simple
+ *	pre-relocation pool
+ * @page_shift: log2 of the page size
+ * @arena_pages: Number of pages to obtain at a time
+ * @arena: Next page to hand out from the newest arena
+ * @arena_end: End of the newest arena
+ * @arenas: Number of arenas obtained
+ * @arena_bytes: Total usable size of the arenas, for mallinfo()
+ * @cls: Information for each size class
+ * @first_page: Page number (address >> @page_shift) of the first page in the
+ *	malloc() region
+ * @num_pages: Number of pages in the malloc() region
+ * @page_class: Class of each page in the malloc() region plus one, or 0 if the
+ *	page does not belong to a slab
+ */
+struct malloc_slab {
+	bool full;
+	uint page_shift;
+	uint arena_pages;
+	char *arena;
+	char *arena_end;
+	uint arenas;
+	ulong arena_bytes;
+	struct slab_class cls[SLAB_CLASSES];
+	ulong first_page;
+	ulong num_pages;
+	u8 page_class[];
+};
+
+static struct malloc_slab *slab_setup(bool full, ulong start, ulong end)
+{
+	struct malloc_slab *slab;
+	uint shift;
+	ulong num;
+
+	shift = full ? SLAB_PAGE_SHIFT : SLAB_F_PAGE_SHIFT;
+	num = ((end - 1) >> shift) - (start >> shift) + 1;
+
+	/* memalign() never uses the slabs, so there is no recursion here */
+	slab = memalign(sizeof(long), sizeof(*slab) + num);
+	if (!slab)
+		return NULL;
+	memset(slab, '\0', sizeof(*slab) + num);
+	slab->full = full;
+	slab->page_shift = shift;
+	slab->arena_pages = full ? SLAB_ARENA_PAGES : SLAB_F_ARENA_PAGES;
+	slab->first_page = start >> shift;
+	slab->num_pages = num;
+	gd->malloc_slab = slab;
+	log_debug("slab: %lx pages of %x bytes\n", num, 1U << shift);
+
+	return slab;
+}
+
+static struct malloc_slab *slab_get(void)
+{
+	struct malloc_slab *slab = gd->malloc_slab;
+	bool full = true;
+
+	if (CONFIG_IS_ENABLED(SYS_MALLOC_F))
+		full = gd->flags & GD_FLG_FULL_MALLOC_INIT;
+	if (slab && slab->full == full)
+		return slab;
+
+	if (full) {
+		/* dlmalloc is not set up yet */
+		if (!mem_malloc_start)
+			return NULL;
+		return slab_setup(true, mem_malloc_start, mem_malloc_end);
+	}
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SLAB_F)
+	if (gd->malloc_limit) {
+		ulong base = (ulong)map_sysmem(gd->malloc_base,
+					       gd->malloc_limit);
+
+		return slab_setup(false, base, base + gd->malloc_limit);
+	}
+#endif
+
+	return NULL;
+}
+
+/* Get the page number of an address, which is @num_pages or more if outside */
+static ulong slab_page(struct malloc_slab *slab, const void *ptr)
+{
+	return ((ulong)ptr >> slab->page_shift) - slab->first_page;
+}
+
+/* Find the class of an object, or -1 if it is not in a slab */
+static int slab_class_of(struct malloc_slab *slab, const void *ptr)
+{
+	ulong page = slab_page(slab, ptr);
+
+	if (page >= slab->num_pages)
+		return -1;
+
+	return slab->page_class[page] - 1;
+}
+
+static int slab_new_page(struct malloc_slab *slab, int idx)
+{
+	struct slab_class *cls = &slab->cls[idx];
+	ulong page_size = 1UL << slab->page_shift;
+	char *page;
+
+	if (slab->arena == slab->arena_end) {
+		ulong size = slab->arena_pages << slab->page_shift;
+		char *arena;
+
+		arena = memalign(page_size, size);
+		if (!arena)
+			return -ENOMEM;
+		if (slab_page(slab, arena) >= slab->num_pages ||
+		    slab_page(slab, arena + size - 1) >= slab->num_pages) {
+			/* outside the malloc() region, so free() cannot tell */
+			log_debug("slab: arena %p out of range\n", arena);
+			free(arena);
+			return -ERANGE;
+		}
+		slab->arena = arena;
+		slab->arena_end = arena + size;
+		slab->arenas++;
+		if (slab->full)
+			slab->arena_bytes += malloc_usable_size(arena);
+	}
+	page = slab->arena;
+	slab->arena += page_size;
+	slab->page_class[slab_page(slab, page)] = idx + 1;
+	cls->next = page;
+	cls->end = page + page_size;
+	cls->pages++;
+
+	return 0;
+}
+
+void *malloc_slab_alloc(size_t bytes)
+{
+	struct malloc_slab *slab;
+	struct slab_class *cls;
+	void *ptr;
+	int idx;
+
+	if (bytes > SLAB_MAX_SIZE)
+		return NULL;
+	slab = slab_get();
+	if (!slab)
+		return NULL;
+
+	idx = bytes ? slab_class_for[(bytes - 1) / 16] : 0;
+	cls = &slab->cls[idx];
+	if (cls->free) {
+		ptr = cls->free;
+		cls->free = *(void **)ptr;
+	} else {
+		if (cls->end - cls->next < slab_size[idx] &&
+		    slab_new_page(slab, idx))
+			return NULL;
+		ptr = cls->next;
+		cls->next += slab_size[idx];
+	}
+	cls->in_use++;
+	cls->allocs++;
+
+	return ptr;
+}
+
+bool malloc_slab_free(void *ptr)
+{
+	struct malloc_slab *slab = gd->malloc_slab;
+	struct slab_class *cls;
+	int idx;
+
+	if (!slab || !ptr)
+		return false;
+	idx = slab_class_of(slab, ptr);
+	if (idx < 0)
+		return false;
+
+	cls = &slab->cls[idx];
+	*(void **)ptr = cls->free;
+	cls->free = ptr;
+	cls->in_use--;
+	cls->frees++;
+
+	return true;
+}
+
+size_t malloc_slab_usable_size(const void *ptr)
+{
+	struct malloc_slab *slab = gd->malloc_slab;
+	int idx;
+
+	if (!slab || !ptr)
+		return 0;
+	idx = slab_class_of(slab, ptr);
+
+	return idx < 0 ? 0 : slab_size[idx];
+}
+
+uint malloc_slab_usage(ulong *sparep)
+{
+	struct malloc_slab *slab = gd->malloc_slab;
+	ulong used = 0;
+	int i;
+
+	*sparep = 0;
+	if (!slab || !slab->full)
+		return 0;
+	for (i = 0; i < SLAB_CLASSES; i++)
+		used += (ulong)slab->cls[i].in_use * slab_size[i];
+	*sparep = slab->arena_bytes - used;
+
+	return slab->arenas;
+}
+
+void malloc_slab_info(void)
+{
+	struct malloc_slab *slab = gd->malloc_slab;
+	ulong page_size;
+	int i;
+
+	if (!slab) {
+		printf("No slabs\n");
+		return;
+	}
+	page_size = 1UL << slab->page_shift;
+	printf("%s pool: %u arenas, %lu-byte pages, %lu unused\n",
+	       slab->full ? "Main" : "Early", slab->arenas, page_size,
+	       (ulong)(slab->arena_end - slab->arena) >> slab->page_shift);
+	printf(" size  pages  in use     free      allocs       frees\n");
+	for (i = 0; i < SLAB_CLASSES; i++) {
+		struct slab_class *cls = &slab->cls[i];
+		uint per_page = page_size / slab_size[i];
+
+		printf("%5u %6u %7u %8u %11lu %11lu\n", slab_size[i],
+		       cls->pages, cls->in_use,
+		       cls->pages * per_page - cls->in_use, cls->allocs,
+		       cls->frees);
+	}
+}
@@ -63,6 +63,14 @@ ifdef FTRACE
 PLATFORM_CPPFLAGS += -finstrument-functions -DFTRACE
 endif
 
+# The sampling profiler follows the frame pointer to find the caller
+ifdef CONFIG_PROFILE
+ifndef CONFIG_XPL_BUILD
+PLATFORM_CPPFLAGS += -fno-omit-frame-pointer \
+	$(call cc-option,-mno-omit-leaf-frame-pointer)
+endif
+endif
+
 #########################################################################
 
 RELFLAGS := $(PLATFORM_RELFLAGS)
@@ -10,7 +10,9 @@
 #include <dm.h>
 #include <log.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <part.h>
+#include <uthread.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
@@ -429,19 +431,13 @@ static int blk_buffer_aligned(struct bounce_buffer *state)
 	return 1;	/* Default, any buffer is OK */
 }
 
-long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
+static long blk_read_dev(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+			 void *buf)
 {
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
 	const struct blk_ops *ops = blk_get_ops(dev);
 	ulong blks_read;
 
-	if (!ops->read)
-		return -ENOSYS;
-
-	if (blkcache_read(desc->uclass_id, desc->devnum,
-			  start, blkcnt, desc->blksz, buf))
-		return blkcnt;
-
 	if (IS_ENABLED(CONFIG_BOUNCE_BUFFER) && desc->bb) {
 		struct blk_bounce_buffer bbstate = { .dev = dev };
 		int ret;
@@ -460,6 +456,248 @@ long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
 		blks_read = ops->read(dev, start, blkcnt, buf);
 	}
 
+	return blks_read;
+}
+
+/*
+ * Read the whole cache line around a small request so that neighbouring
+ * blocks are cached too. Returns -EAGAIN if the request should be read as is.
+ */
+static long blk_read_ahead(struct udevice *dev, lbaint_t start,
+			   lbaint_t blkcnt, void *buf)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	lbaint_t ra_start, ra_cnt;
+	long blks_read;
+	void *ra_buf;
+
+	if (!blkcache_readahead(desc->uclass_id, desc->devnum, desc->blksz,
+				start, blkcnt, &ra_start, &ra_cnt))
+		return -EAGAIN;
+
+	/* don't read past the end of the device */
+	if (ra_start + ra_cnt > desc->lba)
+		ra_cnt = max(desc->lba, start + blkcnt) - ra_start;
+
+	ra_buf = malloc_cache_aligned(ra_cnt * desc->blksz);
+	if (!ra_buf)
+		return -EAGAIN;
+
+	blks_read = blk_read_dev(dev, ra_start, ra_cnt, ra_buf);
+	if (blks_read == ra_cnt) {
+		blkcache_fill(desc->uclass_id, desc->devnum, ra_start, ra_cnt,
+			      desc->blksz, ra_buf);
+		memcpy(buf, ra_buf + (start - ra_start) * desc->blksz,
+		       blkcnt * desc->blksz);
+		blks_read = blkcnt;
+	} else {
+		blks_read = -EAGAIN;
+	}
+	free(ra_buf);
+
+	return blks_read;
+}
+
+#if CONFIG_IS_ENABLED(BLK_READAHEAD)
+/**
+ * struct blk_readahead - sequential read-ahead state of a block device
+ *
+ * @buf: window buffer, room for CONFIG_BLK_READAHEAD_SIZE bytes
+ * @start: first block held in @buf
+ * @count: number of valid blocks in @buf, 0 if the window is empty
+ * @size: number of blocks to read on the next window fill; this doubles
+ *	with each fill of a sequential stream, up to the size of @buf
+ * @next: block following the last request, to detect sequential access
+ * @seq: number of consecutive sequential requests
+ * @hwpart: hardware partition the window was filled from
+ * @stats: statistics
+ */
+struct blk_readahead {
+	void *buf;
+	lbaint_t start;
+	lbaint_t count;
+	lbaint_t size;
+	lbaint_t next;
+	uint seq;
+	u8 hwpart;
+	struct blk_readahead_stats stats;
+};
+
+/* Number of sequential requests before read-ahead kicks in */
+#define BLK_READAHEAD_TRIGGER	2
+
+static lbaint_t blk_ra_max(struct blk_desc *desc)
+{
+	return CONFIG_BLK_READAHEAD_SIZE / desc->blksz;
+}
+
+static int blk_ra_fill(struct udevice *dev, struct blk_readahead *ra,
+		       lbaint_t start, lbaint_t blkcnt)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	lbaint_t max = blk_ra_max(desc);
+	lbaint_t count;
+	long blks_read;
+
+	if (!ra->buf) {
+		ra->buf = malloc_cache_aligned(max * desc->blksz);
+		if (!ra->buf)
+			return -ENOMEM;
+	}
+
+	ra->size = ra->size ? min(ra->size * 2, max) : max / 8;
+	count = max(ra->size, blkcnt);
+	if (start + count > desc->lba)
+		count = max(desc->lba, start + blkcnt) - start;
+
+	ra->count = 0;
+	blks_read = blk_read_dev(dev, start, count, ra->buf);
+	if (blks_read < (long)blkcnt)
+		return -EIO;
+
+	ra->start = start;
+	ra->count = blks_read;
+	ra->hwpart = desc->hwpart;
+	ra->stats.fills++;
+	ra->stats.blocks += blks_read;
+	log_debug("fill: start " LBAF ", count " LBAFU "\n", start,
+		  (lbaint_t)blks_read);
+
+	return 0;
+}
+
+/*
+ * Serve small sequential requests from a window that is read in large
+ * transfers. Returns -EAGAIN if the request should be read as is.
+ */
+static long blk_read_seq(struct udevice *dev, lbaint_t start,
+			 lbaint_t blkcnt, void *buf)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	struct blk_readahead *ra = dev_get_uclass_priv(dev);
+	lbaint_t todo = blkcnt;
+	bool seq;
+
+	/* the window lives in uclass-private data, allocated on probe */
+	if (!ra)
+		return -EAGAIN;
+
+	seq = start == ra->next;
+	ra->next = start + blkcnt;
+	if (ra->count && ra->hwpart != desc->hwpart)
+		ra->count = 0;
+
+	/* large reads are efficient already */
+	if (blkcnt >= blk_ra_max(desc)) {
+		ra->seq = 0;
+		return -EAGAIN;
+	}
+
+	while (todo) {
+		lbaint_t n;
+
+		if (start < ra->start || start >= ra->start + ra->count) {
+			/* only refill the window for a sequential stream */
+			if (!seq || ++ra->seq < BLK_READAHEAD_TRIGGER) {
+				if (!seq) {
+					ra->seq = 0;
+					ra->size = 0;
+				}
+				break;
+			}
+			if (blk_ra_fill(dev, ra, start, todo))
+				break;
+		}
+
+		n = min(todo, ra->start + ra->count - start);
+		memcpy(buf, ra->buf + (start - ra->start) * desc->blksz,
+		       n * desc->blksz);
+		buf += n * desc->blksz;
+		start += n;
+		todo -= n;
+	}
+
+	if (todo == blkcnt)
+		return -EAGAIN;
+
+	ra->stats.hits++;
+	if (todo) {
+		long blks_read = blk_read_dev(dev, start, todo, buf);
+
+		if (blks_read < 0)
+			return blks_read;
+		todo -= blks_read;
+	}
+
+	return blkcnt - todo;
+}
+
+void blk_readahead_invalidate(struct blk_desc *desc)
+{
+	struct blk_readahead *ra;
+
+	if (!desc->bdev)
+		return;
+
+	ra = dev_get_uclass_priv(desc->bdev);
+	if (!ra)
+		return;
+	ra->count = 0;
+	ra->seq = 0;
+	ra->size = 0;
+}
+
+int blk_readahead_stats(struct udevice *dev, struct blk_readahead_stats *stats)
+{
+	struct blk_readahead *ra = dev_get_uclass_priv(dev);
+
+	if (!ra)
+		return -ENODEV;
+	*stats = ra->stats;
+	memset(&ra->stats, '\0', sizeof(ra->stats));
+
+	return 0;
+}
+
+static int blk_pre_remove(struct udevice *dev)
+{
+	struct blk_readahead *ra = dev_get_uclass_priv(dev);
+
+	free(ra->buf);
+
+	return 0;
+}
+#else
+static long blk_read_seq(struct udevice *dev, lbaint_t start,
+			 lbaint_t blkcnt, void *buf)
+{
+	return -EAGAIN;
+}
+#endif
+
+static long blk_do_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+			void *buf)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	long blks_read;
+
+	if (!ops->read)
+		return -ENOSYS;
+
+	if (blkcache_read(desc->uclass_id, desc->devnum,
+			  start, blkcnt, desc->blksz, buf))
+		return blkcnt;
+
+	blks_read = blk_read_seq(dev, start, blkcnt, buf);
+	if (blks_read != -EAGAIN)
+		return blks_read;
+
+	blks_read = blk_read_ahead(dev, start, blkcnt, buf);
+	if (blks_read != -EAGAIN)
+		return blks_read;
+
+	blks_read = blk_read_dev(dev, start, blkcnt, buf);
 	if (blks_read == blkcnt)
 		blkcache_fill(desc->uclass_id, desc->devnum, start, blkcnt,
 			      desc->blksz, buf);
@@ -467,8 +705,8 @@ long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
 	return blks_read;
 }
 
-long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
-	       const void *buf)
+static long blk_do_write(struct udevice *dev, lbaint_t start,
+			 lbaint_t blkcnt, const void *buf)
 {
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
 	const struct blk_ops *ops = blk_get_ops(dev);
@@ -478,6 +716,7 @@ long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
 		return -ENOSYS;
 
 	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	blk_readahead_invalidate(desc);
 
 	if (IS_ENABLED(CONFIG_BOUNCE_BUFFER) && desc->bb) {
 		struct blk_bounce_buffer bbstate = { .dev = dev };
@@ -501,7 +740,7 @@ long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
 	return blks_written;
 }
 
-long blk_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
+static long blk_do_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
 {
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
 	const struct blk_ops *ops = blk_get_ops(dev);
@@ -510,10 +749,81 @@ long blk_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
 		return -ENOSYS;
 
 	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	blk_readahead_invalidate(desc);
 
 	return ops->erase(dev, start, blkcnt);
 }
 
+#if CONFIG_IS_ENABLED(UTHREAD)
+/*
+ * Block I/O may be issued from several uthreads at once, see blk_read_async(),
+ * and drivers yield while they wait for the hardware, so serialise all
+ * requests. The lock is recursive since partitions and blkmaps call back into
+ * blk_read() for their parent device.
+ */
+static struct uthread_mutex blk_io_mutex = UTHREAD_MUTEX_INITIALIZER;
+static struct uthread *blk_io_owner;
+static uint blk_io_depth;
+
+static void blk_io_lock(void)
+{
+	struct uthread *self = uthread_self();
+
+	if (blk_io_depth && blk_io_owner == self) {
+		blk_io_depth++;
+		return;
+	}
+	uthread_mutex_lock(&blk_io_mutex);
+	blk_io_owner = self;
+	blk_io_depth = 1;
+}
+
+static void blk_io_unlock(void)
+{
+	if (--blk_io_depth)
+		return;
+	blk_io_owner = NULL;
+	uthread_mutex_unlock(&blk_io_mutex);
+}
+#else
+static inline void blk_io_lock(void) {}
+static inline void blk_io_unlock(void) {}
+#endif
+
+long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
+{
+	long ret;
+
+	blk_io_lock();
+	ret = blk_do_read(dev, start, blkcnt, buf);
+	blk_io_unlock();
+
+	return ret;
+}
+
+long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+	       const void *buf)
+{
+	long ret;
+
+	blk_io_lock();
+	ret = blk_do_write(dev, start, blkcnt, buf);
+	blk_io_unlock();
+
+	return ret;
+}
+
+long blk_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
+{
+	long ret;
+
+	blk_io_lock();
+	ret = blk_do_erase(dev, start, blkcnt);
+	blk_io_unlock();
+
+	return ret;
+}
+
 ulong blk_dread(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
 		void *buffer)
 {
@@ -531,6 +841,50 @@ ulong blk_derase(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt)
 	return blk_erase(desc->bdev, start, blkcnt);
 }
 
+static void blk_async_fn(void *arg)
+{
+	struct blk_async *req = arg;
+
+	req->ret = blk_read(req->dev, req->start, req->blkcnt, req->buf);
+	req->done = true;
+}
+
+int blk_read_async(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+		   void *buf, struct blk_async *req)
+{
+	if (!blk_get_ops(dev)->read)
+		return -ENOSYS;
+
+	req->dev = dev;
+	req->start = start;
+	req->blkcnt = blkcnt;
+	req->buf = buf;
+	req->ret = 0;
+	req->done = false;
+
+	/* without a thread, complete the read before returning */
+	if (uthread_create(NULL, blk_async_fn, req, 0, 0))
+		blk_async_fn(req);
+
+	return 0;
+}
+
+int blk_dread_async(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+		    void *buffer, struct blk_async *req)
+{
+	return blk_read_async(desc->bdev, start, blkcnt, buffer, req);
+}
+
+long blk_async_wait(struct blk_async *req)
+{
+	while (!req->done) {
+		if (!uthread_schedule())
+			return -EIO;
+	}
+
+	return req->ret;
+}
+
 int blk_find_from_parent(struct udevice *parent, struct udevice **devp)
 {
 	struct udevice *dev;
@@ -845,5 +1199,9 @@ UCLASS_DRIVER(blk) = {
 	.id		= UCLASS_BLK,
 	.name		= "blk",
 	.post_probe	= blk_post_probe,
+#if CONFIG_IS_ENABLED(BLK_READAHEAD)
+	.pre_remove	= blk_pre_remove,
+	.per_device_auto	= sizeof(struct blk_readahead),
+#endif
 	.per_device_plat_auto	= sizeof(struct blk_desc),
 };
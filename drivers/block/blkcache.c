@@ -5,6 +5,7 @@
  *
  */
 #include <blk.h>
+#include <div64.h>
 #include <log.h>
 #include <malloc.h>
 #include <part.h>
@@ -12,159 +13,420 @@
 #include <linux/ctype.h>
 #include <linux/list.h>
 
+/*
+ * The cache is split per block device. Each device owns a set-associative
+ * array of cache lines: a line holds up to max_blocks_per_entry blocks,
+ * aligned to that size, and is found by hashing its line number to one of
+ * max_entries / ways sets. A lookup therefore only ever walks one set, no
+ * matter how large the cache is configured.
+ */
+
+/**
+ * struct block_cache_node - a cache line
+ *
+ * @lh: entry in the set, most-recently-used first
+ * @line: first block of the (aligned) line
+ * @start: first valid block in this line
+ * @blkcnt: number of valid blocks starting at @start
+ * @cache: cached data, room for a full line
+ */
 struct block_cache_node {
 	struct list_head lh;
-	int iftype;
-	int devnum;
+	lbaint_t line;
 	lbaint_t start;
 	lbaint_t blkcnt;
-	unsigned long blksz;
 	char *cache;
 };
 
+/**
+ * struct block_cache_dev - cache state for one block device
+ *
+ * @lh: entry in block_cache, most-recently-used first
+ * @iftype: uclass_id of the device
+ * @devnum: device number within @iftype
+ * @blksz: block size, in bytes, of the cached lines
+ * @nsets: number of sets in @sets
+ * @sets: array of @nsets lists of struct block_cache_node, or NULL if the
+ *	cache for this device is empty
+ * @stats: configuration and statistics for this device
+ */
+struct block_cache_dev {
+	struct list_head lh;
+	int iftype;
+	int devnum;
+	unsigned long blksz;
+	unsigned int nsets;
+	struct list_head *sets;
+	struct block_cache_stats stats;
+};
+
 static LIST_HEAD(block_cache);
 
 static struct block_cache_stats _stats = {
 	.max_blocks_per_entry = 8,
-	.max_entries = 32
+	.max_entries = 32,
+	.ways = CONFIG_BLOCK_CACHE_WAYS,
 };
 
-static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+static struct block_cache_dev *cache_dev(int iftype, int devnum, bool create)
+{
+	struct block_cache_dev *bcd;
+
+	list_for_each_entry(bcd, &block_cache, lh) {
+		if (bcd->iftype == iftype && bcd->devnum == devnum) {
+			if (block_cache.next != &bcd->lh) {
+				list_del(&bcd->lh);
+				list_add(&bcd->lh, &block_cache);
+			}
+			return bcd;
+		}
+	}
+	if (!create)
+		return NULL;
+
+	bcd = calloc(1, sizeof(*bcd));
+	if (!bcd)
+		return NULL;
+	bcd->iftype = iftype;
+	bcd->devnum = devnum;
+	bcd->stats.max_blocks_per_entry = _stats.max_blocks_per_entry;
+	bcd->stats.max_entries = _stats.max_entries;
+	bcd->stats.ways = _stats.ways;
+	list_add(&bcd->lh, &block_cache);
+
+	return bcd;
+}
+
+static void cache_dev_drop(struct block_cache_dev *bcd)
+{
+	struct block_cache_node *node, *n;
+	unsigned int i;
+
+	if (!bcd->sets)
+		return;
+
+	for (i = 0; i < bcd->nsets; i++) {
+		list_for_each_entry_safe(node, n, &bcd->sets[i], lh) {
+			list_del(&node->lh);
+			free(node);
+		}
+	}
+	free(bcd->sets);
+	bcd->sets = NULL;
+	bcd->nsets = 0;
+	bcd->stats.entries = 0;
+}
+
+static int cache_dev_setup(struct block_cache_dev *bcd, unsigned long blksz)
+{
+	unsigned int i, ways;
+
+	if (bcd->sets && bcd->blksz == blksz)
+		return 0;
+
+	cache_dev_drop(bcd);
+	ways = min(bcd->stats.ways, bcd->stats.max_entries);
+	if (!ways || !bcd->stats.max_blocks_per_entry)
+		return -ENOSPC;
+
+	bcd->nsets = bcd->stats.max_entries / ways;
+	bcd->sets = malloc(bcd->nsets * sizeof(*bcd->sets));
+	if (!bcd->sets)
+		return -ENOMEM;
+	for (i = 0; i < bcd->nsets; i++)
+		INIT_LIST_HEAD(&bcd->sets[i]);
+	bcd->blksz = blksz;
+
+	return 0;
+}
+
+static lbaint_t cache_line(struct block_cache_dev *bcd, lbaint_t blk)
+{
+	u64 n = blk;
+
+	return blk - do_div(n, bcd->stats.max_blocks_per_entry);
+}
+
+static struct list_head *cache_set(struct block_cache_dev *bcd, lbaint_t line)
 {
+	u64 key = line;
+	u32 hash;
+
+	do_div(key, bcd->stats.max_blocks_per_entry);
+	hash = (u32)(key ^ (key >> 32)) * 0x9e3779b1;
+
+	return &bcd->sets[hash % bcd->nsets];
+}
+
+static struct block_cache_node *cache_find(struct block_cache_dev *bcd,
+					   lbaint_t line)
+{
+	struct list_head *set = cache_set(bcd, line);
 	struct block_cache_node *node;
 
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
-			if (block_cache.next != &node->lh) {
+	list_for_each_entry(node, set, lh)
+		if (node->line == line) {
+			if (set->next != &node->lh) {
 				/* maintain MRU ordering */
 				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
+				list_add(&node->lh, set);
 			}
 			return node;
 		}
-	return 0;
+	return NULL;
 }
 
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
-		debug("hit: start " LBAF ", count " LBAFU "\n",
-		      start, blkcnt);
-		++_stats.hits;
-		return 1;
+	struct block_cache_node *nodes[2];
+	struct block_cache_dev *bcd;
+	lbaint_t blk, end, line;
+	int i, count;
+
+	bcd = cache_dev(iftype, devnum, true);
+	if (!bcd)
+		return 0;
+
+	/* big reads bypass the cache */
+	if (blkcnt > bcd->stats.max_blocks_per_entry)
+		return 0;
+
+	if (!bcd->sets || bcd->blksz != blksz)
+		goto miss;
+
+	/* a request no larger than a line spans at most two lines */
+	end = start + blkcnt;
+	for (blk = start, count = 0; blk < end; count++) {
+		line = cache_line(bcd, blk);
+		nodes[count] = cache_find(bcd, line);
+		if (!nodes[count] || nodes[count]->start > blk ||
+		    nodes[count]->start + nodes[count]->blkcnt <
+		    min(end, line + bcd->stats.max_blocks_per_entry))
+			goto miss;
+		blk = line + bcd->stats.max_blocks_per_entry;
 	}
 
+	for (i = 0, blk = start; i < count; i++) {
+		struct block_cache_node *node = nodes[i];
+		lbaint_t cnt = min(end, node->start + node->blkcnt) - blk;
+
+		memcpy(buffer, node->cache + (blk - node->line) * blksz,
+		       cnt * blksz);
+		buffer += cnt * blksz;
+		blk += cnt;
+	}
+
+	debug("hit: start " LBAF ", count " LBAFU "\n",
+	      start, blkcnt);
+	bcd->stats.hits++;
+	bcd->stats.bytes_saved += blkcnt * blksz;
+	return 1;
+
+miss:
 	debug("miss: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
-	++_stats.misses;
+	bcd->stats.misses++;
 	return 0;
 }
 
+static void cache_fill_line(struct block_cache_dev *bcd, lbaint_t line,
+			    lbaint_t start, lbaint_t blkcnt,
+			    void const *buffer)
+{
+	struct list_head *set = cache_set(bcd, line);
+	struct block_cache_node *node;
+	unsigned int used = 0;
+
+	node = cache_find(bcd, line);
+	if (node) {
+		/* keep the larger of the two ranges */
+		if (node->blkcnt > blkcnt)
+			return;
+	} else {
+		list_for_each_entry(node, set, lh)
+			used++;
+		if (used >= min(bcd->stats.ways, bcd->stats.max_entries)) {
+			/* evict the LRU line of this set */
+			node = list_last_entry(set, struct block_cache_node,
+					       lh);
+			list_del(&node->lh);
+			debug("drop: start " LBAF ", count " LBAFU "\n",
+			      node->start, node->blkcnt);
+			bcd->stats.evictions++;
+		} else {
+			node = malloc(sizeof(*node) + bcd->blksz *
+				      bcd->stats.max_blocks_per_entry);
+			if (!node)
+				return;
+			node->cache = (char *)(node + 1);
+			bcd->stats.entries++;
+		}
+		node->line = line;
+		list_add(&node->lh, set);
+	}
+
+	debug("fill: start " LBAF ", count " LBAFU "\n",
+	      start, blkcnt);
+
+	node->start = start;
+	node->blkcnt = blkcnt;
+	memcpy(node->cache + (start - line) * bcd->blksz, buffer,
+	       blkcnt * bcd->blksz);
+}
+
 void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
-	struct block_cache_node *node;
+	struct block_cache_dev *bcd;
+	lbaint_t end, line, next, cnt;
+
+	bcd = cache_dev(iftype, devnum, true);
+	if (!bcd)
+		return;
 
 	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
+	if (blkcnt > bcd->stats.max_blocks_per_entry)
 		return;
 
-	if (_stats.max_entries == 0)
+	if (cache_dev_setup(bcd, blksz))
 		return;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
-		}
-	} else {
-		node = malloc(sizeof(*node));
-		if (!node)
-			return;
-		node->cache = 0;
+	end = start + blkcnt;
+	while (start < end) {
+		line = cache_line(bcd, start);
+		next = line + bcd->stats.max_blocks_per_entry;
+		cnt = min(end, next) - start;
+		cache_fill_line(bcd, line, start, cnt, buffer);
+		buffer += cnt * blksz;
+		start += cnt;
 	}
+}
 
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
-		}
-	}
+bool blkcache_readahead(int iftype, int devnum, unsigned long blksz,
+			lbaint_t start, lbaint_t blkcnt,
+			lbaint_t *ra_startp, lbaint_t *ra_cntp)
+{
+	struct block_cache_dev *bcd;
+	lbaint_t first;
+	u32 blocks;
 
-	debug("fill: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
+	if (!IS_ENABLED(CONFIG_BLOCK_CACHE_READAHEAD))
+		return false;
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+	bcd = cache_dev(iftype, devnum, true);
+	if (!bcd)
+		return false;
+
+	blocks = bcd->stats.max_blocks_per_entry;
+	if (!blocks || blkcnt > blocks || !bcd->stats.max_entries)
+		return false;
+
+	/* only widen requests which fall within a single line */
+	first = cache_line(bcd, start);
+	if (first != cache_line(bcd, start + blkcnt - 1) ||
+	    (first == start && blkcnt == blocks))
+		return false;
+
+	*ra_startp = first;
+	*ra_cntp = blocks;
+
+	return true;
 }
 
 void blkcache_invalidate(int iftype, int devnum)
 {
-	struct list_head *entry, *n;
-	struct block_cache_node *node;
+	struct block_cache_dev *bcd;
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
+	list_for_each_entry(bcd, &block_cache, lh) {
 		if (iftype == -1 ||
-		    (node->iftype == iftype && node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
-		}
+		    (bcd->iftype == iftype && bcd->devnum == devnum))
+			cache_dev_drop(bcd);
 	}
 }
 
+static void cache_dev_configure(struct block_cache_dev *bcd,
+				unsigned int blocks, unsigned int entries)
+{
+	cache_dev_drop(bcd);
+	bcd->stats.max_blocks_per_entry = blocks;
+	bcd->stats.max_entries = entries;
+	bcd->stats.hits = 0;
+	bcd->stats.misses = 0;
+	bcd->stats.evictions = 0;
+	bcd->stats.bytes_saved = 0;
+}
+
 void blkcache_configure(unsigned blocks, unsigned entries)
 {
-	/* invalidate cache if there is a change */
-	if ((blocks != _stats.max_blocks_per_entry) ||
-	    (entries != _stats.max_entries))
-		blkcache_invalidate(-1, 0);
+	struct block_cache_dev *bcd;
+
+	/* this overrides any per-device configuration */
+	list_for_each_entry(bcd, &block_cache, lh)
+		cache_dev_configure(bcd, blocks, entries);
 
 	_stats.max_blocks_per_entry = blocks;
 	_stats.max_entries = entries;
+}
+
+int blkcache_configure_dev(int iftype, int devnum, unsigned int blocks,
+			   unsigned int entries)
+{
+	struct block_cache_dev *bcd;
 
-	_stats.hits = 0;
-	_stats.misses = 0;
+	bcd = cache_dev(iftype, devnum, true);
+	if (!bcd)
+		return -ENOMEM;
+	cache_dev_configure(bcd, blocks, entries);
+
+	return 0;
+}
+
+static void stats_reset(struct block_cache_stats *stats)
+{
+	stats->hits = 0;
+	stats->misses = 0;
+	stats->evictions = 0;
+	stats->bytes_saved = 0;
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
 {
+	struct block_cache_dev *bcd;
+
 	memcpy(stats, &_stats, sizeof(*stats));
-	_stats.hits = 0;
-	_stats.misses = 0;
+	list_for_each_entry(bcd, &block_cache, lh) {
+		stats->hits += bcd->stats.hits;
+		stats->misses += bcd->stats.misses;
+		stats->evictions += bcd->stats.evictions;
+		stats->entries += bcd->stats.entries;
+		stats->bytes_saved += bcd->stats.bytes_saved;
+		stats_reset(&bcd->stats);
+	}
+}
+
+int blkcache_dev_stats(int iftype, int devnum, struct block_cache_stats *stats)
+{
+	struct block_cache_dev *bcd;
+
+	bcd = cache_dev(iftype, devnum, false);
+	if (!bcd)
+		return -ENOENT;
+	memcpy(stats, &bcd->stats, sizeof(*stats));
+	stats_reset(&bcd->stats);
+
+	return 0;
 }
 
 void blkcache_free(void)
 {
-	blkcache_invalidate(-1, 0);
+	struct block_cache_dev *bcd, *n;
+
+	list_for_each_entry_safe(bcd, n, &block_cache, lh) {
+		cache_dev_drop(bcd);
+		list_del(&bcd->lh);
+		free(bcd);
+	}
 }
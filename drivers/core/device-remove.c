@@ -15,6 +15,7 @@
 #include <malloc.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
+#include <dm/root.h>
 #include <dm/uclass.h>
 #include <dm/uclass-internal.h>
 #include <dm/util.h>
@@ -90,6 +91,7 @@ int device_unbind(struct udevice *dev)
 			return log_msg_ret("unbind", ret);
 	}
 
+	dm_lazy_drop(dev);
 	ret = device_chld_unbind(dev, NULL);
 	if (ret)
 		return log_msg_ret("child unbind", ret);
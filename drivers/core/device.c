@@ -8,6 +8,7 @@
  * Pavel Herrmann <morpheus.ibis@gmail.com>
  */
 
+#include <bootstage.h>
 #include <cpu_func.h>
 #include <errno.h>
 #include <event.h>
@@ -26,6 +27,7 @@
 #include <dm/pinctrl.h>
 #include <dm/platdata.h>
 #include <dm/read.h>
+#include <dm/root.h>
 #include <dm/uclass.h>
 #include <dm/uclass-internal.h>
 #include <dm/util.h>
@@ -56,7 +58,7 @@ static int device_bind_common(struct udevice *parent, const struct driver *drv,
 	if (!name)
 		return -EINVAL;
 
-	ret = uclass_get(drv->id, &uc);
+	ret = uclass_find_or_add(drv->id, &uc);
 	if (ret) {
 		dm_warn("Missing uclass for driver %s\n", drv->name);
 		return ret;
@@ -97,8 +99,12 @@ static int device_bind_common(struct udevice *parent, const struct driver *drv,
 			}
 		}
 	}
-	if (auto_seq && !(uc->uc_drv->flags & DM_UC_FLAG_NO_AUTO_SEQ))
-		dev->seq_ = uclass_find_next_free_seq(uc);
+	if (auto_seq && !(uc->uc_drv->flags & DM_UC_FLAG_NO_AUTO_SEQ)) {
+		/* a node bound lazily keeps the number it had when scanned */
+		dev->seq_ = dm_lazy_get_seq(node);
+		if (dev->seq_ < 0)
+			dev->seq_ = uclass_find_next_free_seq(uc);
+	}
 
 	/* Check if we need to allocate plat */
 	if (drv->plat_auto) {
@@ -481,6 +487,7 @@ static int device_get_dma_constraints(struct udevice *dev)
 int device_probe(struct udevice *dev)
 {
 	const struct driver *drv;
+	int stage = -1;
 	int ret;
 
 	if (!dev)
@@ -518,6 +525,11 @@ int device_probe(struct udevice *dev)
 
 	dev_or_flags(dev, DM_FLAG_ACTIVATED);
 
+	/* Time this device, leaving out its parents which are probed above */
+	if (CONFIG_IS_ENABLED(BOOTSTAGE_PROBE))
+		stage = bootstage_probe_start(dev->name,
+					      device_get_uclass_id(dev));
+
 	if (CONFIG_IS_ENABLED(POWER_DOMAIN) && dev->parent &&
 	    (device_get_uclass_id(dev) != UCLASS_POWER_DOMAIN) &&
 	    !(drv->flags & DM_FLAG_DEFAULT_PD_CTRL_OFF)) {
@@ -601,6 +613,9 @@ int device_probe(struct udevice *dev)
 	if (ret)
 		goto fail_event;
 
+	if (stage >= 0)
+		bootstage_accum(stage);
+
 	return 0;
 fail_event:
 fail_uclass:
@@ -609,6 +624,8 @@ fail_uclass:
 			__func__, dev->name);
 	}
 fail:
+	if (stage >= 0)
+		bootstage_accum(stage);
 	dev_bic_flags(dev, DM_FLAG_ACTIVATED);
 
 	device_free(dev);
@@ -815,7 +832,8 @@ int device_get_decendent_count(const struct udevice *parent)
 	const struct udevice *dev;
 	int count = 1;
 
-	device_foreach_child(dev, parent)
+	/* only count bound devices, without binding any waiting to be bound */
+	list_for_each_entry(dev, &parent->child_head, sibling_node)
 		count += device_get_decendent_count(dev);
 
 	return count;
@@ -886,7 +904,8 @@ static struct udevice *_device_find_global_by_ofnode(struct udevice *parent,
 	if (ofnode_equal(dev_ofnode(parent), ofnode))
 		return parent;
 
-	device_foreach_child(dev, parent) {
+	/* the callers have bound the node, so don't bind anything else */
+	list_for_each_entry(dev, &parent->child_head, sibling_node) {
 		found = _device_find_global_by_ofnode(dev, ofnode);
 		if (found)
 			return found;
@@ -897,6 +916,7 @@ static struct udevice *_device_find_global_by_ofnode(struct udevice *parent,
 
 int device_find_global_by_ofnode(ofnode ofnode, struct udevice **devp)
 {
+	dm_lazy_bind_node(ofnode);
 	*devp = _device_find_global_by_ofnode(gd->dm_root, ofnode);
 
 	return *devp ? 0 : -ENOENT;
@@ -906,6 +926,7 @@ int device_get_global_by_ofnode(ofnode ofnode, struct udevice **devp)
 {
 	struct udevice *dev;
 
+	dm_lazy_bind_node(ofnode);
 	dev = _device_find_global_by_ofnode(gd->dm_root, ofnode);
 	return device_get_device_tail(dev, dev ? 0 : -ENOENT, devp);
 }
@@ -932,6 +953,7 @@ int device_get_by_ofplat_idx(uint idx, struct udevice **devp)
 
 int device_find_first_child(const struct udevice *parent, struct udevice **devp)
 {
+	device_lazy_bind_children(parent);
 	if (list_empty(&parent->child_head)) {
 		*devp = NULL;
 	} else {
@@ -1107,6 +1129,8 @@ const char *dev_get_uclass_name(const struct udevice *dev)
 
 bool device_has_children(const struct udevice *dev)
 {
+	device_lazy_bind_children(dev);
+
 	return !list_empty(&dev->child_head);
 }
 
@@ -1138,6 +1162,36 @@ void device_set_name_alloced(struct udevice *dev)
 	dev_or_flags(dev, DM_FLAG_NAME_ALLOCED);
 }
 
+/* Check whether a device is in the lookup tables of its uclass */
+static bool device_is_indexed(struct udevice *dev)
+{
+	return dev->uclass && !list_empty(&dev->uclass_node);
+}
+
+void device_set_seq(struct udevice *dev, int seq)
+{
+	bool indexed = device_is_indexed(dev);
+
+	if (indexed)
+		uclass_index_del(dev);
+	dev->seq_ = seq;
+	if (indexed)
+		uclass_index_add(dev);
+}
+
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX) && CONFIG_IS_ENABLED(OF_REAL)
+void dev_set_ofnode(struct udevice *dev, ofnode node)
+{
+	bool indexed = device_is_indexed(dev);
+
+	if (indexed)
+		uclass_index_del(dev);
+	dev->node_ = node;
+	if (indexed)
+		uclass_index_add(dev);
+}
+#endif
+
 int device_set_name(struct udevice *dev, const char *name)
 {
 	name = strdup(name);
@@ -288,4 +288,35 @@ int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 
 	return result;
 }
+
+int lists_find_fdt_uclass(ofnode node, enum uclass_id *idp)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	const char *compat_list, *compat;
+	const struct udevice_id *id;
+	struct driver *entry;
+	int compat_length, i;
+	bool found = false;
+
+	compat_list = ofnode_get_property(node, "compatible", &compat_length);
+	if (!compat_list)
+		return -ENOENT;
+
+	/* lists_bind_fdt() moves on to the next match if bind gives -ENODEV */
+	for (i = 0; i < compat_length; i += strlen(compat) + 1) {
+		compat = compat_list + i;
+		for (entry = driver; entry != driver + n_ents; entry++) {
+			if (driver_check_compatible(entry->of_match, &id,
+						    compat))
+				continue;
+			if (found && entry->id != *idp)
+				return -EXDEV;
+			*idp = entry->id;
+			found = true;
+		}
+	}
+
+	return found ? 0 : -ENOENT;
+}
 #endif
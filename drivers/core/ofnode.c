@@ -7,6 +7,7 @@
 #define LOG_CATEGORY	LOGC_DT
 
 #include <dm.h>
+#include <fdt_index.h>
 #include <fdtdec.h>
 #include <fdt_support.h>
 #include <log.h>
@@ -602,7 +603,7 @@ ofnode ofnode_find_subnode(ofnode node, const char *subnode_name)
 		subnode = ofnode_find_subnode_unit(node, subnode_name);
 	} else {
 		/* special case to avoid code-size increase */
-		int ooffset = fdt_subnode_offset(ofnode_to_fdt(node),
+		int ooffset = fdt_index_subnode_offset(ofnode_to_fdt(node),
 				ofnode_to_offset(node), subnode_name);
 		subnode = noffset_to_ofnode(node, ooffset);
 	}
@@ -750,8 +751,8 @@ ofnode ofnode_get_by_phandle(uint phandle)
 	if (of_live_active())
 		node = np_to_ofnode(of_find_node_by_phandle(NULL, phandle));
 	else
-		node.of_offset = fdt_node_offset_by_phandle(gd->fdt_blob,
-							    phandle);
+		node.of_offset = fdt_index_node_offset_by_phandle(gd->fdt_blob,
+								  phandle);
 
 	return node;
 }
@@ -764,8 +765,8 @@ ofnode oftree_get_by_phandle(oftree tree, uint phandle)
 		node = np_to_ofnode(of_find_node_by_phandle(tree.np, phandle));
 	else
 		node = ofnode_from_tree_offset(tree,
-			fdt_node_offset_by_phandle(oftree_lookup_fdt(tree),
-						   phandle));
+			fdt_index_node_offset_by_phandle(oftree_lookup_fdt(tree),
+							 phandle));
 
 	return node;
 }
@@ -1087,7 +1088,8 @@ ofnode ofnode_path(const char *path)
 	if (of_live_active())
 		return np_to_ofnode(of_find_node_by_path(path));
 	else
-		return offset_to_ofnode(fdt_path_offset(gd->fdt_blob, path));
+		return offset_to_ofnode(fdt_index_path_offset(gd->fdt_blob,
+							      path));
 }
 
 ofnode oftree_root(oftree tree)
@@ -1107,7 +1109,7 @@ ofnode oftree_path(oftree tree, const char *path)
 	} else if (*path != '/' && tree.fdt != gd->fdt_blob) {
 		return ofnode_null();  /* Aliases only on control FDT */
 	} else {
-		int offset = fdt_path_offset(tree.fdt, path);
+		int offset = fdt_index_path_offset(tree.fdt, path);
 
 		return ofnode_from_tree_offset(tree, offset);
 	}
@@ -1716,7 +1718,7 @@ ofnode ofnode_by_compatible(ofnode from, const char *compat)
 			compat));
 	} else {
 		return noffset_to_ofnode(from,
-			fdt_node_offset_by_compatible(ofnode_to_fdt(from),
+			fdt_index_node_offset_by_compatible(ofnode_to_fdt(from),
 					ofnode_to_offset(from), compat));
 	}
 }
@@ -1756,6 +1758,11 @@ int ofnode_write_prop(ofnode node, const char *propname, const void *value,
 			free(newval);
 		return ret;
 	} else {
+		/* the index cannot tell when these are changed in place */
+		if (!strcmp(propname, "compatible") ||
+		    !strcmp(propname, "phandle") ||
+		    !strcmp(propname, "linux,phandle"))
+			fdt_index_invalidate(ofnode_to_fdt(node));
 		ret = fdt_setprop(ofnode_to_fdt(node), ofnode_to_offset(node),
 				  propname, value, len);
 		if (ret)
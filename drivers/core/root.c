@@ -8,6 +8,7 @@
 
 #define LOG_CATEGORY UCLASS_ROOT
 
+#include <bootstage.h>
 #include <errno.h>
 #include <fdtdec.h>
 #include <log.h>
@@ -36,6 +37,76 @@ static const struct driver_info root_info = {
 	.name		= "root_driver",
 };
 
+/**
+ * struct dm_lazy_node - A devicetree node waiting to be bound
+ *
+ * @parent: Device to bind the node to
+ * @node: Node to bind
+ * @id: Uclass of the drivers matching the node, or UCLASS_INVALID if it is no
+ *	longer waiting
+ * @seq: Sequence number the device would have been given if bound when the
+ *	node was scanned, or -1 if it is not numbered automatically
+ */
+struct dm_lazy_node {
+	struct udevice *parent;
+	ofnode node;
+	enum uclass_id id;
+	int seq;
+};
+
+/**
+ * struct dm_lazy - Information about nodes waiting to be bound
+ *
+ * This is the private data of the root device, so it goes away with the
+ * driver-model state it belongs to
+ *
+ * @active: true to record nodes rather than binding them
+ * @depth: Number of nested calls which are binding nodes
+ * @count: Number of entries used in @nodes
+ * @size: Number of entries allocated in @nodes
+ * @pending: Number of entries in @nodes which are waiting to be bound
+ * @nodes: Recorded nodes, in the order they were scanned
+ * @bind_node: Recorded node being bound, ofnode_null() if none
+ * @bind_seq: Sequence number to give the device for @bind_node
+ * @done: true for each uclass whose nodes have been bound
+ * @next_seq: For each uclass, one more than the highest sequence number kept
+ *	for a recorded node, or 0 if none
+ */
+struct dm_lazy {
+	bool active;
+	int depth;
+	int count;
+	int size;
+	int pending;
+	struct dm_lazy_node *nodes;
+	ofnode bind_node;
+	int bind_seq;
+	bool done[UCLASS_COUNT];
+	int next_seq[UCLASS_COUNT];
+};
+
+static struct dm_lazy *dm_lazy_get(void)
+{
+	if (!CONFIG_IS_ENABLED(DM_LAZY_BIND) || !gd->dm_root)
+		return NULL;
+
+	return dev_get_priv(gd->dm_root);
+}
+
+static void dm_lazy_uninit(void)
+{
+	struct dm_lazy *lazy = dm_lazy_get();
+
+	if (!lazy)
+		return;
+	lazy->active = false;
+	free(lazy->nodes);
+	lazy->nodes = NULL;
+	lazy->count = 0;
+	lazy->size = 0;
+	lazy->pending = 0;
+}
+
 struct udevice *dm_root(void)
 {
 	if (!gd->dm_root) {
@@ -131,6 +202,8 @@ int dm_init(bool of_live)
 
 int dm_uninit(void)
 {
+	dm_lazy_uninit();
+
 	/* Remove non-vital devices first */
 	device_remove(dm_root(), DM_REMOVE_NON_VITAL);
 	device_remove(dm_root(), DM_REMOVE_NORMAL);
@@ -181,6 +254,116 @@ int dm_scan_plat(bool pre_reloc_only)
 }
 
 #if CONFIG_IS_ENABLED(OF_REAL)
+/**
+ * dm_lazy_node_seq() - Get the sequence number a node would be given now
+ *
+ * This follows device_bind_common(), so that a node bound later gets the
+ * same number as if it had been bound in devicetree order.
+ *
+ * @lazy: Lazy-binding information
+ * @uc_drv: Uclass driver for the node
+ * @node: Node to check
+ * Return: sequence number, or -1 if the node has an alias or the uclass does
+ * not number its devices automatically
+ */
+static int dm_lazy_node_seq(struct dm_lazy *lazy, struct uclass_driver *uc_drv,
+			    ofnode node)
+{
+	struct uclass *uc;
+	int seq;
+
+	if (uc_drv->flags & DM_UC_FLAG_NO_AUTO_SEQ)
+		return -1;
+	if (CONFIG_IS_ENABLED(DM_SEQ_ALIAS) &&
+	    (uc_drv->flags & DM_UC_FLAG_SEQ_ALIAS) && uc_drv->name) {
+		if (ofnode_is_np(node) ?
+		    of_alias_get_id(ofnode_to_np(node), uc_drv->name) >= 0 :
+		    !fdtdec_get_alias_seq(gd->fdt_blob, uc_drv->name,
+					  ofnode_to_offset(node), &seq))
+			return -1;
+	}
+
+	/* don't create the uclass just for this */
+	uc = uclass_find(uc_drv->id);
+	if (uc)
+		return uclass_find_next_free_seq(uc);
+	seq = lazy->next_seq[uc_drv->id];
+	if (CONFIG_IS_ENABLED(DM_SEQ_ALIAS) &&
+	    (uc_drv->flags & DM_UC_FLAG_SEQ_ALIAS))
+		seq = max(seq, dev_read_alias_highest_id(uc_drv->name) + 1);
+
+	return seq;
+}
+
+/**
+ * dm_lazy_defer() - Record a node to be bound when it is needed
+ *
+ * Only children of the root node and of simple-bus nodes are recorded. Other
+ * buses normally need all their children as soon as they are used, and may
+ * want to bind them in their own way.
+ *
+ * A node with a compatible subnode is bound straight away, since its driver
+ * may bind children in any uclass, which dm_lazy_bind_uclass() would not know
+ * about. This includes simple-bus nodes (which also have
+ * DM_UC_FLAG_NO_LAZY_BIND), so that their children are recorded. So is a node
+ * whose compatible strings match drivers in more than one uclass, since it is
+ * not known which of them it binds to.
+ *
+ * The sequence number which the device would be given now is kept for it, so
+ * that numbering follows the devicetree whatever order nodes are bound in.
+ *
+ * @parent: Parent device for the node
+ * @node: Node to record
+ * Return: true if the node was recorded, false if it should be bound now
+ */
+static bool dm_lazy_defer(struct udevice *parent, ofnode node)
+{
+	struct dm_lazy *lazy = dm_lazy_get();
+	struct uclass_driver *uc_drv;
+	struct dm_lazy_node *ent;
+	enum uclass_id id;
+	ofnode subnode;
+
+	if (!lazy || !lazy->active)
+		return false;
+	if (parent != gd->dm_root &&
+	    device_get_uclass_id(parent) != UCLASS_SIMPLE_BUS)
+		return false;
+	ofnode_for_each_subnode(subnode, node) {
+		if (ofnode_has_property(subnode, "compatible") &&
+		    ofnode_is_enabled(subnode))
+			return false;
+	}
+
+	if (lists_find_fdt_uclass(node, &id) || id < 0 ||
+	    id >= UCLASS_COUNT || lazy->done[id])
+		return false;
+	uc_drv = lists_uclass_lookup(id);
+	if (!uc_drv || uc_drv->flags & DM_UC_FLAG_NO_LAZY_BIND)
+		return false;
+
+	if (lazy->count == lazy->size) {
+		int size = lazy->size ? lazy->size * 2 : 64;
+
+		ent = realloc(lazy->nodes, size * sizeof(*ent));
+		if (!ent)
+			return false;
+		lazy->nodes = ent;
+		lazy->size = size;
+	}
+	ent = &lazy->nodes[lazy->count++];
+	ent->parent = parent;
+	ent->node = node;
+	ent->id = id;
+	ent->seq = dm_lazy_node_seq(lazy, uc_drv, node);
+	if (ent->seq >= 0)
+		lazy->next_seq[id] = ent->seq + 1;
+	dev_or_flags(parent, DM_FLAG_LAZY_CHILDREN);
+	lazy->pending++;
+
+	return true;
+}
+
 /**
  * dm_scan_fdt_node() - Scan the device tree and bind drivers for a node
  *
@@ -211,6 +394,9 @@ static int dm_scan_fdt_node(struct udevice *parent, ofnode parent_node,
 			pr_debug("   - ignoring disabled device\n");
 			continue;
 		}
+		if (CONFIG_IS_ENABLED(DM_LAZY_BIND) && !pre_reloc_only &&
+		    dm_lazy_defer(parent, node))
+			continue;
 		err = lists_bind_fdt(parent, node, NULL, NULL, pre_reloc_only);
 		if (err && !ret) {
 			ret = err;
@@ -333,6 +519,226 @@ int dm_autoprobe(void)
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+static void dm_lazy_start(struct dm_lazy *lazy)
+{
+	if (!lazy->depth++)
+		bootstage_start(BOOTSTAGE_ID_ACCUM_DM_LAZY, "dm_lazy");
+}
+
+static void dm_lazy_end(struct dm_lazy *lazy)
+{
+	if (!--lazy->depth)
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_DM_LAZY);
+}
+
+/**
+ * dm_lazy_bind_entry() - Bind a recorded node
+ *
+ * The node is bound in the same way as when the devicetree is scanned, then
+ * probed if its device asks for that
+ *
+ * @lazy: Lazy-binding information
+ * @i: Index of the node in @lazy->nodes, which must be waiting to be bound
+ * Return: 0 if OK, -ve on error
+ */
+static int dm_lazy_bind_entry(struct dm_lazy *lazy, int i)
+{
+	struct udevice *parent = lazy->nodes[i].parent;
+	ofnode node = lazy->nodes[i].node;
+	ofnode old_node = lazy->bind_node;
+	int old_seq = lazy->bind_seq;
+	struct udevice *dev;
+	int ret;
+
+	/* binding may add entries, so @lazy->nodes may move */
+	lazy->bind_node = node;
+	lazy->bind_seq = lazy->nodes[i].seq;
+	lazy->nodes[i].id = UCLASS_INVALID;
+	lazy->pending--;
+	ret = lists_bind_fdt(parent, node, &dev, NULL, false);
+	lazy->bind_node = old_node;
+	lazy->bind_seq = old_seq;
+	if (ret) {
+		dm_warn("%s: ret=%d\n", ofnode_get_name(node), ret);
+		return ret;
+	}
+	if (dev)
+		return dm_probe_devices(dev, false);
+
+	return 0;
+}
+
+static bool dm_lazy_has_fdt_drivers(enum uclass_id id)
+{
+	struct driver *drv = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	struct driver *entry;
+
+	for (entry = drv; entry != drv + n_ents; entry++) {
+		if (entry->id == id && entry->of_match)
+			return true;
+	}
+
+	return false;
+}
+
+int dm_lazy_bind_uclass(enum uclass_id id)
+{
+	struct dm_lazy *lazy = dm_lazy_get();
+	int ret = 0, err, i;
+
+	if (!lazy || !lazy->active || id < 0 || id >= UCLASS_COUNT ||
+	    lazy->done[id])
+		return 0;
+	lazy->done[id] = true;
+	if (!lazy->pending || id == UCLASS_ROOT)
+		return 0;
+	if (!dm_lazy_has_fdt_drivers(id))
+		return dm_lazy_bind_all();
+
+	dm_lazy_start(lazy);
+	for (i = 0; i < lazy->count; i++) {
+		if (lazy->nodes[i].id == id) {
+			err = dm_lazy_bind_entry(lazy, i);
+			if (err && !ret)
+				ret = err;
+		}
+	}
+	dm_lazy_end(lazy);
+
+	return ret;
+}
+
+int dm_lazy_bind_node(ofnode node)
+{
+	struct dm_lazy *lazy = dm_lazy_get();
+	ofnode path[32];
+	int depth = 0, ret = 0, i;
+
+	if (!lazy || !lazy->active || !lazy->pending)
+		return 0;
+
+	/* parents must be bound first */
+	for (; ofnode_valid(node); node = ofnode_get_parent(node)) {
+		if (depth == ARRAY_SIZE(path))
+			return log_msg_ret("lzd", -E2BIG);
+		path[depth++] = node;
+	}
+
+	dm_lazy_start(lazy);
+	while (depth--) {
+		for (i = 0; i < lazy->count; i++) {
+			if (lazy->nodes[i].id != UCLASS_INVALID &&
+			    ofnode_equal(lazy->nodes[i].node, path[depth]))
+				break;
+		}
+		if (i < lazy->count) {
+			ret = dm_lazy_bind_entry(lazy, i);
+			if (ret)
+				break;
+		}
+	}
+	dm_lazy_end(lazy);
+
+	return ret;
+}
+
+int dm_lazy_bind_children(const struct udevice *parent)
+{
+	struct dm_lazy *lazy = dm_lazy_get();
+	int ret = 0, err, i;
+
+	/* the flag only says whether there may be children to bind */
+	dev_bic_flags((struct udevice *)parent, DM_FLAG_LAZY_CHILDREN);
+	if (!lazy || !lazy->active || !lazy->pending)
+		return 0;
+
+	dm_lazy_start(lazy);
+	for (i = 0; i < lazy->count; i++) {
+		if (lazy->nodes[i].id != UCLASS_INVALID &&
+		    lazy->nodes[i].parent == parent) {
+			err = dm_lazy_bind_entry(lazy, i);
+			if (err && !ret)
+				ret = err;
+		}
+	}
+	dm_lazy_end(lazy);
+
+	return ret;
+}
+
+int dm_lazy_get_seq(ofnode node)
+{
+	struct dm_lazy *lazy = dm_lazy_get();
+
+	if (!lazy || !lazy->depth || !ofnode_equal(node, lazy->bind_node))
+		return -1;
+
+	return lazy->bind_seq;
+}
+
+int dm_lazy_next_seq(enum uclass_id id)
+{
+	struct dm_lazy *lazy = dm_lazy_get();
+
+	if (!lazy || id < 0 || id >= UCLASS_COUNT)
+		return 0;
+
+	return lazy->next_seq[id];
+}
+
+int dm_lazy_bind_all(void)
+{
+	struct dm_lazy *lazy = dm_lazy_get();
+	int ret = 0, err, i;
+
+	if (!lazy || !lazy->active)
+		return 0;
+
+	/* anything scanned from now on is bound straight away */
+	lazy->active = false;
+	dm_lazy_start(lazy);
+	for (i = 0; i < lazy->count; i++) {
+		if (lazy->nodes[i].id != UCLASS_INVALID) {
+			err = dm_lazy_bind_entry(lazy, i);
+			if (err && !ret)
+				ret = err;
+		}
+	}
+	dm_lazy_end(lazy);
+	free(lazy->nodes);
+	lazy->nodes = NULL;
+	lazy->count = 0;
+	lazy->size = 0;
+
+	return ret;
+}
+
+void dm_lazy_drop(struct udevice *parent)
+{
+	struct dm_lazy *lazy = dm_lazy_get();
+	int i;
+
+	if (!lazy)
+		return;
+	for (i = 0; i < lazy->count; i++) {
+		if (lazy->nodes[i].id != UCLASS_INVALID &&
+		    lazy->nodes[i].parent == parent) {
+			lazy->nodes[i].id = UCLASS_INVALID;
+			lazy->pending--;
+		}
+	}
+}
+
+int dm_lazy_pending(void)
+{
+	struct dm_lazy *lazy = dm_lazy_get();
+
+	return lazy ? lazy->pending : 0;
+}
+#endif
+
 /**
  * dm_scan() - Scan tables to bind devices
  *
@@ -377,6 +783,8 @@ int dm_init_and_scan(bool pre_reloc_only)
 		dm_warn("dm_init() failed: %d\n", ret);
 		return ret;
 	}
+	if (CONFIG_IS_ENABLED(DM_LAZY_BIND) && !pre_reloc_only)
+		dm_lazy_get()->active = true;
 	if (!CONFIG_IS_ENABLED(OF_PLATDATA_INST)) {
 		ret = dm_scan(pre_reloc_only);
 		if (ret) {
@@ -469,6 +877,9 @@ struct acpi_ops root_acpi_ops = {
 U_BOOT_DRIVER(root_driver) = {
 	.name	= "root_driver",
 	.id	= UCLASS_ROOT,
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+	.priv_auto	= sizeof(struct dm_lazy),
+#endif
 	ACPI_OPS_PTR(&root_acpi_ops)
 };
 
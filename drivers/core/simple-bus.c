@@ -60,6 +60,8 @@ static int simple_bus_post_bind(struct udevice *dev)
 UCLASS_DRIVER(simple_bus) = {
 	.id		= UCLASS_SIMPLE_BUS,
 	.name		= "simple_bus",
+	/* the children must be scanned so that they can be recorded */
+	.flags		= DM_UC_FLAG_NO_LAZY_BIND,
 	.post_bind	= simple_bus_post_bind,
 	.per_device_plat_auto	= sizeof(struct simple_bus_plat),
 };
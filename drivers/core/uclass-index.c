@@ -0,0 +1,346 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Lookup tables for the devices in a uclass
+ *
+ * Each uclass has an array of devices indexed by sequence number and a hash
+ * table of devices keyed by devicetree node, so that finding a device takes
+ * constant time rather than a walk of the uclass's device list.
+ *
+ * Where several devices share a sequence number or node, the tables hold the
+ * one which comes first in the device list, so results are the same as for a
+ * list walk. The others are counted, so that when the device in the table is
+ * removed, the list only needs to be walked if there may be another to take
+ * its place.
+ */
+
+#define LOG_CATEGORY LOGC_DM
+
+#include <dm.h>
+#include <log.h>
+#include <malloc.h>
+#include <dm/device-internal.h>
+#include <dm/uclass-internal.h>
+#include <linux/list.h>
+
+/* Devices with a sequence number this large are found by walking the list */
+#define SEQ_INDEX_MAX	1024
+
+/**
+ * struct uclass_index - Lookup tables for the devices in a uclass
+ *
+ * @seq_size: Number of entries in @seq_devs
+ * @seq_dups: Number of devices whose sequence number is held by another
+ *	device in @seq_devs
+ * @seq_other: Number of devices with a sequence number of SEQ_INDEX_MAX or
+ *	more
+ * @seq_devs: Device for each sequence number, or NULL if none
+ * @node_count: Number of devices in @node_devs
+ * @node_dups: Number of devices whose node is held by another device in
+ *	@node_devs
+ * @node_mask: Number of entries in @node_devs, less one
+ * @node_devs: Hash table of devices with a valid node, using linear probing
+ */
+struct uclass_index {
+	int seq_size;
+	int seq_dups;
+	int seq_other;
+	struct udevice **seq_devs;
+	int node_count;
+	int node_dups;
+	uint node_mask;
+	struct udevice **node_devs;
+};
+
+void uclass_index_init(struct uclass *uc)
+{
+	uc->index_ = calloc(1, sizeof(struct uclass_index));
+}
+
+void uclass_index_free(struct uclass *uc)
+{
+	struct uclass_index *idx = uc->index_;
+
+	if (!idx)
+		return;
+	free(idx->seq_devs);
+	free(idx->node_devs);
+	free(idx);
+	uc->index_ = NULL;
+}
+
+/* Give up on the tables, e.g. when out of memory, and walk the list instead */
+static void uclass_index_drop(struct uclass *uc)
+{
+	log_debug("Dropping lookup tables for uclass '%s'\n", uc->uc_drv->name);
+	uclass_index_free(uc);
+}
+
+/* Check whether @dev comes before @other in the device list of its uclass */
+static bool uclass_index_before(struct udevice *dev, struct udevice *other)
+{
+	struct udevice *pos;
+
+	/* a device being bound is always last */
+	if (list_is_last(&dev->uclass_node, &dev->uclass->dev_head))
+		return false;
+	uclass_foreach_dev(pos, dev->uclass) {
+		if (pos == dev)
+			return true;
+		if (pos == other)
+			return false;
+	}
+
+	return false;
+}
+
+static int uclass_index_add_seq(struct uclass_index *idx, struct udevice *dev)
+{
+	int seq = dev_seq(dev);
+
+	if (seq < 0)
+		return 0;
+	if (seq >= SEQ_INDEX_MAX) {
+		idx->seq_other++;
+		return 0;
+	}
+	if (seq >= idx->seq_size) {
+		struct udevice **devs;
+		int size;
+
+		for (size = max(idx->seq_size * 2, 8); size <= seq; size *= 2)
+			;
+		/* realloc() is not available before relocation */
+		devs = calloc(size, sizeof(*devs));
+		if (!devs)
+			return -ENOMEM;
+		if (idx->seq_devs)
+			memcpy(devs, idx->seq_devs,
+			       idx->seq_size * sizeof(*devs));
+		free(idx->seq_devs);
+		idx->seq_devs = devs;
+		idx->seq_size = size;
+	}
+	if (idx->seq_devs[seq]) {
+		if (uclass_index_before(dev, idx->seq_devs[seq]))
+			idx->seq_devs[seq] = dev;
+		idx->seq_dups++;
+	} else {
+		idx->seq_devs[seq] = dev;
+	}
+
+	return 0;
+}
+
+static void uclass_index_del_seq(struct uclass_index *idx,
+				 struct udevice *dev)
+{
+	int seq = dev_seq(dev);
+	struct udevice *pos;
+
+	if (seq < 0)
+		return;
+	if (seq >= SEQ_INDEX_MAX) {
+		idx->seq_other--;
+		return;
+	}
+	if (idx->seq_devs[seq] != dev) {
+		idx->seq_dups--;
+		return;
+	}
+	idx->seq_devs[seq] = NULL;
+	if (!idx->seq_dups)
+		return;
+	uclass_foreach_dev(pos, dev->uclass) {
+		if (pos != dev && dev_seq(pos) == seq) {
+			idx->seq_devs[seq] = pos;
+			idx->seq_dups--;
+			break;
+		}
+	}
+}
+
+static uint uclass_index_hash(ofnode node)
+{
+	ulong key = node.of_offset;
+	u32 hash;
+
+	/* node pointers are aligned, so mix in the upper bits */
+	hash = (u32)key ^ (u32)(key >> 16 >> 16);
+	hash *= 0x9e3779b1;
+
+	return hash ^ hash >> 15;
+}
+
+/* Find the slot holding @node, or the empty slot where it would go */
+static uint uclass_index_slot(struct uclass_index *idx, ofnode node)
+{
+	uint i;
+
+	for (i = uclass_index_hash(node) & idx->node_mask; idx->node_devs[i];
+	     i = (i + 1) & idx->node_mask) {
+		if (ofnode_equal(dev_ofnode(idx->node_devs[i]), node))
+			break;
+	}
+
+	return i;
+}
+
+static int uclass_index_grow(struct uclass_index *idx)
+{
+	struct udevice **old = idx->node_devs;
+	uint old_size = old ? idx->node_mask + 1 : 0;
+	uint size = old_size ? old_size * 2 : 16;
+	uint i;
+
+	idx->node_devs = calloc(size, sizeof(*idx->node_devs));
+	if (!idx->node_devs) {
+		idx->node_devs = old;
+		return -ENOMEM;
+	}
+	idx->node_mask = size - 1;
+	for (i = 0; i < old_size; i++) {
+		if (old[i])
+			idx->node_devs[uclass_index_slot(idx,
+						dev_ofnode(old[i]))] = old[i];
+	}
+	free(old);
+
+	return 0;
+}
+
+static int uclass_index_add_node(struct uclass_index *idx,
+				 struct udevice *dev)
+{
+	ofnode node = dev_ofnode(dev);
+	struct udevice *other;
+	uint i;
+
+	if (!ofnode_valid(node))
+		return 0;
+
+	/* keep the table at most half full */
+	if (!idx->node_devs || (idx->node_count + 1) * 2 > idx->node_mask + 1) {
+		if (uclass_index_grow(idx))
+			return -ENOMEM;
+	}
+	i = uclass_index_slot(idx, node);
+	other = idx->node_devs[i];
+	if (other) {
+		if (uclass_index_before(dev, other))
+			idx->node_devs[i] = dev;
+		idx->node_dups++;
+	} else {
+		idx->node_devs[i] = dev;
+		idx->node_count++;
+	}
+
+	return 0;
+}
+
+static void uclass_index_del_node(struct uclass_index *idx,
+				  struct udevice *dev)
+{
+	ofnode node = dev_ofnode(dev);
+	struct udevice *pos;
+	uint i, j, home;
+
+	if (!ofnode_valid(node))
+		return;
+	i = uclass_index_slot(idx, node);
+	if (idx->node_devs[i] != dev) {
+		idx->node_dups--;
+		return;
+	}
+	if (idx->node_dups) {
+		uclass_foreach_dev(pos, dev->uclass) {
+			if (pos != dev && ofnode_equal(dev_ofnode(pos), node)) {
+				idx->node_devs[i] = pos;
+				idx->node_dups--;
+				return;
+			}
+		}
+	}
+
+	/* move back any later entries which can no longer be reached */
+	idx->node_devs[i] = NULL;
+	idx->node_count--;
+	for (j = (i + 1) & idx->node_mask; idx->node_devs[j];
+	     j = (j + 1) & idx->node_mask) {
+		home = uclass_index_hash(dev_ofnode(idx->node_devs[j])) &
+			idx->node_mask;
+		if (((j - home) & idx->node_mask) >=
+		    ((j - i) & idx->node_mask)) {
+			idx->node_devs[i] = idx->node_devs[j];
+			idx->node_devs[j] = NULL;
+			i = j;
+		}
+	}
+}
+
+void uclass_index_add(struct udevice *dev)
+{
+	struct uclass *uc = dev->uclass;
+	struct uclass_index *idx = uc->index_;
+
+	if (!idx)
+		return;
+	if (uclass_index_add_seq(idx, dev) || uclass_index_add_node(idx, dev))
+		uclass_index_drop(uc);
+}
+
+void uclass_index_del(struct udevice *dev)
+{
+	struct uclass_index *idx = dev->uclass->index_;
+
+	if (!idx)
+		return;
+	uclass_index_del_seq(idx, dev);
+	uclass_index_del_node(idx, dev);
+}
+
+int uclass_index_find_seq(struct uclass *uc, int seq, struct udevice **devp)
+{
+	struct uclass_index *idx = uc->index_;
+
+	if (seq < 0)
+		return -ENODEV;
+	if (!idx || seq >= SEQ_INDEX_MAX)
+		return -ENOSYS;
+	if (seq >= idx->seq_size || !idx->seq_devs[seq])
+		return -ENODEV;
+	*devp = idx->seq_devs[seq];
+
+	return 0;
+}
+
+int uclass_index_find_ofnode(struct uclass *uc, ofnode node,
+			     struct udevice **devp)
+{
+	struct uclass_index *idx = uc->index_;
+	struct udevice *dev;
+
+	if (!idx)
+		return -ENOSYS;
+	if (!idx->node_devs)
+		return -ENODEV;
+	dev = idx->node_devs[uclass_index_slot(idx, node)];
+	if (!dev)
+		return -ENODEV;
+	*devp = dev;
+
+	return 0;
+}
+
+int uclass_index_max_seq(struct uclass *uc, int *maxp)
+{
+	struct uclass_index *idx = uc->index_;
+	int seq;
+
+	if (!idx || idx->seq_other)
+		return -ENOSYS;
+	for (seq = idx->seq_size - 1; seq >= 0 && !idx->seq_devs[seq]; seq--)
+		;
+	*maxp = seq;
+
+	return 0;
+}
@@ -17,6 +17,7 @@
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/ofnode_graph.h>
+#include <dm/root.h>
 #include <dm/uclass.h>
 #include <dm/uclass-internal.h>
 #include <dm/util.h>
@@ -85,6 +86,7 @@ static int uclass_add(enum uclass_id id, struct uclass **ucp)
 	uc->uc_drv = uc_drv;
 	INIT_LIST_HEAD(&uc->sibling_node);
 	INIT_LIST_HEAD(&uc->dev_head);
+	uclass_index_init(uc);
 	list_add(&uc->sibling_node, DM_UCLASS_ROOT_NON_CONST);
 
 	if (uc_drv->init) {
@@ -137,12 +139,13 @@ int uclass_destroy(struct uclass *uc)
 	list_del(&uc->sibling_node);
 	if (uc_drv->priv_auto)
 		free(uclass_get_priv(uc));
+	uclass_index_free(uc);
 	free(uc);
 
 	return 0;
 }
 
-int uclass_get(enum uclass_id id, struct uclass **ucp)
+int uclass_find_or_add(enum uclass_id id, struct uclass **ucp)
 {
 	struct uclass *uc;
 
@@ -161,11 +164,20 @@ int uclass_get(enum uclass_id id, struct uclass **ucp)
 	return 0;
 }
 
+int uclass_get(enum uclass_id id, struct uclass **ucp)
+{
+	/* Bind any devices in this uclass which are waiting to be bound */
+	if (CONFIG_IS_ENABLED(DM_LAZY_BIND) && gd->dm_root)
+		dm_lazy_bind_uclass(id);
+
+	return uclass_find_or_add(id, ucp);
+}
+
 const char *uclass_get_name(enum uclass_id id)
 {
 	struct uclass *uc;
 
-	if (uclass_get(id, &uc))
+	if (uclass_find_or_add(id, &uc))
 		return NULL;
 	return uc->uc_drv->name;
 }
@@ -316,7 +328,7 @@ struct udevice *uclass_try_first_device(enum uclass_id id)
 int uclass_find_next_free_seq(struct uclass *uc)
 {
 	struct udevice *dev;
-	int max = -1;
+	int max = -1, seq;
 
 	/* If using aliases, start with the highest alias value */
 	if (CONFIG_IS_ENABLED(DM_SEQ_ALIAS) &&
@@ -324,10 +336,19 @@ int uclass_find_next_free_seq(struct uclass *uc)
 		max = dev_read_alias_highest_id(uc->uc_drv->name);
 
 	/* Avoid conflict with existing devices */
-	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
-		if (dev->seq_ > max)
-			max = dev->seq_;
+	if (!uclass_index_max_seq(uc, &seq)) {
+		if (seq > max)
+			max = seq;
+	} else {
+		list_for_each_entry(dev, &uc->dev_head, uclass_node) {
+			if (dev->seq_ > max)
+				max = dev->seq_;
+		}
 	}
+	/* Leave the numbers kept for devices which are waiting to be bound */
+	if (CONFIG_IS_ENABLED(DM_LAZY_BIND))
+		max = max(max, dm_lazy_next_seq(uc->uc_drv->id) - 1);
+
 	/*
 	 * At this point, max will be -1 if there are no existing aliases or
 	 * devices
@@ -350,6 +371,9 @@ int uclass_find_device_by_seq(enum uclass_id id, int seq, struct udevice **devp)
 	if (ret)
 		return ret;
 
+	ret = uclass_index_find_seq(uc, seq, devp);
+	if (ret != -ENOSYS)
+		return ret;
 	uclass_foreach_dev(dev, uc) {
 		log_debug("   - %d '%s'\n", dev->seq_, dev->name);
 		if (dev->seq_ == seq) {
@@ -402,6 +426,9 @@ int uclass_find_device_by_ofnode(enum uclass_id id, ofnode node,
 	if (ret)
 		return ret;
 
+	ret = uclass_index_find_ofnode(uc, node, devp);
+	if (ret != -ENOSYS)
+		goto done;
 	uclass_foreach_dev(dev, uc) {
 		log(LOGC_DM, LOGL_DEBUG_CONTENT, "      - checking %s\n",
 		    dev->name);
@@ -431,6 +458,16 @@ static int uclass_find_device_by_phandle_id(enum uclass_id id,
 	if (ret)
 		return ret;
 
+	/* only the flat tree can find a phandle quickly */
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX) && !of_live_active()) {
+		ofnode node = ofnode_get_by_phandle(find_phandle);
+
+		if (ofnode_valid(node)) {
+			ret = uclass_index_find_ofnode(uc, node, devp);
+			if (ret != -ENOSYS)
+				return ret;
+		}
+	}
 	uclass_foreach_dev(dev, uc) {
 		uint phandle;
 
@@ -717,6 +754,7 @@ int uclass_bind_device(struct udevice *dev)
 
 	uc = dev->uclass;
 	list_add_tail(&dev->uclass_node, &uc->dev_head);
+	uclass_index_add(dev);
 
 	if (dev->parent) {
 		struct uclass_driver *uc_drv = dev->parent->uclass->uc_drv;
@@ -731,7 +769,8 @@ int uclass_bind_device(struct udevice *dev)
 	return 0;
 err:
 	/* There is no need to undo the parent's post_bind call */
-	list_del(&dev->uclass_node);
+	uclass_index_del(dev);
+	list_del_init(&dev->uclass_node);
 
 	return ret;
 }
@@ -754,7 +793,8 @@ int uclass_pre_unbind_device(struct udevice *dev)
 
 int uclass_unbind_device(struct udevice *dev)
 {
-	list_del(&dev->uclass_node);
+	uclass_index_del(dev);
+	list_del_init(&dev->uclass_node);
 
 	return 0;
 }
@@ -857,4 +897,5 @@ int uclass_id_count(enum uclass_id id)
 UCLASS_DRIVER(nop) = {
 	.id		= UCLASS_NOP,
 	.name		= "nop",
+	.flags		= DM_UC_FLAG_NO_LAZY_BIND,
 };
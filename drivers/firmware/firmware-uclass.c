@@ -11,4 +11,5 @@ UCLASS_DRIVER(firmware) = {
 #if CONFIG_IS_ENABLED(OF_REAL)
 	.post_bind	= dm_scan_fdt_dev,
 #endif
+	.flags		= DM_UC_FLAG_NO_LAZY_BIND,
 };
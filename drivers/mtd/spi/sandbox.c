@@ -93,6 +93,8 @@ struct sandbox_spi_flash {
 	const struct flash_info *data;
 	/* The file on disk to serv up data from */
 	int fd;
+	/* Number of operations received for each opcode */
+	uint op_count[256];
 };
 
 struct sandbox_spi_flash_plat_data {
@@ -110,6 +112,20 @@ void sandbox_sf_set_block_protect(struct udevice *dev, int bp_mask)
 	sbsf->status |= bp_mask << STAT_BP_SHIFT;
 }
 
+uint sandbox_sf_get_op_count(struct udevice *dev, u8 opcode)
+{
+	struct sandbox_spi_flash *sbsf = dev_get_priv(dev);
+
+	return sbsf->op_count[opcode];
+}
+
+void sandbox_sf_reset_op_count(struct udevice *dev)
+{
+	struct sandbox_spi_flash *sbsf = dev_get_priv(dev);
+
+	memset(sbsf->op_count, '\0', sizeof(sbsf->op_count));
+}
+
 /**
  * This is a very strange probe function. If it has platform data (which may
  * have come from the device tree) then this function gets the filename and
@@ -240,6 +256,7 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 		sandbox_spi_tristate(tx, 1);
 
 	sbsf->cmd = rx[0];
+	sbsf->op_count[sbsf->cmd]++;
 	switch (sbsf->cmd) {
 	case SPINOR_OP_RDID:
 		sbsf->state = SF_ID;
@@ -450,8 +450,11 @@ static ssize_t spi_nor_write_data(struct spi_nor *nor, loff_t to, size_t len,
 	if (CONFIG_IS_ENABLED(SPI_DIRMAP) && nor->dirmap.wdesc) {
 		memcpy(&nor->dirmap.wdesc->info.op_tmpl, &op,
 		       sizeof(struct spi_mem_op));
-		op.data.nbytes = spi_mem_dirmap_write(nor->dirmap.wdesc, op.addr.val,
-						      op.data.nbytes, op.data.buf.out);
+		ret = spi_mem_dirmap_write(nor->dirmap.wdesc, op.addr.val,
+					   op.data.nbytes, op.data.buf.out);
+		if (ret < 0)
+			return ret;
+		op.data.nbytes = ret;
 	} else {
 		ret = spi_mem_adjust_op_size(nor->spi, &op);
 		if (ret)
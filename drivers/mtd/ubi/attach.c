@@ -95,6 +95,77 @@ static int self_check_ai(struct ubi_device *ubi, struct ubi_attach_info *ai);
 static struct ubi_ec_hdr *ech;
 static struct ubi_vid_hdr *vidh;
 
+/* Number of &struct ubi_ainf_peb objects allocated at once */
+#define UBI_AEB_CHUNK	64
+
+/**
+ * struct ubi_aeb_chunk - a block of attaching information PEB objects.
+ * @list: link in the list of chunks
+ * @used: number of objects in @aebs which have been handed out
+ * @aebs: the objects
+ */
+struct ubi_aeb_chunk {
+	struct list_head list;
+	int used;
+	struct ubi_ainf_peb aebs[UBI_AEB_CHUNK];
+};
+
+/**
+ * ubi_alloc_aeb - allocate an aeb element
+ * @ai: attaching information
+ * @pnum: physical eraseblock number
+ * @ec: erase counter of the physical eraseblock
+ *
+ * Allocate an aeb object and initialize the pnum and ec information.
+ * vol_id and lnum are set to UBI_UNKNOWN, and the other fields are
+ * initialized to zero. Objects are taken from chunks of %UBI_AEB_CHUNK, which
+ * are only freed with @ai, since there is one for each PEB of the device.
+ * Returns a pointer to the allocated object, or %NULL if out of memory.
+ */
+struct ubi_ainf_peb *ubi_alloc_aeb(struct ubi_attach_info *ai, int pnum,
+				   int ec)
+{
+	struct ubi_aeb_chunk *chunk;
+	struct ubi_ainf_peb *aeb;
+
+	if (!list_empty(&ai->aeb_free)) {
+		aeb = list_first_entry(&ai->aeb_free, struct ubi_ainf_peb,
+				       u.list);
+		list_del(&aeb->u.list);
+	} else {
+		chunk = list_first_entry_or_null(&ai->aeb_chunks,
+						 struct ubi_aeb_chunk, list);
+		if (!chunk || chunk->used == UBI_AEB_CHUNK) {
+			chunk = kmalloc(sizeof(*chunk), GFP_KERNEL);
+			if (!chunk)
+				return NULL;
+			chunk->used = 0;
+			list_add(&chunk->list, &ai->aeb_chunks);
+		}
+		aeb = &chunk->aebs[chunk->used++];
+	}
+
+	memset(aeb, 0, sizeof(*aeb));
+	aeb->pnum = pnum;
+	aeb->ec = ec;
+	aeb->vol_id = UBI_UNKNOWN;
+	aeb->lnum = UBI_UNKNOWN;
+
+	return aeb;
+}
+
+/**
+ * ubi_free_aeb - free an aeb element
+ * @ai: attaching information
+ * @aeb: the element to free
+ *
+ * Release an aeb element, so that ubi_alloc_aeb() can hand it out again.
+ */
+void ubi_free_aeb(struct ubi_attach_info *ai, struct ubi_ainf_peb *aeb)
+{
+	list_add(&aeb->u.list, &ai->aeb_free);
+}
+
 /**
  * add_to_list - add physical eraseblock to a list.
  * @ai: attaching information
@@ -131,14 +202,12 @@ static int add_to_list(struct ubi_attach_info *ai, int pnum, int vol_id,
 	} else
 		BUG();
 
-	aeb = kmem_cache_alloc(ai->aeb_slab_cache, GFP_KERNEL);
+	aeb = ubi_alloc_aeb(ai, pnum, ec);
 	if (!aeb)
 		return -ENOMEM;
 
-	aeb->pnum = pnum;
 	aeb->vol_id = vol_id;
 	aeb->lnum = lnum;
-	aeb->ec = ec;
 	if (to_head)
 		list_add(&aeb->u.list, list);
 	else
@@ -163,13 +232,11 @@ static int add_corrupted(struct ubi_attach_info *ai, int pnum, int ec)
 
 	dbg_bld("add to corrupted: PEB %d, EC %d", pnum, ec);
 
-	aeb = kmem_cache_alloc(ai->aeb_slab_cache, GFP_KERNEL);
+	aeb = ubi_alloc_aeb(ai, pnum, ec);
 	if (!aeb)
 		return -ENOMEM;
 
 	ai->corr_peb_count += 1;
-	aeb->pnum = pnum;
-	aeb->ec = ec;
 	list_add(&aeb->u.list, &ai->corr);
 	return 0;
 }
@@ -571,12 +638,10 @@ int ubi_add_to_av(struct ubi_device *ubi, struct ubi_attach_info *ai, int pnum,
 	if (err)
 		return err;
 
-	aeb = kmem_cache_alloc(ai->aeb_slab_cache, GFP_KERNEL);
+	aeb = ubi_alloc_aeb(ai, pnum, ec);
 	if (!aeb)
 		return -ENOMEM;
 
-	aeb->ec = ec;
-	aeb->pnum = pnum;
 	aeb->vol_id = vol_id;
 	aeb->lnum = lnum;
 	aeb->scrub = bitflips;
@@ -833,6 +898,7 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
+	ubi_io_prefetch_hdrs(ubi, pnum);
 	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
 	if (err < 0)
 		return err;
@@ -1155,7 +1221,7 @@ static void destroy_av(struct ubi_attach_info *ai, struct ubi_ainf_volume *av)
 					this->rb_right = NULL;
 			}
 
-			kmem_cache_free(ai->aeb_slab_cache, aeb);
+			ubi_free_aeb(ai, aeb);
 		}
 	}
 	kfree(av);
@@ -1167,25 +1233,26 @@ static void destroy_av(struct ubi_attach_info *ai, struct ubi_ainf_volume *av)
  */
 static void destroy_ai(struct ubi_attach_info *ai)
 {
+	struct ubi_aeb_chunk *chunk, *chunk_tmp;
 	struct ubi_ainf_peb *aeb, *aeb_tmp;
 	struct ubi_ainf_volume *av;
 	struct rb_node *rb;
 
 	list_for_each_entry_safe(aeb, aeb_tmp, &ai->alien, u.list) {
 		list_del(&aeb->u.list);
-		kmem_cache_free(ai->aeb_slab_cache, aeb);
+		ubi_free_aeb(ai, aeb);
 	}
 	list_for_each_entry_safe(aeb, aeb_tmp, &ai->erase, u.list) {
 		list_del(&aeb->u.list);
-		kmem_cache_free(ai->aeb_slab_cache, aeb);
+		ubi_free_aeb(ai, aeb);
 	}
 	list_for_each_entry_safe(aeb, aeb_tmp, &ai->corr, u.list) {
 		list_del(&aeb->u.list);
-		kmem_cache_free(ai->aeb_slab_cache, aeb);
+		ubi_free_aeb(ai, aeb);
 	}
 	list_for_each_entry_safe(aeb, aeb_tmp, &ai->free, u.list) {
 		list_del(&aeb->u.list);
-		kmem_cache_free(ai->aeb_slab_cache, aeb);
+		ubi_free_aeb(ai, aeb);
 	}
 
 	/* Destroy the volume RB-tree */
@@ -1210,11 +1277,41 @@ static void destroy_ai(struct ubi_attach_info *ai)
 		}
 	}
 
-	kmem_cache_destroy(ai->aeb_slab_cache);
+	list_for_each_entry_safe(chunk, chunk_tmp, &ai->aeb_chunks, list)
+		kfree(chunk);
 
 	kfree(ai);
 }
 
+/**
+ * alloc_hdrs_buf - allocate the buffer for reading both headers at once.
+ * @ubi: UBI device description object
+ *
+ * The EC and VID headers of each PEB are read with one read when they are in
+ * the same min. I/O unit, or on NOR flash, where reading a few more bytes costs
+ * much less than another read. If the buffer cannot be allocated, the headers
+ * are read separately.
+ */
+static void alloc_hdrs_buf(struct ubi_device *ubi)
+{
+	int len = ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize;
+
+	ubi->hdrs_pnum = -1;
+	if (ubi->nor_flash || len <= ubi->min_io_size)
+		ubi->hdrs_buf = kmalloc(len, GFP_KERNEL);
+}
+
+/**
+ * free_hdrs_buf - free the buffer allocated by alloc_hdrs_buf().
+ * @ubi: UBI device description object
+ */
+static void free_hdrs_buf(struct ubi_device *ubi)
+{
+	kfree(ubi->hdrs_buf);
+	ubi->hdrs_buf = NULL;
+	ubi->hdrs_pnum = -1;
+}
+
 /**
  * scan_all - scan entire MTD device.
  * @ubi: UBI device description object
@@ -1243,6 +1340,7 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	if (!vidh)
 		goto out_ech;
 
+	alloc_hdrs_buf(ubi);
 	for (pnum = start; pnum < ubi->peb_count; pnum++) {
 		cond_resched();
 
@@ -1251,6 +1349,7 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		if (err < 0)
 			goto out_vidh;
 	}
+	free_hdrs_buf(ubi);
 
 	ubi_msg(ubi, "scanning is finished");
 
@@ -1295,6 +1394,7 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	return 0;
 
 out_vidh:
+	free_hdrs_buf(ubi);
 	ubi_free_vid_hdr(ubi, vidh);
 out_ech:
 	kfree(ech);
@@ -1313,14 +1413,9 @@ static struct ubi_attach_info *alloc_ai(void)
 	INIT_LIST_HEAD(&ai->free);
 	INIT_LIST_HEAD(&ai->erase);
 	INIT_LIST_HEAD(&ai->alien);
+	INIT_LIST_HEAD(&ai->aeb_chunks);
+	INIT_LIST_HEAD(&ai->aeb_free);
 	ai->volumes = RB_ROOT;
-	ai->aeb_slab_cache = kmem_cache_create("ubi_aeb_slab_cache",
-					       sizeof(struct ubi_ainf_peb),
-					       0, 0, NULL);
-	if (!ai->aeb_slab_cache) {
-		kfree(ai);
-		ai = NULL;
-	}
 
 	return ai;
 }
@@ -1352,6 +1447,7 @@ static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info **ai)
 	if (!vidh)
 		goto out_ech;
 
+	alloc_hdrs_buf(ubi);
 	for (pnum = 0; pnum < UBI_FM_MAX_START; pnum++) {
 		int vol_id = -1;
 		unsigned long long sqnum = -1;
@@ -1368,6 +1464,7 @@ static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info **ai)
 		}
 	}
 
+	free_hdrs_buf(ubi);
 	ubi_free_vid_hdr(ubi, vidh);
 	kfree(ech);
 
@@ -1382,6 +1479,7 @@ static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info **ai)
 	return ubi_scan_fastmap(ubi, *ai, fm_anchor);
 
 out_vidh:
+	free_hdrs_buf(ubi);
 	ubi_free_vid_hdr(ubi, vidh);
 out_ech:
 	kfree(ech);
@@ -397,6 +397,26 @@ void sandbox_eth_set_priv(int index, void *priv)
 	dev_priv->priv = priv;
 }
 
+/*
+ * sandbox_eth_set_batch()
+ *
+ * index - The alias index (also DM seq number)
+ * enable - If false, make recv_batch() fail so packets are received one by one
+ */
+void sandbox_eth_set_batch(int index, bool enable)
+{
+	struct udevice *dev;
+	struct eth_sandbox_priv *priv;
+	int ret;
+
+	ret = uclass_get_device(UCLASS_ETH, index, &dev);
+	if (ret)
+		return;
+
+	priv = dev_get_priv(dev);
+	priv->no_batch = !enable;
+}
+
 static int sb_eth_start(struct udevice *dev)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
@@ -424,14 +444,44 @@ static int sb_eth_send(struct udevice *dev, void *packet, int length)
 	return priv->tx_handler(dev, packet, length);
 }
 
-static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
+static void sb_eth_check_timeout(void)
 {
-	struct eth_sandbox_priv *priv = dev_get_priv(dev);
-
 	if (skip_timeout) {
 		timer_test_add_offset(11000UL);
 		skip_timeout = false;
 	}
+}
+
+/*
+ * Give back the buffers of the first @count packets by moving them to the end
+ * of the ring, so the packets are never copied
+ */
+static void sb_eth_release(struct eth_sandbox_priv *priv, int count)
+{
+	uchar *done[PKTBUFSRX];
+	int i;
+
+	count = min(count, priv->recv_packets);
+	if (!count)
+		return;
+
+	memcpy(done, priv->recv_packet_buffer, count * sizeof(uchar *));
+	priv->recv_packets -= count;
+	for (i = 0; i < PKTBUFSRX - count; i++) {
+		priv->recv_packet_buffer[i] = priv->recv_packet_buffer[i + count];
+		priv->recv_packet_length[i] = priv->recv_packet_length[i + count];
+	}
+	for (i = 0; i < count; i++) {
+		priv->recv_packet_buffer[PKTBUFSRX - count + i] = done[i];
+		priv->recv_packet_length[PKTBUFSRX - count + i] = 0;
+	}
+}
+
+static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	sb_eth_check_timeout();
 
 	if (priv->recv_packets) {
 		int lcl_recv_packet_length = priv->recv_packet_length[0];
@@ -447,19 +497,40 @@ static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 static int sb_eth_free_pkt(struct udevice *dev, uchar *packet, int length)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
-	int i;
 
-	if (!priv->recv_packets)
-		return 0;
+	sb_eth_release(priv, 1);
+
+	return 0;
+}
+
+static int sb_eth_recv_batch(struct udevice *dev, int flags,
+			     struct eth_rx_desc *descs, int max)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	int count, i;
+
+	if (priv->no_batch)
+		return -ENOSYS;
+
+	sb_eth_check_timeout();
 
-	--priv->recv_packets;
-	for (i = 0; i < priv->recv_packets; i++) {
-		priv->recv_packet_length[i] = priv->recv_packet_length[i + 1];
-		memcpy(priv->recv_packet_buffer[i],
-		       priv->recv_packet_buffer[i + 1],
-		       priv->recv_packet_length[i + 1]);
+	count = min(max, priv->recv_packets);
+	for (i = 0; i < count; i++) {
+		descs[i].packet = priv->recv_packet_buffer[i];
+		descs[i].length = priv->recv_packet_length[i];
 	}
-	priv->recv_packet_length[priv->recv_packets] = 0;
+	debug("eth_sandbox: received %d packets, %d waiting\n", count,
+	      priv->recv_packets - count);
+
+	return count;
+}
+
+static int sb_eth_free_batch(struct udevice *dev, struct eth_rx_desc *descs,
+			     int count)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	sb_eth_release(priv, count);
 
 	return 0;
 }
@@ -485,6 +556,8 @@ static const struct eth_ops sb_eth_ops = {
 	.send			= sb_eth_send,
 	.recv			= sb_eth_recv,
 	.free_pkt		= sb_eth_free_pkt,
+	.recv_batch		= sb_eth_recv_batch,
+	.free_batch		= sb_eth_free_batch,
 	.stop			= sb_eth_stop,
 	.write_hwaddr		= sb_eth_write_hwaddr,
 };
@@ -501,6 +574,7 @@ static int sb_eth_of_to_plat(struct udevice *dev)
 
 	pdata->iobase = dev_read_addr(dev);
 	priv->disabled = false;
+	priv->no_batch = false;
 	priv->tx_handler = sb_default_handler;
 
 	return 0;
@@ -426,6 +426,6 @@ UCLASS_DRIVER(pinctrl) = {
 #if CONFIG_IS_ENABLED(OF_REAL)
 	.post_bind = pinctrl_post_bind,
 #endif
-	.flags = DM_UC_FLAG_SEQ_ALIAS,
+	.flags = DM_UC_FLAG_SEQ_ALIAS | DM_UC_FLAG_NO_LAZY_BIND,
 	.name = "pinctrl",
 };
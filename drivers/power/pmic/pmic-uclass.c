@@ -202,4 +202,5 @@ UCLASS_DRIVER(pmic) = {
 	.name		= "pmic",
 	.pre_probe	= pmic_pre_probe,
 	.per_device_auto	= sizeof(struct uc_pmic_priv),
+	.flags		= DM_UC_FLAG_NO_LAZY_BIND,
 };
@@ -535,4 +535,5 @@ UCLASS_DRIVER(regulator) = {
 	.pre_probe	= regulator_pre_probe,
 	.post_probe	= regulator_post_probe,
 	.per_device_plat_auto	= sizeof(struct dm_regulator_uclass_plat),
+	.flags		= DM_UC_FLAG_NO_LAZY_BIND,
 };
@@ -499,6 +499,46 @@ int spi_mem_adjust_op_size(struct spi_slave *slave, struct spi_mem_op *op)
 }
 EXPORT_SYMBOL_GPL(spi_mem_adjust_op_size);
 
+/**
+ * spi_mem_dma_split() - Split a transfer so that its middle part can use DMA
+ * @buf: buffer the data is transferred to or from
+ * @len: length of the transfer in bytes
+ * @align: alignment the DMA engine needs for both the buffer and the length.
+ *	   Must be a power of two
+ * @gran: granularity each part must be a multiple of, e.g. 2 when the data is
+ *	  striped across two memories. Must be a power of two no larger than
+ *	  @align
+ * @split: returns how the transfer is split
+ *
+ * Controllers whose DMA engine needs an aligned buffer and length can use this
+ * to transfer the bulk of the data straight to or from @buf, and handle only
+ * the few bytes at either end without DMA, rather than bouncing the whole
+ * transfer through an aligned buffer. If @buf cannot be aligned while
+ * respecting @gran, or nothing is left for DMA, the whole transfer is returned
+ * in @split->head.
+ */
+void spi_mem_dma_split(const void *buf, size_t len, uint align, uint gran,
+		       struct spi_mem_dma_split *split)
+{
+	size_t head = -(uintptr_t)buf & (align - 1);
+	size_t body = 0;
+
+	if (!(head % gran) && head < len)
+		body = round_down(len - head, align);
+
+	if (!body) {
+		split->head = len;
+		split->body = 0;
+		split->tail = 0;
+		return;
+	}
+
+	split->head = head;
+	split->body = body;
+	split->tail = len - head - body;
+}
+EXPORT_SYMBOL_GPL(spi_mem_dma_split);
+
 static inline u64 spi_mem_bytes_to_ncycles(u32 nbytes, u8 buswidth, u8 dtr)
 {
 	u64 ncycles;
@@ -15,7 +15,6 @@
 #include <clk.h>
 #include <dm.h>
 #include <malloc.h>
-#include <memalign.h>
 #include <spi.h>
 #include <spi-mem.h>
 #include <ubi_uboot.h>
@@ -754,21 +753,44 @@ static int zynqmp_qspi_start_dma(struct zynqmp_qspi_priv *priv,
 
 		writel(GQSPI_DMA_DST_I_STS_DONE, &dma_regs->dmaisr);
 
-		if (buf != priv->rx_buf)
-			memcpy(priv->rx_buf, buf, actuallen);
-
 		buf = (u32 *)((u8 *)buf + actuallen);
-		priv->rx_buf = (u8 *)priv->rx_buf + actuallen;
 	}
 
 	return 0;
 }
 
+static void zynqmp_qspi_set_dma_mode(struct zynqmp_qspi_priv *priv,
+				     bool dma)
+{
+	struct zynqmp_qspi_regs *regs = priv->regs;
+	u32 config_reg;
+
+	config_reg = readl(&regs->confr);
+	config_reg &= ~GQSPI_CONFIG_MODE_EN_MASK;
+	if (dma)
+		config_reg |= GQSPI_CONFIG_DMA_MODE;
+	writel(config_reg, &regs->confr);
+}
+
+static int zynqmp_qspi_rx_io(struct zynqmp_qspi_priv *priv, u32 gen_fifo_cmd,
+			     u8 *buf, u32 len)
+{
+	int ret;
+
+	zynqmp_qspi_set_dma_mode(priv, false);
+	priv->len = len;
+	ret = zynqmp_qspi_start_io(priv, gen_fifo_cmd, (u32 *)buf);
+	zynqmp_qspi_set_dma_mode(priv, true);
+
+	return ret;
+}
+
 static int zynqmp_qspi_genfifo_fill_rx(struct zynqmp_qspi_priv *priv)
 {
+	struct spi_mem_dma_split split;
 	u32 gen_fifo_cmd;
-	u32 *buf;
-	u32 actuallen = priv->len;
+	u8 *buf = priv->rx_buf;
+	int ret;
 
 	log_debug("%s, length: %d\r\n", __func__, priv->len);
 
@@ -779,22 +801,40 @@ static int zynqmp_qspi_genfifo_fill_rx(struct zynqmp_qspi_priv *priv)
 	if (priv->stripe)
 		gen_fifo_cmd |= GQSPI_GFIFO_STRIPE_MASK;
 
+	if (priv->io_mode)
+		return zynqmp_qspi_start_io(priv, gen_fifo_cmd, (u32 *)buf);
+
 	/*
-	 * Check if receive buffer is aligned to 4 byte and length
-	 * is multiples of four byte as we are using dma to receive.
+	 * DMA only whole cache lines straight into the caller's buffer, so
+	 * the cache maintenance cannot touch bytes outside it. Receive the
+	 * bytes at either end in IO mode, all while the chip select stays
+	 * asserted. In striped mode every part is split across both memories,
+	 * so it must be a whole number of byte pairs.
 	 */
-	if ((!((unsigned long)priv->rx_buf & (GQSPI_DMA_ALIGN - 1)) &&
-	     !(actuallen % GQSPI_DMA_ALIGN)) || priv->io_mode) {
-		buf = (u32 *)priv->rx_buf;
-		if (priv->io_mode)
-			return zynqmp_qspi_start_io(priv, gen_fifo_cmd, buf);
-		else
-			return zynqmp_qspi_start_dma(priv, gen_fifo_cmd, buf);
+	spi_mem_dma_split(buf, priv->len, ARCH_DMA_MINALIGN,
+			  priv->stripe ? 2 : 1, &split);
+	log_debug("%s, head: %zu, body: %zu, tail: %zu\r\n", __func__,
+		  split.head, split.body, split.tail);
+
+	if (split.head) {
+		ret = zynqmp_qspi_rx_io(priv, gen_fifo_cmd, buf, split.head);
+		if (ret)
+			return ret;
+		buf += split.head;
 	}
 
-	ALLOC_CACHE_ALIGN_BUFFER(u8, tmp, roundup(priv->len, GQSPI_DMA_ALIGN));
-	buf = (u32 *)tmp;
-	return zynqmp_qspi_start_dma(priv, gen_fifo_cmd, buf);
+	if (split.body) {
+		priv->len = split.body;
+		ret = zynqmp_qspi_start_dma(priv, gen_fifo_cmd, (u32 *)buf);
+		if (ret)
+			return ret;
+		buf += split.body;
+	}
+
+	if (split.tail)
+		return zynqmp_qspi_rx_io(priv, gen_fifo_cmd, buf, split.tail);
+
+	return 0;
 }
 
 static int zynqmp_qspi_claim_bus(struct udevice *dev)
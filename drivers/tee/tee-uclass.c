@@ -211,6 +211,7 @@ UCLASS_DRIVER(tee) = {
 	.per_device_auto	= sizeof(struct tee_uclass_priv),
 	.pre_probe = tee_pre_probe,
 	.pre_remove = tee_pre_remove,
+	.flags = DM_UC_FLAG_NO_LAZY_BIND,
 };
 
 void tee_optee_ta_uuid_from_octets(struct tee_optee_ta_uuid *d,
@@ -146,4 +146,5 @@ UCLASS_DRIVER(tcpm) = {
 	.per_device_plat_auto	= sizeof(struct tcpm_port),
 	.post_bind	= tcpm_post_bind,
 	.post_probe	= tcpm_post_probe,
+	.flags		= DM_UC_FLAG_NO_LAZY_BIND,
 };
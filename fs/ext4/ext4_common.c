@@ -33,6 +33,7 @@
 
 struct ext2_data *ext4fs_root;
 struct ext2fs_node *ext4fs_file;
+struct ext4_extent_map ext4fs_file_map;
 __le32 *ext4fs_indir1_block;
 int ext4fs_indir1_size;
 int ext4fs_indir1_blkno = -1;
@@ -1566,6 +1567,140 @@ static struct ext4_extent_header *ext4fs_get_extent_block
 	}
 }
 
+/* An extent longer than this is unwritten, with length ee_len - this */
+#define EXT4_EXT_INIT_MAX_LEN	(1 << 15)
+/* Maximum depth of the extent tree */
+#define EXT4_EXT_MAX_DEPTH	5
+
+/* Add a run to the end of an extent map, merging it with the last if possible */
+static int ext4fs_add_extent_run(struct ext4_extent_map *map,
+				 uint32_t fileblock, uint32_t len,
+				 uint64_t start)
+{
+	struct ext4_extent_run *run;
+
+	if (map->count) {
+		run = &map->runs[map->count - 1];
+		if (fileblock < run->fileblock + run->len)
+			return -EINVAL;
+		if (fileblock == run->fileblock + run->len &&
+		    start == run->start + run->len) {
+			run->len += len;
+			return 0;
+		}
+	}
+	if (map->count == map->alloced) {
+		int alloced = map->alloced ? map->alloced * 2 : 16;
+
+		run = realloc(map->runs, alloced * sizeof(*run));
+		if (!run)
+			return -ENOMEM;
+		map->runs = run;
+		map->alloced = alloced;
+	}
+	run = &map->runs[map->count++];
+	run->fileblock = fileblock;
+	run->len = len;
+	run->start = start;
+
+	return 0;
+}
+
+/**
+ * ext4fs_map_extent_node() - Add the runs below a node of the extent tree
+ *
+ * @map: Map to add to
+ * @hdr: Header of the node
+ * @size: Size of the node in bytes
+ * @depth: Depth the node should have, or -1 for the root
+ * Return: 0 if OK, -ve on error
+ */
+static int ext4fs_map_extent_node(struct ext4_extent_map *map,
+				  struct ext4_extent_header *hdr, int size,
+				  int depth)
+{
+	int blksz = EXT2_BLOCK_SIZE(ext4fs_root);
+	int log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root) -
+		get_fs()->dev_desc->log2blksz;
+	struct ext4_extent_idx *idx;
+	struct ext4_extent *ext;
+	uint64_t block;
+	int entries, i, ret;
+	char *buf;
+
+	entries = le16_to_cpu(hdr->eh_entries);
+	if (le16_to_cpu(hdr->eh_magic) != EXT4_EXT_MAGIC ||
+	    (entries + 1) * sizeof(*ext) > size)
+		return -EINVAL;
+	if (depth == -1)
+		depth = le16_to_cpu(hdr->eh_depth);
+	if (le16_to_cpu(hdr->eh_depth) != depth || depth > EXT4_EXT_MAX_DEPTH)
+		return -EINVAL;
+
+	if (!depth) {
+		ext = (struct ext4_extent *)(hdr + 1);
+		for (i = 0; i < entries; i++) {
+			uint len = le16_to_cpu(ext[i].ee_len);
+
+			/* an unwritten extent reads as zeroes, so is a hole */
+			if (len > EXT4_EXT_INIT_MAX_LEN)
+				continue;
+			block = le16_to_cpu(ext[i].ee_start_hi);
+			block = (block << 32) + le32_to_cpu(ext[i].ee_start_lo);
+			ret = ext4fs_add_extent_run(map,
+						    le32_to_cpu(ext[i].ee_block),
+						    len, block);
+			if (ret)
+				return ret;
+		}
+
+		return 0;
+	}
+
+	buf = memalign(ARCH_DMA_MINALIGN, blksz);
+	if (!buf)
+		return -ENOMEM;
+	idx = (struct ext4_extent_idx *)(hdr + 1);
+	for (i = 0, ret = 0; i < entries && !ret; i++) {
+		block = le16_to_cpu(idx[i].ei_leaf_hi);
+		block = (block << 32) + le32_to_cpu(idx[i].ei_leaf_lo);
+		if (!ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
+				    buf)) {
+			ret = -EIO;
+			break;
+		}
+		ret = ext4fs_map_extent_node(map,
+					     (struct ext4_extent_header *)buf,
+					     blksz, depth - 1);
+	}
+	free(buf);
+
+	return ret;
+}
+
+int ext4fs_build_extent_map(struct ext2_inode *inode,
+			    struct ext4_extent_map *map)
+{
+	int ret;
+
+	ret = ext4fs_map_extent_node(map, (struct ext4_extent_header *)
+				     inode->b.blocks.dir_blocks,
+				     sizeof(inode->b.blocks), -1);
+	if (ret) {
+		ext4fs_free_extent_map(map);
+		return ret;
+	}
+	map->valid = true;
+
+	return 0;
+}
+
+void ext4fs_free_extent_map(struct ext4_extent_map *map)
+{
+	free(map->runs);
+	memset(map, '\0', sizeof(*map));
+}
+
 static int ext4fs_blockgroup
 	(struct ext2_data *data, int group, struct ext2_block_group *blkgrp)
 {
@@ -2009,6 +2144,7 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock,
  */
 void ext4fs_reinit_global(void)
 {
+	ext4fs_free_extent_map(&ext4fs_file_map);
 	if (ext4fs_indir1_block != NULL) {
 		free(ext4fs_indir1_block);
 		ext4fs_indir1_block = NULL;
@@ -2316,6 +2452,7 @@ int ext4fs_open(const char *filename, loff_t *len)
 		return -1;
 
 	ext4fs_file = NULL;
+	ext4fs_free_extent_map(&ext4fs_file_map);
 	status = ext4fs_find_file(filename, &ext4fs_root->diropen, &fdiro,
 				  FILETYPE_REG);
 	if (status == 0)
@@ -47,6 +47,39 @@ static inline void *zalloc(size_t size)
 	return kzalloc(size, 0);
 }
 
+/**
+ * struct ext4_extent_run - a run of file blocks which are contiguous on disk
+ *
+ * @fileblock: First block of the run within the file
+ * @len: Number of blocks in the run
+ * @start: Filesystem block holding @fileblock
+ */
+struct ext4_extent_run {
+	uint32_t fileblock;
+	uint32_t len;
+	uint64_t start;
+};
+
+/**
+ * struct ext4_extent_map - the runs making up a file which uses extents
+ *
+ * Blocks which are not in any run are holes, which read as zeroes
+ *
+ * @runs: Runs, in order of @fileblock
+ * @count: Number of runs
+ * @alloced: Number of runs allocated in @runs
+ * @valid: true if the map has been built
+ */
+struct ext4_extent_map {
+	struct ext4_extent_run *runs;
+	int count;
+	int alloced;
+	bool valid;
+};
+
+/* Extent map of ext4fs_file, built on the first read */
+extern struct ext4_extent_map ext4fs_file_map;
+
 int ext4fs_read_inode(struct ext2_data *data, int ino,
 		      struct ext2_inode *inode);
 int ext4fs_read_file(struct ext2fs_node *node, loff_t pos, loff_t len,
@@ -58,6 +91,27 @@ int ext4fs_find_file1(const char *currpath, struct ext2fs_node *currroot,
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			struct ext2fs_node **fnode, int *ftype);
 
+/**
+ * ext4fs_build_extent_map() - Build the extent map of a file
+ *
+ * This walks the whole extent tree once, so that a file can be read with one
+ * device read per run, rather than walking the tree for every block
+ *
+ * @inode: Inode of the file, which must use extents
+ * @map: Returns the map, which must be empty on entry
+ * Return: 0 if OK, -EINVAL if the extent tree is corrupt, -EIO on read error,
+ * -ENOMEM if out of memory
+ */
+int ext4fs_build_extent_map(struct ext2_inode *inode,
+			    struct ext4_extent_map *map);
+
+/**
+ * ext4fs_free_extent_map() - Free an extent map, leaving it empty
+ *
+ * @map: Map to free
+ */
+void ext4fs_free_extent_map(struct ext4_extent_map *map);
+
 #if defined(CONFIG_EXT4_WRITE)
 uint32_t ext4fs_div_roundup(uint32_t size, uint32_t n);
 uint16_t ext4fs_checksum_update(unsigned int i);
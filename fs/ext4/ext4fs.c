@@ -29,6 +29,7 @@
 #include <part.h>
 #include <rtc.h>
 #include <u-boot/uuid.h>
+#include <linux/sizes.h>
 #include "ext4_common.h"
 
 int ext4fs_symlinknest;
@@ -206,6 +207,81 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 	return 0;
 }
 
+/**
+ * ext4fs_read_extents() - Read from a file using its extent map
+ *
+ * Each run of blocks which is contiguous on disk is read with a single device
+ * read, and holes are filled with zeroes
+ *
+ * @node: File to read
+ * @map: Extent map of the file
+ * @pos: Position in the file to start reading from
+ * @len: Number of bytes to read
+ * @buf: Buffer to read into
+ * @actread: Returns the number of bytes read
+ * Return: 0 if OK, -1 on error
+ */
+static int ext4fs_read_extents(struct ext2fs_node *node,
+			       struct ext4_extent_map *map, loff_t pos,
+			       loff_t len, char *buf, loff_t *actread)
+{
+	struct ext_filesystem *fs = get_fs();
+	int log2blksz = fs->dev_desc->log2blksz;
+	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data);
+	unsigned int filesize = le32_to_cpu(node->inode.size);
+	struct ext4_extent_run *run = map->runs;
+	struct ext4_extent_run *end = map->runs + map->count;
+	loff_t cur, stop;
+
+	/* Adjust len so it we can't read past the end of the file. */
+	if (len + pos > filesize)
+		len = (filesize - pos);
+	if (len <= 0)
+		return -1;
+
+	/* skip the runs which end before the start */
+	stop = pos + len;
+	while (run < end &&
+	       ((loff_t)run->fileblock + run->len) << log2_fs_blocksize <= pos)
+		run++;
+
+	for (cur = pos; cur < stop;) {
+		loff_t run_pos, run_end, next;
+
+		run_pos = stop;
+		if (run < end)
+			run_pos = (loff_t)run->fileblock << log2_fs_blocksize;
+		if (cur < run_pos) {
+			/* hole before the next run */
+			next = min(run_pos, stop);
+			memset(buf, '\0', next - cur);
+		} else {
+			loff_t offset = cur - run_pos;
+			lbaint_t sector;
+
+			run_end = run_pos + ((loff_t)run->len << log2_fs_blocksize);
+			next = min(run_end, stop);
+
+			/* fs_devread() takes an int length */
+			next = min_t(loff_t, next, cur + SZ_1G);
+			sector = ((lbaint_t)run->start <<
+				  (log2_fs_blocksize - log2blksz)) +
+				(offset >> log2blksz);
+			if (!ext4fs_devread(sector,
+					    offset & ((1 << log2blksz) - 1),
+					    next - cur, buf))
+				return -1;
+			if (next == run_end)
+				run++;
+		}
+		buf += next - cur;
+		cur = next;
+	}
+	*actread = len;
+
+	return 0;
+}
+
 int ext4fs_opendir(const char *dirname, struct fs_dir_stream **dirsp)
 {
 	struct ext4_dir_stream *dirs;
@@ -373,6 +449,19 @@ int ext4fs_read(char *buf, loff_t offset, loff_t len, loff_t *actread)
 	if (ext4fs_root == NULL || ext4fs_file == NULL)
 		return -1;
 
+	if (le32_to_cpu(ext4fs_file->inode.flags) & EXT4_EXTENTS_FL) {
+		struct ext4_extent_map *map = &ext4fs_file_map;
+
+		if (!map->valid && ext4fs_build_extent_map(&ext4fs_file->inode,
+							   map)) {
+			printf("invalid extent block\n");
+			return -1;
+		}
+
+		return ext4fs_read_extents(ext4fs_file, map, offset, len, buf,
+					   actread);
+	}
+
 	return ext4fs_read_file(ext4fs_file, offset, len, buf, actread);
 }
 
@@ -162,6 +162,53 @@ int flush_dirty_fat_buffer(fsdata *mydata)
 }
 #endif
 
+/*
+ * When fatbuf holds the whole FAT, it is read from disk a window of
+ * FATBUFBLOCKS sectors at a time, the first time an entry in that window is
+ * needed. Make sure that the entry at 'offset' in fatbuf has been read, and
+ * add 'state' to the windows holding it.
+ * Return 0 on success, -1 otherwise.
+ */
+static int fat_cache_entry(fsdata *mydata, __u32 offset, __u8 state)
+{
+	__u32 winsize = mydata->sect_size * FATBUFBLOCKS;
+	__u32 pos, win, last;
+
+	switch (mydata->fatsize) {
+	case 32:
+		pos = offset * 4;
+		last = pos + 3;
+		break;
+	case 16:
+		pos = offset * 2;
+		last = pos + 1;
+		break;
+	default:
+		pos = (offset * 3) / 2;
+		last = pos + 1;
+		break;
+	}
+
+	for (win = pos / winsize; win <= last / winsize; win++) {
+		__u32 startblock = win * FATBUFBLOCKS;
+		__u32 getsize = min_t(__u32, FATBUFBLOCKS,
+				      mydata->fatlength - startblock);
+
+		if (!(mydata->fatwin[win] & FAT_WIN_LOADED)) {
+			if (disk_read(mydata->fat_sect + startblock, getsize,
+				      mydata->fatbuf +
+				      startblock * mydata->sect_size) < 0) {
+				debug("Error reading FAT blocks\n");
+				return -1;
+			}
+			mydata->fatwin[win] |= FAT_WIN_LOADED;
+		}
+		mydata->fatwin[win] |= state;
+	}
+
+	return 0;
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -201,12 +248,12 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 
 	/* Read a new block of FAT entries into the cache. */
 	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
+		__u32 getsize = mydata->fatbufblocks;
 		__u8 *bufptr = mydata->fatbuf;
 		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
+		__u32 startblock = bufnum * mydata->fatbufblocks;
 
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+		/* Cap length if fatlength is not a multiple of fatbufblocks */
 		if (startblock + getsize > fatlength)
 			getsize = fatlength - startblock;
 
@@ -216,9 +263,9 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 		if (flush_dirty_fat_buffer(mydata) < 0)
 			return -1;
 
-		if (getsize > FATBUFBLOCKS) {
+		if (getsize > mydata->fatbufblocks) {
 			debug("getsize is too large for bufptr\n");
-			getsize = FATBUFBLOCKS;
+			getsize = mydata->fatbufblocks;
 		}
 
 		if (disk_read(startblock, getsize, bufptr) < 0) {
@@ -228,6 +275,10 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 		mydata->fatbufnum = bufnum;
 	}
 
+	if (CONFIG_IS_ENABLED(FS_FAT_CACHE) && mydata->fatwin &&
+	    fat_cache_entry(mydata, offset, 0) < 0)
+		return ret;
+
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
 	case 32:
@@ -691,7 +742,33 @@ static int get_fs_info(fsdata *mydata)
 
 	mydata->fatbufnum = -1;
 	mydata->fat_dirty = 0;
-	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
+	mydata->next_free = 3;
+	mydata->fatbuf = NULL;
+	mydata->fatwin = NULL;
+
+#if CONFIG_IS_ENABLED(FS_FAT_CACHE)
+	/*
+	 * Try to hold the whole FAT, falling back to a few sectors of it. The
+	 * window states follow the FAT in the same allocation, so that it is
+	 * freed along with fatbuf. Nothing is read until it is needed.
+	 */
+	if (mydata->fatlength * mydata->sect_size <=
+	    CONFIG_FS_FAT_CACHE_MAX_SIZE) {
+		__u32 nwin = DIV_ROUND_UP(mydata->fatlength, FATBUFBLOCKS);
+
+		mydata->fatbufblocks = mydata->fatlength;
+		mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE + nwin);
+		if (mydata->fatbuf) {
+			mydata->fatwin = mydata->fatbuf + FATBUFSIZE;
+			memset(mydata->fatwin, '\0', nwin);
+			mydata->fatbufnum = 0;
+		}
+	}
+#endif
+	if (!mydata->fatbuf) {
+		mydata->fatbufblocks = FATBUFBLOCKS;
+		mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
+	}
 	if (mydata->fatbuf == NULL) {
 		debug("Error: allocating memory\n");
 		return -1;
@@ -213,20 +213,13 @@ static int disk_write(__u32 block, __u32 nr_blocks, void *buf)
 }
 
 /*
- * Write fat buffer into block device
+ * Write 'getsize' sectors of the FAT, starting at 'startblock', from 'bufptr'
+ * into each copy of the FAT on the block device
  */
-static int flush_dirty_fat_buffer(fsdata *mydata)
+static int write_fat_blocks(fsdata *mydata, __u32 startblock, int getsize,
+			    __u8 *bufptr)
 {
-	int getsize = FATBUFBLOCKS;
 	__u32 fatlength = mydata->fatlength;
-	__u8 *bufptr = mydata->fatbuf;
-	__u32 startblock = mydata->fatbufnum * FATBUFBLOCKS;
-
-	debug("debug: evicting %d, dirty: %d\n", mydata->fatbufnum,
-	      (int)mydata->fat_dirty);
-
-	if ((!mydata->fat_dirty) || (mydata->fatbufnum == -1))
-		return 0;
 
 	/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
 	if (startblock + getsize > fatlength)
@@ -248,6 +241,44 @@ static int flush_dirty_fat_buffer(fsdata *mydata)
 			return -1;
 		}
 	}
+
+	return 0;
+}
+
+/*
+ * Write fat buffer into block device
+ */
+static int flush_dirty_fat_buffer(fsdata *mydata)
+{
+	__u32 startblock = mydata->fatbufnum * FATBUFBLOCKS;
+	__u32 win;
+
+	debug("debug: evicting %d, dirty: %d\n", mydata->fatbufnum,
+	      (int)mydata->fat_dirty);
+
+	if ((!mydata->fat_dirty) || (mydata->fatbufnum == -1))
+		return 0;
+
+	if (!CONFIG_IS_ENABLED(FS_FAT_CACHE) || !mydata->fatwin) {
+		if (write_fat_blocks(mydata, startblock, FATBUFBLOCKS,
+				     mydata->fatbuf) < 0)
+			return -1;
+		mydata->fat_dirty = 0;
+
+		return 0;
+	}
+
+	/* Only write the windows of the whole FAT which were modified */
+	for (win = 0; win * FATBUFBLOCKS < mydata->fatlength; win++) {
+		if (!(mydata->fatwin[win] & FAT_WIN_DIRTY))
+			continue;
+		startblock = win * FATBUFBLOCKS;
+		if (write_fat_blocks(mydata, startblock, FATBUFBLOCKS,
+				     mydata->fatbuf +
+				     startblock * mydata->sect_size) < 0)
+			return -1;
+		mydata->fatwin[win] &= ~FAT_WIN_DIRTY;
+	}
 	mydata->fat_dirty = 0;
 
 	return 0;
@@ -463,12 +494,12 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 
 	/* Read a new block of FAT entries into the cache. */
 	if (bufnum != mydata->fatbufnum) {
-		int getsize = FATBUFBLOCKS;
+		int getsize = mydata->fatbufblocks;
 		__u8 *bufptr = mydata->fatbuf;
 		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
+		__u32 startblock = bufnum * mydata->fatbufblocks;
 
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+		/* Cap length if fatlength is not a multiple of fatbufblocks */
 		if (startblock + getsize > fatlength)
 			getsize = fatlength - startblock;
 
@@ -484,6 +515,10 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 		mydata->fatbufnum = bufnum;
 	}
 
+	if (CONFIG_IS_ENABLED(FS_FAT_CACHE) && mydata->fatwin &&
+	    fat_cache_entry(mydata, offset, FAT_WIN_DIRTY) < 0)
+		return -1;
+
 	/* Mark as dirty */
 	mydata->fat_dirty = 1;
 
@@ -804,7 +839,7 @@ get_set_cluster(fsdata *mydata, __u32 clustnum, loff_t pos, __u8 *buffer,
  */
 static int find_empty_cluster(fsdata *mydata)
 {
-	__u32 fat_val, entry = 3;
+	__u32 fat_val, entry = mydata->next_free;
 
 	while (1) {
 		fat_val = get_fatent(mydata, entry);
@@ -812,6 +847,7 @@ static int find_empty_cluster(fsdata *mydata)
 			break;
 		entry++;
 	}
+	mydata->next_free = entry;
 
 	return entry;
 }
@@ -872,6 +908,7 @@ static int clear_fatent(fsdata *mydata, __u32 entry)
 			set_fatent_value(mydata, entry, 0);
 		else
 			break;
+		mydata->next_free = min(mydata->next_free, entry);
 
 		entry = fat_val;
 	}
@@ -1261,6 +1298,8 @@ static int update_parent_dir_props(fat_itr *dir_itr)
 	fsdata = *itr.fsdata;
 
 	/* allocate local fat buffer */
+	fsdata.fatbufblocks = FATBUFBLOCKS;
+	fsdata.fatwin = NULL;
 	fsdata.fatbuf = malloc_cache_aligned(FATBUFSIZE);
 	if (!fsdata.fatbuf) {
 		log_debug("Error: allocating memory\n");
@@ -1602,6 +1641,8 @@ static int fat_dir_entries(fat_itr *itr)
 	fsdata = *dirs->fsdata;
 
 	/* allocate local fat buffer */
+	fsdata.fatbufblocks = FATBUFBLOCKS;
+	fsdata.fatwin = NULL;
 	fsdata.fatbuf = malloc_cache_aligned(FATBUFSIZE);
 	if (!fsdata.fatbuf) {
 		debug("Error: allocating memory\n");
@@ -1935,6 +1976,8 @@ static int check_path_prefix(loff_t prefix_clust, fat_itr *path_itr)
 	fsdata = *itr.fsdata;
 
 	/* allocate local fat buffer */
+	fsdata.fatbufblocks = FATBUFBLOCKS;
+	fsdata.fatwin = NULL;
 	fsdata.fatbuf = malloc_cache_aligned(FATBUFSIZE);
 	if (!fsdata.fatbuf) {
 		log_debug("Error: allocating memory\n");
@@ -26,7 +26,71 @@
 
 #define MAX_SYMLINK_NEST 8
 
+/* Number of decompressed fragment blocks held by the cache */
+#define SQFS_CACHE_FRAGS 4
+
+/**
+ * struct sqfs_cached_frag - A fragment block held by the cache
+ *
+ * @start: Position of the fragment block in the image
+ * @buf: Buffer holding the fragment block, or NULL if this slot is unused
+ * @data: Start of the (decompressed) fragment block within @buf
+ * @size: Size of @buf in bytes
+ * @last_used: Value of @tick in struct sqfs_cache when the block was last used
+ */
+struct sqfs_cached_frag {
+	u64 start;
+	char *buf;
+	char *data;
+	ulong size;
+	ulong last_used;
+};
+
+/**
+ * struct sqfs_cache - Metadata kept from one lookup to the next
+ *
+ * The filesystem is closed after every command, so the cache outlives it. It
+ * belongs to the image whose superblock is @sblk, on the partition starting at
+ * @part_start on @dev, and is checked against that each time a filesystem is
+ * probed. Each part is filled in the first time it is needed.
+ *
+ * @dev: Block device holding the image, or NULL if the cache is empty
+ * @part_start: Start of the partition holding the image
+ * @part_size: Size of the partition holding the image
+ * @sblk: Superblock of the image
+ * @inode_table: Decompressed inode table, or NULL if not read yet
+ * @dir_table: Decompressed directory table, or NULL if not read yet
+ * @pos_list: Position of each metadata block of the directory table
+ * @metablks_count: Number of metadata blocks in the directory table
+ * @frag_table: Buffer holding the fragment index, or NULL if not read yet
+ * @frag_index: Position of each block of fragment entries, within @frag_table
+ * @frag_entries: Decompressed blocks of fragment entries, each NULL if not read
+ *	yet
+ * @frag_blocks: Number of blocks of fragment entries
+ * @frags: Recently used fragment blocks
+ * @tick: Incremented each time a fragment block is used
+ * @stats: Statistics, with @stats.size giving the bytes allocated above
+ */
+struct sqfs_cache {
+	struct blk_desc *dev;
+	lbaint_t part_start;
+	lbaint_t part_size;
+	struct squashfs_super_block sblk;
+	unsigned char *inode_table;
+	unsigned char *dir_table;
+	u32 *pos_list;
+	int metablks_count;
+	unsigned char *frag_table;
+	unsigned char *frag_index;
+	struct squashfs_fragment_block_entry **frag_entries;
+	u32 frag_blocks;
+	struct sqfs_cached_frag frags[SQFS_CACHE_FRAGS];
+	ulong tick;
+	struct sqfs_cache_stats stats;
+};
+
 static struct squashfs_ctxt ctxt;
+static struct sqfs_cache cache;
 static int symlinknest;
 
 static int sqfs_readdir_nest(struct fs_dir_stream *fs_dirs, struct fs_dirent **dentp);
@@ -99,26 +163,15 @@ static int sqfs_calc_n_blks(__le64 start, __le64 end, u64 *offset)
 }
 
 /*
- * Retrieves fragment block entry and returns true if the fragment block is
- * compressed
+ * Reads the fragment index table, which gives the position of each metadata
+ * block of fragment entries. The index starts at *offsetp in the returned
+ * buffer, which must be freed. Returns the size of the buffer.
  */
-static int sqfs_frag_lookup(u32 inode_fragment_index,
-			    struct squashfs_fragment_block_entry *e)
+static int sqfs_read_frag_index(unsigned char **tablep, u64 *offsetp)
 {
-	u64 start, end, exp_tbl, n_blks, src_len, table_offset, start_block;
-	unsigned char *metadata_buffer, *metadata, *table;
-	struct squashfs_fragment_block_entry *entries;
 	struct squashfs_super_block *sblk = ctxt.sblk;
-	unsigned long dest_len;
-	int block, offset, ret;
-	u16 header;
-
-	metadata_buffer = NULL;
-	entries = NULL;
-	table = NULL;
-
-	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
-		return -EINVAL;
+	u64 start, end, exp_tbl, n_blks;
+	unsigned char *table;
 
 	start = get_unaligned_le64(&sblk->fragment_table_start);
 	end = get_unaligned_le64(&sblk->id_table_start);
@@ -128,41 +181,47 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 		end = exp_tbl;
 
 	n_blks = sqfs_calc_n_blks(sblk->fragment_table_start,
-				  cpu_to_le64(end), &table_offset);
+				  cpu_to_le64(end), offsetp);
 
 	start /= ctxt.cur_dev->blksz;
 
 	/* Allocate a proper sized buffer to store the fragment index table */
 	table = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!table) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	if (!table)
+		return -ENOMEM;
 
 	if (sqfs_disk_read(start, n_blks, table) < 0) {
-		ret = -EINVAL;
-		goto out;
+		free(table);
+		return -EINVAL;
 	}
+	*tablep = table;
 
-	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
-	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index);
+	return n_blks * ctxt.cur_dev->blksz;
+}
 
-	/*
-	 * Get the start offset of the metadata block that contains the right
-	 * fragment block entry
-	 */
-	start_block = get_unaligned_le64(table + table_offset + block *
-					 sizeof(u64));
+/*
+ * Reads and decompresses the metadata block of fragment entries which starts
+ * at start_block. The entries are returned in a buffer of
+ * SQFS_METADATA_BLOCK_SIZE bytes, which must be freed.
+ */
+static int sqfs_read_frag_entries(u64 start_block,
+				  struct squashfs_fragment_block_entry **entriesp)
+{
+	struct squashfs_fragment_block_entry *entries = NULL;
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	unsigned char *metadata_buffer, *metadata;
+	u64 start, n_blks, src_len, table_offset;
+	unsigned long dest_len;
+	u16 header;
+	int ret;
 
 	start = start_block / ctxt.cur_dev->blksz;
 	n_blks = sqfs_calc_n_blks(cpu_to_le64(start_block),
 				  sblk->fragment_table_start, &table_offset);
 
 	metadata_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!metadata_buffer) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	if (!metadata_buffer)
+		return -ENOMEM;
 
 	if (sqfs_disk_read(start, n_blks, metadata_buffer) < 0) {
 		ret = -EINVAL;
@@ -197,17 +256,224 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 		memcpy(entries, metadata, SQFS_METADATA_SIZE(header));
 	}
 
+	*entriesp = entries;
+	entries = NULL;
+	ret = 0;
+
+out:
+	free(entries);
+	free(metadata_buffer);
+
+	return ret;
+}
+
+/*
+ * Gets the block of fragment entries with the given index from the cache,
+ * reading the fragment index and the block itself if needed
+ */
+static int sqfs_cache_frag_entries(int block,
+				   struct squashfs_fragment_block_entry **entriesp)
+{
+	struct squashfs_fragment_block_entry **entries;
+	u64 start_block, offset;
+	u32 count;
+	int ret;
+
+	if (!cache.frag_table) {
+		count = DIV_ROUND_UP(get_unaligned_le32(&cache.sblk.fragments),
+				     SQFS_MAX_ENTRIES);
+		entries = calloc(count, sizeof(*entries));
+		if (!entries)
+			return -ENOMEM;
+		ret = sqfs_read_frag_index(&cache.frag_table, &offset);
+		if (ret < 0) {
+			free(entries);
+			return ret;
+		}
+		cache.stats.size += ret + count * sizeof(*entries);
+		cache.frag_index = cache.frag_table + offset;
+		cache.frag_entries = entries;
+		cache.frag_blocks = count;
+	}
+
+	if (block >= cache.frag_blocks)
+		return -EINVAL;
+
+	if (cache.frag_entries[block]) {
+		cache.stats.index_hits++;
+	} else {
+		start_block = get_unaligned_le64(cache.frag_index +
+						 block * sizeof(u64));
+		ret = sqfs_read_frag_entries(start_block,
+					     &cache.frag_entries[block]);
+		if (ret)
+			return ret;
+		cache.stats.index_misses++;
+		cache.stats.size += SQFS_METADATA_BLOCK_SIZE;
+	}
+	*entriesp = cache.frag_entries[block];
+
+	return 0;
+}
+
+/*
+ * Retrieves fragment block entry and returns true if the fragment block is
+ * compressed
+ */
+static int sqfs_frag_lookup(u32 inode_fragment_index,
+			    struct squashfs_fragment_block_entry *e)
+{
+	struct squashfs_fragment_block_entry *entries = NULL;
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	u64 table_offset, start_block;
+	unsigned char *table = NULL;
+	int block, offset, ret;
+
+	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
+		return -EINVAL;
+
+	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
+	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index);
+
+	if (CONFIG_IS_ENABLED(SQUASHFS_CACHE)) {
+		ret = sqfs_cache_frag_entries(block, &entries);
+		if (ret)
+			return ret;
+		*e = entries[offset];
+
+		return SQFS_COMPRESSED_BLOCK(e->size);
+	}
+
+	ret = sqfs_read_frag_index(&table, &table_offset);
+	if (ret < 0)
+		return ret;
+
+	/*
+	 * Get the start offset of the metadata block that contains the right
+	 * fragment block entry
+	 */
+	start_block = get_unaligned_le64(table + table_offset + block *
+					 sizeof(u64));
+
+	ret = sqfs_read_frag_entries(start_block, &entries);
+	if (ret)
+		goto out;
+
 	*e = entries[offset];
 	ret = SQFS_COMPRESSED_BLOCK(e->size);
 
 out:
 	free(entries);
-	free(metadata_buffer);
 	free(table);
 
 	return ret;
 }
 
+/*
+ * Reads the fragment block described by e, decompressing it if needed. The
+ * block starts at *datap within *bufp, which must be freed. Returns the size
+ * of *bufp.
+ */
+static int sqfs_read_frag(struct squashfs_fragment_block_entry *e,
+			  char **bufp, char **datap)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	u64 start, n_blks, table_size, table_offset;
+	char *fragment, *fragment_block;
+	unsigned long dest_len;
+	size_t buf_size;
+	int ret;
+
+	start = lldiv(e->start, ctxt.cur_dev->blksz);
+	table_size = SQFS_BLOCK_SIZE(e->size);
+	table_offset = e->start - (start * ctxt.cur_dev->blksz);
+	n_blks = DIV_ROUND_UP(table_size + table_offset, ctxt.cur_dev->blksz);
+
+	if (__builtin_mul_overflow(n_blks, ctxt.cur_dev->blksz, &buf_size))
+		return -EINVAL;
+
+	fragment = malloc_cache_aligned(buf_size);
+	if (!fragment)
+		return -ENOMEM;
+
+	ret = sqfs_disk_read(start, n_blks, fragment);
+	if (ret < 0)
+		goto err;
+
+	if (!SQFS_COMPRESSED_BLOCK(e->size)) {
+		*bufp = fragment;
+		*datap = fragment + table_offset;
+
+		return buf_size;
+	}
+
+	dest_len = get_unaligned_le32(&sblk->block_size);
+	fragment_block = malloc(dest_len);
+	if (!fragment_block) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	ret = sqfs_decompress(&ctxt, fragment_block, &dest_len,
+			      fragment + table_offset, table_size);
+	if (ret) {
+		free(fragment_block);
+		goto err;
+	}
+	free(fragment);
+	*bufp = fragment_block;
+	*datap = fragment_block;
+
+	return get_unaligned_le32(&sblk->block_size);
+
+err:
+	free(fragment);
+
+	return ret;
+}
+
+/*
+ * Gets the fragment block described by e from the cache, reading it in place
+ * of the least recently used one if needed
+ */
+static int sqfs_cache_frag(struct squashfs_fragment_block_entry *e,
+			   char **datap)
+{
+	struct sqfs_cached_frag *frag, *victim = cache.frags;
+	int ret;
+
+	cache.tick++;
+	for (frag = cache.frags; frag < cache.frags + SQFS_CACHE_FRAGS;
+	     frag++) {
+		if (frag->buf && frag->start == e->start) {
+			cache.stats.frag_hits++;
+			frag->last_used = cache.tick;
+			*datap = frag->data;
+			return 0;
+		}
+		if (!frag->buf ||
+		    (victim->buf && frag->last_used < victim->last_used))
+			victim = frag;
+	}
+
+	cache.stats.size -= victim->size;
+	free(victim->buf);
+	victim->buf = NULL;
+	victim->size = 0;
+
+	ret = sqfs_read_frag(e, &victim->buf, &victim->data);
+	if (ret < 0)
+		return ret;
+	cache.stats.frag_misses++;
+	cache.stats.size += ret;
+	victim->size = ret;
+	victim->start = e->start;
+	victim->last_used = cache.tick;
+	*datap = victim->data;
+
+	return 0;
+}
+
 /*
  * The entry name is a flexible array member, and we don't know its size before
  * actually reading the entry. So we need a first copy to retrieve this size so
@@ -710,11 +976,15 @@ static int sqfs_get_metablk_pos(u32 *pos_list, void *table, u32 offset,
 	return ret;
 }
 
+/*
+ * Reads and decompresses the inode table. Returns the number of metadata
+ * blocks it is made of.
+ */
 static int sqfs_read_inode_table(unsigned char **inode_table)
 {
 	struct squashfs_super_block *sblk = ctxt.sblk;
 	u64 start, n_blks, table_offset, table_size;
-	int j, ret = 0, metablks_count;
+	int j, ret = 0, metablks_count = 0;
 	unsigned char *src_table, *itb;
 	u32 src_len, dest_offset = 0;
 	unsigned long dest_len = 0;
@@ -798,7 +1068,7 @@ static int sqfs_read_inode_table(unsigned char **inode_table)
 free_itb:
 	free(itb);
 
-	return ret;
+	return ret ? ret : metablks_count;
 }
 
 static int sqfs_read_directory_table(unsigned char **dir_table, u32 **pos_list)
@@ -905,6 +1175,60 @@ out:
 	return metablks_count;
 }
 
+/*
+ * Gets the decompressed inode and directory tables, and the position of each
+ * metadata block of the directory table. Returns the number of those blocks.
+ * The tables are held by the cache if it is enabled, so they must be released
+ * with sqfs_free_table().
+ */
+static int sqfs_get_tables(unsigned char **inode_table,
+			   unsigned char **dir_table, u32 **pos_list)
+{
+	int ret, metablks_count;
+
+	if (CONFIG_IS_ENABLED(SQUASHFS_CACHE) && cache.inode_table) {
+		cache.stats.table_hits++;
+		*inode_table = cache.inode_table;
+		*dir_table = cache.dir_table;
+		*pos_list = cache.pos_list;
+
+		return cache.metablks_count;
+	}
+
+	ret = sqfs_read_inode_table(inode_table);
+	if (ret < 0)
+		return ret;
+
+	metablks_count = sqfs_read_directory_table(dir_table, pos_list);
+	if (metablks_count < 1) {
+		free(*inode_table);
+		*inode_table = NULL;
+		return -EINVAL;
+	}
+
+	if (CONFIG_IS_ENABLED(SQUASHFS_CACHE)) {
+		cache.stats.table_misses++;
+		cache.stats.size += (ret + metablks_count) *
+			SQFS_METADATA_BLOCK_SIZE + metablks_count * sizeof(u32);
+		cache.inode_table = *inode_table;
+		cache.dir_table = *dir_table;
+		cache.pos_list = *pos_list;
+		cache.metablks_count = metablks_count;
+	}
+
+	return metablks_count;
+}
+
+/* Frees a table unless it is held by the cache */
+static void sqfs_free_table(void *table)
+{
+	if (CONFIG_IS_ENABLED(SQUASHFS_CACHE) && table &&
+	    (table == cache.inode_table || table == cache.dir_table ||
+	     table == cache.pos_list))
+		return;
+	free(table);
+}
+
 static int sqfs_opendir_nest(const char *filename, struct fs_dir_stream **dirsp)
 {
 	unsigned char *inode_table = NULL, *dir_table = NULL;
@@ -924,13 +1248,7 @@ static int sqfs_opendir_nest(const char *filename, struct fs_dir_stream **dirsp)
 	dirs->inode_table = NULL;
 	dirs->dir_table = NULL;
 
-	ret = sqfs_read_inode_table(&inode_table);
-	if (ret) {
-		ret = -EINVAL;
-		goto out;
-	}
-
-	metablks_count = sqfs_read_directory_table(&dir_table, &pos_list);
+	metablks_count = sqfs_get_tables(&inode_table, &dir_table, &pos_list);
 	if (metablks_count < 1) {
 		ret = -EINVAL;
 		goto out;
@@ -992,10 +1310,11 @@ out:
 			free(token_list[j]);
 		free(token_list);
 	}
-	free(pos_list);
+	sqfs_free_table(pos_list);
 	free(path);
 	if (ret) {
-		free(inode_table);
+		sqfs_free_table(inode_table);
+		sqfs_free_table(dir_table);
 		free(dirs);
 	}
 
@@ -1131,6 +1450,54 @@ static int sqfs_readdir_nest(struct fs_dir_stream *fs_dirs, struct fs_dirent **d
 	return 0;
 }
 
+void sqfs_cache_drop(void)
+{
+	struct sqfs_cache_stats stats = cache.stats;
+	int i;
+
+	free(cache.inode_table);
+	free(cache.dir_table);
+	free(cache.pos_list);
+	free(cache.frag_table);
+	for (i = 0; i < cache.frag_blocks; i++)
+		free(cache.frag_entries[i]);
+	free(cache.frag_entries);
+	for (i = 0; i < SQFS_CACHE_FRAGS; i++)
+		free(cache.frags[i].buf);
+	if (cache.dev)
+		stats.drops++;
+	stats.size = 0;
+	memset(&cache, '\0', sizeof(cache));
+	cache.stats = stats;
+}
+
+void sqfs_cache_stats(struct sqfs_cache_stats *stats)
+{
+	*stats = cache.stats;
+	memset(&cache.stats, '\0', sizeof(cache.stats));
+	cache.stats.size = stats->size;
+}
+
+/*
+ * Drops the cache if it belongs to a different image from the one just
+ * probed, then sets it up for the new image if needed
+ */
+static void sqfs_cache_check(void)
+{
+	if (cache.dev && (cache.dev != ctxt.cur_dev ||
+			  cache.part_start != ctxt.cur_part_info.start ||
+			  cache.part_size != ctxt.cur_part_info.size ||
+			  memcmp(&cache.sblk, ctxt.sblk, sizeof(cache.sblk))))
+		sqfs_cache_drop();
+
+	if (!cache.dev) {
+		cache.dev = ctxt.cur_dev;
+		cache.part_start = ctxt.cur_part_info.start;
+		cache.part_size = ctxt.cur_part_info.size;
+		cache.sblk = *ctxt.sblk;
+	}
+}
+
 int sqfs_probe(struct blk_desc *fs_dev_desc, struct disk_partition *fs_partition)
 {
 	struct squashfs_super_block *sblk;
@@ -1157,6 +1524,9 @@ int sqfs_probe(struct blk_desc *fs_dev_desc, struct disk_partition *fs_partition
 		goto error;
 	}
 
+	if (CONFIG_IS_ENABLED(SQUASHFS_CACHE))
+		sqfs_cache_check();
+
 	return 0;
 error:
 	ctxt.cur_dev = NULL;
@@ -1379,7 +1749,6 @@ static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 	unsigned long dest_len;
 	struct fs_dirent *dent;
 	unsigned char *ipos;
-	size_t buf_size;
 
 	*actread = 0;
 
@@ -1579,55 +1948,16 @@ static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 		goto out;
 	}
 
-	start = lldiv(frag_entry.start, ctxt.cur_dev->blksz);
-	table_size = SQFS_BLOCK_SIZE(frag_entry.size);
-	table_offset = frag_entry.start - (start * ctxt.cur_dev->blksz);
-	n_blks = DIV_ROUND_UP(table_size + table_offset, ctxt.cur_dev->blksz);
-
-	if (__builtin_mul_overflow(n_blks, ctxt.cur_dev->blksz, &buf_size)) {
-		ret = -EINVAL;
-		goto out;
-	}
-
-	fragment = malloc_cache_aligned(buf_size);
-
-	if (!fragment) {
-		ret = -ENOMEM;
-		goto out;
-	}
-
-	ret = sqfs_disk_read(start, n_blks, fragment);
+	if (CONFIG_IS_ENABLED(SQUASHFS_CACHE))
+		ret = sqfs_cache_frag(&frag_entry, &fragment_block);
+	else
+		ret = sqfs_read_frag(&frag_entry, &fragment, &fragment_block);
 	if (ret < 0)
 		goto out;
+	ret = 0;
 
-	/* File compressed and fragmented */
-	if (finfo.frag && finfo.comp) {
-		dest_len = get_unaligned_le32(&sblk->block_size);
-		fragment_block = malloc(dest_len);
-		if (!fragment_block) {
-			ret = -ENOMEM;
-			goto out;
-		}
-
-		ret = sqfs_decompress(&ctxt, fragment_block, &dest_len,
-				      (void *)fragment  + table_offset,
-				      frag_entry.size);
-		if (ret) {
-			free(fragment_block);
-			goto out;
-		}
-
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
-
-		free(fragment_block);
-
-	} else if (finfo.frag && !finfo.comp) {
-		fragment_block = (void *)fragment + table_offset;
-
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
-	}
+	memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
+	*actread = finfo.size;
 
 out:
 	free(fragment);
@@ -1810,8 +2140,8 @@ void sqfs_closedir(struct fs_dir_stream *dirs)
 		return;
 
 	sqfs_dirs = (struct squashfs_dir_stream *)dirs;
-	free(sqfs_dirs->inode_table);
-	free(sqfs_dirs->dir_table);
+	sqfs_free_table(sqfs_dirs->inode_table);
+	sqfs_free_table(sqfs_dirs->dir_table);
 	free(sqfs_dirs->dir_header);
 	free(sqfs_dirs);
 }
@@ -269,6 +269,12 @@ struct global_data {
 	 */
 	struct device_node *of_root;
 #endif
+#if CONFIG_IS_ENABLED(OF_INDEX)
+	/**
+	 * @fdt_index: index of the control FDT, see fdt_index_build()
+	 */
+	struct fdt_index *fdt_index;
+#endif
 #if CONFIG_IS_ENABLED(MULTI_DTB_FIT)
 	/**
 	 * @multi_dtb_fit: pointer to uncompressed multi-dtb FIT image
@@ -310,6 +316,12 @@ struct global_data {
 	 */
 	unsigned int malloc_ptr;
 #endif
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SLAB)
+	/**
+	 * @malloc_slab: state of the malloc() slabs, see malloc_slab_alloc()
+	 */
+	struct malloc_slab *malloc_slab;
+#endif
 #ifdef CONFIG_CONSOLE_RECORD
 	/**
 	 * @console_out: output buffer for console recording
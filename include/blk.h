@@ -8,6 +8,7 @@
 #define BLK_H
 
 #include <bouncebuf.h>
+#include <errno.h>
 #include <dm/uclass-id.h>
 #include <efi.h>
 
@@ -23,6 +24,7 @@ typedef ulong lbaint_t;
 
 #define DEFAULT_BLKSZ		512
 
+struct blk_async;
 struct udevice;
 
 static inline bool blk_enabled(void)
@@ -140,6 +142,29 @@ void blkcache_fill(int iftype, int dev,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer);
 
+/**
+ * blkcache_readahead() - widen a read so that it fills whole cache lines
+ *
+ * A read which falls within a single cache line but does not cover all of
+ * it may be widened by the caller to the whole line, so that the
+ * neighbouring blocks are cached as well. The line may extend beyond the end
+ * of the device, so the widened range must be clamped by the caller.
+ *
+ * @iftype - uclass_id_x for type of device
+ * @dev - device index of particular type
+ * @blksz - size in bytes of each block
+ * @start - starting block number of the request
+ * @blkcnt - number of blocks in the request
+ * @ra_startp - returns the starting block number to read
+ * @ra_cntp - returns the number of blocks to read
+ *
+ * Return: true if the read should be widened to *@ra_startp / *@ra_cntp,
+ * false to read just the requested blocks
+ */
+bool blkcache_readahead(int iftype, int dev, unsigned long blksz,
+			lbaint_t start, lbaint_t blkcnt,
+			lbaint_t *ra_startp, lbaint_t *ra_cntp);
+
 /**
  * blkcache_invalidate() - discard the cache for a set of blocks
  * because of a write or device (re)initialization.
@@ -152,29 +177,59 @@ void blkcache_invalidate(int iftype, int dev);
 /**
  * blkcache_configure() - configure block cache
  *
+ * This sets the defaults for all devices and replaces any per-device
+ * configuration.
+ *
  * @param blocks - maximum blocks per entry
  * @param entries - maximum entries in cache
  */
 void blkcache_configure(unsigned blocks, unsigned entries);
 
+/**
+ * blkcache_configure_dev() - configure block cache for a single device
+ *
+ * @iftype - uclass_id_x for type of device
+ * @dev - device index of particular type
+ * @blocks - maximum blocks per entry
+ * @entries - maximum entries in the cache of this device
+ * Return: 0 if OK, -ENOMEM if out of memory
+ */
+int blkcache_configure_dev(int iftype, int dev, unsigned int blocks,
+			   unsigned int entries);
+
 /*
  * statistics of the block cache
  */
 struct block_cache_stats {
 	unsigned hits;
 	unsigned misses;
+	unsigned evictions;
 	unsigned entries; /* current entry count */
 	unsigned max_blocks_per_entry;
 	unsigned max_entries;
+	unsigned ways; /* entries per set */
+	u64 bytes_saved; /* bytes returned from the cache */
 };
 
 /**
  * get_blkcache_stats() - return statistics and reset
  *
+ * The counters are summed over all devices.
+ *
  * @param stats - statistics are copied here
  */
 void blkcache_stats(struct block_cache_stats *stats);
 
+/**
+ * blkcache_dev_stats() - return statistics of a single device and reset
+ *
+ * @iftype - uclass_id_x for type of device
+ * @dev - device index of particular type
+ * @stats - statistics are copied here
+ * Return: 0 if OK, -ENOENT if the cache has never seen this device
+ */
+int blkcache_dev_stats(int iftype, int dev, struct block_cache_stats *stats);
+
 /** blkcache_free() - free all memory allocated to the block cache */
 void blkcache_free(void);
 
@@ -191,6 +246,13 @@ static inline void blkcache_fill(int iftype, int dev,
 				 lbaint_t start, lbaint_t blkcnt,
 				 unsigned long blksz, void const *buffer) {}
 
+static inline bool blkcache_readahead(int iftype, int dev, unsigned long blksz,
+				      lbaint_t start, lbaint_t blkcnt,
+				      lbaint_t *ra_startp, lbaint_t *ra_cntp)
+{
+	return false;
+}
+
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
 static inline void blkcache_free(void) {}
@@ -291,9 +353,49 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt, const void *buffer);
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
+int blk_dread_async(struct blk_desc *block_dev, lbaint_t start,
+		    lbaint_t blkcnt, void *buffer, struct blk_async *req);
 
 #endif /* BLK */
 
+/*
+ * statistics of the sequential read-ahead of a block device
+ */
+struct blk_readahead_stats {
+	unsigned int hits;	/* requests served from the read-ahead window */
+	unsigned int fills;	/* transfers issued to fill the window */
+	lbaint_t blocks;	/* blocks read by those transfers */
+};
+
+#if CONFIG_IS_ENABLED(BLK_READAHEAD)
+/**
+ * blk_readahead_invalidate() - discard the read-ahead window of a device
+ *
+ * This must be called when the contents of the device may have changed
+ * without a write through blk_write(), e.g. when the medium is replaced.
+ *
+ * @desc: Block device descriptor
+ */
+void blk_readahead_invalidate(struct blk_desc *desc);
+
+/**
+ * blk_readahead_stats() - return read-ahead statistics and reset them
+ *
+ * @dev: Block device
+ * @stats: Returns the statistics
+ * Return: 0 if OK, -ve on error
+ */
+int blk_readahead_stats(struct udevice *dev, struct blk_readahead_stats *stats);
+#else
+static inline void blk_readahead_invalidate(struct blk_desc *desc) {}
+
+static inline int blk_readahead_stats(struct udevice *dev,
+				      struct blk_readahead_stats *stats)
+{
+	return -ENOSYS;
+}
+#endif
+
 /**
  * blk_read() - Read from a block device
  *
@@ -331,6 +433,56 @@ long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
  */
 long blk_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt);
 
+/**
+ * struct blk_async - an asynchronous block read
+ *
+ * @dev: Device to read from
+ * @start: Start block for the read
+ * @blkcnt: Number of blocks to read
+ * @buf: Place to put the data
+ * @ret: Result of the read, as returned by blk_read(), valid once @done is set
+ * @done: true once the read has completed
+ */
+struct blk_async {
+	struct udevice *dev;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buf;
+	long ret;
+	bool done;
+};
+
+/**
+ * blk_read_async() - Start reading from a block device
+ *
+ * The read is carried out by a uthread, so that the caller can do something
+ * useful, such as hashing or decompressing data read previously, while the
+ * device driver waits for the hardware. The read makes progress whenever the
+ * caller yields, e.g. via schedule(), and completes at the latest in
+ * blk_async_wait(). @buf must not be accessed before the read has completed.
+ *
+ * Without CONFIG_UTHREAD, or if no thread can be created, the read completes
+ * before this function returns.
+ *
+ * @dev: Device to read from
+ * @start: Start block for the read
+ * @blkcnt: Number of blocks to read
+ * @buf: Place to put the data
+ * @req: Request to fill in, which must remain valid until the read completes
+ * Return: 0 if the read was started, -ENOSYS if the device cannot be read
+ */
+int blk_read_async(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+		   void *buf, struct blk_async *req);
+
+/**
+ * blk_async_wait() - Wait for an asynchronous read to complete
+ *
+ * @req: Request started with blk_read_async()
+ * Return: number of blocks read (which may be less than the number requested),
+ * or -ve on error
+ */
+long blk_async_wait(struct blk_async *req);
+
 /**
  * blk_find_device() - Find a block device
  *
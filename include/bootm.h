@@ -11,6 +11,7 @@
 
 struct boot_params;
 struct cmd_tbl;
+struct fit_stream;
 
 #define BOOTM_ERR_RESET		(-1)
 #define BOOTM_ERR_OVERLAP		(-2)
@@ -313,6 +314,22 @@ const char *zimage_get_kernel_version(struct boot_params *params,
  */
 void zimage_dump(struct boot_params *base_ptr, bool show_cmdline);
 
+/**
+ * bootm_stream_run() - Boot a FIT configuration loaded from a stream
+ *
+ * This loads the images of the configuration with fit_stream_load_config(),
+ * each straight to its load address, then boots the kernel as bootm would.
+ * The value of the 'verify' environment variable is honoured.
+ *
+ * @bmi: bootm information, set up with bootm_init()
+ * @strm: Stream opened with fit_stream_open()
+ * @conf_uname: Configuration to boot, or NULL for the default one
+ * Return: -ve error code on error. On success the OS boots so this function
+ * does not return, except on sandbox
+ */
+int bootm_stream_run(struct bootm_info *bmi, struct fit_stream *strm,
+		     const char *conf_uname);
+
 /*
  * bootm_boot_start() - Boot an image at the given address
  *
@@ -11,6 +11,7 @@
 #ifndef _BOOTSTAGE_H
 #define _BOOTSTAGE_H
 
+#include <errno.h>
 #include <linux/types.h>
 #ifdef USE_HOSTCC
 #include <linux/kconfig.h>
@@ -20,6 +21,7 @@
 enum bootstage_flags {
 	BOOTSTAGEF_ERROR	= 1 << 0,	/* Error record */
 	BOOTSTAGEF_ALLOC	= 1 << 1,	/* Allocate an id */
+	BOOTSTAGEF_PROBE	= 1 << 2,	/* Time taken to probe a device */
 };
 
 /* bootstate sub-IDs used for kernel and ramdisk ranges */
@@ -213,6 +215,8 @@ enum bootstage_id {
 	BOOTSTAGE_ID_ACCUM_FSP_M,
 	BOOTSTAGE_ID_ACCUM_FSP_S,
 	BOOTSTAGE_ID_ACCUM_MMAP_SPI,
+	BOOTSTAGE_ID_ACCUM_OF_INDEX,
+	BOOTSTAGE_ID_ACCUM_DM_LAZY,
 
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
@@ -335,9 +339,38 @@ uint32_t bootstage_start(enum bootstage_id id, const char *name);
  */
 uint32_t bootstage_accum(enum bootstage_id id);
 
+/**
+ * bootstage_probe_start() - Mark the start of probing a device
+ *
+ * This is called by device_probe() when CONFIG_BOOTSTAGE_PROBE is enabled. It
+ * works like bootstage_start() with a record for the device, found by its
+ * name and uclass, so that probing the same device again adds to its time.
+ * Call bootstage_accum() with the returned ID once the device is probed.
+ *
+ * @name: Name of the device
+ * @uclass_id: Uclass of the device (enum uclass_id)
+ * Return: ID of the record for the device, -ENOENT if bootstage is not set
+ *	up, -ENOSPC if there is no space for a new record, -ENOMEM if out of
+ *	memory
+ */
+int bootstage_probe_start(const char *name, int uclass_id);
+
 /* Print a report about boot time */
 void bootstage_report(void);
 
+/**
+ * bootstage_export() - Write out all records in text form
+ *
+ * This writes one line for each record, for use by 'proftool -b'. See
+ * doc/develop/trace.rst for the format.
+ *
+ * @buf: Buffer to write to, or NULL to write to the console
+ * @size: Size of @buf in bytes
+ * Return: number of bytes of text, not including the terminator, which may be
+ *	more than @size if the buffer is too small
+ */
+int bootstage_export(char *buf, int size);
+
 /**
  * Add bootstage information to the device tree
  *
@@ -435,6 +468,16 @@ static inline uint32_t bootstage_accum(enum bootstage_id id)
 	return 0;
 }
 
+static inline int bootstage_probe_start(const char *name, int uclass_id)
+{
+	return -ENOSYS;
+}
+
+static inline int bootstage_export(char *buf, int size)
+{
+	return 0;
+}
+
 static inline int bootstage_stash(void *base, int size)
 {
 	return 0;	/* Pretend to succeed */
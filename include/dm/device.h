@@ -87,6 +87,12 @@ struct driver_info;
  */
 #define DM_FLAG_PROBE_AFTER_BIND	(1 << 15)
 
+/*
+ * Device may have devicetree children waiting to be bound, with
+ * CONFIG_DM_LAZY_BIND
+ */
+#define DM_FLAG_LAZY_CHILDREN		(1 << 16)
+
 /*
  * One or multiple of these flags are passed to device_remove() so that
  * a selective device removal as specified by the remove-stage and the
@@ -298,12 +304,24 @@ static inline __attribute_const__ bool dev_has_ofnode(const struct udevice *dev)
 #endif
 }
 
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX) && CONFIG_IS_ENABLED(OF_REAL)
+/**
+ * dev_set_ofnode() - Set the devicetree node of a device
+ *
+ * This also updates the lookup tables of the device's uclass
+ *
+ * @dev: Device to update
+ * @node: New node
+ */
+void dev_set_ofnode(struct udevice *dev, ofnode node);
+#else
 static inline void dev_set_ofnode(struct udevice *dev, ofnode node)
 {
 #if CONFIG_IS_ENABLED(OF_REAL)
 	dev->node_ = node;
 #endif
 }
+#endif
 
 static inline int dev_seq(const struct udevice *dev)
 {
@@ -961,6 +979,17 @@ int device_set_name(struct udevice *dev, const char *name);
  */
 void device_set_name_alloced(struct udevice *dev);
 
+/**
+ * device_set_seq() - set the sequence number of a device
+ *
+ * Normally the sequence number is set when the device is bound. This allows
+ * a uclass to set it later, e.g. when the device is probed.
+ *
+ * @dev:	Device to update
+ * @seq:	New sequence number, or -1 for none
+ */
+void device_set_seq(struct udevice *dev, int seq);
+
 /**
  * device_is_compatible() - check if the device is compatible with the compat
  *
@@ -1024,14 +1053,45 @@ static inline bool device_is_on_pci_bus(const struct udevice *dev)
 #define device_foreach_child_safe(pos, next, parent)	\
 	list_for_each_entry_safe(pos, next, &parent->child_head, sibling_node)
 
+/**
+ * dm_lazy_bind_children() - Bind the children of a device waiting to be bound
+ *
+ * Use device_lazy_bind_children() instead, which only calls this if needed
+ *
+ * @parent: Parent device
+ * Return: 0 if OK, -ve on error (devices which bind successfully remain bound)
+ */
+int dm_lazy_bind_children(const struct udevice *parent);
+
+/**
+ * device_lazy_bind_children() - bind children waiting to be bound
+ *
+ * With CONFIG_DM_LAZY_BIND, some devicetree children of a device may not be
+ * bound yet. This binds them, so that walking the children finds them all.
+ *
+ * @parent: parent device
+ */
+static inline void device_lazy_bind_children(const struct udevice *parent)
+{
+	if (CONFIG_IS_ENABLED(DM_LAZY_BIND) &&
+	    (dev_get_flags(parent) & DM_FLAG_LAZY_CHILDREN))
+		dm_lazy_bind_children(parent);
+}
+
 /**
  * device_foreach_child() - iterate through child devices
  *
+ * With CONFIG_DM_LAZY_BIND, any children waiting to be bound are bound first.
+ *
  * @pos: struct udevice * for the current device
  * @parent: parent device to scan
  */
-#define device_foreach_child(pos, parent)	\
-	list_for_each_entry(pos, &parent->child_head, sibling_node)
+#define device_foreach_child(pos, parent)				\
+	for (device_lazy_bind_children(parent),				\
+	     pos = list_first_entry(&(parent)->child_head, typeof(*pos),	\
+				    sibling_node);			\
+	     !list_entry_is_head(pos, &(parent)->child_head, sibling_node); \
+	     pos = list_next_entry(pos, sibling_node))
 
 /**
  * device_foreach_child_of_to_plat() - iterate through children
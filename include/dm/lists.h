@@ -64,6 +64,19 @@ int lists_bind_drivers(struct udevice *parent, bool pre_reloc_only);
 int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 		   struct driver *drv, bool pre_reloc_only);
 
+/**
+ * lists_find_fdt_uclass() - find the uclass a device tree node binds to
+ *
+ * This checks every driver matching one of the compatible strings of a node,
+ * since lists_bind_fdt() may try several of them, without binding anything.
+ *
+ * @node: device tree node to check
+ * @idp: returns the uclass of the matching drivers
+ * Return: 0 if OK, -ENOENT if no driver matches, -EXDEV if the matching
+ * drivers are in more than one uclass
+ */
+int lists_find_fdt_uclass(ofnode node, enum uclass_id *idp);
+
 /**
  * device_bind_driver() - bind a device to a driver
  *
@@ -9,7 +9,9 @@
 #ifndef _DM_ROOT_H_
 #define _DM_ROOT_H_
 
+#include <dm/ofnode_decl.h>
 #include <dm/tag.h>
+#include <dm/uclass-id.h>
 
 struct udevice;
 
@@ -130,6 +132,10 @@ int dm_scan_other(bool pre_reloc_only);
  * then scans and binds available devices from platform data and the FDT.
  * This calls dm_init() to set up Driver Model structures.
  *
+ * With CONFIG_DM_LAZY_BIND, most devicetree nodes are only recorded when
+ * @pre_reloc_only is false, to be bound when first needed. See
+ * dm_lazy_bind_uclass().
+ *
  * @pre_reloc_only: If true, bind only nodes with special devicetree properties,
  * or drivers with the DM_FLAG_PRE_RELOC flag. If false bind all drivers.
  * Return: 0 if OK, -ve on error
@@ -151,6 +157,90 @@ int dm_init_and_scan(bool pre_reloc_only);
  */
 int dm_autoprobe(void);
 
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+/**
+ * dm_lazy_bind_uclass() - Bind the devices of a uclass waiting to be bound
+ *
+ * With CONFIG_DM_LAZY_BIND, dm_init_and_scan() records devicetree nodes
+ * instead of binding them. This binds the recorded nodes whose driver is in
+ * uclass @id, then probes any which ask to be probed after binding. It does
+ * nothing after the first call for each uclass.
+ *
+ * If no driver in the uclass binds to devicetree nodes, its devices may be
+ * created by any other device, so all recorded nodes are bound.
+ *
+ * This is called by uclass_get(), so there is normally no need to call it.
+ *
+ * @id: Uclass to bind
+ * Return: 0 if OK, -ve on error (devices which bind successfully remain bound)
+ */
+int dm_lazy_bind_uclass(enum uclass_id id);
+
+/**
+ * dm_lazy_bind_node() - Bind a devicetree node waiting to be bound
+ *
+ * This binds @node and any of its parents which are waiting to be bound, so
+ * that device_find_global_by_ofnode() can find it.
+ *
+ * @node: Node to bind
+ * Return: 0 if OK (including if @node was not waiting), -ve on error
+ */
+int dm_lazy_bind_node(ofnode node);
+
+/**
+ * dm_lazy_get_seq() - Get the sequence number kept for a node being bound
+ *
+ * When a recorded node is bound, its device is given the sequence number it
+ * would have had if it had been bound when the devicetree was scanned.
+ *
+ * @node: Node being bound
+ * Return: sequence number, or -1 if none was kept for @node
+ */
+int dm_lazy_get_seq(ofnode node);
+
+/**
+ * dm_lazy_next_seq() - Get the next sequence number free for a uclass
+ *
+ * @id: Uclass to check
+ * Return: one more than the highest sequence number kept for a recorded node
+ * in uclass @id, or 0 if none
+ */
+int dm_lazy_next_seq(enum uclass_id id);
+
+/**
+ * dm_lazy_bind_all() - Bind all devicetree nodes waiting to be bound
+ *
+ * After this, devicetree nodes are bound as soon as they are scanned.
+ *
+ * Return: 0 if OK, -ve on error (devices which bind successfully remain bound)
+ */
+int dm_lazy_bind_all(void);
+
+/**
+ * dm_lazy_drop() - Forget the nodes waiting to be bound to a parent
+ *
+ * This is called when @parent is unbound
+ *
+ * @parent: Device which is being unbound
+ */
+void dm_lazy_drop(struct udevice *parent);
+
+/**
+ * dm_lazy_pending() - Get the number of nodes waiting to be bound
+ *
+ * Return: number of nodes waiting
+ */
+int dm_lazy_pending(void);
+#else
+static inline int dm_lazy_bind_uclass(enum uclass_id id) { return 0; }
+static inline int dm_lazy_bind_node(ofnode node) { return 0; }
+static inline int dm_lazy_get_seq(ofnode node) { return -1; }
+static inline int dm_lazy_next_seq(enum uclass_id id) { return 0; }
+static inline int dm_lazy_bind_all(void) { return 0; }
+static inline void dm_lazy_drop(struct udevice *parent) { }
+static inline int dm_lazy_pending(void) { return 0; }
+#endif
+
 /**
  * dm_init() - Initialise Driver Model structures
  *
@@ -335,6 +335,113 @@ int uclass_get_count(void);
  */
 struct uclass *uclass_find(enum uclass_id key);
 
+/**
+ * uclass_find_or_add() - Find a uclass by its id, creating it if needed
+ *
+ * This is the same as uclass_get(), except that it does not bind devices in
+ * the uclass which are waiting to be bound (see CONFIG_DM_LAZY_BIND)
+ *
+ * @id:		Id to search for
+ * @ucp:	Returns pointer to uclass (there is only one per ID)
+ * Return: 0 if OK, -EDEADLK if driver model is not yet inited,
+ * other -ve on other error
+ */
+int uclass_find_or_add(enum uclass_id id, struct uclass **ucp);
+
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+/**
+ * uclass_index_init() - Set up the lookup tables for a new uclass
+ *
+ * If there is not enough memory, the uclass has no tables and lookups walk
+ * its list of devices
+ *
+ * @uc: Uclass, which must have no devices
+ */
+void uclass_index_init(struct uclass *uc);
+
+/**
+ * uclass_index_free() - Free the lookup tables of a uclass
+ *
+ * @uc: Uclass being destroyed
+ */
+void uclass_index_free(struct uclass *uc);
+
+/**
+ * uclass_index_add() - Add a device to the lookup tables of its uclass
+ *
+ * This must be called after the device is added to the list of devices in
+ * its uclass, and after its sequence number or devicetree node changes.
+ *
+ * @dev: Device to add
+ */
+void uclass_index_add(struct udevice *dev);
+
+/**
+ * uclass_index_del() - Remove a device from the lookup tables of its uclass
+ *
+ * This must be called before the device is removed from the list of devices
+ * in its uclass, and before its sequence number or devicetree node changes.
+ *
+ * @dev: Device to remove
+ */
+void uclass_index_del(struct udevice *dev);
+
+/**
+ * uclass_index_find_seq() - Find a device by sequence number
+ *
+ * @uc: Uclass to search
+ * @seq: Sequence number to find
+ * @devp: Returns the first device in the uclass with that sequence number
+ * Return: 0 if found, -ENODEV if not or if @seq is -ve, -ENOSYS if the lookup
+ * tables cannot answer, in which case the caller should walk the list of
+ * devices
+ */
+int uclass_index_find_seq(struct uclass *uc, int seq, struct udevice **devp);
+
+/**
+ * uclass_index_find_ofnode() - Find a device by devicetree node
+ *
+ * @uc: Uclass to search
+ * @node: Node to find (must be valid)
+ * @devp: Returns the first device in the uclass with that node
+ * Return: 0 if found, -ENODEV if not, -ENOSYS if the lookup tables cannot
+ * answer, in which case the caller should walk the list of devices
+ */
+int uclass_index_find_ofnode(struct uclass *uc, ofnode node,
+			     struct udevice **devp);
+
+/**
+ * uclass_index_max_seq() - Find the highest sequence number in a uclass
+ *
+ * @uc: Uclass to check
+ * @maxp: Returns the highest sequence number, or -1 if there is none
+ * Return: 0 if OK, -ENOSYS if the lookup tables cannot answer
+ */
+int uclass_index_max_seq(struct uclass *uc, int *maxp);
+#else
+static inline void uclass_index_init(struct uclass *uc) {}
+static inline void uclass_index_free(struct uclass *uc) {}
+static inline void uclass_index_add(struct udevice *dev) {}
+static inline void uclass_index_del(struct udevice *dev) {}
+
+static inline int uclass_index_find_seq(struct uclass *uc, int seq,
+					struct udevice **devp)
+{
+	return -ENOSYS;
+}
+
+static inline int uclass_index_find_ofnode(struct uclass *uc, ofnode node,
+					   struct udevice **devp)
+{
+	return -ENOSYS;
+}
+
+static inline int uclass_index_max_seq(struct uclass *uc, int *maxp)
+{
+	return -ENOSYS;
+}
+#endif
+
 /**
  * uclass_destroy() - Destroy a uclass
  *
@@ -30,12 +30,17 @@
  * @dev_head: List of devices in this uclass (devices are attached to their
  * uclass when their bind method is called)
  * @sibling_node: Next uclass in the linked list of uclasses
+ * @index_: Lookup tables for the devices in this uclass, or NULL if not
+ * available (do not access outside driver model)
  */
 struct uclass {
 	void *priv_;
 	struct uclass_driver *uc_drv;
 	struct list_head dev_head;
 	struct list_head sibling_node;
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	struct uclass_index *index_;
+#endif
 };
 
 struct driver;
@@ -47,6 +52,9 @@ struct udevice;
 /* Members of this uclass without aliases don't get a sequence number */
 #define DM_UC_FLAG_NO_AUTO_SEQ			(1 << 1)
 
+/* Bind members of this uclass at start-up even with CONFIG_DM_LAZY_BIND */
+#define DM_UC_FLAG_NO_LAZY_BIND			(1 << 2)
+
 /* Same as DM_FLAG_ALLOC_PRIV_DMA */
 #define DM_UC_FLAG_ALLOC_PRIV_DMA		(1 << 5)
 
@@ -0,0 +1,144 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Index of a flat devicetree, for fast phandle, path and compatible lookups
+ */
+
+#ifndef __FDT_INDEX_H
+#define __FDT_INDEX_H
+
+#include <linux/errno.h>
+#include <linux/libfdt.h>
+
+/*
+ * libfdt finds nodes by phandle, path or compatible string by walking the
+ * tree from the start, so that each lookup costs O(size of the tree). The
+ * index holds, for one tree:
+ *
+ * - a table of node offsets in tree order, with the parent of each node
+ * - the phandles, sorted, with the offset of each node
+ * - the compatible strings, sorted, with the offset of each node using them
+ * - a hash table from (parent, node name) to node, used for paths
+ *
+ * so that these lookups take O(log n), or O(depth) for a path.
+ *
+ * The functions below give the same result as the libfdt function they are
+ * named after. If @fdt is not the indexed tree, or it has changed size since
+ * the index was built, they fall back to that libfdt function.
+ *
+ * Only one tree is indexed, normally the control FDT. Changes which do not
+ * alter the size of the tree are not noticed, e.g. fdt_setprop_inplace() or
+ * a same-size fdt_setprop() on a 'compatible' or 'phandle' property,
+ * fdt_set_name(), fdt_nop_property() or fdt_nop_node(). Code making such a
+ * change must call fdt_index_invalidate(), or lookups may return the old node.
+ * These do it for the tree they change: ofnode_write_prop(), fdt_set_phandle(),
+ * fdt_overlay_apply_verbose(), image_setup_libfdt(), board_fix_fdt() (through
+ * its caller) and each 'fdt' subcommand which may change the working FDT.
+ */
+
+#if CONFIG_IS_ENABLED(OF_INDEX)
+/**
+ * fdt_index_build() - Build the index for a tree
+ *
+ * This replaces any existing index.
+ *
+ * @fdt: Tree to index
+ * Return: 0 if OK, -ENOMEM if out of memory, -E2BIG if the tree is nested too
+ * deeply, other -ve if the tree is not valid
+ */
+int fdt_index_build(const void *fdt);
+
+/**
+ * fdt_index_invalidate() - Drop the index of a tree
+ *
+ * @fdt: Tree which has been changed. Nothing is done if it is not the indexed
+ *	tree
+ */
+void fdt_index_invalidate(const void *fdt);
+
+/**
+ * fdt_index_node_offset_by_phandle() - Find a node by phandle
+ *
+ * See fdt_node_offset_by_phandle()
+ *
+ * @fdt: Tree to search
+ * @phandle: Phandle to find
+ * Return: offset of the first node with that phandle, -FDT_ERR_NOTFOUND if
+ * none, -FDT_ERR_BADPHANDLE if @phandle is not valid
+ */
+int fdt_index_node_offset_by_phandle(const void *fdt, uint32_t phandle);
+
+/**
+ * fdt_index_path_offset() - Find a node by path
+ *
+ * See fdt_path_offset(). The path may start with an alias.
+ *
+ * @fdt: Tree to search
+ * @path: Path of the node
+ * Return: offset of the node, -FDT_ERR_NOTFOUND if not found,
+ * -FDT_ERR_BADPATH if the path uses an unknown alias
+ */
+int fdt_index_path_offset(const void *fdt, const char *path);
+
+/**
+ * fdt_index_subnode_offset() - Find a subnode by name
+ *
+ * See fdt_subnode_offset(). A name without a unit address matches the first
+ * subnode with that name, with or without a unit address.
+ *
+ * @fdt: Tree to search
+ * @parentoffset: Offset of the parent node
+ * @name: Name of the subnode
+ * Return: offset of the subnode, -FDT_ERR_NOTFOUND if not found
+ */
+int fdt_index_subnode_offset(const void *fdt, int parentoffset,
+			     const char *name);
+
+/**
+ * fdt_index_node_offset_by_compatible() - Find the next compatible node
+ *
+ * See fdt_node_offset_by_compatible()
+ *
+ * @fdt: Tree to search
+ * @startoffset: Only nodes after this offset are considered, -1 to search the
+ *	whole tree
+ * @compatible: Compatible string to find
+ * Return: offset of the node, -FDT_ERR_NOTFOUND if there are no more
+ */
+int fdt_index_node_offset_by_compatible(const void *fdt, int startoffset,
+					const char *compatible);
+#else
+static inline int fdt_index_build(const void *fdt)
+{
+	return -ENOSYS;
+}
+
+static inline void fdt_index_invalidate(const void *fdt)
+{
+}
+
+static inline int fdt_index_node_offset_by_phandle(const void *fdt,
+						   uint32_t phandle)
+{
+	return fdt_node_offset_by_phandle(fdt, phandle);
+}
+
+static inline int fdt_index_path_offset(const void *fdt, const char *path)
+{
+	return fdt_path_offset(fdt, path);
+}
+
+static inline int fdt_index_subnode_offset(const void *fdt, int parentoffset,
+					   const char *name)
+{
+	return fdt_subnode_offset(fdt, parentoffset, name);
+}
+
+static inline int fdt_index_node_offset_by_compatible(const void *fdt,
+						      int startoffset,
+						      const char *compatible)
+{
+	return fdt_node_offset_by_compatible(fdt, startoffset, compatible);
+}
+#endif
+
+#endif
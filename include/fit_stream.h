@@ -0,0 +1,167 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Loading FIT images in chunks, straight from storage
+ */
+
+#ifndef __FIT_STREAM_H
+#define __FIT_STREAM_H
+
+#include <linux/types.h>
+
+struct blk_desc;
+struct bootm_headers;
+struct fit_stream;
+
+/**
+ * struct fit_stream - a FIT which is read from storage a chunk at a time
+ *
+ * Only the FIT structure (the devicetree) is held in memory. With external
+ * data (mkimage -E) each image is read chunk by chunk, each chunk being hashed
+ * and then decompressed, or read directly, to the image's load address.
+ *
+ * @read: Read @size bytes at byte @offset from the start of the FIT into
+ *	@buf. Returns 0 if OK, -ve on error
+ * @read_start: Optional. Start reading @size bytes at byte @offset into @buf,
+ *	possibly returning before the data has arrived. Returns 0 if the read
+ *	was started, -ve on error. Without this, @read is used for each chunk
+ * @read_wait: Optional, required with @read_start. Wait for the read started
+ *	by @read_start. Returns 0 if OK, -ve on error
+ * @release: Optional. Free any resources held by the source
+ * @priv: Private data for the source
+ * @size: Size of the source in bytes, or 0 if not known. The FIT structure and
+ *	the image data must lie within this
+ * @align: Reads are arranged so that all but the first start at a multiple of
+ *	this many bytes from the start of the FIT (e.g. the device block size)
+ * @chunk_size: Number of bytes to read at a time, a multiple of @align. If 0,
+ *	CONFIG_FIT_STREAM_CHUNK_SIZE is used
+ * @fit: FIT structure, read by fit_stream_open()
+ * @buf: Buffer for two chunks, used when the data must be decompressed
+ */
+struct fit_stream {
+	int (*read)(struct fit_stream *strm, ulong offset, ulong size,
+		    void *buf);
+	int (*read_start)(struct fit_stream *strm, ulong offset, ulong size,
+			  void *buf);
+	int (*read_wait)(struct fit_stream *strm);
+	void (*release)(struct fit_stream *strm);
+	void *priv;
+	ulong size;
+	ulong align;
+	ulong chunk_size;
+	void *fit;
+	void *buf;
+};
+
+/**
+ * fit_stream_init_blk() - Set up a stream reading a FIT from a block device
+ *
+ * Chunks which start and end on a block boundary are read with
+ * blk_dread_async(), so that the next chunk is on its way while the current
+ * one is hashed.
+ *
+ * @strm: Stream to set up
+ * @desc: Block device to read from
+ * @start: Block number where the FIT starts
+ * Return: 0 if OK, -ENOMEM if out of memory
+ */
+int fit_stream_init_blk(struct fit_stream *strm, struct blk_desc *desc,
+			ulong start);
+
+/**
+ * fit_stream_init_fs() - Set up a stream reading a FIT from a file
+ *
+ * The device and partition are looked up once, here. Each chunk is read with
+ * fs_read() at its offset in the file.
+ *
+ * @strm: Stream to set up
+ * @ifname: Interface name (e.g. "mmc")
+ * @dev_part_str: Device and partition (e.g. "0:1")
+ * @filename: Path of the FIT within the filesystem
+ * Return: 0 if OK, -ENODEV if the device or partition is not found, -ENOENT
+ * if the file is not found, -ENOMEM if out of memory
+ */
+int fit_stream_init_fs(struct fit_stream *strm, const char *ifname,
+		       const char *dev_part_str, const char *filename);
+
+/**
+ * fit_stream_open() - Read and check the FIT structure
+ *
+ * @strm: Stream set up by the caller or one of the fit_stream_init_...()
+ *	functions
+ * The FIT structure is read into memory, so its size is checked first: it must
+ * fit in the source and in CONFIG_FIT_STREAM_MAX_STRUCT_SIZE.
+ *
+ * Return: 0 if OK, -ENOEXEC if this is not a valid FIT, -E2BIG if the FIT
+ * structure is too large, -ENOMEM if out of memory, other -ve on read error
+ */
+int fit_stream_open(struct fit_stream *strm);
+
+/**
+ * fit_stream_load_image() - Load an image from a FIT
+ *
+ * The image data is read in chunks of strm->chunk_size. Each chunk is added
+ * to the hashes of the image and is then decompressed to @load, or copied
+ * there for an uncompressed image. Without verification, uncompressed data
+ * is read directly to @load.
+ *
+ * Unchecked data is never written to @load, nor decompressed. When verifying,
+ * data is only passed on as it arrives if the image has a hash tree, each
+ * chunk being passed on once it has been checked. Otherwise the data is
+ * collected in a buffer of its (compressed) size and is copied or
+ * decompressed to @load once the hashes are good. If loading fails while
+ * verifying, whatever was written at @load is cleared.
+ *
+ * The caller must make sure that @max_len bytes at @load are free, e.g. by
+ * reserving them with lmb.
+ *
+ * @strm: Stream opened with fit_stream_open()
+ * @noffset: Image node offset in strm->fit
+ * @load: Address to load the image to
+ * @max_len: Maximum number of bytes which may be written at @load
+ * @verify: true to check the image hashes
+ * @lenp: Returns the number of bytes written at @load
+ * Return: 0 if OK, -EACCES if a hash does not match, -E2BIG if the image does
+ * not fit in @max_len, -EINVAL if the image data lies outside the source,
+ * -ENOSYS if the image is ciphered or signed (which needs the whole image in
+ * memory), other -ve on error
+ */
+int fit_stream_load_image(struct fit_stream *strm, int noffset, ulong load,
+			  ulong max_len, bool verify, ulong *lenp);
+
+/**
+ * fit_stream_load_config() - Load all images of a FIT configuration
+ *
+ * The configuration signature, if any, is checked before anything is loaded.
+ * Each image referenced by the configuration is then loaded to its load
+ * address with fit_stream_load_image(). Images without a load address are
+ * skipped.
+ *
+ * Before anything is written, the destination of each image is reserved with
+ * lmb: the size of the data for an uncompressed image, or for a compressed one
+ * as much free memory as is available at the load address, up to
+ * CONFIG_SYS_BOOTM_LEN, trimmed to the decompressed size once loaded. Loading
+ * fails if this clashes with memory which must not be overwritten (e.g. U-Boot
+ * itself) or with another image of the configuration. The reservations are
+ * kept if the configuration is loaded for booting (@images is not NULL), and
+ * dropped otherwise.
+ *
+ * @strm: Stream opened with fit_stream_open()
+ * @conf_uname: Configuration to load, or NULL for the default one
+ * @verify: true to check the signature and hashes
+ * @images: If not NULL, the loaded kernel, ramdisk and fdt are recorded here
+ *	so that bootm can boot them
+ * Return: 0 if OK, -ENOENT if the configuration does not exist, -EPROTOTYPE
+ * if the kernel cannot be booted on this architecture, -EEXIST if an image
+ * clashes with reserved memory or with another image, other -ve on error
+ */
+int fit_stream_load_config(struct fit_stream *strm, const char *conf_uname,
+			   bool verify, struct bootm_headers *images);
+
+/**
+ * fit_stream_close() - Free the resources held by a stream
+ *
+ * @strm: Stream to close
+ */
+void fit_stream_close(struct fit_stream *strm);
+
+#endif
@@ -1070,6 +1070,8 @@ int booti_setup(ulong image, ulong *relocated_addr, ulong *size,
 #define FIT_ALGO_PROP		"algo"
 #define FIT_VALUE_PROP		"value"
 #define FIT_IGNORE_PROP		"uboot-ignore"
+#define FIT_CHUNK_SIZE_PROP	"chunk-size"
+#define FIT_CHUNK_HASHES_PROP	"chunk-hashes"
 #define FIT_SIG_NODENAME	"signature"
 #define FIT_KEY_REQUIRED	"required"
 #define FIT_KEY_HINT		"key-name-hint"
@@ -1259,6 +1261,28 @@ int fit_get_data_conf_prop(const void *fit, const char *prop_name,
 int fit_image_hash_get_algo(const void *fit, int noffset, const char **algo);
 int fit_image_hash_get_value(const void *fit, int noffset, uint8_t **value,
 				int *value_len);
+int fit_image_hash_get_chunk_size(const void *fit, int noffset,
+				  ulong *chunk_size);
+
+/**
+ * fit_image_check_chunk() - Check one chunk of an image against a hash tree
+ *
+ * This allows part of an image to be checked without reading the rest of it.
+ * Note that this only checks the chunk against the 'chunk-hashes' property;
+ * the caller must check 'chunk-hashes' against 'value' (or rely on a
+ * configuration signature covering it) for the result to mean anything.
+ *
+ * @fit: Pointer to the FIT format image header
+ * @noffset: Offset of a hash node with a 'chunk-size' property
+ * @index: Index of the chunk, counting from 0
+ * @data: Chunk data
+ * @size: Chunk size, which is less than the chunk size only for the last chunk
+ * Return: 0 if the chunk is OK, -EACCES if it does not match, -ERANGE if
+ * @index is too large, -EINVAL if the hash node is not a hash tree,
+ * -EPROTONOSUPPORT if the algorithm is not supported
+ */
+int fit_image_check_chunk(const void *fit, int noffset, ulong index,
+			  const void *data, size_t size);
 
 int fit_set_timestamp(void *fit, int noffset, time_t timestamp);
 
@@ -1352,6 +1376,7 @@ static inline int fit_config_verify(const void *fit, int conf_noffset)
 }
 #endif
 int fit_all_image_verify(const void *fit);
+
 int fit_config_decrypt(const void *fit, int conf_noffset);
 int fit_image_check_os(const void *fit, int noffset, uint8_t os);
 int fit_image_check_arch(const void *fit, int noffset, uint8_t arch);
@@ -1466,6 +1491,28 @@ int fit_check_ramdisk(const void *fit, int os_noffset,
 int calculate_hash(const void *data, int data_len, const char *algo,
 			uint8_t *value, int *value_len);
 
+/**
+ * fit_calc_hash_tree() - Calculate a hash tree over some data
+ *
+ * The data is split into chunks of @chunk_size bytes, the last one possibly
+ * shorter. The hash of each chunk is written to @leaves and the hash of
+ * @leaves is written to @value.
+ *
+ * @data: Data to hash
+ * @size: Size of data in bytes
+ * @algo: Hash algorithm name
+ * @chunk_size: Chunk size in bytes
+ * @leaves: Returns the chunk hashes; must have space for
+ *	DIV_ROUND_UP(@size, @chunk_size) * FIT_MAX_HASH_LEN bytes
+ * @leaves_len: Returns the number of bytes written to @leaves
+ * @value: Returns the hash of @leaves
+ * @value_len: Returns the length of a single hash
+ * Return: 0 if OK, -1 if the algorithm is not supported
+ */
+int fit_calc_hash_tree(const void *data, size_t size, const char *algo,
+		       ulong chunk_size, uint8_t *leaves, int *leaves_len,
+		       uint8_t *value, int *value_len);
+
 /*
  * At present we only support signing on the host, and verification on the
  * device
@@ -407,7 +407,10 @@ enum log_rec_flags {
  * @flags: Flags for log record (enum log_rec_flags)
  * @file: Name of file where the log record was generated (not allocated)
  * @func: Function where the log record was generated (not allocated)
- * @msg: Log message (allocated)
+ * @msg: Log message (allocated), or NULL if it has not been formatted yet
+ * @fmt: printf() format string for the message (not allocated)
+ * @args: Arguments for @fmt. A driver which uses these must va_copy() them
+ *	first, since other drivers may need them too
  */
 struct log_rec {
 	enum log_category_t cat;
@@ -417,12 +420,15 @@ struct log_rec {
 	const char *file;
 	const char *func;
 	const char *msg;
+	const char *fmt;
+	va_list *args;
 };
 
 struct log_device;
 
 enum log_device_flags {
 	LOGDF_ENABLE		= BIT(0),	/* Device is enabled */
+	LOGDF_DEFER		= BIT(1),	/* Device formats msg itself */
 };
 
 /**
@@ -430,7 +436,11 @@ enum log_device_flags {
  *
  * @name: Name of driver
  * @emit: Method to call to emit a log record via this device
- * @flags: Initial value for flags (use LOGDF_ENABLE to enable on start-up)
+ * @flags: Initial value for flags (use LOGDF_ENABLE to enable on start-up).
+ *	With LOGDF_DEFER the message is not formatted for this device, so
+ *	@emit must use the format string and arguments in the record instead
+ * @level: Maximum level to emit when the device has no filters, or 0 to use
+ *	the default log level
  */
 struct log_driver {
 	const char *name;
@@ -443,6 +453,7 @@ struct log_driver {
 	 */
 	int (*emit)(struct log_device *ldev, struct log_rec *rec);
 	unsigned short flags;
+	enum log_level_t level;
 };
 
 /**
@@ -701,4 +712,43 @@ struct global_data;
  */
 void log_fixup_for_gd_move(struct global_data *new_gd);
 
+/**
+ * log_ring_dump() - Write out the records in the log ring buffer
+ *
+ * The records are formatted as they would be on the console, using
+ * gd->log_fmt, with the time at which each one was created in front of it.
+ * The ring buffer is not changed.
+ *
+ * @level: Maximum level of the records to write out
+ * @cat_list: Categories of the records to write out, terminated by %LOGC_END
+ *	if fewer than %LOGF_MAX_CATEGORIES, or NULL for all
+ * @buf: Buffer to write the text to, or NULL to write it to the console
+ * @size: Size of @buf in bytes
+ * Return: number of bytes of text, not including the terminator, which may
+ *	be more than fits in @buf
+ */
+int log_ring_dump(enum log_level_t level, enum log_category_t cat_list[],
+		  char *buf, int size);
+
+/**
+ * log_ring_to_bloblist() - Write the log ring buffer into the bloblist
+ *
+ * The records are written out as with log_ring_dump(), into a
+ * %BLOBLISTT_U_BOOT_LOG blob, so that they can be read by the next program
+ * to run. The text is nul-terminated. Any existing blob is replaced.
+ *
+ * @level: Maximum level of the records to write out
+ * @cat_list: Categories of the records to write out, terminated by %LOGC_END
+ *	if fewer than %LOGF_MAX_CATEGORIES, or NULL for all
+ * Return: 0 if OK, -ENOSPC if there is not enough space in the bloblist,
+ *	other -ve on error
+ */
+int log_ring_to_bloblist(enum log_level_t level,
+			 enum log_category_t cat_list[]);
+
+/**
+ * log_ring_clear() - Drop all the records in the log ring buffer
+ */
+void log_ring_clear(void);
+
 #endif
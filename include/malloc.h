@@ -879,6 +879,49 @@ void malloc_enable_testing(int max_allocs);
 /** malloc_disable_testing() - Put malloc() into normal mode */
 void malloc_disable_testing(void);
 
+/**
+ * malloc_slab_alloc() - Allocate a small object from a slab
+ *
+ * This is used by malloc() when CONFIG_SYS_MALLOC_SLAB is enabled
+ *
+ * @bytes: Number of bytes needed
+ * Return: pointer to the object, or NULL if @bytes is too large for a slab or
+ * no slab memory is available, in which case the caller should fall back to
+ * the main allocator
+ */
+void *malloc_slab_alloc(size_t bytes);
+
+/**
+ * malloc_slab_free() - Free an object if it belongs to a slab
+ *
+ * @ptr: Pointer to the object, or NULL
+ * Return: true if the object was freed, false if it does not belong to a slab
+ */
+bool malloc_slab_free(void *ptr);
+
+/**
+ * malloc_slab_usable_size() - Get the number of bytes available in an object
+ *
+ * @ptr: Pointer to the object, or NULL
+ * Return: size of the object's slot, or 0 if it does not belong to a slab
+ */
+size_t malloc_slab_usable_size(const void *ptr);
+
+/**
+ * malloc_slab_usage() - Get the memory held by the slabs but not in use
+ *
+ * This allows mallinfo() to count the objects in the slabs, rather than the
+ * arenas holding them. Slabs in the pre-relocation pool are not counted.
+ *
+ * @sparep: Returns the total usable size of all arenas, less the size of the
+ *	objects in use
+ * Return: number of arenas
+ */
+uint malloc_slab_usage(ulong *sparep);
+
+/** malloc_slab_info() - Show how the slabs are used */
+void malloc_slab_info(void);
+
 #if CONFIG_IS_ENABLED(SYS_MALLOC_SIMPLE)
 #define malloc malloc_simple
 #define realloc realloc_simple
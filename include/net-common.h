@@ -242,6 +242,17 @@ enum eth_recv_flags {
 	ETH_RECV_CHECK_DEVICE		= 1 << 0,
 };
 
+/**
+ * struct eth_rx_desc - a received packet handed up by recv_batch()
+ *
+ * @packet: Start of the packet, in a buffer owned by the driver
+ * @length: Length of the packet in bytes
+ */
+struct eth_rx_desc {
+	uchar *packet;
+	int length;
+};
+
 /**
  * struct eth_ops - functions of Ethernet MAC controllers
  *
@@ -255,6 +266,15 @@ enum eth_recv_flags {
  * free_pkt: Give the driver an opportunity to manage its packet buffer memory
  *	     when the network stack is finished processing it. This will only be
  *	     called when no error was returned from recv - optional
+ * recv_batch: Hand up to "max" received packets to the network stack in one
+ *	       go, filling in a descriptor for each. The packets are processed
+ *	       in place and must stay valid until free_batch() is called.
+ *	       Return the number of packets, 0 if there are none or an error.
+ *	       If -ENOSYS is returned, recv() is used instead. Drivers must
+ *	       still provide recv() and free_pkt() - optional
+ * free_batch: Give back the buffers of the first "count" packets returned by
+ *	       recv_batch(), once the network stack is finished with them -
+ *	       required if recv_batch is provided
  * stop: Stop the hardware from looking for packets - may be called even if
  *	 state == PASSIVE
  * mcast: Join or leave a multicast group (for TFTP) - optional
@@ -277,6 +297,10 @@ struct eth_ops {
 	int (*send)(struct udevice *dev, void *packet, int length);
 	int (*recv)(struct udevice *dev, int flags, uchar **packetp);
 	int (*free_pkt)(struct udevice *dev, uchar *packet, int length);
+	int (*recv_batch)(struct udevice *dev, int flags,
+			  struct eth_rx_desc *descs, int max);
+	int (*free_batch)(struct udevice *dev, struct eth_rx_desc *descs,
+			  int count);
 	void (*stop)(struct udevice *dev);
 	int (*mcast)(struct udevice *dev, const u8 *enetaddr, int join);
 	int (*write_hwaddr)(struct udevice *dev);
@@ -0,0 +1,186 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Writing network downloads to storage as they arrive
+ */
+
+#ifndef __NET_SINK_H__
+#define __NET_SINK_H__
+
+#include <linux/errno.h>
+#include <linux/types.h>
+
+/**
+ * struct net_sink - destination to which a download is written
+ *
+ * Rather than loading the whole file into memory, a download can be passed to
+ * a sink in chunks as it arrives. The protocol stores the data in a staging
+ * buffer at the load address, which is used as a ring. Each time a chunk of
+ * the file is complete it is handed to @write, so the buffer only needs to be
+ * large enough to cover the data which can be in flight.
+ *
+ * @name: Name of the destination, for messages
+ * @align: Alignment in bytes needed for writes, e.g. the block size
+ * @write: Write part of the file. @offset is a multiple of the chunk size and
+ *	@len is the chunk size, except at the end of the file. Returns 0 if OK,
+ *	-ve on error
+ * @finish: Called once the whole file has been written, with its size, or
+ *	NULL if nothing is needed. Returns 0 if OK, -ve on error
+ * @priv: Private data for the destination
+ */
+struct net_sink {
+	const char *name;
+	ulong align;
+	int (*write)(struct net_sink *sink, ulong offset, const void *buf,
+		     ulong len);
+	int (*finish)(struct net_sink *sink, ulong size);
+	void *priv;
+};
+
+#if IS_ENABLED(CONFIG_NET_SINK)
+
+/**
+ * net_sink_set() - Write the next download to a sink
+ *
+ * The sink is used by the next TFTP or HTTP download and then dropped, whether
+ * the download worked or not.
+ *
+ * @sink: Sink to use, or NULL to go back to loading into memory
+ * @buf_size: Size of the staging buffer, or 0 for CONFIG_NET_SINK_BUF_SIZE
+ */
+void net_sink_set(struct net_sink *sink, ulong buf_size);
+
+/**
+ * net_sink_set_blk() - Write the next download to a block device
+ *
+ * The file is written from the start of the device or partition, which must
+ * be large enough to hold it.
+ *
+ * @ifname: Interface name, e.g. "mmc"
+ * @dev_part_str: Device and optional partition, e.g. "0:2"
+ * @buf_size: Size of the staging buffer, or 0 for CONFIG_NET_SINK_BUF_SIZE
+ * Return: 0 if OK, -ve on error
+ */
+int net_sink_set_blk(const char *ifname, const char *dev_part_str,
+		     ulong buf_size);
+
+/**
+ * net_sink_get() - Get the sink for the next download
+ *
+ * Return: sink, or NULL if the download goes to memory
+ */
+struct net_sink *net_sink_get(void);
+
+/**
+ * net_sink_active() - Check if the download is going to a sink
+ *
+ * Return: true if a sink has been set
+ */
+static inline bool net_sink_active(void)
+{
+	return net_sink_get();
+}
+
+/**
+ * net_sink_start() - Start a download into the sink
+ *
+ * This may be called again if the download starts over.
+ *
+ * @addr: Address of the staging buffer
+ * Return: 0 if OK, -ve on error
+ */
+int net_sink_start(ulong addr);
+
+/**
+ * net_sink_window() - Get how far ahead data may be received
+ *
+ * Protocols with a window should keep it within this, so that nothing has to
+ * be dropped by net_sink_store().
+ *
+ * Return: number of bytes which fit in the buffer beyond the data which has
+ *	all been received
+ */
+ulong net_sink_window(void);
+
+/**
+ * net_sink_store() - Store data received for the file
+ *
+ * The data may arrive out of order, but must not be further ahead of the
+ * data already written than the buffer allows.
+ *
+ * @offset: Offset of the data in the file
+ * @src: Data received
+ * @len: Number of bytes
+ * Return: 0 if OK, -ENOSPC if the data does not fit in the buffer yet, so
+ *	must be dropped and received again
+ */
+int net_sink_store(ulong offset, const void *src, ulong len);
+
+/**
+ * net_sink_advance() - Write the chunks which are complete
+ *
+ * @size: Number of bytes from the start of the file which have all been
+ *	received
+ * Return: 0 if OK, -ve on error
+ */
+int net_sink_advance(ulong size);
+
+/**
+ * net_sink_finish() - Write the rest of the file once it is all received
+ *
+ * @size: Size of the file
+ * Return: 0 if OK, -ve on error
+ */
+int net_sink_finish(ulong size);
+
+/**
+ * net_sink_end() - Drop the sink after a download which used it
+ *
+ * This is called once the network loop is finished. If a download was started
+ * into the sink, the sink is dropped so that later downloads go to memory.
+ */
+void net_sink_end(void);
+
+#else
+
+static inline struct net_sink *net_sink_get(void)
+{
+	return NULL;
+}
+
+static inline bool net_sink_active(void)
+{
+	return false;
+}
+
+static inline int net_sink_start(ulong addr)
+{
+	return -ENOSYS;
+}
+
+static inline ulong net_sink_window(void)
+{
+	return 0;
+}
+
+static inline int net_sink_store(ulong offset, const void *src, ulong len)
+{
+	return -ENOSYS;
+}
+
+static inline int net_sink_advance(ulong size)
+{
+	return 0;
+}
+
+static inline int net_sink_finish(ulong size)
+{
+	return 0;
+}
+
+static inline void net_sink_end(void)
+{
+}
+
+#endif
+
+#endif /* __NET_SINK_H__ */
@@ -86,7 +86,7 @@ struct ip_tcp_hdr {
 #define TCP_OPT_LEN_8	0x08
 #define TCP_OPT_LEN_A	0x0a		/* Timestamp Length		*/
 #define TCP_MSS		1460		/* Max segment size		*/
-#define TCP_SCALE	0x01		/* Scale			*/
+#define TCP_MAX_SCALE	14		/* Largest window scale, RFC 7323 */
 
 /**
  * struct tcp_mss - TCP option structure for MSS (Max segment size)
@@ -144,6 +144,15 @@ struct sack_edges {
 
 #define TCP_SACK_HILLS	4
 
+/*
+ * Only three SACK blocks fit in the option space next to the timestamp, so
+ * at most that many of the hills are reported to the sender. More hills are
+ * tracked, so that data received beyond many gaps in a large window is not
+ * forgotten and sent again.
+ */
+#define TCP_SACK_SEND	3
+#define TCP_SACK_TRACK	16
+
 /**
  * struct tcp_sack_v - TCP option structure for SACK
  * @kind: Field ID
@@ -172,6 +181,16 @@ struct tcp_t_opt {
 
 #define TCP_TSOPT_SIZE (sizeof(struct tcp_t_opt))
 
+/**
+ * struct tcp_sack_track - hills received beyond the next expected byte
+ * @len: Length of a SACK option listing all the hills
+ * @hill: L & R edges of the hills, in sequence order
+ */
+struct tcp_sack_track {
+	u8	len;
+	struct	sack_edges hill[TCP_SACK_TRACK];
+};
+
 /*
  * ip tcp  structure with options
  */
@@ -353,13 +372,18 @@ enum tcp_status {
  * @irs:		Initial receive sequence number
  * @rcv_nxt:		Receive next
  * @rcv_wnd:		Receive window (in bytes)
+ * @ack_pending:	Number of received segments not yet acknowledged
  *
  * @loc_timestamp:	Local timestamp
  * @rmt_timestamp:	Remote timestamp
  *
  * @rmt_win_scale:	Remote window scale factor
+ * @rcv_wnd_scale:	Local window scale factor, 0 unless both sides offered
+ *			  window scaling
  *
  * @lost:		Used for SACK
+ * @sack_last:		Sequence number of the last segment received, which
+ *			  goes in the first SACK block
  *
  * @retry_cnt:		Number of retry attempts remaining. Only SYN, FIN
  *			  or DATA segments are tried to retransmit.
@@ -413,6 +437,7 @@ struct tcp_stream {
 	u32		irs;
 	u32		rcv_nxt;
 	u32		rcv_wnd;
+	u8		ack_pending;
 
 	/* TCP option timestamp */
 	u32		loc_timestamp;
@@ -420,9 +445,11 @@ struct tcp_stream {
 
 	/* TCP window scale */
 	u8		rmt_win_scale;
+	u8		rcv_wnd_scale;
 
 	/* TCP sliding window control used to request re-TX */
-	struct tcp_sack_v lost;
+	struct tcp_sack_track lost;
+	u32		sack_last;
 
 	/* used for data retransmission */
 	int		retry_cnt;
@@ -25,6 +25,48 @@ void tftp_start_server(void);	/* Wait for incoming TFTP put */
 extern ulong tftp_timeout_ms;
 extern int tftp_timeout_count_max;
 
+/**
+ * struct tftp_stats - statistics for the last TFTP transfer
+ *
+ * @size: Number of bytes transferred
+ * @time_ms: Time taken in milliseconds
+ * @blksize: Block size agreed with the server
+ * @windowsize: Window size agreed with the server
+ * @blocks: Number of data blocks received in order
+ * @out_of_order: Number of data blocks received ahead of a missing block and
+ *	kept until it arrived
+ * @dups: Number of data blocks received more than once
+ * @nacks: Number of times the server was asked to resend from a missing block
+ * @timeouts: Number of timeouts waiting for the server
+ * @rtt_count: Number of round trips measured, from sending an ACK to
+ *	receiving the block after it
+ * @rtt_min_us: Shortest round trip in microseconds
+ * @rtt_max_us: Longest round trip in microseconds
+ * @rtt_total_us: Total of the round trips, for working out the average
+ */
+struct tftp_stats {
+	ulong size;
+	ulong time_ms;
+	uint blksize;
+	uint windowsize;
+	ulong blocks;
+	ulong out_of_order;
+	ulong dups;
+	ulong nacks;
+	ulong timeouts;
+	ulong rtt_count;
+	ulong rtt_min_us;
+	ulong rtt_max_us;
+	ulong rtt_total_us;
+};
+
+/**
+ * tftp_get_stats() - Get the statistics for the last TFTP transfer
+ *
+ * @stats: Returns the statistics
+ */
+void tftp_get_stats(struct tftp_stats *stats);
+
 /**********************************************************************/
 
 #endif /* __TFTP_H__ */
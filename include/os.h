@@ -152,6 +152,25 @@ void os_set_alarm_handler(void (*handler)(int));
  */
 void os_raise_sigalrm(void);
 
+/**
+ * os_profile_start() - start a timer which interrupts to take samples
+ *
+ * This uses ITIMER_PROF, so the timer only runs while the process is using
+ * the CPU, and SIGALRM remains available for os_alarm()
+ *
+ * @usec: interval between samples in microseconds
+ * @handler: function to call for each sample, with the program counter and the
+ *	return address (0 if this cannot be found safely)
+ * Return: 0 if OK, -1 on error
+ */
+int os_profile_start(unsigned int usec,
+		     void (*handler)(unsigned long pc, unsigned long caller));
+
+/**
+ * os_profile_stop() - stop the timer started by os_profile_start()
+ */
+void os_profile_stop(void);
+
 /**
  * os_tty_raw() - put tty into raw mode to mimic serial console better
  *
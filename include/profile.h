@@ -0,0 +1,80 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Sampling profiler
+ *
+ * A timer interrupt records the address being executed at a fixed rate. Unlike
+ * function tracing (see trace.h) this does not need the code to be built with
+ * -finstrument-functions, so the image runs at nearly its normal speed.
+ */
+
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+#include <linux/types.h>
+
+/**
+ * profile_sample() - Record a sample
+ *
+ * This is called from the timer interrupt (or signal, on sandbox), so must
+ * not do anything more than store the sample.
+ *
+ * @pc: Address which was being executed when the interrupt happened
+ * @caller: Return address of the function containing @pc, or 0 if not known
+ */
+void profile_sample(ulong pc, ulong caller);
+
+/**
+ * profile_start() - Start taking samples
+ *
+ * This drops any samples taken previously.
+ *
+ * @freq: Number of samples to take each second
+ * Return: 0 if OK, -EALREADY if already running, -EINVAL if @freq is not
+ * valid, -ENOMEM if the buffer could not be allocated, other -ve value if the
+ * timer could not be set up
+ */
+int profile_start(uint freq);
+
+/**
+ * profile_stop() - Stop taking samples
+ *
+ * Return: 0 if OK, -EALREADY if not running
+ */
+int profile_stop(void);
+
+/**
+ * profile_print_stats() - Show how many samples have been taken
+ */
+void profile_print_stats(void);
+
+/**
+ * profile_list_samples() - Write the samples into a buffer
+ *
+ * The buffer holds a struct trace_output_hdr of type TRACE_CHUNK_SAMPLES
+ * followed by a struct trace_sample for each sample, in the same format as the
+ * output of trace_list_calls(), so that proftool can read it.
+ *
+ * @buff: Buffer to write to
+ * @buff_size: Size of buffer
+ * @needed: Returns the number of bytes needed, which may be more than
+ *	@buff_size
+ * Return: 0 if OK, -ENOSPC if the buffer is too small
+ */
+int profile_list_samples(void *buff, size_t buff_size, size_t *needed);
+
+/**
+ * arch_profile_start() - Start the timer which takes samples
+ *
+ * The timer calls profile_sample() @freq times a second.
+ *
+ * @freq: Number of samples to take each second
+ * Return: 0 if OK, -ENOSYS if there is no timer interrupt, other -ve on error
+ */
+int arch_profile_start(uint freq);
+
+/**
+ * arch_profile_stop() - Stop the timer which takes samples
+ */
+void arch_profile_stop(void);
+
+#endif
@@ -197,6 +197,20 @@ struct spi_mem_op {
 		__VA_ARGS__					\
 	}
 
+/**
+ * struct spi_mem_dma_split - Split of a transfer around its DMA-able part
+ * @head: number of bytes to transfer without DMA before @body
+ * @body: number of bytes which can be transferred by DMA
+ * @tail: number of bytes to transfer without DMA after @body
+ *
+ * Filled in by spi_mem_dma_split().
+ */
+struct spi_mem_dma_split {
+	size_t head;
+	size_t body;
+	size_t tail;
+};
+
 /**
  * struct spi_mem_dirmap_info - Direct mapping information
  * @op_tmpl: operation template that should be used by the direct mapping when
@@ -392,6 +406,8 @@ bool spi_mem_default_supports_op(struct spi_mem *mem,
 #endif /* __UBOOT__ */
 
 int spi_mem_adjust_op_size(struct spi_slave *slave, struct spi_mem_op *op);
+void spi_mem_dma_split(const void *buf, size_t len, uint align, uint gran,
+		       struct spi_mem_dma_split *split);
 u64 spi_mem_calc_op_duration(struct spi_mem_op *op);
 
 bool spi_mem_supports_op(struct spi_slave *slave, const struct spi_mem_op *op);
@@ -12,6 +12,29 @@
 
 struct disk_partition;
 
+/**
+ * struct sqfs_cache_stats - Statistics for the SquashFS metadata cache
+ *
+ * @table_hits: Lookups which used the cached inode and directory tables
+ * @table_misses: Lookups which read the inode and directory tables
+ * @index_hits: Fragment lookups which used a cached block of fragment entries
+ * @index_misses: Fragment lookups which read a block of fragment entries
+ * @frag_hits: File reads which used a cached fragment block
+ * @frag_misses: File reads which read a fragment block
+ * @drops: Number of times the cache was discarded
+ * @size: Number of bytes currently held by the cache
+ */
+struct sqfs_cache_stats {
+	ulong table_hits;
+	ulong table_misses;
+	ulong index_hits;
+	ulong index_misses;
+	ulong frag_hits;
+	ulong frag_misses;
+	ulong drops;
+	ulong size;
+};
+
 int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp);
 int sqfs_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp);
 int sqfs_probe(struct blk_desc *fs_dev_desc,
@@ -23,4 +46,22 @@ int sqfs_exists(const char *filename);
 void sqfs_close(void);
 void sqfs_closedir(struct fs_dir_stream *dirs);
 
+/**
+ * sqfs_cache_stats() - Get and reset the statistics for the metadata cache
+ *
+ * All counts except @stats->size are reset to zero.
+ *
+ * @stats: Returns the statistics
+ */
+void sqfs_cache_stats(struct sqfs_cache_stats *stats);
+
+/**
+ * sqfs_cache_drop() - Discard the metadata cache
+ *
+ * The cache is checked against the image each time a filesystem is probed, but
+ * this can be used to make sure that nothing is kept, e.g. after writing to the
+ * medium.
+ */
+void sqfs_cache_drop(void);
+
 #endif /* SQFS_H  */
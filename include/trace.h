@@ -34,6 +34,7 @@ enum {
 enum trace_chunk_type {
 	TRACE_CHUNK_FUNCS,
 	TRACE_CHUNK_CALLS,
+	TRACE_CHUNK_SAMPLES,
 };
 
 /* A trace record for a function, as written to the profile output file */
@@ -47,7 +48,7 @@ struct trace_output_hdr {
 	enum trace_chunk_type type;	/* Record type */
 	uint32_t version;		/* Version (TRACE_VERSION) */
 	uint32_t rec_count;		/* Number of records */
-	uint32_t spare;			/* 0 */
+	uint32_t spare;			/* Sample rate in Hz, or 0 */
 	uint64_t text_base;		/* Value of CONFIG_TEXT_BASE */
 	uint64_t spare2;		/* 0 */
 };
@@ -89,6 +90,15 @@ struct trace_call {
 
 int trace_list_calls(void *buff, size_t buff_size, size_t *needed);
 
+/* Caller offset used in a sample when the caller is not known */
+#define TRACE_SAMPLE_NO_CALLER	0xffffffffU
+
+/* A sample from the sampling profiler (see profile.h) */
+struct trace_sample {
+	uint32_t pc;		/* Offset into code of the sampled address */
+	uint32_t caller;	/* Offset of the return address, if known */
+};
+
 /**
  * Turn function tracing on and off
  *
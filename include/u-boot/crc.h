@@ -99,6 +99,32 @@ uint32_t crc32_no_comp(uint32_t crc, const unsigned char *buf, uint len);
 void crc32_wd_buf(const uint8_t *input, uint ilen, uint8_t *output,
 		  uint chunk_sz);
 
+/* arch/arm/cpu/armv8/crc32.c */
+
+/**
+ * crc32_armv8() - crc32_no_comp() using the ARMv8 CRC32 instructions
+ *
+ * Only call this if ID_AA64ISAR0_EL1 reports the CRC32 instructions.
+ *
+ * @crc: CRC to start from, without the one's complement
+ * @buf: Buffer to checksum
+ * @len: Length of buffer in bytes
+ * Return: CRC32 result, without the one's complement
+ */
+uint32_t crc32_armv8(uint32_t crc, const unsigned char *buf, uint len);
+
+/**
+ * crc32c_armv8() - crc32c_cal() using the ARMv8 CRC32C instructions
+ *
+ * Only call this if ID_AA64ISAR0_EL1 reports the CRC32 instructions.
+ *
+ * @crc: CRC to start from
+ * @buf: Buffer to checksum
+ * @len: Length of buffer in bytes
+ * Return: CRC32C result
+ */
+uint32_t crc32c_armv8(uint32_t crc, const unsigned char *buf, uint len);
+
 /* lib/crc32c.c */
 
 /**
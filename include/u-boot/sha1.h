@@ -89,6 +89,19 @@ void sha1_finish( sha1_context *ctx, unsigned char output[20] );
 void sha1_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+/**
+ * \brief	   SHA-1 process 64-byte blocks in C
+ *
+ * Architectures providing their own sha1_process() can fall back to this
+ * when the CPU lacks the instructions they use.
+ *
+ * \param ctx	   SHA-1 context
+ * \param data	   buffer holding the blocks
+ * \param blocks   number of blocks
+ */
+void sha1_process_generic(sha1_context *ctx, const unsigned char *data,
+			  unsigned int blocks);
+
 /**
  * \brief	   Output = HMAC-SHA-1( input buffer, hmac key )
  *
@@ -37,6 +37,19 @@ void sha256_finish(sha256_context * ctx, uint8_t digest[SHA256_SUM_LEN]);
 void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+/**
+ * sha256_process_generic() - Hash some blocks in C
+ *
+ * Architectures providing their own sha256_process() can fall back to this
+ * when the CPU lacks the instructions they use.
+ *
+ * @ctx: Context to update
+ * @data: Data to hash
+ * @blocks: Number of 64-byte blocks at @data
+ */
+void sha256_process_generic(sha256_context *ctx, const unsigned char *data,
+			    unsigned int blocks);
+
 int sha256_hmac(const unsigned char *key, int keylen,
 		const unsigned char *input, unsigned int ilen,
 		unsigned char *output);
@@ -101,6 +101,13 @@ int uthread_create(struct uthread *uthr, void (*fn)(void *), void *arg,
  * Return: true if a thread was scheduled, false if no runnable thread was found
  */
 bool uthread_schedule(void);
+/**
+ * uthread_self() - return the thread object of the calling thread
+ *
+ * Return: the current thread. This is a framework-internal object for the main
+ * thread, i.e. when called outside of any thread created by uthread_create()
+ */
+struct uthread *uthread_self(void);
 /**
  * uthread_grp_new_id() - return a new ID for a thread group
  *
@@ -169,6 +176,11 @@ static inline bool uthread_schedule(void)
 	return false;
 }
 
+static inline struct uthread *uthread_self(void)
+{
+	return NULL;
+}
+
 static inline unsigned int uthread_grp_new_id(void)
 {
 	return 0;
@@ -11,10 +11,19 @@
  */
 
 #include <compiler.h>
+#include <u-boot/crc.h>
+#ifdef CONFIG_ARM64_CRC32
+#include <asm/system.h>
+#endif
 
 uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
 		    uint32_t *crc32c_table)
 {
+#ifdef CONFIG_ARM64_CRC32
+	/* the table is for the CRC32C polynomial, as set up by crc32c_init() */
+	if (read_id_aa64isar0() & ID_AA64ISAR0_EL1_CRC32)
+		return crc32c_armv8(crc, (const unsigned char *)data, length);
+#endif
 	while (length--)
 		crc = crc32c_table[(u8)(crc ^ *data++)] ^ (crc >> 8);
 
@@ -0,0 +1,488 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Index of a flat devicetree, for fast phandle, path and compatible lookups
+ */
+
+#define LOG_CATEGORY	LOGC_DT
+
+#include <fdt_index.h>
+#include <log.h>
+#include <malloc.h>
+#include <sort.h>
+#include <asm/global_data.h>
+#include <linux/log2.h>
+#include <linux/string.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+enum {
+	MAX_DEPTH	= 32,
+};
+
+struct fdt_index_phandle {
+	u32 phandle;
+	int offset;
+};
+
+struct fdt_index_compat {
+	const char *str;
+	int offset;
+};
+
+/**
+ * struct fdt_index_slot - entry in the hash table of node names
+ *
+ * Each node has an entry for its name and, if it has a unit address, one for
+ * its name without the unit address, unless an earlier sibling already matches
+ * that name.
+ *
+ * @hash: Hash of the parent node index and the name
+ * @len: Length of the name
+ * @node: Node index, -1 if the slot is empty
+ */
+struct fdt_index_slot {
+	u32 hash;
+	int len;
+	int node;
+};
+
+/**
+ * struct fdt_index - index of a flat devicetree
+ *
+ * Nodes are numbered in tree order, the root node being 0.
+ *
+ * @fdt: Indexed tree
+ * @off_struct: Offset of the structure block when the index was built
+ * @size_struct: Size of the structure block when the index was built
+ * @size_strings: Size of the strings block when the index was built
+ * @early: true if allocated before relocation, so it cannot be freed after
+ * @aliases: Offset of the /aliases node, -1 if none
+ * @node_count: Number of nodes
+ * @offsets: Offset of each node, in ascending order
+ * @parents: Index of each node's parent, -1 for the root node
+ * @phandle_count: Number of nodes with a phandle
+ * @phandles: Phandles, sorted by phandle and then offset
+ * @compat_count: Number of compatible strings
+ * @compats: Compatible strings, sorted by string and then offset
+ * @slot_mask: Number of hash-table slots, minus 1
+ * @slots: Hash table of node names
+ */
+struct fdt_index {
+	const void *fdt;
+	int off_struct;
+	int size_struct;
+	int size_strings;
+	bool early;
+	int aliases;
+	int node_count;
+	int *offsets;
+	int *parents;
+	int phandle_count;
+	struct fdt_index_phandle *phandles;
+	int compat_count;
+	struct fdt_index_compat *compats;
+	uint slot_mask;
+	struct fdt_index_slot *slots;
+};
+
+static struct fdt_index *fdt_index_get(const void *fdt)
+{
+	struct fdt_index *idx = gd->fdt_index;
+
+	if (!idx || idx->fdt != fdt ||
+	    fdt_off_dt_struct(fdt) != idx->off_struct ||
+	    fdt_size_dt_struct(fdt) != idx->size_struct ||
+	    fdt_size_dt_strings(fdt) != idx->size_strings)
+		return NULL;
+
+	return idx;
+}
+
+/* Find the index of the node at @offset, -1 if there is no node there */
+static int fdt_index_node(struct fdt_index *idx, int offset)
+{
+	int lo = 0, hi = idx->node_count;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (idx->offsets[mid] == offset)
+			return mid;
+		if (idx->offsets[mid] < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return -1;
+}
+
+static u32 fdt_index_hash(int parent, const char *name, int len)
+{
+	u32 hash = 2166136261U ^ (parent * 0x9e3779b1U);
+
+	while (len--) {
+		hash ^= (u8)*name++;
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+/* Check a node name as fdt_subnode_offset_namelen() does */
+static bool fdt_index_name_eq(const void *fdt, int offset, const char *name,
+			      int len)
+{
+	const char *p;
+	int olen;
+
+	p = fdt_get_name(fdt, offset, &olen);
+	if (!p || olen < len || memcmp(p, name, len))
+		return false;
+
+	return !p[len] || (p[len] == '@' && !memchr(name, '@', len));
+}
+
+static int fdt_index_child(struct fdt_index *idx, int parent, const char *name,
+			   int len)
+{
+	u32 hash = fdt_index_hash(parent, name, len);
+	uint i;
+
+	for (i = hash & idx->slot_mask; ; i = (i + 1) & idx->slot_mask) {
+		struct fdt_index_slot *slot = &idx->slots[i];
+
+		if (slot->node < 0)
+			return -1;
+		if (slot->hash == hash && slot->len == len &&
+		    idx->parents[slot->node] == parent &&
+		    fdt_index_name_eq(idx->fdt, idx->offsets[slot->node], name,
+				      len))
+			return slot->node;
+	}
+}
+
+static void fdt_index_add_child(struct fdt_index *idx, int parent, int node,
+				const char *name, int len)
+{
+	u32 hash = fdt_index_hash(parent, name, len);
+	uint i;
+
+	/* an earlier sibling already matches this name */
+	if (fdt_index_child(idx, parent, name, len) >= 0)
+		return;
+
+	i = hash & idx->slot_mask;
+	while (idx->slots[i].node >= 0)
+		i = (i + 1) & idx->slot_mask;
+	idx->slots[i].hash = hash;
+	idx->slots[i].len = len;
+	idx->slots[i].node = node;
+}
+
+static int fdt_index_phandle_cmp(const void *a, const void *b)
+{
+	const struct fdt_index_phandle *pa = a, *pb = b;
+
+	if (pa->phandle != pb->phandle)
+		return pa->phandle < pb->phandle ? -1 : 1;
+
+	return pa->offset - pb->offset;
+}
+
+static int fdt_index_compat_cmp(const void *a, const void *b)
+{
+	const struct fdt_index_compat *ca = a, *cb = b;
+	int ret;
+
+	ret = strcmp(ca->str, cb->str);
+	if (ret)
+		return ret;
+
+	return ca->offset - cb->offset;
+}
+
+/*
+ * Get the phandle and compatible strings of a node in one pass over its
+ * properties, with the same result as fdt_get_phandle() and
+ * fdt_stringlist_count()
+ */
+static u32 fdt_index_scan_node(const void *fdt, int offset,
+			       const char **compatp, int *countp)
+{
+	const fdt32_t *php = NULL, *linux_php = NULL;
+	int prop;
+
+	*compatp = NULL;
+	*countp = 0;
+	fdt_for_each_property_offset(prop, fdt, offset) {
+		const char *name, *val;
+		int len, i;
+
+		val = fdt_getprop_by_offset(fdt, prop, &name, &len);
+		if (!val)
+			continue;
+		if (!*compatp && !strcmp(name, "compatible")) {
+			*compatp = val;
+			if (len && !val[len - 1]) {
+				for (i = 0; i < len; i++)
+					*countp += !val[i];
+			}
+		} else if (len == sizeof(fdt32_t)) {
+			if (!php && !strcmp(name, "phandle"))
+				php = (const fdt32_t *)val;
+			else if (!linux_php && !strcmp(name, "linux,phandle"))
+				linux_php = (const fdt32_t *)val;
+		}
+	}
+	if (!php)
+		php = linux_php;
+
+	return php ? fdt32_to_cpu(*php) : 0;
+}
+
+static void fdt_index_free(void)
+{
+	struct fdt_index *idx = gd->fdt_index;
+
+	if (idx && !(idx->early && (gd->flags & GD_FLG_FULL_MALLOC_INIT)))
+		free(idx);
+	gd->fdt_index = NULL;
+}
+
+void fdt_index_invalidate(const void *fdt)
+{
+	if (gd->fdt_index && gd->fdt_index->fdt == fdt)
+		fdt_index_free();
+}
+
+int fdt_index_build(const void *fdt)
+{
+	int node_count = 0, key_count = 0, phandle_count = 0, compat_count = 0;
+	int stack[MAX_DEPTH];
+	struct fdt_index *idx;
+	int offset, depth, node, nph, ncompat;
+	uint slots;
+	void *ptr;
+
+	fdt_index_free();
+	if (!fdt || fdt_check_header(fdt))
+		return -EINVAL;
+
+	/* count everything so that the index can be a single allocation */
+	for (offset = 0, depth = 0; offset >= 0 && depth >= 0;
+	     offset = fdt_next_node(fdt, offset, &depth)) {
+		const char *name, *str;
+		int len, count;
+
+		if (depth >= MAX_DEPTH)
+			return log_msg_ret("dep", -E2BIG);
+		name = fdt_get_name(fdt, offset, &len);
+		if (!name)
+			return log_msg_ret("nam", -EINVAL);
+		node_count++;
+		key_count += memchr(name, '@', len) ? 2 : 1;
+		if (fdt_index_scan_node(fdt, offset, &str, &count))
+			phandle_count++;
+		compat_count += count;
+	}
+	if (offset < 0)
+		return log_msg_ret("nxt", -EINVAL);
+
+	/* keep the hash table at most half full */
+	slots = __roundup_pow_of_two(key_count * 2);
+	idx = malloc(sizeof(*idx) +
+		     compat_count * sizeof(struct fdt_index_compat) +
+		     slots * sizeof(struct fdt_index_slot) +
+		     phandle_count * sizeof(struct fdt_index_phandle) +
+		     node_count * 2 * sizeof(int));
+	if (!idx)
+		return log_msg_ret("idx", -ENOMEM);
+	ptr = idx + 1;
+	idx->compats = ptr;
+	ptr += compat_count * sizeof(struct fdt_index_compat);
+	idx->slots = ptr;
+	ptr += slots * sizeof(struct fdt_index_slot);
+	idx->phandles = ptr;
+	ptr += phandle_count * sizeof(struct fdt_index_phandle);
+	idx->offsets = ptr;
+	idx->parents = idx->offsets + node_count;
+	memset(idx->slots, '\xff', slots * sizeof(struct fdt_index_slot));
+	idx->slot_mask = slots - 1;
+	idx->fdt = fdt;
+	idx->node_count = node_count;
+	idx->phandle_count = phandle_count;
+	idx->compat_count = compat_count;
+
+	node = 0;
+	nph = 0;
+	ncompat = 0;
+	for (offset = 0, depth = 0; offset >= 0 && depth >= 0;
+	     offset = fdt_next_node(fdt, offset, &depth), node++) {
+		const char *name, *at, *str;
+		int len, count;
+		u32 phandle;
+
+		idx->offsets[node] = offset;
+		idx->parents[node] = depth ? stack[depth - 1] : -1;
+		stack[depth] = node;
+		if (depth) {
+			name = fdt_get_name(fdt, offset, &len);
+			fdt_index_add_child(idx, idx->parents[node], node, name,
+					    len);
+			at = memchr(name, '@', len);
+			if (at)
+				fdt_index_add_child(idx, idx->parents[node],
+						    node, name, at - name);
+		}
+
+		phandle = fdt_index_scan_node(fdt, offset, &str, &count);
+		if (phandle) {
+			idx->phandles[nph].phandle = phandle;
+			idx->phandles[nph++].offset = offset;
+		}
+		for (; count; count--, str += strlen(str) + 1) {
+			idx->compats[ncompat].str = str;
+			idx->compats[ncompat++].offset = offset;
+		}
+	}
+	qsort(idx->phandles, phandle_count, sizeof(struct fdt_index_phandle),
+	      fdt_index_phandle_cmp);
+	qsort(idx->compats, compat_count, sizeof(struct fdt_index_compat),
+	      fdt_index_compat_cmp);
+
+	node = fdt_index_child(idx, 0, "aliases", strlen("aliases"));
+	idx->aliases = node < 0 ? -1 : idx->offsets[node];
+	idx->off_struct = fdt_off_dt_struct(fdt);
+	idx->size_struct = fdt_size_dt_struct(fdt);
+	idx->size_strings = fdt_size_dt_strings(fdt);
+	idx->early = !(gd->flags & GD_FLG_FULL_MALLOC_INIT);
+	gd->fdt_index = idx;
+	log_debug("Indexed %d nodes, %d phandles, %d compatible strings\n",
+		  node_count, phandle_count, compat_count);
+
+	return 0;
+}
+
+int fdt_index_node_offset_by_phandle(const void *fdt, uint32_t phandle)
+{
+	struct fdt_index *idx;
+	int lo, hi;
+
+	if (!phandle || phandle == ~0U)
+		return -FDT_ERR_BADPHANDLE;
+	idx = fdt_index_get(fdt);
+	if (!idx)
+		return fdt_node_offset_by_phandle(fdt, phandle);
+
+	lo = 0;
+	hi = idx->phandle_count;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (idx->phandles[mid].phandle < phandle)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < idx->phandle_count && idx->phandles[lo].phandle == phandle)
+		return idx->phandles[lo].offset;
+
+	return -FDT_ERR_NOTFOUND;
+}
+
+int fdt_index_path_offset(const void *fdt, const char *path)
+{
+	struct fdt_index *idx = fdt_index_get(fdt);
+	const char *end, *p = path;
+	int node = 0;
+
+	if (!idx)
+		return fdt_path_offset(fdt, path);
+
+	end = path + strlen(path);
+	if (*path != '/') {
+		const char *q = memchr(path, '/', end - p);
+		const char *alias = NULL;
+
+		if (!q)
+			q = end;
+		if (idx->aliases >= 0)
+			alias = fdt_getprop_namelen(fdt, idx->aliases, p, q - p,
+						    NULL);
+		if (!alias)
+			return -FDT_ERR_BADPATH;
+		node = fdt_index_node(idx, fdt_index_path_offset(fdt, alias));
+
+		/* leave aliases to missing nodes to libfdt */
+		if (node < 0)
+			return fdt_path_offset(fdt, path);
+		p = q;
+	}
+
+	while (p < end) {
+		const char *q;
+
+		while (*p == '/') {
+			p++;
+			if (p == end)
+				return idx->offsets[node];
+		}
+		q = memchr(p, '/', end - p);
+		if (!q)
+			q = end;
+
+		node = fdt_index_child(idx, node, p, q - p);
+		if (node < 0)
+			return -FDT_ERR_NOTFOUND;
+
+		p = q;
+	}
+
+	return idx->offsets[node];
+}
+
+int fdt_index_subnode_offset(const void *fdt, int parentoffset,
+			     const char *name)
+{
+	struct fdt_index *idx = fdt_index_get(fdt);
+	int parent, node;
+
+	parent = idx ? fdt_index_node(idx, parentoffset) : -1;
+	if (parent < 0)
+		return fdt_subnode_offset(fdt, parentoffset, name);
+
+	node = fdt_index_child(idx, parent, name, strlen(name));
+	if (node < 0)
+		return -FDT_ERR_NOTFOUND;
+
+	return idx->offsets[node];
+}
+
+int fdt_index_node_offset_by_compatible(const void *fdt, int startoffset,
+					const char *compatible)
+{
+	struct fdt_index *idx = fdt_index_get(fdt);
+	int lo, hi;
+
+	if (!idx || (startoffset >= 0 && fdt_index_node(idx, startoffset) < 0))
+		return fdt_node_offset_by_compatible(fdt, startoffset,
+						     compatible);
+
+	/* find the first entry for @compatible after @startoffset */
+	lo = 0;
+	hi = idx->compat_count;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		int ret = strcmp(idx->compats[mid].str, compatible);
+
+		if (ret < 0 || (!ret && idx->compats[mid].offset <= startoffset))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < idx->compat_count && !strcmp(idx->compats[lo].str, compatible))
+		return idx->compats[lo].offset;
+
+	return -FDT_ERR_NOTFOUND;
+}
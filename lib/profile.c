@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Sampling profiler, driven by a timer interrupt
+ *
+ * Each sample records the offset into U-Boot's code of the address which was
+ * being executed and of the return address of that function. The samples are
+ * written out in the same format as the function trace, so proftool can look
+ * up the function names in System.map
+ */
+
+#include <malloc.h>
+#include <profile.h>
+#include <trace.h>
+#include <linux/compiler.h>
+#include <linux/errno.h>
+#include <asm/global_data.h>
+#include <asm/sections.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/**
+ * struct profile_info - state of the sampling profiler
+ *
+ * @buf: Buffer holding the samples
+ * @size: Number of samples which fit in @buf
+ * @count: Number of samples in @buf
+ * @dropped: Number of samples dropped since @buf was full
+ * @outside: Number of samples taken outside U-Boot's code, which are not stored
+ * @freq: Number of samples taken each second
+ * @running: true if samples are being taken
+ */
+struct profile_info {
+	struct trace_sample *buf;
+	uint size;
+	uint count;
+	uint dropped;
+	uint outside;
+	uint freq;
+	bool running;
+};
+
+static struct profile_info info;
+
+/* Work out the offset of an address into U-Boot's code, as trace.c does */
+static ulong notrace addr_to_offset(ulong addr)
+{
+#ifdef CONFIG_SANDBOX
+	return addr - (ulong)_init;
+#else
+	if (gd->flags & GD_FLG_RELOC)
+		return addr - gd->relocaddr;
+
+	return addr - CONFIG_TEXT_BASE;
+#endif
+}
+
+void notrace profile_sample(ulong pc, ulong caller)
+{
+	struct trace_sample *sample;
+	ulong offset;
+
+	if (!info.running)
+		return;
+	offset = addr_to_offset(pc);
+	if (offset >= gd->mon_len) {
+		info.outside++;
+		return;
+	}
+	if (info.count == info.size) {
+		info.dropped++;
+		return;
+	}
+	sample = &info.buf[info.count];
+	sample->pc = offset;
+	offset = addr_to_offset(caller);
+	sample->caller = caller && offset < gd->mon_len ? offset :
+		TRACE_SAMPLE_NO_CALLER;
+
+	/* the sample must be complete before it is counted */
+	barrier();
+	info.count++;
+}
+
+int profile_start(uint freq)
+{
+	int ret;
+
+	if (info.running)
+		return -EALREADY;
+	if (!freq)
+		return -EINVAL;
+	if (!info.buf) {
+		info.buf = malloc(CONFIG_PROFILE_BUFFER_SIZE);
+		if (!info.buf)
+			return -ENOMEM;
+		info.size = CONFIG_PROFILE_BUFFER_SIZE / sizeof(*info.buf);
+	}
+	info.count = 0;
+	info.dropped = 0;
+	info.outside = 0;
+	info.freq = freq;
+	info.running = true;
+	ret = arch_profile_start(freq);
+	if (ret) {
+		info.running = false;
+		return ret;
+	}
+
+	return 0;
+}
+
+int profile_stop(void)
+{
+	if (!info.running)
+		return -EALREADY;
+	arch_profile_stop();
+	info.running = false;
+
+	return 0;
+}
+
+void profile_print_stats(void)
+{
+	if (!info.buf) {
+		printf("No samples taken\n");
+		return;
+	}
+	printf("Sampling %s at %u Hz\n", info.running ? "running" : "stopped",
+	       info.freq);
+	print_grouped_ull(info.count, 10);
+	puts(" samples recorded\n");
+	print_grouped_ull(info.outside, 10);
+	puts(" samples outside U-Boot\n");
+	print_grouped_ull(info.dropped, 10);
+	puts(" samples dropped due to overflow\n");
+	print_grouped_ull(info.size, 10);
+	puts(" max samples\n");
+}
+
+int profile_list_samples(void *buff, size_t buff_size, size_t *needed)
+{
+	struct trace_output_hdr *output_hdr = NULL;
+	void *end, *ptr = buff;
+	uint count, stored;
+
+	end = buff ? buff + buff_size : NULL;
+	if (ptr + sizeof(struct trace_output_hdr) <= end)
+		output_hdr = ptr;
+	ptr += sizeof(struct trace_output_hdr);
+
+	/* samples may still be arriving, so only take the ones there now */
+	count = READ_ONCE(info.count);
+	stored = 0;
+	if (ptr < end)
+		stored = min_t(size_t, count, (end - ptr) / sizeof(*info.buf));
+	if (stored)
+		memcpy(ptr, info.buf, stored * sizeof(*info.buf));
+	ptr += count * sizeof(*info.buf);
+
+	if (output_hdr) {
+		memset(output_hdr, '\0', sizeof(*output_hdr));
+		output_hdr->type = TRACE_CHUNK_SAMPLES;
+		output_hdr->version = TRACE_VERSION;
+		output_hdr->rec_count = stored;
+		output_hdr->spare = info.freq;
+		output_hdr->text_base = CONFIG_TEXT_BASE;
+	}
+
+	*needed = ptr - buff;
+	if (ptr > end)
+		return -ENOSPC;
+
+	return 0;
+}
+
+__weak int arch_profile_start(uint freq)
+{
+	return -ENOSYS;
+}
+
+__weak void arch_profile_stop(void)
+{
+}
@@ -119,6 +119,11 @@ bool uthread_schedule(void)
 	return false;
 }
 
+struct uthread *uthread_self(void)
+{
+	return current;
+}
+
 unsigned int uthread_grp_new_id(void)
 {
 	static unsigned int id;
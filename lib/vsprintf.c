@@ -622,7 +622,9 @@ repeat:
 				while (--field_width > 0)
 					ADDCH(str, ' ');
 			}
-			ADDCH(str, (unsigned char) va_arg(args, int));
+			/* always use up the argument, even if there is no room */
+			num = (unsigned char)va_arg(args, int);
+			ADDCH(str, num);
 			while (--field_width > 0)
 				ADDCH(str, ' ');
 			continue;
@@ -435,6 +435,43 @@ int eth_send(void *packet, int length)
 	return ret;
 }
 
+/*
+ * Receive packets a batch at a time, until the driver has no more or a whole
+ * receive pool has been processed. Returns -ENOSYS if the driver cannot do this
+ */
+static int eth_rx_batch(struct udevice *current)
+{
+	struct eth_ops *ops = eth_get_ops(current);
+	struct eth_rx_desc descs[ETH_PACKETS_BATCH_RECV];
+	int total = 0;
+	int flags;
+	int ret;
+	int i;
+
+	flags = ETH_RECV_CHECK_DEVICE;
+	do {
+		ret = ops->recv_batch(current, flags, descs,
+				      ETH_PACKETS_BATCH_RECV);
+		flags = 0;
+		if (ret <= 0)
+			break;
+		for (i = 0; i < ret; i++) {
+			if (descs[i].length > 0)
+				net_process_received_packet(descs[i].packet,
+							    descs[i].length);
+			if (!eth_is_active(current)) {
+				ops->free_batch(current, descs, i + 1);
+				return 0;
+			}
+		}
+		ops->free_batch(current, descs, ret);
+		total += ret;
+	} while (ret == ETH_PACKETS_BATCH_RECV &&
+		 total < max(PKTBUFSRX, ETH_PACKETS_BATCH_RECV));
+
+	return ret;
+}
+
 int eth_rx(void)
 {
 	struct udevice *current;
@@ -450,6 +487,12 @@ int eth_rx(void)
 	if (!eth_is_active(current))
 		return -EINVAL;
 
+	if (eth_get_ops(current)->recv_batch) {
+		ret = eth_rx_batch(current);
+		if (ret != -ENOSYS)
+			goto done;
+	}
+
 	/* Process up to 32 packets at one time */
 	flags = ETH_RECV_CHECK_DEVICE;
 	for (i = 0; i < ETH_PACKETS_BATCH_RECV; i++) {
@@ -464,6 +507,7 @@ int eth_rx(void)
 		if (!eth_is_active(current))
 			break;
 	}
+done:
 	if (ret == -EAGAIN)
 		ret = 0;
 	if (ret < 0) {
@@ -105,6 +105,7 @@
 #if defined(CONFIG_CMD_PCAP)
 #include <net/pcap.h>
 #endif
+#include <net/sink.h>
 #include <net/tcp.h>
 #include <net/tftp.h>
 #include <net/udp.h>
@@ -760,6 +761,7 @@ done:
 #ifdef CONFIG_USB_KEYBOARD
 	net_busy_flag = 0;
 #endif
+	net_sink_end();
 #ifdef CONFIG_CMD_TFTPPUT
 	/* Clear out the handlers */
 	net_set_udp_handler(NULL);
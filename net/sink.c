@@ -0,0 +1,244 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Writing network downloads to storage as they arrive
+ */
+
+#include <blk.h>
+#include <lmb.h>
+#include <log.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <memalign.h>
+#include <part.h>
+#include <vsprintf.h>
+#include <net/sink.h>
+
+/* Number of chunks in the staging buffer */
+#define SINK_CHUNKS	4
+
+/**
+ * struct sink_blk - block device which a download is written to
+ *
+ * @desc: Block device
+ * @start: First block of the partition, or 0 for the whole device
+ * @count: Number of blocks in the partition or device
+ * @name: Name of the device and partition, for messages
+ */
+struct sink_blk {
+	struct blk_desc *desc;
+	lbaint_t start;
+	lbaint_t count;
+	char name[32];
+};
+
+static struct net_sink *sink;
+static ulong sink_buf_size;
+static bool sink_started;
+
+/* Staging buffer, used as a ring of SINK_CHUNKS chunks */
+static ulong sink_addr;
+static ulong sink_chunk;
+static ulong sink_ring;
+/* Number of bytes from the start of the file passed to the sink so far */
+static ulong sink_written;
+
+static struct sink_blk sink_blk;
+
+void net_sink_set(struct net_sink *new_sink, ulong buf_size)
+{
+	sink = new_sink;
+	sink_buf_size = buf_size;
+	sink_started = false;
+}
+
+struct net_sink *net_sink_get(void)
+{
+	return sink;
+}
+
+int net_sink_start(ulong addr)
+{
+	ulong size = sink_buf_size ?: CONFIG_NET_SINK_BUF_SIZE;
+
+	sink_chunk = rounddown(size / SINK_CHUNKS, sink->align);
+	if (!sink_chunk) {
+		printf("\nnet sink: buffer of %lx bytes is too small\n", size);
+		return -EINVAL;
+	}
+	sink_ring = sink_chunk * SINK_CHUNKS;
+	if (CONFIG_IS_ENABLED(LMB) && lmb_read_check(addr, sink_ring)) {
+		printf("\nnet sink: buffer overlaps reserved memory\n");
+		return -EFAULT;
+	}
+	sink_addr = addr;
+	sink_written = 0;
+	sink_started = true;
+
+	return 0;
+}
+
+ulong net_sink_window(void)
+{
+	/* up to a chunk may be complete but not written out yet */
+	return sink_ring - sink_chunk;
+}
+
+int net_sink_store(ulong offset, const void *src, ulong len)
+{
+	ulong pos, n;
+	void *ptr;
+
+	/* skip anything which has been written already */
+	if (offset + len <= sink_written)
+		return 0;
+	if (offset < sink_written) {
+		src += sink_written - offset;
+		len -= sink_written - offset;
+		offset = sink_written;
+	}
+	if (offset + len > sink_written + sink_ring)
+		return -ENOSPC;
+
+	while (len) {
+		pos = offset % sink_ring;
+		n = min(len, sink_ring - pos);
+		ptr = map_sysmem(sink_addr + pos, n);
+		memcpy(ptr, src, n);
+		unmap_sysmem(ptr);
+		offset += n;
+		src += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* Pass the next @len bytes of the file to the sink */
+static int sink_write(ulong len)
+{
+	void *ptr;
+	int ret;
+
+	ptr = map_sysmem(sink_addr + sink_written % sink_ring, len);
+	ret = sink->write(sink, sink_written, ptr, len);
+	unmap_sysmem(ptr);
+	if (ret == -EFBIG)
+		printf("\nnet sink: file does not fit in %s\n", sink->name);
+	else if (ret)
+		printf("\nnet sink: error %d writing to %s at %lx\n", ret,
+		       sink->name, sink_written);
+	if (ret)
+		return ret;
+	sink_written += len;
+
+	return 0;
+}
+
+int net_sink_advance(ulong size)
+{
+	int ret;
+
+	if (!sink_started)
+		return 0;
+	while (size >= sink_written + sink_chunk) {
+		ret = sink_write(sink_chunk);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+int net_sink_finish(ulong size)
+{
+	int ret;
+
+	ret = net_sink_advance(size);
+	if (ret)
+		return ret;
+	if (size > sink_written) {
+		ret = sink_write(size - sink_written);
+		if (ret)
+			return ret;
+	}
+	if (sink->finish) {
+		ret = sink->finish(sink, size);
+		if (ret) {
+			printf("\nnet sink: error %d finishing %s\n", ret,
+			       sink->name);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+void net_sink_end(void)
+{
+	if (sink_started)
+		net_sink_set(NULL, 0);
+}
+
+static int sink_blk_write(struct net_sink *blk_sink, ulong offset,
+			  const void *buf, ulong len)
+{
+	struct sink_blk *blk = blk_sink->priv;
+	struct blk_desc *desc = blk->desc;
+	lbaint_t lba = offset / desc->blksz;
+	lbaint_t count = len / desc->blksz;
+	ulong tail = len % desc->blksz;
+	void *block;
+	int ret = 0;
+
+	if (lba + count + !!tail > blk->count)
+		return -EFBIG;
+	if (count && blk_dwrite(desc, blk->start + lba, count, buf) != count)
+		return -EIO;
+	if (!tail)
+		return 0;
+
+	/* keep whatever follows the end of the file in its last block */
+	block = malloc_cache_aligned(desc->blksz);
+	if (!block)
+		return -ENOMEM;
+	lba += count;
+	if (blk_dread(desc, blk->start + lba, 1, block) != 1) {
+		ret = -EIO;
+		goto out;
+	}
+	memcpy(block, buf + count * desc->blksz, tail);
+	if (blk_dwrite(desc, blk->start + lba, 1, block) != 1)
+		ret = -EIO;
+out:
+	free(block);
+
+	return ret;
+}
+
+static struct net_sink sink_blk_ops = {
+	.write = sink_blk_write,
+	.priv = &sink_blk,
+};
+
+int net_sink_set_blk(const char *ifname, const char *dev_part_str,
+		     ulong buf_size)
+{
+	struct disk_partition info;
+	struct blk_desc *desc;
+	int part;
+
+	part = blk_get_device_part_str(ifname, dev_part_str, &desc, &info, 1);
+	if (part < 0)
+		return -ENODEV;
+
+	sink_blk.desc = desc;
+	sink_blk.start = info.start;
+	sink_blk.count = info.size;
+	snprintf(sink_blk.name, sizeof(sink_blk.name), "%s %s", ifname,
+		 dev_part_str);
+	sink_blk_ops.name = sink_blk.name;
+	sink_blk_ops.align = desc->blksz;
+	net_sink_set(&sink_blk_ops, buf_size);
+
+	return 0;
+}
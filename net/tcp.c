@@ -36,7 +36,9 @@
 #define TCP_SEND_RETRY		3
 #define TCP_SEND_TIMEOUT	2000UL
 #define TCP_RX_INACTIVE_TIMEOUT	30000UL
-#if PKTBUFSRX != 0
+#if CONFIG_PROT_TCP_RCV_WND
+  #define TCP_RCV_WND_SIZE	(CONFIG_PROT_TCP_RCV_WND * 1024)
+#elif PKTBUFSRX != 0
   #define TCP_RCV_WND_SIZE	(PKTBUFSRX * TCP_MSS)
 #else
   #define TCP_RCV_WND_SIZE	(4 * TCP_MSS)
@@ -45,7 +47,10 @@
 #define TCP_PACKET_OK		0
 #define TCP_PACKET_DROP		1
 
-static struct tcp_stream tcp_stream;
+/* Acknowledge at least every second segment, see RFC 5681 section 4.2 */
+#define TCP_DELACK_SEGS		2
+
+static struct tcp_stream tcp_streams[CONFIG_PROT_TCP_MAX_STREAMS];
 
 static int (*tcp_stream_on_create)(struct tcp_stream *tcp);
 
@@ -97,6 +102,38 @@ static inline ulong msec_to_ticks(ulong msec)
 	return msec * CONFIG_SYS_HZ / 1000;
 }
 
+/**
+ * tcp_wnd_shift() - get the window scale needed to offer a window
+ * @wnd: window size in bytes
+ *
+ * Return: smallest shift which makes @wnd fit in the 16-bit window field
+ */
+static u8 tcp_wnd_shift(u32 wnd)
+{
+	u8 shift = 0;
+
+	while (shift < TCP_MAX_SCALE && (wnd >> shift) > 0xffff)
+		shift++;
+
+	return shift;
+}
+
+/**
+ * tcp_sack_len() - get the length of the SACK option to send
+ * @tcp: tcp stream
+ *
+ * Return: length of the SACK option in bytes, 0 if there is nothing to report
+ */
+static int tcp_sack_len(struct tcp_stream *tcp)
+{
+	int cnt = (tcp->lost.len - TCP_OPT_LEN_2) / TCP_OPT_LEN_8;
+
+	if (!IS_ENABLED(CONFIG_PROT_TCP_SACK) || cnt <= 0)
+		return 0;
+
+	return TCP_OPT_LEN_2 + min(cnt, TCP_SACK_SEND) * TCP_OPT_LEN_8;
+}
+
 /**
  * tcp_stream_get_state() - get TCP stream state
  * @tcp: tcp stream
@@ -172,17 +209,20 @@ static void tcp_stream_destroy(struct tcp_stream *tcp)
 void tcp_init(void)
 {
 	static int initialized;
-	struct tcp_stream *tcp = &tcp_stream;
+	struct tcp_stream *tcp;
 
 	tcp_stream_on_create = NULL;
 	if (!initialized) {
 		initialized = 1;
-		memset(tcp, 0, sizeof(struct tcp_stream));
+		memset(tcp_streams, 0, sizeof(tcp_streams));
 	}
 
-	tcp_stream_set_state(tcp, TCP_CLOSED);
-	tcp_stream_set_status(tcp, TCP_ERR_RST);
-	tcp_stream_destroy(tcp);
+	for (tcp = tcp_streams; tcp < tcp_streams + ARRAY_SIZE(tcp_streams);
+	     tcp++) {
+		tcp_stream_set_state(tcp, TCP_CLOSED);
+		tcp_stream_set_status(tcp, TCP_ERR_RST);
+		tcp_stream_destroy(tcp);
+	}
 }
 
 void tcp_stream_set_on_create_handler(int (*on_create)(struct tcp_stream *))
@@ -193,27 +233,49 @@ void tcp_stream_set_on_create_handler(int (*on_create)(struct tcp_stream *))
 static struct tcp_stream *tcp_stream_add(struct in_addr rhost,
 					 u16 rport, u16 lport)
 {
-	struct tcp_stream *tcp = &tcp_stream;
+	struct tcp_stream *tcp;
 
-	if (!tcp_stream_on_create ||
-	    tcp->state != TCP_CLOSED)
+	if (!tcp_stream_on_create)
 		return NULL;
 
-	tcp_stream_init(tcp, rhost, rport, lport);
-	if (!tcp_stream_on_create(tcp))
-		return NULL;
+	for (tcp = tcp_streams; tcp < tcp_streams + ARRAY_SIZE(tcp_streams);
+	     tcp++) {
+		if (tcp->state != TCP_CLOSED)
+			continue;
 
-	return tcp;
+		tcp_stream_init(tcp, rhost, rport, lport);
+		if (!tcp_stream_on_create(tcp))
+			return NULL;
+
+		return tcp;
+	}
+
+	return NULL;
+}
+
+static struct tcp_stream *tcp_stream_find(struct in_addr rhost,
+					  u16 rport, u16 lport)
+{
+	struct tcp_stream *tcp;
+
+	for (tcp = tcp_streams; tcp < tcp_streams + ARRAY_SIZE(tcp_streams);
+	     tcp++) {
+		if (tcp->rhost.s_addr == rhost.s_addr &&
+		    tcp->rport == rport &&
+		    tcp->lport == lport)
+			return tcp;
+	}
+
+	return NULL;
 }
 
 struct tcp_stream *tcp_stream_get(int is_new, struct in_addr rhost,
 				  u16 rport, u16 lport)
 {
-	struct tcp_stream *tcp = &tcp_stream;
+	struct tcp_stream *tcp;
 
-	if (tcp->rhost.s_addr == rhost.s_addr &&
-	    tcp->rport == rport &&
-	    tcp->lport == lport)
+	tcp = tcp_stream_find(rhost, rport, lport);
+	if (tcp)
 		return tcp;
 
 	return is_new ? tcp_stream_add(rhost, rport, lport) : NULL;
@@ -282,6 +344,8 @@ static void tcp_send_packet(struct tcp_stream *tcp, u8 action,
 			    u32 tcp_seq_num, u32 tcp_ack_num, u32 tx_len)
 {
 	tcp->tx_packets++;
+	if (action & TCP_ACK)
+		tcp->ack_pending = 0;
 	net_send_tcp_packet(tx_len, tcp->rhost, tcp->rport,
 			    tcp->lport, action, tcp_seq_num,
 			    tcp_ack_num);
@@ -307,7 +371,7 @@ static void tcp_send_repeat(struct tcp_stream *tcp)
 
 	if (tcp->retry_tx_len > 0) {
 		tcp_opts_size = ROUND_TCPHDR_BYTES(TCP_TSOPT_SIZE +
-						   tcp->lost.len);
+						   tcp_sack_len(tcp));
 		ptr = net_tx_packet + net_eth_hdr_size() +
 			IP_TCP_HDR_SIZE + tcp_opts_size;
 
@@ -362,7 +426,7 @@ static void tcp_steam_tx_try(struct tcp_stream *tcp)
 	    !tcp->tx)
 		return;
 
-	tcp_opts_size = ROUND_TCPHDR_BYTES(TCP_TSOPT_SIZE + tcp->lost.len);
+	tcp_opts_size = ROUND_TCPHDR_BYTES(TCP_TSOPT_SIZE + tcp_sack_len(tcp));
 	tx_len = TCP_MSS - tcp_opts_size;
 	if (tcp->fin_tx) {
 		/* do not try to send beyonds FIN packet limits */
@@ -426,6 +490,11 @@ static void tcp_stream_poll(struct tcp_stream *tcp, ulong time)
 	}
 
 	tcp_steam_tx_try(tcp);
+
+	/* acknowledge what was left over from the last received packets */
+	if (tcp->ack_pending && tcp->state != TCP_CLOSED)
+		tcp_send_packet(tcp, tcp_stream_fin_needed(tcp, tcp->snd_una) |
+				TCP_ACK, tcp->snd_una, tcp->rcv_nxt, 0);
 }
 
 void tcp_streams_poll(void)
@@ -434,8 +503,9 @@ void tcp_streams_poll(void)
 	struct tcp_stream	*tcp;
 
 	time = get_timer(0);
-	tcp = &tcp_stream;
-	tcp_stream_poll(tcp, time);
+	for (tcp = tcp_streams; tcp < tcp_streams + ARRAY_SIZE(tcp_streams);
+	     tcp++)
+		tcp_stream_poll(tcp, time);
 }
 
 /**
@@ -485,6 +555,9 @@ u16 tcp_set_pseudo_header(uchar *pkt, struct in_addr src, struct in_addr dest,
  */
 int net_set_ack_options(struct tcp_stream *tcp, union tcp_build_pkt *b)
 {
+	struct sack_edges *hill = tcp->lost.hill;
+	int i, n, cnt, first, sack_len;
+
 	b->sack.hdr.tcp_hlen = SHIFT_TO_TCPHDRLEN_FIELD(LEN_B_TO_DW(TCP_HDR_SIZE));
 
 	b->sack.t_opt.kind = TCP_O_TS;
@@ -495,31 +568,42 @@ int net_set_ack_options(struct tcp_stream *tcp, union tcp_build_pkt *b)
 	b->sack.sack_v.len = 0;
 
 	if (IS_ENABLED(CONFIG_PROT_TCP_SACK)) {
-		if (tcp->lost.len > TCP_OPT_LEN_2) {
+		sack_len = tcp_sack_len(tcp);
+		if (sack_len) {
 			debug_cond(DEBUG_DEV_PKT, "TCP ack opt lost.len %x\n",
 				   tcp->lost.len);
-			b->sack.sack_v.len = tcp->lost.len;
+			b->sack.sack_v.len = sack_len;
 			b->sack.sack_v.kind = TCP_V_SACK;
-			b->sack.sack_v.hill[0].l = htonl(tcp->lost.hill[0].l);
-			b->sack.sack_v.hill[0].r = htonl(tcp->lost.hill[0].r);
 
 			/*
-			 * These SACK structures are initialized with NOPs to
-			 * provide TCP header alignment padding. There are 4
-			 * SACK structures used for both header padding and
-			 * internally.
+			 * The first block must hold the segment which arrived
+			 * last (RFC 2018 section 4), the others follow in
+			 * sequence order. Hills beyond TCP_SACK_SEND are still
+			 * tracked, but not reported until earlier ones are
+			 * filled.
 			 */
-			b->sack.sack_v.hill[1].l = htonl(tcp->lost.hill[1].l);
-			b->sack.sack_v.hill[1].r = htonl(tcp->lost.hill[1].r);
-			b->sack.sack_v.hill[2].l = htonl(tcp->lost.hill[2].l);
-			b->sack.sack_v.hill[2].r = htonl(tcp->lost.hill[2].r);
-			b->sack.sack_v.hill[3].l = TCP_O_NOP;
-			b->sack.sack_v.hill[3].r = TCP_O_NOP;
+			cnt = (tcp->lost.len - TCP_OPT_LEN_2) / TCP_OPT_LEN_8;
+			for (first = cnt - 1; first > 0; first--) {
+				if (tcp_seq_cmp(tcp->sack_last, hill[first].l) >= 0)
+					break;
+			}
+
+			b->sack.sack_v.hill[0].l = htonl(hill[first].l);
+			b->sack.sack_v.hill[0].r = htonl(hill[first].r);
+			n = 1;
+			for (i = 0; n < (sack_len - TCP_OPT_LEN_2) / TCP_OPT_LEN_8;
+			     i++) {
+				if (i == first)
+					continue;
+				b->sack.sack_v.hill[n].l = htonl(hill[i].l);
+				b->sack.sack_v.hill[n].r = htonl(hill[i].r);
+				n++;
+			}
 		}
 
 		b->sack.hdr.tcp_hlen = SHIFT_TO_TCPHDRLEN_FIELD(ROUND_TCPHDR_LEN(TCP_HDR_SIZE +
 										 TCP_TSOPT_SIZE +
-										 tcp->lost.len));
+										 sack_len));
 	} else {
 		b->sack.sack_v.kind = 0;
 		b->sack.hdr.tcp_hlen = SHIFT_TO_TCPHDRLEN_FIELD(ROUND_TCPHDR_LEN(TCP_HDR_SIZE +
@@ -549,7 +633,7 @@ void net_set_syn_options(struct tcp_stream *tcp, union tcp_build_pkt *b)
 	b->ip.mss.len = TCP_OPT_LEN_4;
 	b->ip.mss.mss = htons(TCP_MSS);
 	b->ip.scale.kind = TCP_O_SCL;
-	b->ip.scale.scale = TCP_SCALE;
+	b->ip.scale.scale = tcp_wnd_shift(tcp->rcv_wnd);
 	b->ip.scale.len = TCP_OPT_LEN_3;
 	if (IS_ENABLED(CONFIG_PROT_TCP_SACK)) {
 		b->ip.sack_p.kind = TCP_P_SACK;
@@ -597,6 +681,7 @@ int tcp_set_tcp_header(struct tcp_stream *tcp, uchar *pkt, int payload_len,
 	int pkt_hdr_len;
 	int pkt_len;
 	int tcp_len;
+	u32 wnd;
 
 	/*
 	 * Header: 5 32 bit words. 4 bits TCP header Length,
@@ -655,8 +740,14 @@ int tcp_set_tcp_header(struct tcp_stream *tcp, uchar *pkt, int payload_len,
 	 * SOCs is may not be considered a constraint to buffer space, if
 	 * it is, then the u-boot tftp or nfs kernel netboot should be
 	 * considered.
+	 *
+	 * The window is only scaled once both sides agreed to it, which is
+	 * never the case for the SYN segments themselves (RFC 7323).
 	 */
-	b->ip.hdr.tcp_win = htons(tcp->rcv_wnd >> TCP_SCALE);
+	wnd = tcp->rcv_wnd;
+	if (!(action & TCP_SYN))
+		wnd >>= tcp->rcv_wnd_scale;
+	b->ip.hdr.tcp_win = htons(min_t(u32, wnd, 0xffff));
 
 	b->ip.hdr.tcp_xsum = 0;
 	b->ip.hdr.tcp_ugr = 0;
@@ -673,14 +764,16 @@ int tcp_set_tcp_header(struct tcp_stream *tcp, uchar *pkt, int payload_len,
 static void tcp_update_rcv_nxt(struct tcp_stream *tcp)
 {
 	if (tcp_seq_cmp(tcp->rcv_nxt, tcp->lost.hill[0].l) >= 0) {
-		tcp->rcv_nxt = tcp->lost.hill[0].r;
+		/* a retransmitted segment must not move rcv_nxt back */
+		if (tcp_seq_cmp(tcp->lost.hill[0].r, tcp->rcv_nxt) > 0)
+			tcp->rcv_nxt = tcp->lost.hill[0].r;
 
 		memmove(&tcp->lost.hill[0], &tcp->lost.hill[1],
-			(TCP_SACK_HILLS - 1) * sizeof(struct sack_edges));
+			(TCP_SACK_TRACK - 1) * sizeof(struct sack_edges));
 
 		tcp->lost.len -= TCP_OPT_LEN_8;
-		tcp->lost.hill[TCP_SACK_HILLS - 1].l = TCP_O_NOP;
-		tcp->lost.hill[TCP_SACK_HILLS - 1].r = TCP_O_NOP;
+		tcp->lost.hill[TCP_SACK_TRACK - 1].l = TCP_O_NOP;
+		tcp->lost.hill[TCP_SACK_TRACK - 1].r = TCP_O_NOP;
 	}
 }
 
@@ -727,11 +820,12 @@ void tcp_hole(struct tcp_stream *tcp, u32 tcp_seq_num, u32 len)
 			if (cnt > i + cnt_move + 1)
 				memmove(&tcp->lost.hill[i + 1],
 					&tcp->lost.hill[i + cnt_move + 1],
-					cnt_move * sizeof(struct sack_edges));
+					(cnt - i - cnt_move - 1) *
+					sizeof(struct sack_edges));
 
 			cnt -= cnt_move;
 			tcp->lost.len = TCP_OPT_LEN_2 + cnt * TCP_OPT_LEN_8;
-			for (j = cnt; j < TCP_SACK_HILLS; j++) {
+			for (j = cnt; j < TCP_SACK_TRACK; j++) {
 				tcp->lost.hill[j].l = TCP_O_NOP;
 				tcp->lost.hill[j].r = TCP_O_NOP;
 			}
@@ -741,17 +835,18 @@ void tcp_hole(struct tcp_stream *tcp, u32 tcp_seq_num, u32 len)
 		return;
 	}
 
-	if (i == TCP_SACK_HILLS) {
+	if (i == TCP_SACK_TRACK) {
 		tcp_update_rcv_nxt(tcp);
 		return;
 	}
 
-	if (cnt < TCP_SACK_HILLS) {
+	if (cnt < TCP_SACK_TRACK) {
 		cnt_move = cnt - i;
 		cnt++;
 	} else {
-		cnt = TCP_SACK_HILLS;
-		cnt_move = TCP_SACK_HILLS - i;
+		/* no room, so forget the hill furthest ahead */
+		cnt = TCP_SACK_TRACK;
+		cnt_move = TCP_SACK_TRACK - i - 1;
 	}
 
 	if (cnt_move > 0)
@@ -794,8 +889,17 @@ void tcp_parse_options(struct tcp_stream *tcp, uchar *o, int o_len)
 		case TCP_V_SACK:
 			break;
 		case TCP_O_SCL:
+			/*
+			 * Only the SYN-ACK answering our SYN counts. The SYN
+			 * which we answer is not considered, since our SYN-ACK
+			 * does not carry the option
+			 */
+			if (tcp->state != TCP_SYN_SENT)
+				break;
 			wsopt = (struct tcp_scale *)p;
-			tcp->rmt_win_scale = wsopt->scale;
+			tcp->rmt_win_scale = min_t(u8, wsopt->scale,
+						   TCP_MAX_SCALE);
+			tcp->rcv_wnd_scale = tcp_wnd_shift(tcp->rcv_wnd);
 			break;
 		case TCP_O_TS:
 			tsopt = (struct tcp_t_opt *)p;
@@ -920,7 +1024,7 @@ static int tcp_rx_check_ack_num(struct tcp_stream *tcp, u32 tcp_seq_num,
 static int tcp_rx_user_data(struct tcp_stream *tcp, u32 tcp_seq_num,
 			    char *buf, int len)
 {
-	int tmp_len;
+	int tmp_len, gap;
 	u32 buf_offs, old_offs, new_offs;
 	u8 action;
 
@@ -951,13 +1055,27 @@ static int tcp_rx_user_data(struct tcp_stream *tcp, u32 tcp_seq_num,
 			return TCP_PACKET_DROP;
 		}
 	}
-	if (tmp_len)
+	gap = tcp->lost.len > TCP_OPT_LEN_2;
+	if (tmp_len) {
+		tcp->sack_last = tcp_seq_num;
 		tcp_hole(tcp, tcp_seq_num, tmp_len);
+	}
 
 	new_offs = tcp_stream_rx_offs(tcp);
 	if (tcp->on_rcv_nxt_update && old_offs != new_offs)
 		tcp->on_rcv_nxt_update(tcp, new_offs);
 
+	/*
+	 * In-order data is acknowledged every TCP_DELACK_SEGS segments, what
+	 * is left is acknowledged by tcp_streams_poll() once all the packets
+	 * received together were handled. Anything around a gap is
+	 * acknowledged straight away, so the sender learns about losses
+	 * quickly.
+	 */
+	if (!gap && tcp->lost.len <= TCP_OPT_LEN_2 &&
+	    ++tcp->ack_pending < TCP_DELACK_SEGS)
+		return TCP_PACKET_OK;
+
 	action = tcp_stream_fin_needed(tcp, tcp->snd_una) | TCP_ACK;
 	tcp_send_packet(tcp, action, tcp->snd_una, tcp->rcv_nxt, 0);
 
@@ -974,6 +1092,7 @@ void tcp_rx_state_machine(struct tcp_stream *tcp,
 
 	tcp_hdr_len = GET_TCP_HDR_LEN_IN_BYTES(b->ip.hdr.tcp_hlen);
 	payload_len = tcp_len - tcp_hdr_len;
+	tcp_flags = b->ip.hdr.tcp_flags;
 
 	if (tcp_hdr_len > TCP_HDR_SIZE)
 		tcp_parse_options(tcp, (uchar *)b + IP_TCP_HDR_SIZE,
@@ -984,9 +1103,9 @@ void tcp_rx_state_machine(struct tcp_stream *tcp,
 	 */
 	tcp_seq_num = ntohl(b->ip.hdr.tcp_seq);
 	tcp_ack_num = ntohl(b->ip.hdr.tcp_ack);
-	tcp_win_size = ntohs(b->ip.hdr.tcp_win) << tcp->rmt_win_scale;
-
-	tcp_flags = b->ip.hdr.tcp_flags;
+	tcp_win_size = ntohs(b->ip.hdr.tcp_win);
+	if (!(tcp_flags & TCP_SYN))
+		tcp_win_size <<= tcp->rmt_win_scale;
 
 //	printf("pkt: seq=%d, ack=%d, flags=%x, len=%d\n",
 //		tcp_seq_num - tcp->irs, tcp_ack_num - tcp->iss, tcp_flags, pkt_len);
@@ -1211,8 +1330,15 @@ void rxhand_tcp_f(union tcp_build_pkt *b, unsigned int pkt_len)
 struct tcp_stream *tcp_stream_connect(struct in_addr rhost, u16 rport)
 {
 	struct tcp_stream *tcp;
+	uint lport;
+
+	/* streams opened within the same tick would get the same port */
+	lport = random_port();
+	while (tcp_stream_find(rhost, rport, lport))
+		lport = RANDOM_PORT_START +
+			(lport + 1 - RANDOM_PORT_START) % RANDOM_PORT_RANGE;
 
-	tcp = tcp_stream_add(rhost, rport, random_port());
+	tcp = tcp_stream_add(rhost, rport, lport);
 	if (!tcp)
 		return NULL;
 
@@ -16,7 +16,9 @@
 #include <mapmem.h>
 #include <net.h>
 #include <net6.h>
+#include <time.h>
 #include <asm/global_data.h>
+#include <net/sink.h>
 #include <net/tftp.h>
 #include "bootp.h"
 
@@ -95,6 +97,18 @@ static ushort	tftp_windowsize;
 static ushort	tftp_next_ack;
 /* Last nack block we send */
 static ushort	tftp_last_nack;
+/* Blocks after the next one which have already arrived, one bit per block */
+static u64	tftp_held;
+/* Number of the short block which ends the file, if it arrived early */
+static ushort	tftp_last_block;
+static bool	tftp_last_held;
+/* The end of the window has arrived, while a block before it is missing */
+static bool	tftp_window_end;
+/* Block acknowledged by the last ACK we sent, for measuring the round trip */
+static ushort	tftp_rtt_block;
+static bool	tftp_rtt_pending;
+static ulong	tftp_rtt_start;
+static struct tftp_stats tftp_stats;
 #ifdef CONFIG_CMD_TFTPPUT
 /* 1 if writing, else 0 */
 static int	tftp_put_active;
@@ -118,6 +132,12 @@ static int	tftp_put_final_block_sent;
 #define TFTP_MTU_BLOCKSIZE6 (CONFIG_TFTP_BLOCKSIZE - 20)
 /* sequence number is 16 bit */
 #define TFTP_SEQUENCE_SIZE	((ulong)(1<<16))
+/* Number of blocks after a missing one which can be kept until it arrives */
+#define TFTP_HOLD_MAX		64
+/* Time to wait for a missing block which may just be out of order */
+#define TFTP_REORDER_MS		2
+/* Timeouts after the OACK before trying again with a smaller block size */
+#define TFTP_ADAPT_TIMEOUTS	2
 
 #define DEFAULT_NAME_LEN	(8 + 4 + 1)
 static char default_filename[DEFAULT_NAME_LEN];
@@ -149,6 +169,17 @@ static char tftp_filename[MAX_LEN];
 static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = CONFIG_TFTP_BLOCKSIZE;
 static unsigned short tftp_window_size_option = TFTP_WINDOWSIZE;
+/* Block and window size asked for, which may be less than the options */
+static unsigned short tftp_block_size_req;
+static unsigned short tftp_window_size_req;
+/*
+ * With CONFIG_TFTP_ADAPTIVE, the block and window size learned from earlier
+ * transfers, along with the options they were learned for
+ */
+static unsigned short tftp_block_size_adapt;
+static unsigned short tftp_window_size_adapt;
+static unsigned short tftp_adapt_block_size_option;
+static unsigned short tftp_adapt_window_size_option;
 
 static inline int store_block(int block, uchar *src, unsigned int len)
 {
@@ -157,19 +188,26 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 	ulong newsize = offset + len;
 	ulong store_addr = tftp_load_addr + offset;
 	void *ptr;
+	int ret;
 
-	if (CONFIG_IS_ENABLED(LMB)) {
-		if (store_addr < tftp_load_addr ||
-		    lmb_read_check(store_addr, len)) {
-			puts("\nTFTP error: ");
-			puts("trying to overwrite reserved memory...\n");
-			return -1;
+	if (net_sink_active()) {
+		ret = net_sink_store(offset, src, len);
+		if (ret)
+			return ret;
+	} else {
+		if (CONFIG_IS_ENABLED(LMB)) {
+			if (store_addr < tftp_load_addr ||
+			    lmb_read_check(store_addr, len)) {
+				puts("\nTFTP error: ");
+				puts("trying to overwrite reserved memory...\n");
+				return -1;
+			}
 		}
-	}
 
-	ptr = map_sysmem(store_addr, len);
-	memcpy(ptr, src, len);
-	unmap_sysmem(ptr);
+		ptr = map_sysmem(store_addr, len);
+		memcpy(ptr, src, len);
+		unmap_sysmem(ptr);
+	}
 
 	if (net_boot_file_size < newsize)
 		net_boot_file_size = newsize;
@@ -277,9 +315,90 @@ static void update_block_number(void)
 	show_block_marker();
 }
 
+/* Work out the block and window size to ask for in the next request */
+static void tftp_adapt_request(void)
+{
+	tftp_block_size_req = tftp_block_size_option;
+	tftp_window_size_req = tftp_window_size_option;
+	if (!IS_ENABLED(CONFIG_TFTP_ADAPTIVE) || tftp_put_active)
+		return;
+
+	/* Start again from the options if the user has changed them */
+	if (tftp_adapt_block_size_option != tftp_block_size_option ||
+	    tftp_adapt_window_size_option != tftp_window_size_option) {
+		tftp_adapt_block_size_option = tftp_block_size_option;
+		tftp_adapt_window_size_option = tftp_window_size_option;
+		tftp_block_size_adapt = tftp_block_size_option;
+		tftp_window_size_adapt = tftp_window_size_option;
+	}
+	tftp_block_size_req = tftp_block_size_adapt;
+	tftp_window_size_req = tftp_window_size_adapt;
+}
+
+/*
+ * Adjust the window size for the next request: halve it if any blocks were
+ * lost, otherwise double it, up to the option. If the server accepted our
+ * request but no data arrived, the blocks may be too large for the network,
+ * so halve the block size too.
+ *
+ * @failed: true if the transfer is being abandoned
+ */
+static void tftp_adapt(bool failed)
+{
+	if (!IS_ENABLED(CONFIG_TFTP_ADAPTIVE) || tftp_put_active)
+		return;
+
+	if (tftp_stats.nacks || tftp_stats.timeouts)
+		tftp_window_size_adapt = max(tftp_window_size_adapt / 2, 1);
+	else if (!failed)
+		tftp_window_size_adapt = min(tftp_window_size_adapt * 2,
+					     (int)tftp_window_size_option);
+
+	if (failed && tftp_state == STATE_OACK)
+		tftp_block_size_adapt = max(tftp_block_size_adapt / 2,
+					    TFTP_BLOCK_SIZE);
+}
+
+/* Record the time between an ACK and the first block it asked for */
+static void tftp_rtt_add(ulong us)
+{
+	if (!tftp_stats.rtt_count || us < tftp_stats.rtt_min_us)
+		tftp_stats.rtt_min_us = us;
+	if (us > tftp_stats.rtt_max_us)
+		tftp_stats.rtt_max_us = us;
+	tftp_stats.rtt_total_us += us;
+	tftp_stats.rtt_count++;
+	tftp_rtt_pending = false;
+}
+
+static void tftp_show_stats(void)
+{
+	struct tftp_stats *st = &tftp_stats;
+
+	printf("\n\t %lu blocks of %u bytes, window %u", st->blocks,
+	       st->blksize, st->windowsize);
+	printf("\n\t %lu out of order, %lu duplicate, %lu resend requests, %lu timeouts",
+	       st->out_of_order, st->dups, st->nacks, st->timeouts);
+	if (st->rtt_count)
+		printf("\n\t RTT min/avg/max %lu/%lu/%lu us", st->rtt_min_us,
+		       st->rtt_total_us / st->rtt_count, st->rtt_max_us);
+}
+
+void tftp_get_stats(struct tftp_stats *stats)
+{
+	*stats = tftp_stats;
+}
+
 /* The TFTP get or put is complete */
 static void tftp_complete(void)
 {
+	if (net_sink_active() && !tftp_put_active &&
+	    net_sink_finish(net_boot_file_size)) {
+		eth_halt_state_only();
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+
 #ifdef CONFIG_TFTP_TSIZE
 	/* Print hash marks for the last packet received */
 	while (tftp_tsize && tftp_tsize_num_hash < 49) {
@@ -295,11 +414,18 @@ static void tftp_complete(void)
 		print_size(net_boot_file_size /
 			time_start * 1000, "/s");
 	}
+	tftp_stats.size = net_boot_file_size;
+	tftp_stats.time_ms = time_start;
+	tftp_stats.blksize = tftp_block_size;
+	tftp_stats.windowsize = tftp_windowsize;
+	if (IS_ENABLED(CONFIG_TFTP_STATS))
+		tftp_show_stats();
+	tftp_adapt(false);
 	puts("\ndone\n");
 
 	led_activity_off();
 
-	if (!tftp_put_active)
+	if (!tftp_put_active && !net_sink_active())
 		efi_set_bootdev("Net", "", tftp_filename,
 				map_sysmem(tftp_load_addr, 0),
 				net_boot_file_size);
@@ -351,15 +477,15 @@ static void tftp_send(void)
 #endif
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
-				0, tftp_block_size_option, 0);
+				0, tftp_block_size_req, 0);
 
 		/* try for more effic. window size.
 		 * Implemented only for tftp get.
 		 * Don't bother sending if it's 1
 		 */
-		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_option > 1)
+		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_req > 1)
 			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
-					0, tftp_window_size_option, 0);
+					0, tftp_window_size_req, 0);
 		len = pkt - xp;
 		break;
 
@@ -433,8 +559,13 @@ static void tftp_send(void)
 		net_send_udp_packet(net_server_ethaddr, tftp_remote_ip,
 				    tftp_remote_port, tftp_our_port, len);
 
-	if (err_pkt)
+	if (err_pkt) {
 		net_set_state(NETLOOP_FAIL);
+	} else if (!tftp_put_active) {
+		tftp_rtt_block = tftp_cur_block;
+		tftp_rtt_start = timer_get_us();
+		tftp_rtt_pending = true;
+	}
 }
 
 #ifdef CONFIG_CMD_TFTPPUT
@@ -449,6 +580,110 @@ static void icmp_handler(unsigned type, unsigned code, unsigned dest,
 }
 #endif
 
+/* Ask the server to send the window again, from the first missing block */
+static void tftp_nack(void)
+{
+	/*
+	 * If one packet is dropped most likely
+	 * all other buffers in the window
+	 * that will arrive will cause a sending NACK.
+	 * This just overwellms the server, let's just send one.
+	 */
+	if (tftp_last_nack != tftp_cur_block) {
+		tftp_send();
+		tftp_stats.nacks++;
+		tftp_last_nack = tftp_cur_block;
+		tftp_next_ack = (ushort)(tftp_cur_block + tftp_windowsize);
+		tftp_window_end = false;
+	}
+}
+
+/* A block is still missing at the end of the window, so it was lost */
+static void tftp_reorder_timeout_handler(void)
+{
+	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+	tftp_nack();
+}
+
+/*
+ * Handle a data block which is not the next one expected. Blocks a little way
+ * ahead are stored straight away, so that only the missing ones need to be
+ * sent again. Once the end of the window arrives, the missing block is given a
+ * little longer in case it is just out of order, then the server is asked to
+ * resend from it. A block too far ahead to keep is treated as a loss at once.
+ */
+static void tftp_data_ahead(ushort block, uchar *src, unsigned int len)
+{
+	ushort ahead = block - (ushort)(tftp_cur_block + 1);
+	u64 bit;
+	int ret;
+
+	/* A block we already have, which the server has sent again */
+	if (ahead >= TFTP_SEQUENCE_SIZE / 2) {
+		tftp_stats.dups++;
+		return;
+	}
+
+	if (tftp_state == STATE_OACK && ahead <= TFTP_HOLD_MAX) {
+		/* block 1 is missing, but this block is from the transfer */
+		tftp_state = STATE_DATA;
+		new_transfer();
+	}
+
+	if (tftp_state == STATE_DATA && ahead <= TFTP_HOLD_MAX) {
+		bit = 1ULL << (ahead - 1);
+		if (tftp_held & bit) {
+			tftp_stats.dups++;
+		} else {
+			ret = store_block(tftp_cur_block + 1 + ahead, src, len);
+			/* no room to keep it yet, so it has to be sent again */
+			if (ret == -ENOSPC)
+				goto nack;
+			if (ret) {
+				eth_halt_state_only();
+				net_set_state(NETLOOP_FAIL);
+				return;
+			}
+			tftp_held |= bit;
+			tftp_stats.out_of_order++;
+			if (len < tftp_block_size) {
+				tftp_last_block = block;
+				tftp_last_held = true;
+			}
+		}
+		/* the window is over at its last block or the end of file */
+		if ((short)(block - tftp_next_ack) >= 0 ||
+		    len < tftp_block_size) {
+			tftp_window_end = true;
+			net_set_timeout_handler(TFTP_REORDER_MS,
+						tftp_reorder_timeout_handler);
+		}
+		return;
+	}
+
+nack:
+	tftp_nack();
+}
+
+/*
+ * Move past the blocks which arrived early, now that the block before them is
+ * here. Returns true if this reaches the end of the file.
+ */
+static bool tftp_take_held(void)
+{
+	while (tftp_held & 1) {
+		tftp_held >>= 1;
+		tftp_cur_block = (tftp_cur_block + 1) % TFTP_SEQUENCE_SIZE;
+		update_block_number();
+		tftp_prev_block = tftp_cur_block;
+		if (tftp_last_held && tftp_cur_block == tftp_last_block)
+			return true;
+	}
+	tftp_held >>= 1;
+
+	return false;
+}
+
 static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			 unsigned src, unsigned len)
 {
@@ -456,6 +691,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	__be16 *s;
 	int i;
 	u16 timeout_val_rcvd;
+	ushort block;
 
 	if (dest != tftp_our_port) {
 			return;
@@ -543,7 +779,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 					dectoul((char *)pkt + i + 8, NULL);
 				debug("Blocksize oack: %s, %d\n",
 				      (char *)pkt + i + 8, tftp_block_size);
-				if (tftp_block_size > tftp_block_size_option) {
+				if (tftp_block_size > tftp_block_size_req) {
 					printf("Invalid blk size(=%d)\n",
 					       tftp_block_size);
 					tftp_state = STATE_INVALID_OPTION;
@@ -591,31 +827,15 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		if (len < 2)
 			return;
 		len -= 2;
+		block = ntohs(*(__be16 *)pkt);
+
+		if (tftp_rtt_pending && block == (ushort)(tftp_rtt_block + 1))
+			tftp_rtt_add(timer_get_us() - tftp_rtt_start);
 
-		if (ntohs(*(__be16 *)pkt) != (ushort)(tftp_cur_block + 1)) {
+		if (block != (ushort)(tftp_cur_block + 1)) {
 			debug("Received unexpected block: %d, expected: %d\n",
-			      ntohs(*(__be16 *)pkt),
-			      (ushort)(tftp_cur_block + 1));
-			/*
-			 * Only ACK if the block count received is greater than
-			 * the expected block count, otherwise skip ACK.
-			 * (required to properly handle the server retransmitting
-			 *  the window)
-			 */
-			if ((ushort)(tftp_cur_block + 1) - (short)(ntohs(*(__be16 *)pkt)) > 0)
-				break;
-			/*
-			 * If one packet is dropped most likely
-			 * all other buffers in the window
-			 * that will arrive will cause a sending NACK.
-			 * This just overwellms the server, let's just send one.
-			 */
-			if (tftp_last_nack != tftp_cur_block) {
-				tftp_send();
-				tftp_last_nack = tftp_cur_block;
-				tftp_next_ack = (ushort)(tftp_cur_block +
-							 tftp_windowsize);
-			}
+			      block, (ushort)(tftp_cur_block + 1));
+			tftp_data_ahead(block, pkt + 2, len);
 			break;
 		}
 
@@ -655,25 +875,45 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
 		if (store_block(tftp_cur_block, pkt + 2, len)) {
+			if (net_sink_active()) {
+				puts("\nTFTP error: ");
+				puts("block does not fit in the staging buffer\n");
+			}
 			eth_halt_state_only();
 			net_set_state(NETLOOP_FAIL);
 			break;
 		}
 		timeout_count = 0;
+		tftp_stats.blocks++;
 
-		if (len < tftp_block_size) {
+		if (len < tftp_block_size || tftp_take_held()) {
 			tftp_send();
 			tftp_complete();
 			break;
 		}
 
+		/* write out what is complete before acknowledging it */
+		if (net_sink_advance(tftp_cur_block * tftp_block_size +
+				     tftp_block_wrap_offset)) {
+			eth_halt_state_only();
+			net_set_state(NETLOOP_FAIL);
+			break;
+		}
+
+		/* another block is missing, and the window is already over */
+		if (tftp_held && tftp_window_end)
+			net_set_timeout_handler(TFTP_REORDER_MS,
+						tftp_reorder_timeout_handler);
+
 		/*
 		 *	Acknowledge the block just received, which will prompt
 		 *	the remote for the next one.
 		 */
-		if (tftp_cur_block == tftp_next_ack) {
+		if ((short)((ushort)tftp_cur_block - tftp_next_ack) >= 0) {
 			tftp_send();
-			tftp_next_ack += tftp_windowsize;
+			tftp_next_ack = (ushort)(tftp_cur_block +
+						 tftp_windowsize);
+			tftp_window_end = false;
 		}
 		break;
 
@@ -704,13 +944,29 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 static void tftp_timeout_handler(void)
 {
+	tftp_stats.timeouts++;
 	if (++timeout_count > timeout_count_max) {
+		tftp_adapt(true);
 		restart("Retry count exceeded");
+	} else if (IS_ENABLED(CONFIG_TFTP_ADAPTIVE) &&
+		   tftp_state == STATE_OACK && !tftp_put_active &&
+		   tftp_block_size > TFTP_BLOCK_SIZE &&
+		   timeout_count >= TFTP_ADAPT_TIMEOUTS) {
+		tftp_adapt(true);
+		restart("No data received, trying smaller blocks");
 	} else {
 		puts("T ");
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 		if (tftp_state != STATE_RECV_WRQ)
 			tftp_send();
+		/* do not time the round trip from a resent packet */
+		tftp_rtt_pending = false;
+		/* the server starts a new window after the block we ACKed */
+		if (tftp_state == STATE_DATA && !tftp_put_active) {
+			tftp_next_ack = (ushort)(tftp_cur_block +
+						 tftp_windowsize);
+			tftp_window_end = false;
+		}
 	}
 }
 
@@ -908,7 +1164,14 @@ void tftp_start(enum proto_t protocol)
 			puts("trying to overwrite reserved memory...\n");
 			return;
 		}
+		if (net_sink_active() && net_sink_start(tftp_load_addr)) {
+			eth_halt();
+			net_set_state(NETLOOP_FAIL);
+			return;
+		}
 		printf("Load address: 0x%lx\n", tftp_load_addr);
+		if (net_sink_active())
+			printf("Writing to:   %s\n", net_sink_get()->name);
 		puts("Loading: *\b");
 		tftp_state = STATE_SEND_RRQ;
 	}
@@ -936,6 +1199,17 @@ void tftp_start(enum proto_t protocol)
 	tftp_cur_block = 0;
 	tftp_windowsize = 1;
 	tftp_last_nack = 0;
+	tftp_held = 0;
+	tftp_last_held = false;
+	tftp_window_end = false;
+	tftp_rtt_pending = false;
+	memset(&tftp_stats, '\0', sizeof(tftp_stats));
+	tftp_adapt_request();
+	/* keep the window within what the staging buffer can hold */
+	if (net_sink_active() && !tftp_put_active)
+		tftp_window_size_req = clamp(net_sink_window() /
+					     tftp_block_size_req, 1UL,
+					     (ulong)tftp_window_size_req);
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
 	/* Revert tftp_block_size to dflt */
@@ -959,9 +1233,16 @@ void tftp_start_server(void)
 		puts("\nTFTP error: trying to overwrite reserved memory...\n");
 		return;
 	}
+	if (net_sink_active() && net_sink_start(tftp_load_addr)) {
+		eth_halt();
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
 	printf("Using %s device\n", eth_get_name());
 	printf("Listening for TFTP transfer on %pI4\n", &net_ip);
 	printf("Load address: 0x%lx\n", tftp_load_addr);
+	if (net_sink_active())
+		printf("Writing to:   %s\n", net_sink_get()->name);
 
 	puts("Loading: *\b");
 
@@ -976,6 +1257,11 @@ void tftp_start_server(void)
 	tftp_our_port = WELL_KNOWN_PORT;
 	tftp_windowsize = 1;
 	tftp_next_ack = tftp_windowsize;
+	tftp_held = 0;
+	tftp_last_held = false;
+	tftp_window_end = false;
+	tftp_rtt_pending = false;
+	memset(&tftp_stats, '\0', sizeof(tftp_stats));
 
 #ifdef CONFIG_TFTP_TSIZE
 	tftp_tsize = 0;
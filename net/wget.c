@@ -9,10 +9,13 @@
 #include <display_options.h>
 #include <env.h>
 #include <efi_loader.h>
+#include <hash.h>
 #include <image.h>
+#include <linux/sizes.h>
 #include <lmb.h>
 #include <mapmem.h>
 #include <net.h>
+#include <net/sink.h>
 #include <net/tcp.h>
 #include <net/wget.h>
 #include <stdlib.h>
@@ -28,17 +31,51 @@ DECLARE_GLOBAL_DATA_PTR;
 
 #define HTTP_STATUS_BAD		0
 #define HTTP_STATUS_OK		200
+#define HTTP_STATUS_PARTIAL	206
+
+/* Smallest range worth opening another connection for */
+#define WGET_MIN_RANGE		SZ_256K
+
+/**
+ * struct wget_conn - HTTP connection fetching the file or a range of it
+ *
+ * @tcp: TCP stream, or NULL if the connection is closed
+ * @start: Offset in the file of the first byte requested
+ * @end: Offset in the file following the last byte wanted, or 0 for the whole
+ *	file
+ * @hdr_size: Size of the HTTP header, or 0 until it has been received
+ * @max_rx_pos: Highest offset received in the stream, or -1 if none
+ * @received: Number of bytes of the body received in order
+ * @done: All the data wanted from this connection was received
+ */
+struct wget_conn {
+	struct tcp_stream *tcp;
+	ulong start;
+	ulong end;
+	u32 hdr_size;
+	u32 max_rx_pos;
+	ulong received;
+	bool done;
+};
 
 static const char http_proto[] = "HTTP/1.0";
 static const char http_eom[] = "\r\n\r\n";
 static const char content_len[] = "Content-Length:";
+static const char content_range[] = "Content-Range: bytes ";
 static const char linefeed[] = "\r\n";
 static struct in_addr web_server_ip;
 static unsigned int server_port;
 static unsigned long content_length;
-static u32 http_hdr_size, max_rx_pos;
 static int wget_tsize_num_hash;
 
+static struct wget_conn wget_conns[CONFIG_PROT_TCP_MAX_STREAMS];
+static struct wget_conn *wget_new_conn;
+static int wget_num_conns;
+static u32 wget_rx_packets;
+static enum tcp_status wget_tcp_status;
+static bool wget_failed;
+static bool wget_closed;
+
 static char *image_url;
 static enum net_loop_state wget_loop_state;
 
@@ -56,6 +93,8 @@ static inline int store_block(uchar *src, unsigned int offset, unsigned int len)
 	// Avoid overflow
 	if (wget_info->buffer_size && wget_info->buffer_size < offset + len)
 		return -1;
+	if (net_sink_active())
+		return net_sink_store(offset, src, len);
 	if (CONFIG_IS_ENABLED(LMB) && wget_info->set_bootdev) {
 		if (store_addr < image_load_addr ||
 		    lmb_read_check(store_addr, len)) {
@@ -98,45 +137,255 @@ static void show_block_marker(u32 packets)
 	}
 }
 
-static void tcp_stream_on_closed(struct tcp_stream *tcp)
+/* Add up the data received over all the connections */
+static void wget_update_size(void)
 {
-	if (tcp->status != TCP_ERR_OK)
-		wget_loop_state = NETLOOP_FAIL;
+	struct wget_conn *conn;
+	ulong size = 0;
+
+	for (conn = wget_conns; conn < wget_conns + wget_num_conns; conn++) {
+		if (conn->end)
+			size += min(conn->received, conn->end - conn->start);
+		else
+			size += conn->received;
+	}
+	net_boot_file_size = size;
+}
+
+/**
+ * wget_check_hash() - check the file against the wgethash variable
+ *
+ * Return: 0 if the variable is not set or the hash matches, -ve on error
+ */
+static int wget_check_hash(void)
+{
+	u8 expect[HASH_MAX_DIGEST_SIZE], output[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo;
+	char name[16];
+	const char *spec, *digest;
+	void *ptr;
+	int ret;
+
+	spec = env_get("wgethash");
+	if (!CONFIG_IS_ENABLED(HASH) || !IS_ENABLED(CONFIG_WGET_RANGES) ||
+	    !spec)
+		return 0;
+	/* the file is not in memory */
+	if (net_sink_active())
+		return -EOPNOTSUPP;
+
+	digest = strchr(spec, ':');
+	if (!digest || digest - spec >= sizeof(name))
+		return -EINVAL;
+	strlcpy(name, spec, digest - spec + 1);
+	digest++;
+
+	ret = hash_lookup_algo(name, &algo);
+	if (ret)
+		return ret;
+	if (strlen(digest) != algo->digest_size * 2)
+		return -EINVAL;
+	hash_parse_string(name, digest, expect);
+
+	ptr = map_sysmem(image_load_addr, net_boot_file_size);
+	ret = hash_block(name, ptr, net_boot_file_size, output, NULL);
+	unmap_sysmem(ptr);
+	if (ret)
+		return ret;
+	if (memcmp(expect, output, algo->digest_size))
+		return -EBADMSG;
+
+	return 0;
+}
+
+static void wget_on_done(void)
+{
+	int ret;
 
-	net_set_state(wget_loop_state);
 	if (wget_loop_state != NETLOOP_SUCCESS) {
-		net_boot_file_size = 0;
 		if (!wget_info->silent)
 			printf("\nwget: Transfer Fail, TCP status - %d\n",
-			       tcp->status);
-		return;
+			       wget_tcp_status);
+		goto fail;
+	}
+
+	if (net_sink_active()) {
+		ret = net_sink_finish(net_boot_file_size);
+		if (ret)
+			goto fail;
 	}
 
+	if (wget_info->method == WGET_HTTP_METHOD_GET) {
+		ret = wget_check_hash();
+		if (ret) {
+			if (!wget_info->silent)
+				printf("\nwget: Hash check failed (err=%d)\n",
+				       ret);
+			goto fail;
+		}
+	}
+
+	net_set_state(NETLOOP_SUCCESS);
+	/* the ranges make up the whole file */
+	if (wget_info->status_code == HTTP_STATUS_PARTIAL)
+		wget_info->status_code = HTTP_STATUS_OK;
 	if (!wget_info->silent)
 		printf("\nPackets received %d, Transfer Successful\n",
-		       tcp->rx_packets);
+		       wget_rx_packets);
 	wget_info->file_size = net_boot_file_size;
 	if (wget_info->method == WGET_HTTP_METHOD_GET && wget_info->set_bootdev) {
-		efi_set_bootdev("Http", NULL, image_url,
-				map_sysmem(image_load_addr, 0),
-				net_boot_file_size);
+		if (!net_sink_active())
+			efi_set_bootdev("Http", NULL, image_url,
+					map_sysmem(image_load_addr, 0),
+					net_boot_file_size);
 		env_set_hex("filesize", net_boot_file_size);
 	}
+	return;
+
+fail:
+	net_set_state(NETLOOP_FAIL);
+	net_boot_file_size = 0;
+}
+
+static void tcp_stream_on_closed(struct tcp_stream *tcp)
+{
+	struct wget_conn *conn = tcp->priv;
+	struct tcp_stream *other;
+	int i;
+
+	conn->tcp = NULL;
+	wget_rx_packets += tcp->rx_packets;
+	if (tcp->status == TCP_ERR_OK && !conn->end)
+		conn->done = true;
+	if (!wget_failed)
+		wget_tcp_status = tcp->status;
+	if (!conn->done) {
+		wget_failed = true;
+		wget_loop_state = NETLOOP_FAIL;
+	}
+
+	/* once one connection has failed, the others are of no use */
+	for (i = 0; i < wget_num_conns; i++) {
+		other = wget_conns[i].tcp;
+		if (!other)
+			continue;
+		if (!wget_failed)
+			return;
+		tcp_stream_reset(other);
+		tcp_stream_put(other);
+	}
+
+	if (!wget_closed) {
+		wget_closed = true;
+		wget_on_done();
+	}
+}
+
+/**
+ * wget_split() - fetch the rest of the file over more connections
+ *
+ * Called once the first connection has found the size of the file. That
+ * connection keeps the first range and the others are requested by new
+ * connections. If a connection cannot be opened, the previous one is given
+ * the rest of the file.
+ *
+ * @total: Size of the file
+ */
+static void wget_split(ulong total)
+{
+	struct wget_conn *conn;
+	ulong chunk;
+	int i;
+
+	if (total < wget_num_conns * WGET_MIN_RANGE)
+		wget_num_conns = total / WGET_MIN_RANGE ?: 1;
+	chunk = DIV_ROUND_UP(total, wget_num_conns);
+	for (i = 1; i < wget_num_conns; i++) {
+		conn = &wget_conns[i];
+		memset(conn, '\0', sizeof(*conn));
+		conn->start = i * chunk;
+		wget_conns[i - 1].end = conn->start;
+		conn->end = min(conn->start + chunk, total);
+		conn->max_rx_pos = (u32)(-1);
+
+		wget_new_conn = conn;
+		conn->tcp = tcp_stream_connect(web_server_ip, server_port);
+		wget_new_conn = NULL;
+		if (!conn->tcp) {
+			wget_conns[i - 1].end = i > 1 ? total : 0;
+			wget_num_conns = i;
+			break;
+		}
+		tcp_stream_put(conn->tcp);
+	}
+}
+
+/*
+ * Parse the Content-Range header of a partial response, checking that it
+ * starts where requested. Returns the size of the file, or 0 on error.
+ */
+static ulong wget_parse_range(struct wget_conn *conn, char *hdr)
+{
+	ulong first, last, total;
+	char *pos, *tail;
+
+	pos = strstr(hdr, content_range);
+	if (!pos)
+		return 0;
+	pos += strlen(content_range);
+	first = simple_strtoul(pos, &tail, 10);
+	if (tail == pos || *tail != '-')
+		return 0;
+	pos = tail + 1;
+	last = simple_strtoul(pos, &tail, 10);
+	if (tail == pos || *tail != '/')
+		return 0;
+	pos = tail + 1;
+	total = simple_strtoul(pos, &tail, 10);
+	if (tail == pos || first != conn->start || last >= total ||
+	    (conn->end && last + 1 != conn->end))
+		return 0;
+
+	return total;
+}
+
+/* Account for the data received in order on a connection */
+static void wget_on_data(struct tcp_stream *tcp, u32 rx_bytes)
+{
+	struct wget_conn *conn = tcp->priv;
+
+	conn->received = rx_bytes - conn->hdr_size;
+	wget_update_size();
+
+	if (net_sink_advance(net_boot_file_size)) {
+		tcp_stream_reset(tcp);
+		return;
+	}
+
+	/* the first connection asked for the whole file, so is stopped */
+	if (conn->end && conn->received >= conn->end - conn->start &&
+	    !conn->done) {
+		conn->done = true;
+		if (conn == wget_conns)
+			tcp_stream_reset(tcp);
+	}
 }
 
 static void tcp_stream_on_rcv_nxt_update(struct tcp_stream *tcp, u32 rx_bytes)
 {
+	struct wget_conn *conn = tcp->priv;
 	char	*pos, *tail;
 	uchar	saved, *ptr;
 	int	reply_len;
+	ulong	total;
 
-	if (http_hdr_size) {
-		net_boot_file_size = rx_bytes - http_hdr_size;
+	if (conn->hdr_size) {
+		wget_on_data(tcp, rx_bytes);
 		show_block_marker(tcp->rx_packets);
 		return;
 	}
 
-	ptr = map_sysmem(image_load_addr, rx_bytes + 1);
+	ptr = map_sysmem(image_load_addr + conn->start, rx_bytes + 1);
 
 	saved = ptr[rx_bytes];
 	ptr[rx_bytes] = '\0';
@@ -154,10 +403,11 @@ static void tcp_stream_on_rcv_nxt_update(struct tcp_stream *tcp, u32 rx_bytes)
 		goto end;
 	}
 
-	http_hdr_size = pos - (char *)ptr + strlen(http_eom);
+	conn->hdr_size = pos - (char *)ptr + strlen(http_eom);
 	*pos = '\0';
 
-	if (wget_info->headers && http_hdr_size < MAX_HTTP_HEADERS_SIZE)
+	if (wget_info->headers && conn == wget_conns &&
+	    conn->hdr_size < MAX_HTTP_HEADERS_SIZE)
 		strcpy(wget_info->headers, ptr);
 
 	/* check for HTTP proto */
@@ -173,7 +423,7 @@ static void tcp_stream_on_rcv_nxt_update(struct tcp_stream *tcp, u32 rx_bytes)
 	if (pos)
 		reply_len = pos - (char *)ptr;
 	else
-		reply_len = http_hdr_size - strlen(http_eom);
+		reply_len = conn->hdr_size - strlen(http_eom);
 
 	pos = strchr((char *)ptr, ' ');
 	if (!pos || pos - (char *)ptr > reply_len) {
@@ -194,14 +444,25 @@ static void tcp_stream_on_rcv_nxt_update(struct tcp_stream *tcp, u32 rx_bytes)
 	debug_cond(DEBUG_WGET,
 		   "wget: HTTP Status Code %d\n", wget_info->status_code);
 
-	if (wget_info->status_code != HTTP_STATUS_OK) {
+	/* only the first connection may get the whole file */
+	total = 0;
+	if (wget_info->status_code == HTTP_STATUS_PARTIAL &&
+	    wget_num_conns > 1) {
+		total = wget_parse_range(conn, (char *)ptr);
+		if (!total) {
+			debug_cond(DEBUG_WGET, "wget: Bad Content-Range\n");
+			tcp_stream_close(tcp);
+			goto end;
+		}
+	} else if (wget_info->status_code != HTTP_STATUS_OK ||
+		   conn != wget_conns) {
 		debug_cond(DEBUG_WGET, "wget: Connected Bad Xfer\n");
 		tcp_stream_close(tcp);
 		goto end;
 	}
 
 	debug_cond(DEBUG_WGET, "wget: Connctd pkt %p  hlen %x\n",
-		   ptr, http_hdr_size);
+		   ptr, conn->hdr_size);
 
 	content_length = -1;
 	pos = strstr((char *)ptr, content_len);
@@ -213,8 +474,10 @@ static void tcp_stream_on_rcv_nxt_update(struct tcp_stream *tcp, u32 rx_bytes)
 		if (*tail != '\r' && *tail != '\n' && *tail != '\0')
 			content_length = -1;
 	}
+	if (total)
+		content_length = total;
 
-	if (content_length != -1) {
+	if (content_length != -1 && conn == wget_conns) {
 		debug_cond(DEBUG_WGET,
 			   "wget: Connected Len %lu\n",
 			   content_length);
@@ -226,9 +489,13 @@ static void tcp_stream_on_rcv_nxt_update(struct tcp_stream *tcp, u32 rx_bytes)
 
 	}
 
-	net_boot_file_size = rx_bytes - http_hdr_size;
-	memmove(ptr, ptr + http_hdr_size, max_rx_pos + 1 - http_hdr_size);
-	wget_loop_state = NETLOOP_SUCCESS;
+	memmove(ptr, ptr + conn->hdr_size, conn->max_rx_pos + 1 - conn->hdr_size);
+	if (conn == wget_conns) {
+		wget_loop_state = NETLOOP_SUCCESS;
+		if (total)
+			wget_split(total);
+	}
+	wget_on_data(tcp, rx_bytes);
 
 end:
 	unmap_sysmem(ptr);
@@ -236,11 +503,37 @@ end:
 
 static int tcp_stream_rx(struct tcp_stream *tcp, u32 rx_offs, void *buf, int len)
 {
-	if ((max_rx_pos == (u32)(-1)) || (max_rx_pos < rx_offs + len - 1))
-		max_rx_pos = rx_offs + len - 1;
+	struct wget_conn *conn = tcp->priv;
+	ulong offs = conn->start + rx_offs - conn->hdr_size;
+	int ret;
+
+	/*
+	 * Until the header is known, the data is kept where it would be with
+	 * no header, so it must not reach the range of the next connection.
+	 * Refuse it, so that it is sent again.
+	 */
+	if (conn->end && !conn->hdr_size && offs + len > conn->end)
+		return 0;
+
+	if ((conn->max_rx_pos == (u32)(-1)) ||
+	    (conn->max_rx_pos < rx_offs + len - 1))
+		conn->max_rx_pos = rx_offs + len - 1;
+
+	/* the first connection is reset once it has its range */
+	if (conn->end && offs + len > conn->end) {
+		if (offs >= conn->end)
+			return len;
+		if (store_block(buf, offs, conn->end - offs) < 0)
+			return -1;
+		return len;
+	}
 
 	// Avoid overflow
-	if (store_block(buf, rx_offs - http_hdr_size, len) < 0)
+	ret = store_block(buf, offs, len);
+	/* too far ahead of what has been written out, so refuse it for now */
+	if (ret == -ENOSPC)
+		return 0;
+	if (ret < 0)
 		return -1;
 
 	return len;
@@ -248,8 +541,10 @@ static int tcp_stream_rx(struct tcp_stream *tcp, u32 rx_offs, void *buf, int len
 
 static int tcp_stream_tx(struct tcp_stream *tcp, u32 tx_offs, void *buf, int maxlen)
 {
+	struct wget_conn *conn = tcp->priv;
 	int ret;
 	const char *method;
+	char range[48];
 
 	if (tx_offs)
 		return 0;
@@ -264,20 +559,32 @@ static int tcp_stream_tx(struct tcp_stream *tcp, u32 tx_offs, void *buf, int max
 		break;
 	}
 
-	ret = snprintf(buf, maxlen, "%s %s %s\r\n\r\n",
-		       method, image_url, http_proto);
+	range[0] = '\0';
+	if (conn->end)
+		snprintf(range, sizeof(range), "Range: bytes=%lu-%lu\r\n",
+			 conn->start, conn->end - 1);
+	else if (wget_num_conns > 1)
+		strcpy(range, "Range: bytes=0-\r\n");
+
+	ret = snprintf(buf, maxlen, "%s %s %s\r\n%s\r\n",
+		       method, image_url, http_proto, range);
 
 	return ret;
 }
 
 static int tcp_stream_on_create(struct tcp_stream *tcp)
 {
-	if (tcp->rhost.s_addr != web_server_ip.s_addr ||
+	if (!wget_new_conn ||
+	    tcp->rhost.s_addr != web_server_ip.s_addr ||
 	    tcp->rport != server_port)
 		return 0;
 
+	tcp->priv = wget_new_conn;
 	tcp->max_retry_count = WGET_RETRY_COUNT;
 	tcp->initial_timeout = WGET_TIMEOUT;
+	/* do not let the server send more than the staging buffer holds */
+	if (net_sink_active())
+		tcp->rcv_wnd = min(tcp->rcv_wnd, (u32)net_sink_window());
 	tcp->on_closed = tcp_stream_on_closed;
 	tcp->on_rcv_nxt_update = tcp_stream_on_rcv_nxt_update;
 	tcp->rx = tcp_stream_rx;
@@ -290,6 +597,7 @@ static int tcp_stream_on_create(struct tcp_stream *tcp)
 
 void wget_start(void)
 {
+	struct wget_conn *conn = wget_conns;
 	struct tcp_stream *tcp;
 
 	if (!wget_info)
@@ -340,12 +648,30 @@ void wget_start(void)
 
 	memset(net_server_ethaddr, 0, 6);
 
-	max_rx_pos = (u32)(-1);
+	memset(wget_conns, '\0', sizeof(wget_conns));
+	conn->max_rx_pos = (u32)(-1);
 	net_boot_file_size = 0;
-	http_hdr_size = 0;
 	wget_tsize_num_hash = 0;
+	wget_rx_packets = 0;
+	wget_failed = false;
+	wget_closed = false;
 	wget_loop_state = NETLOOP_FAIL;
 
+	wget_num_conns = 1;
+	if (IS_ENABLED(CONFIG_WGET_RANGES) &&
+	    wget_info->method == WGET_HTTP_METHOD_GET)
+		wget_num_conns = clamp(env_get_ulong("wgetconns", 10, 1), 1UL,
+				       (ulong)ARRAY_SIZE(wget_conns));
+
+	/* the file is written out in order, so it needs a single connection */
+	if (net_sink_active()) {
+		wget_num_conns = 1;
+		if (net_sink_start(image_load_addr)) {
+			net_set_state(NETLOOP_FAIL);
+			return;
+		}
+	}
+
 	wget_info->status_code = HTTP_STATUS_BAD;
 	wget_info->file_size = 0;
 	wget_info->hdr_cont_len = 0;
@@ -354,13 +680,16 @@ void wget_start(void)
 
 	server_port = env_get_ulong("httpdstp", 10, SERVER_PORT) & 0xffff;
 	tcp_stream_set_on_create_handler(tcp_stream_on_create);
+	wget_new_conn = conn;
 	tcp = tcp_stream_connect(web_server_ip, server_port);
+	wget_new_conn = NULL;
 	if (!tcp) {
 		if (!wget_info->silent)
 			printf("No free tcp streams\n");
 		net_set_state(NETLOOP_FAIL);
 		return;
 	}
+	conn->tcp = tcp;
 	tcp_stream_put(tcp);
 }
 
@@ -0,0 +1,430 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Test for loading FIT images in chunks
+ */
+
+#include <blk.h>
+#include <bootm.h>
+#include <fit_stream.h>
+#include <gzip.h>
+#include <image.h>
+#include <lmb.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <os.h>
+#include <part.h>
+#include <test/ut.h>
+#include "bootstd_common.h"
+
+#define PLAIN_SIZE	3000
+#define PLAIN_ADDR	0x200000
+#define GZ_SIZE		0x4000
+#define GZ_ADDR		0x300000
+#define KERNEL_ADDR	0x400000
+#define FDT_SIZE	0x100
+#define FDT_ADDR	0x500000
+#define FIT_BLK		4
+#define TREE_CHUNK	0x200
+#define GZ_CHUNK	0x20
+#define FIT_FILE	"fit_stream.itb"
+
+static inline int fdt_property_addr(void *fdt, const char *name, ulong val)
+{
+	if (sizeof(ulong) == sizeof(u32))
+		return fdt_property_u32(fdt, name, val);
+	return fdt_property_u64(fdt, name, val);
+}
+
+/*
+ * Add an image with a sha256 hash, a hash tree if @chunk is not 0, and crc32.
+ * An image called "kernel" is a Linux kernel and one called "fdt" is a
+ * devicetree; the others are firmware.
+ */
+static int add_image(struct unit_test_state *uts, void *fit, const char *name,
+		     const char *comp, ulong load, int offset,
+		     const void *data, int size, ulong chunk)
+{
+	u8 leaves[(PLAIN_SIZE / TREE_CHUNK + 1) * FIT_MAX_HASH_LEN];
+	u8 value[FIT_MAX_HASH_LEN];
+	int leaves_len, len;
+
+	ut_assertok(fdt_begin_node(fit, name));
+	ut_assertok(fdt_property_string(fit, FIT_DESC_PROP, name));
+	if (!strcmp(name, "kernel")) {
+		ut_assertok(fdt_property_string(fit, FIT_TYPE_PROP, "kernel"));
+		ut_assertok(fdt_property_string(fit, FIT_OS_PROP, "linux"));
+		ut_assertok(fdt_property_string(fit, FIT_ARCH_PROP,
+						"sandbox"));
+	} else if (!strcmp(name, "fdt")) {
+		ut_assertok(fdt_property_string(fit, FIT_TYPE_PROP, "flat_dt"));
+	} else {
+		ut_assertok(fdt_property_string(fit, FIT_TYPE_PROP,
+						"firmware"));
+	}
+	ut_assertok(fdt_property_string(fit, FIT_COMP_PROP, comp));
+	ut_assertok(fdt_property_addr(fit, FIT_LOAD_PROP, load));
+	ut_assertok(fdt_property_u32(fit, FIT_DATA_OFFSET_PROP, offset));
+	ut_assertok(fdt_property_u32(fit, FIT_DATA_SIZE_PROP, size));
+
+	ut_assertok(fdt_begin_node(fit, "hash-1"));
+	ut_assertok(fdt_property_string(fit, FIT_ALGO_PROP, "sha256"));
+	if (chunk) {
+		ut_assert(size / chunk < ARRAY_SIZE(leaves) / FIT_MAX_HASH_LEN);
+		ut_assertok(fit_calc_hash_tree(data, size, "sha256", chunk,
+					       leaves, &leaves_len, value,
+					       &len));
+		ut_assertok(fdt_property_u32(fit, FIT_CHUNK_SIZE_PROP, chunk));
+		ut_assertok(fdt_property(fit, FIT_CHUNK_HASHES_PROP, leaves,
+					 leaves_len));
+	} else {
+		ut_assertok(calculate_hash(data, size, "sha256", value, &len));
+	}
+	ut_assertok(fdt_property(fit, FIT_VALUE_PROP, value, len));
+	ut_assertok(fdt_end_node(fit));
+
+	ut_assertok(fdt_begin_node(fit, "hash-2"));
+	ut_assertok(fdt_property_string(fit, FIT_ALGO_PROP, "crc32"));
+	ut_assertok(calculate_hash(data, size, "crc32", value, &len));
+	ut_assertok(fdt_property(fit, FIT_VALUE_PROP, value, len));
+	ut_assertok(fdt_end_node(fit));
+
+	ut_assertok(fdt_end_node(fit));
+
+	return 0;
+}
+
+/*
+ * Build a FIT with external data, holding an uncompressed image and a
+ * gzip-compressed one, with a hash tree if @gz_chunk is not 0. The kernel
+ * shares the data of the uncompressed image and is booted with a nearly
+ * empty devicetree.
+ */
+static int build_fit(struct unit_test_state *uts, void *buf, int size,
+		     const void *plain, const void *gz, int gz_len,
+		     ulong gz_chunk, int *lenp)
+{
+	int gz_offset = ALIGN(PLAIN_SIZE, 4);
+	int fdt_offset = ALIGN(gz_offset + gz_len, 4);
+	char dtb[FDT_SIZE];
+	int fit_size;
+
+	ut_assertok(fdt_create_empty_tree(dtb, FDT_SIZE));
+	ut_assert(fdt_add_subnode(dtb, 0, "chosen") > 0);
+
+	ut_assertok(fdt_create(buf, size));
+	ut_assertok(fdt_finish_reservemap(buf));
+	ut_assertok(fdt_begin_node(buf, ""));
+	ut_assertok(fdt_property_u32(buf, FIT_TIMESTAMP_PROP, 0));
+	ut_assertok(fdt_property_u32(buf, "#address-cells",
+				     sizeof(ulong) / sizeof(u32)));
+	ut_assertok(fdt_property_string(buf, FIT_DESC_PROP, "stream test"));
+
+	ut_assertok(fdt_begin_node(buf, "images"));
+	ut_assertok(add_image(uts, buf, "plain", "none", PLAIN_ADDR, 0, plain,
+			      PLAIN_SIZE, TREE_CHUNK));
+	ut_assertok(add_image(uts, buf, "gz", "gzip", GZ_ADDR, gz_offset, gz,
+			      gz_len, gz_chunk));
+	ut_assertok(add_image(uts, buf, "kernel", "none", KERNEL_ADDR, 0,
+			      plain, PLAIN_SIZE, 0));
+	ut_assertok(add_image(uts, buf, "fdt", "none", FDT_ADDR, fdt_offset,
+			      dtb, FDT_SIZE, 0));
+	ut_assertok(fdt_end_node(buf));
+
+	ut_assertok(fdt_begin_node(buf, "configurations"));
+	ut_assertok(fdt_property_string(buf, FIT_DEFAULT_PROP, "conf-1"));
+	ut_assertok(fdt_begin_node(buf, "conf-1"));
+	ut_assertok(fdt_property_string(buf, FIT_FIRMWARE_PROP, "plain"));
+	ut_assertok(fdt_property_string(buf, FIT_LOADABLE_PROP, "gz"));
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_begin_node(buf, "conf-boot"));
+	ut_assertok(fdt_property_string(buf, FIT_KERNEL_PROP, "kernel"));
+	ut_assertok(fdt_property_string(buf, FIT_FDT_PROP, "fdt"));
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_end_node(buf));
+
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_finish(buf));
+
+	fit_size = ALIGN(fdt_totalsize(buf), 4);
+	ut_assert(fit_size + fdt_offset + FDT_SIZE <= size);
+	memcpy(buf + fit_size, plain, PLAIN_SIZE);
+	memcpy(buf + fit_size + gz_offset, gz, gz_len);
+	memcpy(buf + fit_size + fdt_offset, dtb, FDT_SIZE);
+	*lenp = fit_size + fdt_offset + FDT_SIZE;
+
+	return 0;
+}
+
+static int mem_read(struct fit_stream *strm, ulong offset, ulong size,
+		    void *buf)
+{
+	memcpy(buf, strm->priv + offset, size);
+
+	return 0;
+}
+
+/* Check that both images arrived at their load addresses */
+static int check_loaded(struct unit_test_state *uts, const void *plain,
+			const void *unz)
+{
+	ut_asserteq_mem(plain, map_sysmem(PLAIN_ADDR, PLAIN_SIZE), PLAIN_SIZE);
+	ut_asserteq_mem(unz, map_sysmem(GZ_ADDR, GZ_SIZE), GZ_SIZE);
+	memset(map_sysmem(PLAIN_ADDR, PLAIN_SIZE), '\0', PLAIN_SIZE);
+	memset(map_sysmem(GZ_ADDR, GZ_SIZE), '\0', GZ_SIZE);
+
+	return 0;
+}
+
+/* Check that nothing is left at an address after a failed load */
+static int check_clear(struct unit_test_state *uts, ulong addr, int size)
+{
+	const u8 *buf = map_sysmem(addr, size);
+	int i;
+
+	for (i = 0; i < size; i++)
+		ut_asserteq(0, buf[i]);
+
+	return 0;
+}
+
+/* Fill in the image contents and compress the second one */
+static int make_data(struct unit_test_state *uts, char *plain, char *unz,
+		     char *gz, unsigned long *gz_lenp)
+{
+	int i;
+
+	for (i = 0; i < PLAIN_SIZE; i++)
+		plain[i] = i * 7;
+	for (i = 0; i < GZ_SIZE; i++)
+		unz[i] = 'a' + i % 23;
+	*gz_lenp = GZ_SIZE;
+	ut_assertok(gzip(gz, gz_lenp, unz, GZ_SIZE));
+
+	return 0;
+}
+
+/* Test loading a FIT a chunk at a time, from memory, a block device and a file */
+static int test_fit_stream(struct unit_test_state *uts)
+{
+	struct fit_stream strm;
+	struct blk_desc *desc;
+	unsigned long gz_len;
+	char *plain, *unz, *gz, *fit;
+	int fit_len, gz_end, blks;
+
+	plain = malloc(PLAIN_SIZE);
+	unz = malloc(GZ_SIZE);
+	gz = malloc(GZ_SIZE);
+	fit = calloc(1, 0x8000);
+	ut_assert(plain && unz && gz && fit);
+	ut_assertok(make_data(uts, plain, unz, gz, &gz_len));
+	ut_assertok(build_fit(uts, fit, 0x8000, plain, gz, gz_len, GZ_CHUNK,
+			      &fit_len));
+
+	/* small chunks so that each image takes several steps */
+	memset(&strm, '\0', sizeof(strm));
+	strm.read = mem_read;
+	strm.priv = fit;
+	strm.chunk_size = 0x100;
+	ut_assertok(fit_stream_open(&strm));
+	ut_assertok(fit_stream_load_config(&strm, NULL, true, NULL));
+	ut_assertok(check_loaded(uts, plain, unz));
+	ut_asserteq(-ENOENT,
+		    fit_stream_load_config(&strm, "conf-2", true, NULL));
+	fit_stream_close(&strm);
+
+	/* a block device, where all but the first chunk are block-aligned */
+	ut_asserteq(2, blk_get_device_by_str("mmc", "2", &desc));
+	blks = DIV_ROUND_UP(fit_len, desc->blksz);
+	ut_asserteq(blks, blk_dwrite(desc, FIT_BLK, blks, fit));
+	ut_assertok(fit_stream_init_blk(&strm, desc, FIT_BLK));
+	strm.chunk_size = 0x400;
+	ut_assertok(fit_stream_open(&strm));
+	ut_assertok(fit_stream_load_config(&strm, "conf-1", true, NULL));
+	ut_assertok(check_loaded(uts, plain, unz));
+	fit_stream_close(&strm);
+
+	gz_end = ALIGN(fdt_totalsize(fit), 4) + ALIGN(PLAIN_SIZE, 4) + gz_len;
+
+	/*
+	 * corrupted data is caught before it is decompressed, unless
+	 * verification is off, and nothing is left at the load address
+	 */
+	fit[gz_end - 3] ^= 0xff;
+	memset(&strm, '\0', sizeof(strm));
+	strm.read = mem_read;
+	strm.priv = fit;
+	ut_assertok(fit_stream_open(&strm));
+	ut_asserteq(-EACCES, fit_stream_load_config(&strm, NULL, true, NULL));
+	ut_assertok(check_clear(uts, GZ_ADDR, GZ_SIZE));
+	/* the plain image was loaded before the gz one failed */
+	memset(map_sysmem(PLAIN_ADDR, PLAIN_SIZE), '\0', PLAIN_SIZE);
+	fit[ALIGN(fdt_totalsize(fit), 4) + 10] ^= 0xff;
+	fit[gz_end - 3] ^= 0xff;
+	ut_asserteq(-EACCES, fit_stream_load_config(&strm, NULL, true, NULL));
+	ut_assertok(check_clear(uts, PLAIN_ADDR, PLAIN_SIZE));
+	ut_assertok(fit_stream_load_config(&strm, NULL, false, NULL));
+	fit_stream_close(&strm);
+
+	/*
+	 * a file, read an image at a time; without a hash tree the compressed
+	 * image is collected and checked before it is decompressed
+	 */
+	memset(fit, '\0', 0x8000);
+	ut_assertok(build_fit(uts, fit, 0x8000, plain, gz, gz_len, 0,
+			      &fit_len));
+	ut_assertok(os_write_file(FIT_FILE, fit, fit_len));
+	ut_assertok(fit_stream_init_fs(&strm, "hostfs", "-", FIT_FILE));
+	ut_assertok(fit_stream_open(&strm));
+	ut_assertok(fit_stream_load_config(&strm, NULL, true, NULL));
+	ut_assertok(check_loaded(uts, plain, unz));
+	fit_stream_close(&strm);
+	os_unlink(FIT_FILE);
+
+	free(fit);
+	free(gz);
+	free(unz);
+	free(plain);
+
+	return 0;
+}
+BOOTSTD_TEST(test_fit_stream, UTF_DM | UTF_SCAN_FDT);
+
+/* Check that an address still holds the pattern written by fill() */
+static int check_untouched(struct unit_test_state *uts, ulong addr, int size)
+{
+	const u8 *buf = map_sysmem(addr, size);
+	int i;
+
+	for (i = 0; i < size; i++)
+		ut_asserteq(0xa5, buf[i]);
+
+	return 0;
+}
+
+static void fill(ulong addr, int size)
+{
+	memset(map_sysmem(addr, size), 0xa5, size);
+}
+
+/* Test that nothing is written before an image has been checked and reserved */
+static int test_fit_stream_checks(struct unit_test_state *uts)
+{
+	struct fit_stream strm;
+	unsigned long gz_len;
+	char *plain, *unz, *gz, *fit;
+	phys_addr_t addr;
+	int fit_len;
+
+	plain = malloc(PLAIN_SIZE);
+	unz = malloc(GZ_SIZE);
+	gz = malloc(GZ_SIZE);
+	fit = calloc(1, 0x8000);
+	ut_assert(plain && unz && gz && fit);
+	ut_assertok(make_data(uts, plain, unz, gz, &gz_len));
+	ut_assertok(build_fit(uts, fit, 0x8000, plain, gz, gz_len, GZ_CHUNK,
+			      &fit_len));
+
+	/* the FIT structure and the image data must lie within the source */
+	memset(&strm, '\0', sizeof(strm));
+	strm.read = mem_read;
+	strm.priv = fit;
+	strm.size = fdt_totalsize(fit) - 1;
+	ut_asserteq(-E2BIG, fit_stream_open(&strm));
+	fit_stream_close(&strm);
+	strm.read = mem_read;
+	strm.priv = fit;
+	strm.size = fit_len - 1;
+	ut_assertok(fit_stream_open(&strm));
+	fill(FDT_ADDR, FDT_SIZE);
+	ut_asserteq(-EINVAL, fit_stream_load_config(&strm, "conf-boot", true,
+						    NULL));
+	ut_assertok(check_untouched(uts, FDT_ADDR, FDT_SIZE));
+	strm.size = fit_len;
+
+	/*
+	 * without a hash tree, an uncompressed image is only copied to its
+	 * load address once it has been checked
+	 */
+	fit[ALIGN(fdt_totalsize(fit), 4) + 10] ^= 0xff;
+	fill(KERNEL_ADDR, PLAIN_SIZE);
+	ut_asserteq(-EACCES, fit_stream_load_config(&strm, "conf-boot", true,
+						    NULL));
+	ut_assertok(check_untouched(uts, KERNEL_ADDR, PLAIN_SIZE));
+	fit[ALIGN(fdt_totalsize(fit), 4) + 10] ^= 0xff;
+
+	/* memory which must not be overwritten is not touched */
+	if (CONFIG_IS_ENABLED(LMB)) {
+		addr = PLAIN_ADDR + PLAIN_SIZE - 1;
+		ut_assertok(lmb_alloc_mem(LMB_MEM_ALLOC_ADDR, 0, &addr, 1,
+					  LMB_NOOVERWRITE));
+		fill(PLAIN_ADDR, PLAIN_SIZE);
+		ut_asserteq(-EEXIST, fit_stream_load_config(&strm, NULL, true,
+							    NULL));
+		ut_assertok(check_untouched(uts, PLAIN_ADDR, PLAIN_SIZE));
+		ut_assertok(lmb_free(addr, 1, LMB_NOOVERWRITE));
+
+		/* and the images are no longer reserved once loaded */
+		ut_assertok(fit_stream_load_config(&strm, NULL, true, NULL));
+		ut_assertok(check_loaded(uts, plain, unz));
+		addr = PLAIN_ADDR;
+		ut_assertok(lmb_alloc_mem(LMB_MEM_ALLOC_ADDR, 0, &addr,
+					  PLAIN_SIZE, LMB_NOOVERWRITE));
+		ut_assertok(lmb_free(addr, PLAIN_SIZE, LMB_NOOVERWRITE));
+	}
+	fit_stream_close(&strm);
+
+	free(fit);
+	free(gz);
+	free(unz);
+	free(plain);
+
+	return 0;
+}
+BOOTSTD_TEST(test_fit_stream_checks, UTF_DM | UTF_SCAN_FDT);
+
+/*
+ * Test booting a FIT configuration loaded a chunk at a time. This needs a
+ * live tree, since with a flat tree the devicetree fixups for the kernel run
+ * the VBE handlers, which need the bootstd disk images.
+ */
+static int test_fit_stream_boot(struct unit_test_state *uts)
+{
+	struct fit_stream strm;
+	struct bootm_info bmi;
+	unsigned long gz_len;
+	char *plain, *unz, *gz, *fit;
+	int fit_len;
+
+	plain = malloc(PLAIN_SIZE);
+	unz = malloc(GZ_SIZE);
+	gz = malloc(GZ_SIZE);
+	fit = calloc(1, 0x8000);
+	ut_assert(plain && unz && gz && fit);
+	ut_assertok(make_data(uts, plain, unz, gz, &gz_len));
+	ut_assertok(build_fit(uts, fit, 0x8000, plain, gz, gz_len, GZ_CHUNK,
+			      &fit_len));
+
+	memset(&strm, '\0', sizeof(strm));
+	strm.read = mem_read;
+	strm.priv = fit;
+	ut_assertok(fit_stream_open(&strm));
+	bootm_init(&bmi);
+	ut_assertok(bootm_stream_run(&bmi, &strm, "conf-boot"));
+	ut_asserteq(KERNEL_ADDR, bmi.images->os.load);
+	ut_asserteq(KERNEL_ADDR, bmi.images->ep);
+	ut_asserteq(PLAIN_SIZE, bmi.images->os.image_len);
+	ut_asserteq(FDT_SIZE, fdt_totalsize(map_sysmem(FDT_ADDR, FDT_SIZE)));
+	ut_asserteq_mem(plain, map_sysmem(KERNEL_ADDR, PLAIN_SIZE),
+			PLAIN_SIZE);
+	ut_asserteq(-ENOENT, bootm_stream_run(&bmi, &strm, "conf-1"));
+	fit_stream_close(&strm);
+
+	free(fit);
+	free(gz);
+	free(unz);
+	free(plain);
+
+	return 0;
+}
+BOOTSTD_TEST(test_fit_stream_boot, UTF_DM | UTF_SCAN_FDT | UTF_LIVE_TREE);
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for checking FIT image hashes
+ */
+
+#include <image.h>
+#include <malloc.h>
+#include <test/ut.h>
+#include "bootstd_common.h"
+
+#define DATA_SIZE	0x1000
+#define CHUNK_SIZE	0x300
+
+/* Test checking an image against a hash tree, as a whole and a chunk at once */
+static int test_fit_hash_tree(struct unit_test_state *uts)
+{
+	u8 leaves[(DATA_SIZE / CHUNK_SIZE + 1) * FIT_MAX_HASH_LEN];
+	u8 value[FIT_MAX_HASH_LEN];
+	int size = 4 * DATA_SIZE;
+	int leaves_len, len, i;
+	int image, hash;
+	const void *data;
+	size_t data_len;
+	char *buf, *fit;
+
+	buf = malloc(DATA_SIZE);
+	fit = malloc(size);
+	ut_assert(buf && fit);
+	for (i = 0; i < DATA_SIZE; i++)
+		buf[i] = i + i / 0x100;
+
+	ut_assertok(fit_calc_hash_tree(buf, DATA_SIZE, "sha256", CHUNK_SIZE,
+				       leaves, &leaves_len, value, &len));
+	ut_asserteq(32, len);
+	ut_asserteq(DIV_ROUND_UP(DATA_SIZE, CHUNK_SIZE) * len, leaves_len);
+
+	ut_assertok(fdt_create(fit, size));
+	ut_assertok(fdt_finish_reservemap(fit));
+	ut_assertok(fdt_begin_node(fit, ""));
+	ut_assertok(fdt_begin_node(fit, "images"));
+	ut_assertok(fdt_begin_node(fit, "kernel"));
+	ut_assertok(fdt_property(fit, FIT_DATA_PROP, buf, DATA_SIZE));
+	ut_assertok(fdt_begin_node(fit, "hash-1"));
+	ut_assertok(fdt_property_string(fit, FIT_ALGO_PROP, "sha256"));
+	ut_assertok(fdt_property_u32(fit, FIT_CHUNK_SIZE_PROP, CHUNK_SIZE));
+	ut_assertok(fdt_property(fit, FIT_CHUNK_HASHES_PROP, leaves,
+				 leaves_len));
+	ut_assertok(fdt_property(fit, FIT_VALUE_PROP, value, len));
+	ut_assertok(fdt_end_node(fit));
+	ut_assertok(fdt_end_node(fit));
+	ut_assertok(fdt_end_node(fit));
+	ut_assertok(fdt_end_node(fit));
+	ut_assertok(fdt_finish(fit));
+
+	image = fit_image_get_node(fit, "kernel");
+	ut_assert(image >= 0);
+	hash = fdt_subnode_offset(fit, image, "hash-1");
+	ut_assert(hash >= 0);
+	ut_assertok(fit_image_get_data(fit, image, &data, &data_len));
+	ut_asserteq(1, fit_image_verify(fit, image));
+
+	/* single chunks, including the short last one */
+	ut_assertok(fit_image_check_chunk(fit, hash, 0, data, CHUNK_SIZE));
+	ut_assertok(fit_image_check_chunk(fit, hash, DATA_SIZE / CHUNK_SIZE,
+					  data + DATA_SIZE / CHUNK_SIZE *
+					  CHUNK_SIZE, DATA_SIZE % CHUNK_SIZE));
+	ut_asserteq(-EACCES, fit_image_check_chunk(fit, hash, 1, data,
+						   CHUNK_SIZE));
+	ut_asserteq(-ERANGE, fit_image_check_chunk(fit, hash, 6, data,
+						   CHUNK_SIZE));
+	ut_asserteq(-EINVAL, fit_image_check_chunk(fit, hash, 0, data,
+						   CHUNK_SIZE + 1));
+
+	/* a bad chunk, then bad chunk hashes, then a bad root */
+	((char *)data)[CHUNK_SIZE + 1] ^= 0xff;
+	ut_asserteq(0, fit_image_verify(fit, image));
+	ut_assertok(fit_image_check_chunk(fit, hash, 0, data, CHUNK_SIZE));
+	ut_asserteq(-EACCES, fit_image_check_chunk(fit, hash, 1,
+						   data + CHUNK_SIZE,
+						   CHUNK_SIZE));
+	((char *)data)[CHUNK_SIZE + 1] ^= 0xff;
+	ut_asserteq(1, fit_image_verify(fit, image));
+
+	leaves[0] ^= 0xff;
+	ut_assertok(fdt_setprop_inplace(fit, hash, FIT_CHUNK_HASHES_PROP,
+					leaves, leaves_len));
+	ut_asserteq(0, fit_image_verify(fit, image));
+	leaves[0] ^= 0xff;
+	ut_assertok(fdt_setprop_inplace(fit, hash, FIT_CHUNK_HASHES_PROP,
+					leaves, leaves_len));
+
+	value[0] ^= 0xff;
+	ut_assertok(fdt_setprop_inplace(fit, hash, FIT_VALUE_PROP, value,
+					len));
+	ut_asserteq(0, fit_image_verify(fit, image));
+
+	free(fit);
+	free(buf);
+
+	return 0;
+}
+BOOTSTD_TEST(test_fit_hash_tree, 0);
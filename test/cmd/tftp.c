@@ -0,0 +1,612 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the tftpboot command, using a TFTP server on the sandbox Ethernet
+ * device
+ */
+
+#include <blk.h>
+#include <command.h>
+#include <dm.h>
+#include <env.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <net.h>
+#include <os.h>
+#include <sandbox_host.h>
+#include <time.h>
+#include <asm/eth.h>
+#include <asm/test.h>
+#include <linux/sizes.h>
+#include <net/sink.h>
+#include <net/tftp.h>
+#include <test/cmd.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define TFTP_PORT	69
+#define TFTP_TID	21313
+
+#define TFTP_RRQ	1
+#define TFTP_DATA	3
+#define TFTP_ACK	4
+#define TFTP_OACK	6
+
+#define TFTP_HDR_SIZE	4
+
+/* Largest block size which fits in an Ethernet frame */
+#define TFTP_MAX_BLKSIZE	1468
+
+/* Timeout for the client, and how far to move time on to make it happen */
+#define TIMEOUT_MS	1000
+#define TIMEOUT_SKIP_MS	(TIMEOUT_MS + 100)
+
+#define TEST_ADDR	0x1000000
+#define TEST_SIZE	(200 * 1024 + 123)
+#define SPEED_SIZE	SZ_32M
+
+/* Backing file for the block device which downloads are written to */
+#define SINK_FILE	"netsink.img"
+#define SINK_BUF_SIZE	SZ_32K
+
+/**
+ * struct sb_tftp_server - State of the TFTP server
+ *
+ * @img: Contents of the file being served
+ * @size: Size of the file in bytes
+ * @blksize: Block size agreed with the client
+ * @windowsize: Number of blocks sent for each ACK
+ * @req_blksize: Block size asked for by the client
+ * @req_windowsize: Window size asked for by the client
+ * @max_size: Data packets with more than this many bytes of data are lost, as
+ *	if they were too large for the network, or 0 for no limit
+ * @lose_every: Lose each block whose number is a multiple of this, the first
+ *	time it is sent, or 0 to lose nothing
+ * @reorder: Send each pair of blocks in a window the wrong way round
+ * @acked: Last block acknowledged by the client, counting from 0 without
+ *	wrapping
+ * @last_lost: Last block lost because of @lose_every
+ * @sent: Number of data packets sent
+ * @lost: Number of data packets lost on purpose
+ * @overflows: Number of data packets dropped because the receive buffers were
+ *	full
+ * @prev_ethact: Value of ethact before the test
+ * @prev_ethrotate: Value of ethrotate before the test
+ * @prev_ip: Our IP address before the test
+ * @prev_server_ip: Server IP address before the test
+ */
+struct sb_tftp_server {
+	const char *img;
+	size_t size;
+	uint blksize;
+	uint windowsize;
+	uint req_blksize;
+	uint req_windowsize;
+	uint max_size;
+	uint lose_every;
+	bool reorder;
+	ulong acked;
+	ulong last_lost;
+	ulong sent;
+	ulong lost;
+	ulong overflows;
+	char *prev_ethact;
+	char *prev_ethrotate;
+	struct in_addr prev_ip;
+	struct in_addr prev_server_ip;
+};
+
+/* Start a reply to @packet, returning a pointer to the UDP payload */
+static void *sb_tftp_reply(struct udevice *dev, void *packet, int payload_len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth = packet, *eth_recv;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE, *ipr;
+
+	if (priv->recv_packets >= PKTBUFSRX)
+		return NULL;
+
+	eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = htons(PROT_IP);
+
+	ipr = (void *)eth_recv + ETHER_HDR_SIZE;
+	ipr->ip_hl_v = 0x45;
+	ipr->ip_tos = 0;
+	ipr->ip_len = htons(IP_UDP_HDR_SIZE + payload_len);
+	ipr->ip_id = 0;
+	ipr->ip_off = htons(IP_FLAGS_DFRAG);
+	ipr->ip_ttl = 255;
+	ipr->ip_p = IPPROTO_UDP;
+	ipr->ip_sum = 0;
+	net_copy_ip(&ipr->ip_dst, &ip->ip_src);
+	net_copy_ip(&ipr->ip_src, &ip->ip_dst);
+	ipr->ip_sum = compute_ip_checksum(ipr, IP_HDR_SIZE);
+	ipr->udp_src = htons(TFTP_TID);
+	ipr->udp_dst = ip->udp_src;
+	ipr->udp_len = htons(UDP_HDR_SIZE + payload_len);
+	ipr->udp_xsum = 0;
+
+	priv->recv_packet_length[priv->recv_packets] = ETHER_HDR_SIZE +
+		IP_UDP_HDR_SIZE + payload_len;
+	++priv->recv_packets;
+
+	return (void *)ipr + IP_UDP_HDR_SIZE;
+}
+
+/* Send an OACK accepting the options in a read request */
+static void sb_tftp_oack(struct udevice *dev, struct sb_tftp_server *srv,
+			 void *packet, const char *opt, const char *end)
+{
+	char buf[128], *p = buf;
+	__be16 *hdr;
+
+	srv->blksize = 512;
+	srv->windowsize = 1;
+	srv->req_blksize = 512;
+	srv->req_windowsize = 1;
+	srv->acked = 0;
+
+	/* skip the filename and mode */
+	opt += strlen(opt) + 1;
+	opt += strlen(opt) + 1;
+	while (opt < end) {
+		const char *val = opt + strlen(opt) + 1;
+		ulong num = dectoul(val, NULL);
+
+		if (!strcmp(opt, "blksize")) {
+			srv->req_blksize = num;
+			srv->blksize = min(num, (ulong)TFTP_MAX_BLKSIZE);
+			p += sprintf(p, "blksize%c%u%c", 0, srv->blksize, 0);
+		} else if (!strcmp(opt, "windowsize")) {
+			srv->req_windowsize = num;
+			srv->windowsize = num;
+			p += sprintf(p, "windowsize%c%u%c", 0, srv->windowsize,
+				     0);
+		} else if (!strcmp(opt, "timeout")) {
+			p += sprintf(p, "timeout%c%lu%c", 0, num, 0);
+		} else if (!strcmp(opt, "tsize")) {
+			p += sprintf(p, "tsize%c%zu%c", 0, srv->size, 0);
+		}
+		opt = val + strlen(val) + 1;
+	}
+
+	hdr = sb_tftp_reply(dev, packet, 2 + p - buf);
+	if (hdr) {
+		hdr[0] = htons(TFTP_OACK);
+		memcpy(&hdr[1], buf, p - buf);
+	}
+}
+
+/*
+ * Send a data block, returning true if it is lost on the way. Only the last
+ * block of a window is too large to get through: losing it otherwise would
+ * leave the client waiting for a timeout, which takes real time.
+ */
+static bool sb_tftp_send_block(struct udevice *dev,
+			       struct sb_tftp_server *srv, void *packet,
+			       ulong block, bool last)
+{
+	size_t offset = (block - 1) * srv->blksize;
+	size_t size = min(srv->size - offset, (size_t)srv->blksize);
+	__be16 *hdr;
+
+	if ((srv->max_size && size > srv->max_size) ||
+	    (srv->lose_every && !(block % srv->lose_every) &&
+	     block > srv->last_lost && !last)) {
+		srv->last_lost = max(srv->last_lost, block);
+		srv->lost++;
+		return true;
+	}
+
+	hdr = sb_tftp_reply(dev, packet, TFTP_HDR_SIZE + size);
+	if (!hdr) {
+		srv->overflows++;
+		return false;
+	}
+	hdr[0] = htons(TFTP_DATA);
+	hdr[1] = htons(block);
+	memcpy(&hdr[2], srv->img + offset, size);
+	srv->sent++;
+
+	return false;
+}
+
+/* Send a window of data blocks, following the block last acknowledged */
+static void sb_tftp_send_window(struct udevice *dev,
+				struct sb_tftp_server *srv, void *packet)
+{
+	ulong nblocks = srv->size / srv->blksize + 1;
+	ulong first = srv->acked + 1;
+	ulong last = min(nblocks, srv->acked + srv->windowsize);
+	bool lost = false;
+	ulong i, block;
+
+	for (i = first; i <= last; i++) {
+		block = i;
+		if (srv->reorder && !((i - first) % 2) && i < last)
+			block = i + 1;
+		else if (srv->reorder && (i - first) % 2)
+			block = i - 1;
+		lost = sb_tftp_send_block(dev, srv, packet, block, i == last);
+	}
+
+	/* nothing got through, so move time on to make the client time out */
+	if (lost)
+		timer_test_add_offset(TIMEOUT_SKIP_MS);
+}
+
+static int sb_tftp_handler(struct udevice *dev, void *packet,
+			   unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_tftp_server *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	__be16 *hdr = (void *)ip + IP_UDP_HDR_SIZE;
+	u16 block;
+
+	if (ntohs(eth->et_protlen) == PROT_ARP)
+		return sandbox_eth_arp_req_to_reply(dev, packet, len);
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	if (ntohs(ip->udp_dst) == TFTP_PORT && ntohs(hdr[0]) == TFTP_RRQ) {
+		sb_tftp_oack(dev, srv, packet, (char *)&hdr[1],
+			     (void *)ip + ntohs(ip->udp_len) + IP_HDR_SIZE);
+	} else if (ntohs(ip->udp_dst) == TFTP_TID &&
+		   ntohs(hdr[0]) == TFTP_ACK) {
+		/* block numbers wrap, so work out how far this one is */
+		block = ntohs(hdr[1]);
+		srv->acked += (u16)(block - (u16)srv->acked);
+		sb_tftp_send_window(dev, srv, packet);
+	}
+
+	return 0;
+}
+
+/* Fill @size bytes at @buf with a pattern which differs from block to block */
+static void sb_tftp_fill(char *buf, size_t size)
+{
+	u32 val = 0x12345678;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		val = val * 1103515245 + 12345;
+		buf[i] = val >> 16;
+	}
+}
+
+static int sb_tftp_setup(struct unit_test_state *uts,
+			 struct sb_tftp_server *srv, size_t size)
+{
+	char *img;
+
+	img = malloc(size);
+	ut_assertnonnull(img);
+	sb_tftp_fill(img, size);
+	memset(srv, '\0', sizeof(*srv));
+	srv->img = img;
+	srv->size = size;
+
+	srv->prev_ethact = env_get("ethact");
+	srv->prev_ethrotate = env_get("ethrotate");
+	srv->prev_ip = net_ip;
+	srv->prev_server_ip = net_server_ip;
+
+	sandbox_eth_set_tx_handler(0, sb_tftp_handler);
+	sandbox_eth_set_priv(0, srv);
+	env_set("ethact", "eth@10002000");
+	env_set("ethrotate", "no");
+	env_set_ulong("tftptimeout", TIMEOUT_MS);
+	net_ip = string_to_ip("1.1.2.2");
+	net_server_ip = string_to_ip("1.1.2.4");
+
+	/*
+	 * With CONFIG_TFTP_ADAPTIVE, what was learned from earlier transfers is
+	 * forgotten when the options change, so do a transfer with different
+	 * ones from the tests
+	 */
+	env_set_ulong("tftpblocksize", 512);
+	env_set_ulong("tftpwindowsize", 1);
+	ut_assertok(run_commandf("tftpboot %x file", TEST_ADDR));
+
+	return 0;
+}
+
+static void sb_tftp_finish(struct sb_tftp_server *srv)
+{
+	sandbox_eth_set_tx_handler(0, NULL);
+	sandbox_eth_set_priv(0, NULL);
+	sandbox_eth_set_batch(0, true);
+	env_set("ethact", srv->prev_ethact);
+	env_set("ethrotate", srv->prev_ethrotate);
+	net_ip = srv->prev_ip;
+	net_server_ip = srv->prev_server_ip;
+	env_set("tftpblocksize", NULL);
+	env_set("tftpwindowsize", NULL);
+	env_set("tftptimeout", NULL);
+	env_set("netretry", NULL);
+	free((char *)srv->img);
+}
+
+/* Download the file with the given window size */
+static int sb_tftp_get(struct unit_test_state *uts,
+		       struct sb_tftp_server *srv, int windowsize)
+{
+	env_set_ulong("tftpwindowsize", windowsize);
+	env_set_ulong("tftpblocksize", TFTP_MAX_BLKSIZE);
+	srv->sent = 0;
+	srv->lost = 0;
+	srv->last_lost = 0;
+	srv->overflows = 0;
+	memset(map_sysmem(TEST_ADDR, srv->size), '\0', srv->size);
+	ut_assertok(run_commandf("tftpboot %x file", TEST_ADDR));
+	ut_asserteq(srv->size, env_get_hex("filesize", 0));
+	ut_asserteq(0, srv->overflows);
+
+	return 0;
+}
+
+/* Load the file with the given window size, and check it arrived intact */
+static int sb_tftp_load(struct unit_test_state *uts,
+			struct sb_tftp_server *srv, int windowsize)
+{
+	ut_assertok(sb_tftp_get(uts, srv, windowsize));
+	ut_asserteq_mem(srv->img, map_sysmem(TEST_ADDR, srv->size), srv->size);
+
+	return 0;
+}
+
+/* Test loading a file, with and without receiving packets in batches */
+static int net_test_tftp(struct unit_test_state *uts)
+{
+	struct sb_tftp_server srv;
+
+	ut_assertok(sb_tftp_setup(uts, &srv, TEST_SIZE));
+
+	ut_assertok(sb_tftp_load(uts, &srv, 1));
+	ut_asserteq(DIV_ROUND_UP(TEST_SIZE + 1, TFTP_MAX_BLKSIZE), srv.sent);
+	ut_assertok(sb_tftp_load(uts, &srv, 16));
+
+	sandbox_eth_set_batch(0, false);
+	ut_assertok(sb_tftp_load(uts, &srv, 1));
+	ut_assertok(sb_tftp_load(uts, &srv, 16));
+
+	sb_tftp_finish(&srv);
+
+	return 0;
+}
+CMD_TEST(net_test_tftp, 0);
+
+/* Test that blocks which arrive out of order are kept */
+static int net_test_tftp_reorder(struct unit_test_state *uts)
+{
+	struct sb_tftp_server srv;
+	struct tftp_stats stats;
+	ulong nblocks = DIV_ROUND_UP(TEST_SIZE + 1, TFTP_MAX_BLKSIZE);
+
+	ut_assertok(sb_tftp_setup(uts, &srv, TEST_SIZE));
+	srv.reorder = true;
+
+	/* nothing needs to be sent twice */
+	ut_assertok(sb_tftp_load(uts, &srv, 16));
+	ut_asserteq(nblocks, srv.sent);
+	tftp_get_stats(&stats);
+	ut_asserteq(nblocks / 2, stats.out_of_order);
+	ut_asserteq(nblocks - nblocks / 2, stats.blocks);
+	ut_asserteq(0, stats.dups);
+	ut_asserteq(0, stats.nacks);
+	ut_asserteq(0, stats.timeouts);
+	ut_asserteq(TEST_SIZE, stats.size);
+	ut_asserteq(16, stats.windowsize);
+	ut_asserteq(TFTP_MAX_BLKSIZE, stats.blksize);
+	ut_assert(stats.rtt_count > 0);
+	ut_assert(stats.rtt_min_us <= stats.rtt_max_us);
+
+	sb_tftp_finish(&srv);
+
+	return 0;
+}
+CMD_TEST(net_test_tftp_reorder, 0);
+
+/* Test recovering lost blocks, and the window adapting to the losses */
+static int net_test_tftp_loss(struct unit_test_state *uts)
+{
+	struct sb_tftp_server srv;
+	struct tftp_stats stats;
+
+	ut_assertok(sb_tftp_setup(uts, &srv, TEST_SIZE));
+
+	/* make sure the window starts from the option */
+	ut_assertok(sb_tftp_load(uts, &srv, 1));
+
+	srv.lose_every = 10;
+	ut_assertok(sb_tftp_load(uts, &srv, 32));
+	ut_asserteq(32, srv.req_windowsize);
+	ut_assert(srv.lost > 0);
+	tftp_get_stats(&stats);
+	ut_assert(stats.nacks + stats.timeouts > 0);
+	ut_asserteq(DIV_ROUND_UP(TEST_SIZE + 1, TFTP_MAX_BLKSIZE),
+		    stats.blocks + stats.out_of_order);
+
+	if (!IS_ENABLED(CONFIG_TFTP_ADAPTIVE))
+		goto done;
+
+	/* the window is halved after losses and grows back without */
+	ut_assertok(sb_tftp_load(uts, &srv, 32));
+	ut_asserteq(16, srv.req_windowsize);
+	srv.lose_every = 0;
+	ut_assertok(sb_tftp_load(uts, &srv, 32));
+	ut_asserteq(8, srv.req_windowsize);
+	ut_assertok(sb_tftp_load(uts, &srv, 32));
+	ut_asserteq(16, srv.req_windowsize);
+	ut_assertok(sb_tftp_load(uts, &srv, 32));
+	ut_asserteq(32, srv.req_windowsize);
+	ut_assertok(sb_tftp_load(uts, &srv, 32));
+	ut_asserteq(32, srv.req_windowsize);
+
+done:
+	sb_tftp_finish(&srv);
+
+	return 0;
+}
+CMD_TEST(net_test_tftp_loss, 0);
+
+/* Test falling back to smaller blocks when large ones do not get through */
+static int net_test_tftp_blksize(struct unit_test_state *uts)
+{
+	struct sb_tftp_server srv;
+	struct tftp_stats stats;
+
+	if (!IS_ENABLED(CONFIG_TFTP_ADAPTIVE))
+		return -EAGAIN;
+
+	ut_assertok(sb_tftp_setup(uts, &srv, TEST_SIZE));
+	env_set("netretry", "once");
+	srv.max_size = 1000;
+
+	ut_assertok(sb_tftp_load(uts, &srv, 1));
+	ut_asserteq(TFTP_MAX_BLKSIZE / 2, srv.req_blksize);
+	tftp_get_stats(&stats);
+	ut_asserteq(TFTP_MAX_BLKSIZE / 2, stats.blksize);
+
+	/* the smaller size is used for the next transfer too */
+	ut_assertok(sb_tftp_load(uts, &srv, 1));
+	ut_asserteq(TFTP_MAX_BLKSIZE / 2, srv.req_blksize);
+
+	sb_tftp_finish(&srv);
+
+	return 0;
+}
+CMD_TEST(net_test_tftp_blksize, 0);
+
+/*
+ * Create a host device of @size bytes to write the file to, filled with 0xff
+ * so that it shows what was written
+ */
+static int sb_tftp_sink_dev(struct unit_test_state *uts, ulong size,
+			    struct blk_desc **descp)
+{
+	struct udevice *dev, *blk;
+	char *buf;
+
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	memset(buf, '\xff', size);
+	ut_assertok(os_write_file(SINK_FILE, buf, size));
+	free(buf);
+	ut_assertok(host_create_attach_file("netsink", SINK_FILE, false, 512,
+					    &dev));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	*descp = dev_get_uclass_plat(blk);
+
+	return 0;
+}
+
+/* Write the file to the host device, and check it arrived intact */
+static int sb_tftp_sink_load(struct unit_test_state *uts,
+			     struct sb_tftp_server *srv, struct blk_desc *desc,
+			     int windowsize)
+{
+	ulong size = desc->lba * desc->blksz;
+	char *buf;
+
+	ut_assertok(run_commandf("netsink blk host %d:0 %x", desc->devnum,
+				 SINK_BUF_SIZE));
+	ut_assertok(sb_tftp_get(uts, srv, windowsize));
+
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	ut_asserteq(desc->lba, blk_dread(desc, 0, desc->lba, buf));
+	ut_asserteq_mem(srv->img, buf, srv->size);
+	ut_assertnull(memchr_inv(buf + srv->size, 0xff, size - srv->size));
+	free(buf);
+
+	return 0;
+}
+
+/* Test writing the file to a block device while it arrives */
+static int net_test_tftp_sink(struct unit_test_state *uts)
+{
+	struct sb_tftp_server srv;
+	struct blk_desc *desc;
+
+	if (!IS_ENABLED(CONFIG_NET_SINK))
+		return -EAGAIN;
+
+	ut_assertok(sb_tftp_setup(uts, &srv, TEST_SIZE));
+	ut_assertok(sb_tftp_sink_dev(uts, SZ_256K, &desc));
+
+	/*
+	 * Only the staging buffer at the load address is used, and the window
+	 * is cut down so that it covers three of its four chunks
+	 */
+	srv.reorder = true;
+	ut_assertok(sb_tftp_sink_load(uts, &srv, desc, 32));
+	ut_asserteq(SINK_BUF_SIZE * 3 / 4 / TFTP_MAX_BLKSIZE,
+		    srv.req_windowsize);
+	ut_assertnull(memchr_inv(map_sysmem(TEST_ADDR + SINK_BUF_SIZE, 0), 0,
+				 srv.size - SINK_BUF_SIZE));
+
+	/* the sink is dropped after use */
+	ut_assertnull(net_sink_get());
+
+	srv.reorder = false;
+	srv.lose_every = 10;
+	ut_assertok(sb_tftp_sink_load(uts, &srv, desc, 16));
+	ut_assert(srv.lost > 0);
+	srv.lose_every = 0;
+
+	/* the download fails if the file does not fit */
+	ut_assertok(run_command("host unbind netsink", 0));
+	ut_assertok(sb_tftp_sink_dev(uts, SZ_128K, &desc));
+	ut_assertok(run_commandf("netsink blk host %d:0 %x", desc->devnum,
+				 SINK_BUF_SIZE));
+	ut_asserteq(1, run_commandf("tftpboot %x file", TEST_ADDR));
+	ut_assertnull(net_sink_get());
+
+	ut_assertok(run_command("host unbind netsink", 0));
+	os_unlink(SINK_FILE);
+	sb_tftp_finish(&srv);
+
+	return 0;
+}
+CMD_TEST(net_test_tftp_sink, 0);
+
+static ulong sb_tftp_speed(struct unit_test_state *uts,
+			   struct sb_tftp_server *srv, int windowsize)
+{
+	ulong start, us;
+
+	start = timer_get_us();
+	if (sb_tftp_load(uts, srv, windowsize))
+		return 0;
+	us = timer_get_us() - start;
+
+	return (ulong)((u64)srv->size * 1000000 / SZ_1M / max(us, 1UL));
+}
+
+/* Print the TFTP throughput with and without receiving packets in batches */
+static int net_test_tftp_speed_norun(struct unit_test_state *uts)
+{
+	static const int windowsizes[] = { 1, 16, 48 };
+	struct sb_tftp_server srv;
+	ulong batch, single;
+	int i;
+
+	ut_assertok(sb_tftp_setup(uts, &srv, SPEED_SIZE));
+	for (i = 0; i < ARRAY_SIZE(windowsizes); i++) {
+		sandbox_eth_set_batch(0, true);
+		batch = sb_tftp_speed(uts, &srv, windowsizes[i]);
+		sandbox_eth_set_batch(0, false);
+		single = sb_tftp_speed(uts, &srv, windowsizes[i]);
+		ut_assert(batch && single);
+		printf("windowsize %2d: batched %4lu MiB/s, single %4lu MiB/s\n",
+		       windowsizes[i], batch, single);
+	}
+	sb_tftp_finish(&srv);
+
+	return 0;
+}
+CMD_TEST(net_test_tftp_speed_norun, UTF_MANUAL);
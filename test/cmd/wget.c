@@ -6,19 +6,29 @@
  * Ying-Chun Liu (PaulLiu) <paul.liu@linaro.org>
  */
 
+#include <blk.h>
 #include <command.h>
 #include <dm.h>
 #include <env.h>
 #include <fdtdec.h>
+#include <hash.h>
+#include <hexdump.h>
 #include <log.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <net.h>
+#include <os.h>
+#include <sandbox_host.h>
+#include <time.h>
+#include <net/sink.h>
 #include <net/tcp.h>
 #include <net/wget.h>
 #include <asm/eth.h>
+#include <asm/unaligned.h>
 #include <dm/test.h>
 #include <dm/device-internal.h>
 #include <dm/uclass-internal.h>
+#include <linux/sizes.h>
 #include <test/cmd.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -27,6 +37,21 @@
 #define LEN_B_TO_DW(x) ((x) >> 2)
 #define GET_TCP_HDR_LEN_IN_BYTES(x) ((x) >> 2)
 
+#define TEST_ADDR	0x1000000
+#define TEST_SIZE	(1024 * 1024 + 123)
+#define SPEED_SIZE	SZ_32M
+
+/* Backing file for the block device which downloads are written to */
+#define SINK_FILE	"netsink.img"
+#define SINK_BUF_SIZE	SZ_64K
+
+/* Window offered by the TCP stack, see TCP_RCV_WND_SIZE */
+#if CONFIG_IS_ENABLED(PROT_TCP) && CONFIG_PROT_TCP_RCV_WND
+#define TEST_RCV_WND	(CONFIG_PROT_TCP_RCV_WND * 1024)
+#else
+#define TEST_RCV_WND	(PKTBUFSRX * TCP_MSS)
+#endif
+
 static int sb_arp_handler(struct udevice *dev, void *packet,
 			  unsigned int len)
 {
@@ -73,7 +98,7 @@ static int sb_syn_handler(struct udevice *dev, void *packet,
 	tcp_send->tcp_ack = htonl(priv->irs + 1);
 	tcp_send->tcp_hlen = SHIFT_TO_TCPHDRLEN_FIELD(LEN_B_TO_DW(TCP_HDR_SIZE));
 	tcp_send->tcp_flags = TCP_SYN | TCP_ACK;
-	tcp_send->tcp_win = htons(PKTBUFSRX * TCP_MSS >> TCP_SCALE);
+	tcp_send->tcp_win = htons(min(PKTBUFSRX * TCP_MSS, 0xffff));
 	tcp_send->tcp_xsum = 0;
 	tcp_send->tcp_ugr = 0;
 	tcp_send->tcp_xsum = tcp_set_pseudo_header((uchar *)tcp_send,
@@ -166,7 +191,7 @@ static int sb_ack_handler(struct udevice *dev, void *packet,
 	}
 
 	tcp_send->tcp_hlen = SHIFT_TO_TCPHDRLEN_FIELD(LEN_B_TO_DW(TCP_HDR_SIZE));
-	tcp_send->tcp_win = htons(PKTBUFSRX * TCP_MSS >> TCP_SCALE);
+	tcp_send->tcp_win = htons(min(PKTBUFSRX * TCP_MSS, 0xffff));
 	tcp_send->tcp_xsum = 0;
 	tcp_send->tcp_ugr = 0;
 	pkt_len = IP_TCP_HDR_SIZE + payload_len;
@@ -261,3 +286,769 @@ static int net_test_wget_uri_validate(struct unit_test_state *uts)
 	return 0;
 }
 CMD_TEST(net_test_wget_uri_validate, UTF_CONSOLE);
+
+/* Connections which the HTTP server can handle at once */
+#define SB_HTTP_CONNS	4
+
+/**
+ * struct sb_http_conn - State of one connection to the HTTP server
+ *
+ * @port: Port of the client, or 0 if the connection is not in use
+ * @ip: IP header of the client's SYN, giving the addresses and ports
+ * @req: Start of the request received from the client
+ * @req_len: Length of @req
+ * @hdr: HTTP response header
+ * @hdr_len: Length of @hdr, which is sent in a segment of its own, or 0 until
+ *	the request has been received
+ * @start: Offset in the file of the first byte to send
+ * @len: Number of bytes of the file to send
+ * @irs: Initial sequence number of the client
+ * @iss: Our initial sequence number
+ * @rcv_nxt: Offset of the next byte expected from the client
+ * @snd_una: Offset of the first byte not acknowledged by the client
+ * @snd_nxt: Offset of the first byte not sent yet
+ * @high_rxt: Offset up to which the gaps found by the client were sent again
+ * @high_sack: Offset following the highest data received by the client
+ * @sacked: Whether each data segment was received by the client, as reported
+ *	by SACK
+ * @wnd_shift: Scale factor of the client's window
+ * @fin_sent: All the data was acknowledged, so FIN was sent
+ */
+struct sb_http_conn {
+	u16 port;
+	struct ip_tcp_hdr ip;
+	char req[256];
+	int req_len;
+	char hdr[160];
+	u32 hdr_len;
+	u32 start;
+	u32 len;
+	u32 irs;
+	u32 iss;
+	u32 rcv_nxt;
+	u32 snd_una;
+	u32 snd_nxt;
+	u32 high_rxt;
+	u32 high_sack;
+	bool *sacked;
+	int wnd_shift;
+	bool fin_sent;
+};
+
+/**
+ * struct sb_http_server - State of the HTTP server streaming a file
+ *
+ * @body: Contents of the file being served
+ * @size: Size of the file in bytes
+ * @win_scale: Offer window scaling in the SYN-ACK
+ * @ranges: Honour the Range header of requests
+ * @max_flight: Most bytes to have in flight, or 0 for the client's window
+ * @lose_every: Lose each data segment whose number is a multiple of this, the
+ *	first time it is sent, or 0 to lose nothing
+ * @mac: MAC address of the client
+ * @conns: Connections from the client
+ * @snd_wnd: Window last offered by the client, in bytes
+ * @syn_win: Window field of the client's last SYN
+ * @syn_scale: Window scale offered by the client, or -1 if none
+ * @sent: Number of data segments sent, including those sent again
+ * @lost: Number of data segments lost on purpose
+ * @resent: Number of data segments sent again
+ * @acks: Number of ACKs received
+ * @sacks: Number of ACKs received with SACK blocks
+ * @max_blocks: Largest number of SACK blocks in an ACK
+ * @requests: Number of requests received
+ * @partial: Number of requests answered with part of the file
+ * @resets: Number of connections reset by the client
+ * @prev_ethact: Value of ethact before the test
+ * @prev_ethrotate: Value of ethrotate before the test
+ */
+struct sb_http_server {
+	const char *body;
+	u32 size;
+	bool win_scale;
+	bool ranges;
+	u32 max_flight;
+	uint lose_every;
+	uchar mac[ARP_HLEN];
+	struct sb_http_conn conns[SB_HTTP_CONNS];
+	u32 snd_wnd;
+	u16 syn_win;
+	int syn_scale;
+	ulong sent;
+	ulong lost;
+	ulong resent;
+	ulong acks;
+	ulong sacks;
+	int max_blocks;
+	int requests;
+	int partial;
+	int resets;
+	char *prev_ethact;
+	char *prev_ethrotate;
+};
+
+/* Send a segment to the client, returning false if there is no room */
+static bool sb_http_send(struct udevice *dev, struct sb_http_server *srv,
+			 struct sb_http_conn *conn, u8 flags, u32 seq,
+			 const void *data, int len, const u8 *opts,
+			 int opts_len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth;
+	struct ip_tcp_hdr *tcp;
+	int pkt_len = IP_TCP_HDR_SIZE + opts_len + len;
+
+	if (priv->recv_packets >= PKTBUFSRX)
+		return false;
+
+	eth = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	memcpy(eth->et_dest, srv->mac, ARP_HLEN);
+	memcpy(eth->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth->et_protlen = htons(PROT_IP);
+
+	tcp = (void *)eth + ETHER_HDR_SIZE;
+	tcp->tcp_src = conn->ip.tcp_dst;
+	tcp->tcp_dst = conn->ip.tcp_src;
+	tcp->tcp_seq = htonl(seq);
+	tcp->tcp_ack = htonl(conn->irs + 1 + conn->rcv_nxt);
+	tcp->tcp_hlen = SHIFT_TO_TCPHDRLEN_FIELD(LEN_B_TO_DW(TCP_HDR_SIZE +
+							     opts_len));
+	tcp->tcp_flags = flags;
+	tcp->tcp_win = htons(0xffff);
+	tcp->tcp_ugr = 0;
+	memcpy((void *)tcp + IP_TCP_HDR_SIZE, opts, opts_len);
+	memcpy((void *)tcp + IP_TCP_HDR_SIZE + opts_len, data, len);
+	tcp->tcp_xsum = 0;
+	tcp->tcp_xsum = tcp_set_pseudo_header((uchar *)tcp, conn->ip.ip_src,
+					      conn->ip.ip_dst,
+					      pkt_len - IP_HDR_SIZE, pkt_len);
+	net_set_ip_header((uchar *)tcp, conn->ip.ip_src, conn->ip.ip_dst,
+			  pkt_len, IPPROTO_TCP);
+
+	priv->recv_packet_length[priv->recv_packets] = ETHER_HDR_SIZE +
+		pkt_len;
+	++priv->recv_packets;
+
+	return true;
+}
+
+/*
+ * Send the data segment at @offs, returning its length, or 0 if there is no
+ * room for it. A few places in the ring are left for the SYN-ACKs and FINs of
+ * other connections. The last segment is never lost, since the client would
+ * only notice after a timeout.
+ */
+static int sb_http_segment(struct udevice *dev, struct sb_http_server *srv,
+			   struct sb_http_conn *conn, u32 offs, bool resend)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	u32 total = conn->hdr_len + conn->len;
+	const char *data;
+	int len;
+
+	if (priv->recv_packets >= PKTBUFSRX - SB_HTTP_CONNS)
+		return 0;
+
+	if (offs < conn->hdr_len) {
+		data = conn->hdr + offs;
+		len = conn->hdr_len - offs;
+	} else {
+		data = srv->body + conn->start + offs - conn->hdr_len;
+		len = min(total - offs, (u32)TCP_MSS);
+		if (!resend && srv->lose_every && offs + len < total &&
+		    !(((offs - conn->hdr_len) / TCP_MSS + 1) % srv->lose_every)) {
+			srv->lost++;
+			return len;
+		}
+	}
+
+	if (!sb_http_send(dev, srv, conn, TCP_ACK, conn->iss + 1 + offs, data,
+			  len, NULL, 0))
+		return 0;
+	srv->sent++;
+	if (resend)
+		srv->resent++;
+
+	return len;
+}
+
+/* Mark the data in the SACK blocks of an ACK, returning how many there are */
+static int sb_http_sack(struct sb_http_conn *conn, struct ip_tcp_hdr *tcp)
+{
+	u8 *opt = (void *)tcp + IP_TCP_HDR_SIZE;
+	u8 *end = (void *)tcp + IP_HDR_SIZE +
+		GET_TCP_HDR_LEN_IN_BYTES(tcp->tcp_hlen);
+	int i, count = 0;
+	u32 l, r;
+
+	while (opt < end && *opt != TCP_O_END) {
+		if (*opt == TCP_1_NOP) {
+			opt++;
+			continue;
+		}
+		if (*opt == TCP_V_SACK) {
+			count = (opt[1] - TCP_OPT_LEN_2) / TCP_SACK_SIZE;
+			for (i = 0; i < count; i++) {
+				l = get_unaligned_be32(opt + 2 + i * 8) -
+					conn->iss - 1;
+				r = get_unaligned_be32(opt + 6 + i * 8) -
+					conn->iss - 1;
+				conn->high_sack = max(conn->high_sack, r);
+				for (; l < r; l += TCP_MSS)
+					conn->sacked[(l - conn->hdr_len) / TCP_MSS] = true;
+			}
+		}
+		opt += opt[1];
+	}
+
+	return count;
+}
+
+/* Find the connection from a client port, or a free one if @port is 0 */
+static struct sb_http_conn *sb_http_find(struct sb_http_server *srv, u16 port)
+{
+	struct sb_http_conn *conn;
+
+	for (conn = srv->conns; conn < srv->conns + SB_HTTP_CONNS; conn++) {
+		if (conn->port == port)
+			return conn;
+	}
+
+	return NULL;
+}
+
+/* Answer the client's SYN, offering SACK and perhaps window scaling */
+static void sb_http_syn(struct udevice *dev, struct sb_http_server *srv,
+			struct ethernet_hdr *eth, struct ip_tcp_hdr *tcp)
+{
+	u8 *opt = (void *)tcp + IP_TCP_HDR_SIZE;
+	u8 *end = (void *)tcp + IP_HDR_SIZE +
+		GET_TCP_HDR_LEN_IN_BYTES(tcp->tcp_hlen);
+	u8 opts[12] = {
+		TCP_O_MSS, TCP_OPT_LEN_4, TCP_MSS >> 8, TCP_MSS & 0xff,
+		TCP_P_SACK, TCP_OPT_LEN_2, TCP_1_NOP, TCP_1_NOP,
+		TCP_1_NOP, TCP_O_SCL, TCP_OPT_LEN_3, 0,
+	};
+	struct sb_http_conn *conn;
+	bool *sacked;
+
+	/* the SYN is sent again if the SYN-ACK is lost */
+	conn = sb_http_find(srv, ntohs(tcp->tcp_src));
+	if (!conn)
+		conn = sb_http_find(srv, 0);
+	if (!conn)
+		return;
+
+	sacked = conn->sacked;
+	memset(conn, '\0', sizeof(*conn));
+	memset(sacked, '\0', DIV_ROUND_UP(srv->size, TCP_MSS));
+	conn->sacked = sacked;
+	conn->port = ntohs(tcp->tcp_src);
+	memcpy(srv->mac, eth->et_src, ARP_HLEN);
+	memcpy(&conn->ip, tcp, sizeof(conn->ip));
+	conn->irs = ntohl(tcp->tcp_seq);
+	conn->iss = ~conn->irs;
+	srv->syn_win = ntohs(tcp->tcp_win);
+	srv->syn_scale = -1;
+
+	while (opt < end && *opt != TCP_O_END) {
+		if (*opt == TCP_1_NOP) {
+			opt++;
+			continue;
+		}
+		if (*opt == TCP_O_SCL)
+			srv->syn_scale = opt[2];
+		opt += opt[1];
+	}
+	conn->wnd_shift = srv->win_scale && srv->syn_scale >= 0 ?
+		srv->syn_scale : 0;
+
+	sb_http_send(dev, srv, conn, TCP_SYN | TCP_ACK, conn->iss, NULL, 0,
+		     opts, srv->win_scale ? 12 : 8);
+}
+
+/* Collect the request and prepare the header of the response */
+static void sb_http_request(struct sb_http_server *srv,
+			    struct sb_http_conn *conn, const char *data,
+			    int len)
+{
+	const char *range;
+	char *tail;
+	u32 last;
+
+	len = min(len, (int)sizeof(conn->req) - 1 - conn->req_len);
+	memcpy(conn->req + conn->req_len, data, len);
+	conn->req_len += len;
+	conn->req[conn->req_len] = '\0';
+	if (conn->hdr_len || !strstr(conn->req, "\r\n\r\n"))
+		return;
+
+	srv->requests++;
+	conn->start = 0;
+	conn->len = srv->size;
+	range = strstr(conn->req, "Range: bytes=");
+	if (srv->ranges && range) {
+		range += strlen("Range: bytes=");
+		conn->start = simple_strtoul(range, &tail, 10);
+		last = srv->size - 1;
+		if (tail[1] != '\r')
+			last = min(last, (u32)simple_strtoul(tail + 1, NULL,
+							     10));
+		conn->len = last + 1 - conn->start;
+		conn->hdr_len = snprintf(conn->hdr, sizeof(conn->hdr),
+					 "HTTP/1.1 206 Partial Content\r\n"
+					 "Content-Range: bytes %u-%u/%u\r\n"
+					 "Content-Length: %u\r\n"
+					 "Connection: close\r\n\r\n",
+					 conn->start, last, srv->size,
+					 conn->len);
+		srv->partial++;
+	} else {
+		conn->hdr_len = snprintf(conn->hdr, sizeof(conn->hdr),
+					 "HTTP/1.1 200 OK\r\n"
+					 "Content-Length: %u\r\n"
+					 "Connection: close\r\n\r\n",
+					 srv->size);
+	}
+}
+
+/* Handle an ACK, noting what the client has received */
+static void sb_http_ack(struct sb_http_server *srv, struct sb_http_conn *conn,
+			struct ip_tcp_hdr *tcp, u32 data_len)
+{
+	int count;
+	bool dup;
+	u32 ack;
+
+	ack = ntohl(tcp->tcp_ack) - conn->iss - 1;
+	srv->acks++;
+	srv->snd_wnd = ntohs(tcp->tcp_win) << conn->wnd_shift;
+	dup = !data_len && ack == conn->snd_una && ack < conn->snd_nxt;
+	if ((s32)(ack - conn->snd_una) > 0)
+		conn->snd_una = ack;
+
+	count = sb_http_sack(conn, tcp);
+	if (count) {
+		srv->sacks++;
+		srv->max_blocks = max(srv->max_blocks, count);
+	} else if (dup) {
+		/* without SACK, a duplicate ACK shows the next segment is lost */
+		conn->high_sack = max(conn->high_sack, conn->snd_una + 1);
+	}
+}
+
+/*
+ * Send again what is missing below the highest data received, then new data
+ * within the window. The other connections may have filled the receive ring
+ * when this one was last acknowledged, so this is done for all of them after
+ * each packet, making up for the lack of a retransmit timer.
+ */
+static void sb_http_push(struct udevice *dev, struct sb_http_server *srv,
+			 struct sb_http_conn *conn)
+{
+	u32 total = conn->hdr_len + conn->len;
+	struct sb_http_conn *other;
+	int len, active = 0;
+	u32 offs, wnd;
+
+	offs = max(conn->snd_una, conn->high_rxt);
+	while (offs < min(conn->high_sack, total)) {
+		len = min(total - offs, (u32)TCP_MSS);
+		if (!conn->sacked[(offs - conn->hdr_len) / TCP_MSS] &&
+		    !sb_http_segment(dev, srv, conn, offs, true))
+			break;
+		offs += len;
+	}
+	conn->high_rxt = max(conn->high_rxt, offs);
+
+	wnd = srv->max_flight ? min(srv->max_flight, srv->snd_wnd) :
+		srv->snd_wnd;
+
+	/*
+	 * Share the ring between the connections, as a link would be, so that
+	 * the data of one cannot hold up the others
+	 */
+	for (other = srv->conns; other < srv->conns + SB_HTTP_CONNS; other++)
+		active += other->port && other->hdr_len;
+	if (active > 1)
+		wnd = min(wnd, (u32)(PKTBUFSRX - SB_HTTP_CONNS) / active *
+			  TCP_MSS);
+
+	while (conn->snd_nxt < total) {
+		len = conn->snd_nxt < conn->hdr_len ? conn->hdr_len :
+			min(total - conn->snd_nxt, (u32)TCP_MSS);
+		if (conn->snd_nxt + len > conn->snd_una + wnd)
+			break;
+		len = sb_http_segment(dev, srv, conn, conn->snd_nxt, false);
+		if (!len)
+			break;
+		conn->snd_nxt += len;
+	}
+
+	if (conn->hdr_len && conn->snd_una == total && !conn->fin_sent) {
+		if (sb_http_send(dev, srv, conn, TCP_ACK | TCP_FIN,
+				 conn->iss + 1 + total, NULL, 0, NULL, 0))
+			conn->fin_sent = true;
+	}
+}
+
+static int sb_http_stream_handler(struct udevice *dev, void *packet,
+				  unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_http_server *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_tcp_hdr *tcp = packet + ETHER_HDR_SIZE;
+	struct sb_http_conn *conn;
+	u32 seq, data_len;
+
+	if (ntohs(eth->et_protlen) == PROT_ARP)
+		return sb_arp_handler(dev, packet, len);
+	if (ntohs(eth->et_protlen) != PROT_IP || tcp->ip_p != IPPROTO_TCP)
+		return 0;
+
+	if (tcp->tcp_flags == TCP_SYN) {
+		sb_http_syn(dev, srv, eth, tcp);
+		return 0;
+	}
+
+	conn = sb_http_find(srv, ntohs(tcp->tcp_src));
+	if (!conn)
+		return 0;
+	if (tcp->tcp_flags & TCP_RST) {
+		conn->port = 0;
+		srv->resets++;
+		goto push;
+	}
+	if (!(tcp->tcp_flags & TCP_ACK))
+		return 0;
+
+	seq = ntohl(tcp->tcp_seq) - conn->irs - 1;
+	data_len = ntohs(tcp->ip_len) - IP_HDR_SIZE -
+		GET_TCP_HDR_LEN_IN_BYTES(tcp->tcp_hlen);
+	if (seq == conn->rcv_nxt && data_len) {
+		conn->rcv_nxt += data_len;
+		sb_http_request(srv, conn, (void *)tcp + IP_HDR_SIZE +
+				GET_TCP_HDR_LEN_IN_BYTES(tcp->tcp_hlen),
+				data_len);
+	}
+	if (tcp->tcp_flags & TCP_FIN) {
+		conn->rcv_nxt = seq + data_len + 1;
+		sb_http_send(dev, srv, conn, TCP_ACK,
+			     conn->iss + 2 + conn->hdr_len + conn->len, NULL,
+			     0, NULL, 0);
+		return 0;
+	}
+	sb_http_ack(srv, conn, tcp, data_len);
+
+push:
+	for (conn = srv->conns; conn < srv->conns + SB_HTTP_CONNS; conn++) {
+		if (conn->port)
+			sb_http_push(dev, srv, conn);
+	}
+
+	return 0;
+}
+
+/* Fill @size bytes at @buf with a pattern which differs from block to block */
+static void sb_http_fill(char *buf, size_t size)
+{
+	u32 val = 0x12345678;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		val = val * 1103515245 + 12345;
+		buf[i] = val >> 16;
+	}
+}
+
+static int sb_http_setup(struct unit_test_state *uts,
+			 struct sb_http_server *srv, u32 size)
+{
+	char *body;
+	int i;
+
+	body = malloc(size);
+	ut_assertnonnull(body);
+	sb_http_fill(body, size);
+	memset(srv, '\0', sizeof(*srv));
+	srv->body = body;
+	srv->size = size;
+	for (i = 0; i < SB_HTTP_CONNS; i++) {
+		srv->conns[i].sacked = calloc(DIV_ROUND_UP(size, TCP_MSS),
+					      sizeof(bool));
+		ut_assertnonnull(srv->conns[i].sacked);
+	}
+
+	srv->prev_ethact = env_get("ethact");
+	srv->prev_ethrotate = env_get("ethrotate");
+	sandbox_eth_set_tx_handler(0, sb_http_stream_handler);
+	sandbox_eth_set_priv(0, srv);
+	env_set("ethact", "eth@10002000");
+	env_set("ethrotate", "no");
+
+	return 0;
+}
+
+static void sb_http_finish(struct sb_http_server *srv)
+{
+	int i;
+
+	sandbox_eth_set_tx_handler(0, NULL);
+	sandbox_eth_set_priv(0, NULL);
+	env_set("ethact", srv->prev_ethact);
+	env_set("ethrotate", srv->prev_ethrotate);
+	free((char *)srv->body);
+	for (i = 0; i < SB_HTTP_CONNS; i++)
+		free(srv->conns[i].sacked);
+}
+
+/* Drop the connections and statistics left by the last download */
+static void sb_http_reset(struct sb_http_server *srv)
+{
+	int i;
+
+	for (i = 0; i < SB_HTTP_CONNS; i++)
+		srv->conns[i].port = 0;
+	srv->sent = 0;
+	srv->lost = 0;
+	srv->resent = 0;
+	srv->acks = 0;
+	srv->sacks = 0;
+	srv->max_blocks = 0;
+	srv->requests = 0;
+	srv->partial = 0;
+	srv->resets = 0;
+}
+
+/* Download the file and check it arrived intact */
+static int sb_http_load(struct unit_test_state *uts,
+			struct sb_http_server *srv)
+{
+	int i;
+
+	sb_http_reset(srv);
+	memset(map_sysmem(TEST_ADDR, srv->size), '\0', srv->size);
+	ut_assertok(run_commandf("wget %x 1.1.2.2:/file", TEST_ADDR));
+	ut_asserteq(srv->size, env_get_hex("filesize", 0));
+	ut_asserteq_mem(srv->body, map_sysmem(TEST_ADDR, srv->size),
+			srv->size);
+
+	/* each connection is closed by the server, unless reset */
+	for (i = 0; i < SB_HTTP_CONNS; i++)
+		ut_assert(!srv->conns[i].port || srv->conns[i].fin_sent);
+
+	return 0;
+}
+
+/* Test that the receive window is scaled, if the server agrees to it */
+static int net_test_wget_window(struct unit_test_state *uts)
+{
+	struct sb_http_server srv;
+	int shift;
+
+	ut_assertok(sb_http_setup(uts, &srv, TEST_SIZE));
+
+	for (shift = 0; TEST_RCV_WND >> shift > 0xffff; shift++)
+		;
+	srv.win_scale = true;
+	ut_assertok(sb_http_load(uts, &srv));
+	ut_asserteq(shift, srv.syn_scale);
+	ut_asserteq(min(TEST_RCV_WND, 0xffff), srv.syn_win);
+	ut_asserteq(TEST_RCV_WND >> shift << shift, srv.snd_wnd);
+	ut_asserteq(0, srv.resent);
+
+	/*
+	 * in-order data is acknowledged every other segment, plus the ACKs
+	 * which complete the handshake, carry the request and close
+	 */
+	ut_assert(srv.acks <= srv.sent / 2 + 4);
+
+	srv.win_scale = false;
+	ut_assertok(sb_http_load(uts, &srv));
+	ut_asserteq(min(TEST_RCV_WND, 0xffff), srv.snd_wnd);
+
+	sb_http_finish(&srv);
+
+	return 0;
+}
+CMD_TEST(net_test_wget_window, 0);
+
+/* Test that only lost segments are sent again */
+static int net_test_wget_sack(struct unit_test_state *uts)
+{
+	struct sb_http_server srv;
+
+	ut_assertok(sb_http_setup(uts, &srv, TEST_SIZE));
+	srv.win_scale = true;
+	srv.lose_every = 10;
+
+	ut_assertok(sb_http_load(uts, &srv));
+	ut_assert(srv.lost > 0);
+	ut_asserteq(srv.lost, srv.resent);
+	if (IS_ENABLED(CONFIG_PROT_TCP_SACK)) {
+		ut_assert(srv.sacks > 0);
+		ut_assert(srv.max_blocks > 1);
+		ut_assert(srv.max_blocks <= TCP_SACK_SEND);
+	}
+
+	sb_http_finish(&srv);
+
+	return 0;
+}
+CMD_TEST(net_test_wget_sack, 0);
+
+/* Test fetching a file in ranges over several connections */
+static int net_test_wget_ranges(struct unit_test_state *uts)
+{
+	u8 digest[HASH_MAX_DIGEST_SIZE];
+	char spec[8 + HASH_MAX_DIGEST_SIZE * 2 + 1];
+	struct sb_http_server srv;
+
+	if (!IS_ENABLED(CONFIG_WGET_RANGES))
+		return -EAGAIN;
+
+	ut_assertok(sb_http_setup(uts, &srv, TEST_SIZE));
+	srv.win_scale = true;
+	srv.ranges = true;
+	ut_assertok(env_set("wgetconns", "4"));
+
+	/* the first connection asks for it all, then is reset */
+	ut_assertok(sb_http_load(uts, &srv));
+	ut_asserteq(4, srv.requests);
+	ut_asserteq(4, srv.partial);
+	ut_asserteq(1, srv.resets);
+	ut_asserteq(0, srv.resent);
+
+	/* losses on all connections are recovered */
+	srv.lose_every = 10;
+	ut_assertok(sb_http_load(uts, &srv));
+	ut_asserteq(4, srv.requests);
+	ut_assert(srv.lost > 0);
+	srv.lose_every = 0;
+
+	/* the file is checked if a hash is given */
+	ut_assertok(hash_block("sha256", srv.body, srv.size, digest, NULL));
+	strcpy(spec, "sha256:");
+	*bin2hex(spec + 7, digest, 32) = '\0';
+	ut_assertok(env_set("wgethash", spec));
+	ut_assertok(sb_http_load(uts, &srv));
+	spec[7] = spec[7] == '0' ? '1' : '0';
+	ut_assertok(env_set("wgethash", spec));
+	sb_http_reset(&srv);
+	ut_asserteq(1, run_commandf("wget %x 1.1.2.2:/file", TEST_ADDR));
+	ut_assertok(env_set("wgethash", NULL));
+
+	/* a server which ignores ranges sends the whole file at once */
+	srv.ranges = false;
+	ut_assertok(sb_http_load(uts, &srv));
+	ut_asserteq(1, srv.requests);
+	ut_asserteq(0, srv.partial);
+	ut_asserteq(0, srv.resets);
+
+	/* by default a single connection is used, with no range */
+	srv.ranges = true;
+	ut_assertok(env_set("wgetconns", NULL));
+	ut_assertok(sb_http_load(uts, &srv));
+	ut_asserteq(1, srv.requests);
+	ut_asserteq(0, srv.partial);
+
+	sb_http_finish(&srv);
+
+	return 0;
+}
+CMD_TEST(net_test_wget_ranges, 0);
+
+/* Test writing the file to a block device while it arrives */
+static int net_test_wget_sink(struct unit_test_state *uts)
+{
+	struct sb_http_server srv;
+	struct udevice *dev, *blk;
+	struct blk_desc *desc;
+	char *buf;
+
+	if (!IS_ENABLED(CONFIG_NET_SINK))
+		return -EAGAIN;
+
+	ut_assertok(sb_http_setup(uts, &srv, TEST_SIZE));
+	srv.win_scale = true;
+	buf = calloc(1, SZ_2M);
+	ut_assertnonnull(buf);
+	ut_assertok(os_write_file(SINK_FILE, buf, SZ_2M));
+	ut_assertok(host_create_attach_file("netsink", SINK_FILE, false, 512,
+					    &dev));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	desc = dev_get_uclass_plat(blk);
+
+	/*
+	 * The window covers three of the four chunks of the staging buffer,
+	 * and the file is fetched over a single connection
+	 */
+	ut_assertok(env_set("wgetconns", "4"));
+	srv.ranges = true;
+	srv.lose_every = 10;
+	sb_http_reset(&srv);
+	memset(map_sysmem(TEST_ADDR, srv.size), '\0', srv.size);
+	ut_assertok(run_commandf("netsink blk host %d:0 %x", desc->devnum,
+				 SINK_BUF_SIZE));
+	ut_assertok(run_commandf("wget %x 1.1.2.2:/file", TEST_ADDR));
+	ut_asserteq(srv.size, env_get_hex("filesize", 0));
+	ut_asserteq(1, srv.requests);
+	ut_assert(srv.lost > 0);
+	ut_asserteq(SINK_BUF_SIZE * 3 / 4 >> srv.syn_scale << srv.syn_scale,
+		    srv.snd_wnd);
+	ut_assertnull(net_sink_get());
+
+	ut_asserteq(SZ_2M / 512, blk_dread(desc, 0, SZ_2M / 512, buf));
+	ut_asserteq_mem(srv.body, buf, srv.size);
+	ut_assertnull(memchr_inv(map_sysmem(TEST_ADDR + SINK_BUF_SIZE, 0), 0,
+				 srv.size - SINK_BUF_SIZE));
+
+	free(buf);
+	ut_assertok(env_set("wgetconns", NULL));
+	ut_assertok(run_command("host unbind netsink", 0));
+	os_unlink(SINK_FILE);
+	sb_http_finish(&srv);
+
+	return 0;
+}
+CMD_TEST(net_test_wget_sink, 0);
+
+static ulong sb_http_speed(struct unit_test_state *uts,
+			   struct sb_http_server *srv)
+{
+	ulong start, us;
+
+	start = timer_get_us();
+	if (sb_http_load(uts, srv))
+		return 0;
+	us = timer_get_us() - start;
+
+	return (ulong)((u64)srv->size * 1000000 / SZ_1M / max(us, 1UL));
+}
+
+/* Print the wget throughput for a few windows, with and without losses */
+static int net_test_wget_speed_norun(struct unit_test_state *uts)
+{
+	static const u32 flights[] = { 4, 16, 0 };
+	struct sb_http_server srv;
+	ulong speed;
+	int i;
+
+	ut_assertok(sb_http_setup(uts, &srv, SPEED_SIZE));
+	srv.win_scale = true;
+	for (i = 0; i < ARRAY_SIZE(flights) * 2; i++) {
+		srv.max_flight = flights[i / 2] * TCP_MSS;
+		srv.lose_every = i % 2 ? 100 : 0;
+		speed = sb_http_speed(uts, &srv);
+		ut_assert(speed);
+		printf("window %7u, loss %3s: %4lu MiB/s, %lu segments, %lu resent, %lu acks\n",
+		       srv.max_flight ? srv.max_flight : srv.snd_wnd,
+		       srv.lose_every ? "1%" : "0%", speed, srv.sent,
+		       srv.resent, srv.acks);
+	}
+	sb_http_finish(&srv);
+
+	return 0;
+}
+CMD_TEST(net_test_wget_speed_norun, UTF_MANUAL);
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for nested bootstage accumulators and device-probe timing
+ */
+
+#include <bootstage.h>
+#include <dm.h>
+#include <malloc.h>
+#include <dm/device-internal.h>
+#include <test/common.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* A record from the output of bootstage_export() */
+struct export_rec {
+	char type;
+	int id;
+	int parent;
+	ulong start_us;
+	ulong total_us;
+	ulong self_us;
+	int count;
+	char uclass[20];
+};
+
+/* Find the record with the given type and name in the export */
+static int find_rec(struct unit_test_state *uts, const char *buf, char type,
+		    const char *name, struct export_rec *rec)
+{
+	int len = strlen(name);
+	const char *line;
+	int pos;
+
+	for (line = buf; *line; line = strchr(line, '\n') + 1) {
+		if (*line == '#')
+			continue;
+		pos = 0;
+		ut_asserteq(8, sscanf(line, "%c %d %d %lu %lu %lu %d %19s %n",
+				      &rec->type, &rec->id, &rec->parent,
+				      &rec->start_us, &rec->total_us,
+				      &rec->self_us, &rec->count, rec->uclass,
+				      &pos));
+		if (rec->type == type && !strncmp(line + pos, name, len) &&
+		    line[pos + len] == '\n')
+			return 0;
+	}
+
+	return -ENOENT;
+}
+
+/* Export everything into a newly allocated buffer */
+static char *export_all(void)
+{
+	char *buf;
+	int len;
+
+	len = bootstage_export((char []){ 0 }, 0);
+	buf = malloc(len + 1);
+	if (buf)
+		bootstage_export(buf, len + 1);
+
+	return buf;
+}
+
+/* Test that accumulators record which one they were started inside */
+static int bootstage_test_scope(struct unit_test_state *uts)
+{
+	struct export_rec outer, inner, dev;
+	char *buf;
+	int id;
+
+	bootstage_start(BOOTSTAGE_ID_ACCUM_FSP_M, "test_outer");
+	bootstage_start(BOOTSTAGE_ID_ACCUM_FSP_S, "test_inner");
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_FSP_S);
+	bootstage_start(BOOTSTAGE_ID_ACCUM_FSP_S, "test_inner");
+	id = bootstage_probe_start("bootstage-test", UCLASS_TEST);
+	if (id >= 0)
+		bootstage_accum(id);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_FSP_S);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_FSP_M);
+
+	buf = export_all();
+	ut_assertnonnull(buf);
+	ut_assertok(find_rec(uts, buf, 'a', "test_outer", &outer));
+	ut_assertok(find_rec(uts, buf, 'a', "test_inner", &inner));
+	if (id >= 0)
+		ut_assertok(find_rec(uts, buf, 'p', "bootstage-test", &dev));
+	free(buf);
+
+	ut_asserteq(BOOTSTAGE_ID_ACCUM_FSP_M, outer.id);
+	ut_asserteq(0, outer.parent);
+	ut_asserteq(BOOTSTAGE_ID_ACCUM_FSP_M, inner.parent);
+	ut_asserteq_str("-", inner.uclass);
+	ut_assert(inner.count >= 2);
+	ut_assert(inner.start_us >= outer.start_us);
+	ut_assert(outer.total_us >= inner.total_us);
+	ut_asserteq(outer.total_us - inner.total_us, outer.self_us);
+
+	/* the device is inside the inner accumulator, if there was space */
+	if (id >= 0) {
+		ut_asserteq(id, dev.id);
+		ut_asserteq(BOOTSTAGE_ID_ACCUM_FSP_S, dev.parent);
+		ut_asserteq_str("test", dev.uclass);
+		ut_asserteq(dev.total_us, dev.self_us);
+		ut_asserteq(inner.total_us - dev.total_us, inner.self_us);
+	} else {
+		ut_asserteq(-ENOSPC, id);
+		ut_asserteq(inner.total_us, inner.self_us);
+	}
+
+	return 0;
+}
+COMMON_TEST(bootstage_test_scope, 0);
+
+/* Test that device_probe() records the time taken to probe each device */
+static int bootstage_test_probe(struct unit_test_state *uts)
+{
+	struct export_rec first, rec;
+	struct udevice *dev;
+	char *buf;
+
+	if (!IS_ENABLED(CONFIG_BOOTSTAGE_PROBE))
+		return -EAGAIN;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_TEST_FDT, "a-test",
+					      &dev));
+	buf = export_all();
+	ut_assertnonnull(buf);
+
+	/* there may be no space left for a new device */
+	if (find_rec(uts, buf, 'p', "a-test", &first)) {
+		free(buf);
+		return -EAGAIN;
+	}
+	free(buf);
+	ut_asserteq_str("testfdt", first.uclass);
+
+	/* probing it again adds to the same record */
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	ut_assertok(device_probe(dev));
+
+	buf = export_all();
+	ut_assertnonnull(buf);
+	ut_assertok(find_rec(uts, buf, 'p', "a-test", &rec));
+	free(buf);
+	ut_asserteq(first.id, rec.id);
+	ut_asserteq(first.count + 1, rec.count);
+	ut_assert(rec.total_us >= first.total_us);
+
+	/* the export is cut short if the buffer is too small */
+	buf = malloc(10);
+	ut_assertnonnull(buf);
+	ut_assert(bootstage_export(buf, 10) > 10);
+	ut_asserteq(9, strlen(buf));
+	free(buf);
+
+	return 0;
+}
+COMMON_TEST(bootstage_test_probe, 0);
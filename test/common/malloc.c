@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the malloc() slabs
+ */
+
+#include <command.h>
+#include <dm.h>
+#include <malloc.h>
+#include <time.h>
+#include <test/common.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define SPEED_OBJS	1000
+#define SPEED_ROUNDS	100
+
+/* Test that small allocations come from the slabs */
+static int test_malloc_slab(struct unit_test_state *uts)
+{
+	static const char zero[100];
+	char *ptr, *ptr2;
+	ulong start;
+
+	start = ut_check_free();
+	ptr = malloc(24);
+	ut_assertnonnull(ptr);
+	ut_asserteq(32, malloc_slab_usable_size(ptr));
+	ut_asserteq(32, malloc_usable_size(ptr));
+
+	/* the most recently freed object is used first */
+	free(ptr);
+	ptr2 = malloc(17);
+	ut_asserteq_ptr(ptr, ptr2);
+
+	/* growing within the slot stays put, beyond it moves */
+	memset(ptr, 'a', 17);
+	ut_asserteq_ptr(ptr, realloc(ptr, 32));
+	ptr2 = realloc(ptr, 100);
+	ut_assertnonnull(ptr2);
+	ut_assert(ptr2 != ptr);
+	ut_asserteq(128, malloc_slab_usable_size(ptr2));
+	ut_asserteq_mem("aaaaaaaaaaaaaaaaa", ptr2, 17);
+
+	/* calloc() clears an object that is reused */
+	memset(ptr2, '\xff', 100);
+	free(ptr2);
+	ptr = calloc(10, 10);
+	ut_asserteq_ptr(ptr2, ptr);
+	ut_asserteq_mem(zero, ptr, sizeof(zero));
+	free(ptr);
+
+	/* large and aligned allocations are left to dlmalloc */
+	ptr = malloc(257);
+	ut_assertnonnull(ptr);
+	ut_asserteq(0, malloc_slab_usable_size(ptr));
+	free(ptr);
+	ptr = memalign(64, 16);
+	ut_assertnonnull(ptr);
+	ut_asserteq(0, malloc_slab_usable_size(ptr));
+	free(ptr);
+
+	/* so are allocations in test mode, so failures happen as expected */
+	malloc_enable_testing(1);
+	ptr = malloc(16);
+	ut_assertnull(malloc(16));
+	malloc_disable_testing();
+	ut_assertnonnull(ptr);
+	ut_asserteq(0, malloc_slab_usable_size(ptr));
+	free(ptr);
+
+	/* mallinfo() counts the objects, not the slabs */
+	ut_assertok(ut_check_delta(start));
+
+	return 0;
+}
+COMMON_TEST(test_malloc_slab, 0);
+
+/* Test the slabinfo command */
+static int test_malloc_slabinfo(struct unit_test_state *uts)
+{
+	if (!IS_ENABLED(CONFIG_CMD_SLABINFO))
+		return -EAGAIN;
+
+	ut_assertok(run_command("slabinfo", 0));
+	ut_assert_nextlinen("Main pool: ");
+	ut_assert_nextline(" size  pages  in use     free      allocs       frees");
+	ut_assert_nextlinen("   16 ");
+	ut_assert_skip_to_linen("  256 ");
+	ut_assert_console_end();
+
+	return 0;
+}
+COMMON_TEST(test_malloc_slabinfo, UTF_CONSOLE);
+
+/* Allocate and free objects of the sizes that driver model uses */
+static ulong malloc_speed(void **ptrs)
+{
+	static const int sizes[] = {
+		sizeof(struct udevice), 16, 24, 40, 64, 96, 200,
+	};
+	ulong start;
+	int round, i;
+
+	start = timer_get_us();
+	for (round = 0; round < SPEED_ROUNDS; round++) {
+		for (i = 0; i < SPEED_OBJS; i++)
+			ptrs[i] = malloc(sizes[i % ARRAY_SIZE(sizes)]);
+
+		/* free every other one and refill the gaps, as unbind does */
+		for (i = 0; i < SPEED_OBJS; i += 2)
+			free(ptrs[i]);
+		for (i = 0; i < SPEED_OBJS; i += 2)
+			ptrs[i] = malloc(sizes[(i + 1) % ARRAY_SIZE(sizes)]);
+		for (i = 0; i < SPEED_OBJS; i++)
+			free(ptrs[i]);
+	}
+
+	/* each round does 3 * SPEED_OBJS calls */
+	return (timer_get_us() - start) * 1000 / (SPEED_ROUNDS * 3 * SPEED_OBJS);
+}
+
+/* Print how long malloc() and free() take with and without the slabs */
+static int test_malloc_speed_norun(struct unit_test_state *uts)
+{
+	ulong slab_ns, dl_ns;
+	void **ptrs;
+
+	ptrs = calloc(SPEED_OBJS, sizeof(*ptrs));
+	ut_assertnonnull(ptrs);
+
+	slab_ns = malloc_speed(ptrs);
+
+	/* test mode sends everything to dlmalloc */
+	malloc_enable_testing(INT_MAX);
+	dl_ns = malloc_speed(ptrs);
+	malloc_disable_testing();
+	free(ptrs);
+
+	printf("slab: %lu ns per call, dlmalloc: %lu ns per call\n", slab_ns,
+	       dl_ns);
+
+	return 0;
+}
+COMMON_TEST(test_malloc_speed_norun, UTF_MANUAL);
@@ -371,6 +371,9 @@ static int snprint(struct unit_test_state *uts)
 	ut_asserteq(7, ret);
 	ret = snprintf(buf, 4, "%s:%d", "abc", 9999);
 	ut_asserteq(8, ret);
+	ret = snprintf(buf, 2, "%c%c%s", 'a', 'b', "cd");
+	ut_asserteq_str("a", buf);
+	ut_asserteq(4, ret);
 	return 0;
 }
 COMMON_TEST(snprint, 0);
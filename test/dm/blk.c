@@ -294,3 +294,168 @@ static int dm_test_blk_foreach(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_foreach, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Test the set-associative block cache and its read-ahead */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats;
+	struct blk_desc *desc;
+	char wbuf[32 * 512], rbuf[16 * 512];
+	int i;
+
+	if (!CONFIG_IS_ENABLED(BLOCK_CACHE_READAHEAD))
+		return -EAGAIN;
+
+	ut_asserteq(2, blk_get_device_by_str("mmc", "2", &desc));
+	ut_asserteq(512, desc->blksz);
+	for (i = 0; i < ARRAY_SIZE(wbuf); i++)
+		wbuf[i] = i / 512;
+	ut_asserteq(32, blk_dwrite(desc, 0, 32, wbuf));
+
+	blkcache_configure(8, 32);
+
+	/* A miss reads the whole line, so its neighbours are then hits */
+	ut_asserteq(1, blk_dread(desc, 3, 1, rbuf));
+	ut_asserteq_mem(wbuf + 3 * 512, rbuf, 512);
+	ut_asserteq(1, blk_dread(desc, 5, 1, rbuf));
+	ut_asserteq_mem(wbuf + 5 * 512, rbuf, 512);
+	ut_asserteq(8, blk_dread(desc, 0, 8, rbuf));
+	ut_asserteq_mem(wbuf, rbuf, 8 * 512);
+
+	/* A read spanning two lines is not widened, but cached as is */
+	ut_asserteq(4, blk_dread(desc, 6, 4, rbuf));
+	ut_asserteq_mem(wbuf + 6 * 512, rbuf, 4 * 512);
+	ut_asserteq(1, blk_dread(desc, 12, 1, rbuf));
+	ut_asserteq_mem(wbuf + 12 * 512, rbuf, 512);
+	ut_asserteq(2, blk_dread(desc, 8, 2, rbuf));
+	ut_asserteq_mem(wbuf + 8 * 512, rbuf, 2 * 512);
+
+	/* Large reads bypass the cache */
+	ut_asserteq(16, blk_dread(desc, 16, 16, rbuf));
+	ut_asserteq_mem(wbuf + 16 * 512, rbuf, 16 * 512);
+
+	ut_assertok(blkcache_dev_stats(UCLASS_MMC, 2, &stats));
+	ut_asserteq(3, stats.hits);
+	ut_asserteq(3, stats.misses);
+	ut_asserteq(0, stats.evictions);
+	ut_asserteq(2, stats.entries);
+	ut_asserteq(11 * 512, stats.bytes_saved);
+
+	/* With a single set of four lines, the fifth line evicts the LRU */
+	ut_assertok(blkcache_configure_dev(UCLASS_MMC, 2, 4, 4));
+	for (i = 0; i < 5; i++) {
+		ut_asserteq(1, blk_dread(desc, i * 4, 1, rbuf));
+		ut_asserteq_mem(wbuf + i * 4 * 512, rbuf, 512);
+	}
+	ut_asserteq(1, blk_dread(desc, 17, 1, rbuf));
+	ut_asserteq(1, blk_dread(desc, 1, 1, rbuf));
+	ut_asserteq_mem(wbuf + 512, rbuf, 512);
+
+	ut_assertok(blkcache_dev_stats(UCLASS_MMC, 2, &stats));
+	ut_asserteq(1, stats.hits);
+	ut_asserteq(6, stats.misses);
+	ut_asserteq(2, stats.evictions);
+	ut_asserteq(4, stats.entries);
+	ut_asserteq(4, stats.max_entries);
+
+	/* A write drops the cached lines */
+	ut_asserteq(1, blk_dwrite(desc, 17, 1, wbuf));
+	ut_assertok(blkcache_dev_stats(UCLASS_MMC, 2, &stats));
+	ut_asserteq(0, stats.entries);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Test that sequential reads are served from the read-ahead window */
+static int dm_test_blk_readahead(struct unit_test_state *uts)
+{
+	struct blk_readahead_stats stats;
+	struct blk_desc *desc;
+	u8 buf[512];
+	int i;
+
+	if (!CONFIG_IS_ENABLED(BLK_READAHEAD))
+		return -EAGAIN;
+
+	ut_asserteq(2, blk_get_device_by_str("mmc", "2", &desc));
+	for (i = 0; i < 200; i++) {
+		memset(buf, i, sizeof(buf));
+		ut_asserteq(1, blk_dwrite(desc, i, 1, buf));
+	}
+
+	/* keep the block cache out of the way */
+	if (CONFIG_IS_ENABLED(BLOCK_CACHE))
+		blkcache_configure(0, 0);
+	ut_assertok(blk_readahead_stats(desc->bdev, &stats));
+
+	/*
+	 * Start away from the blocks read by the partition scan, so that the
+	 * first read is not sequential. It and the next read go to the device,
+	 * the third one is the second sequential read and fills a 64-block
+	 * window. The next fill is twice as large.
+	 */
+	for (i = 50; i < 150; i++) {
+		ut_asserteq(1, blk_dread(desc, i, 1, buf));
+		ut_asserteq(i, buf[0]);
+		ut_asserteq(i, buf[511]);
+	}
+	ut_assertok(blk_readahead_stats(desc->bdev, &stats));
+	ut_asserteq(98, stats.hits);
+	ut_asserteq(2, stats.fills);
+	ut_asserteq(64 + 128, stats.blocks);
+
+	/* A random read is not served from the window */
+	ut_asserteq(1, blk_dread(desc, 1000, 1, buf));
+	ut_asserteq(0, buf[0]);
+	ut_asserteq(1, blk_dread(desc, 150, 1, buf));
+	ut_asserteq(150, buf[0]);
+
+	/* A write drops the window */
+	memset(buf, 0xaa, sizeof(buf));
+	ut_asserteq(1, blk_dwrite(desc, 151, 1, buf));
+	ut_asserteq(1, blk_dread(desc, 151, 1, buf));
+	ut_asserteq(0xaa, buf[0]);
+	ut_assertok(blk_readahead_stats(desc->bdev, &stats));
+	ut_asserteq(1, stats.hits);
+	ut_asserteq(0, stats.fills);
+
+	if (CONFIG_IS_ENABLED(BLOCK_CACHE))
+		blkcache_configure(8, 32);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_readahead, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Test that asynchronous reads complete with the right data */
+static int dm_test_blk_async(struct unit_test_state *uts)
+{
+	struct blk_async req[2];
+	struct blk_desc *desc;
+	u8 wbuf[8 * 512], rbuf[2][4 * 512];
+	int i;
+
+	ut_asserteq(2, blk_get_device_by_str("mmc", "2", &desc));
+	for (i = 0; i < sizeof(wbuf); i++)
+		wbuf[i] = i / 512 + 1;
+	ut_asserteq(8, blk_dwrite(desc, 0, 8, wbuf));
+	memset(rbuf, '\0', sizeof(rbuf));
+
+	ut_assertok(blk_dread_async(desc, 0, 4, rbuf[0], &req[0]));
+	ut_assertok(blk_dread_async(desc, 4, 4, rbuf[1], &req[1]));
+
+	/* The threads only run once the caller yields */
+	if (CONFIG_IS_ENABLED(UTHREAD)) {
+		ut_asserteq(false, req[0].done);
+		ut_asserteq(false, req[1].done);
+		ut_asserteq(0, rbuf[0][0]);
+	}
+
+	ut_asserteq(4, blk_async_wait(&req[1]));
+	ut_asserteq(4, blk_async_wait(&req[0]));
+	ut_asserteq_mem(wbuf, rbuf[0], sizeof(rbuf[0]));
+	ut_asserteq_mem(wbuf + sizeof(rbuf[0]), rbuf[1], sizeof(rbuf[1]));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_async, UTF_SCAN_PDATA | UTF_SCAN_FDT);
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the devicetree index
+ */
+
+#include <command.h>
+#include <dm.h>
+#include <fdt_index.h>
+#include <fdt_support.h>
+#include <malloc.h>
+#include <asm/global_data.h>
+#include <dm/test.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Check that each lookup gives the same result as libfdt */
+static int check_lookups(struct unit_test_state *uts, const void *fdt)
+{
+	static const char *const paths[] = {
+		"/", "//", "", "/nonexistent", "/aliases/", "//aliases//",
+		"nonexistent", "nonexistent/node", "mmc0/nonexistent",
+	};
+	int offset, depth, i;
+	const char *name;
+	char path[256];
+
+	for (offset = 0, depth = 0; offset >= 0 && depth >= 0;
+	     offset = fdt_next_node(fdt, offset, &depth)) {
+		const char *at, *compat;
+		int parent, count;
+		u32 phandle;
+
+		ut_assertok(fdt_get_path(fdt, offset, path, sizeof(path)));
+		ut_asserteq(fdt_path_offset(fdt, path),
+			    fdt_index_path_offset(fdt, path));
+
+		phandle = fdt_get_phandle(fdt, offset);
+		if (phandle)
+			ut_asserteq(fdt_node_offset_by_phandle(fdt, phandle),
+				    fdt_index_node_offset_by_phandle(fdt,
+								     phandle));
+
+		if (depth) {
+			parent = fdt_parent_offset(fdt, offset);
+			name = fdt_get_name(fdt, offset, NULL);
+			ut_asserteq(fdt_subnode_offset(fdt, parent, name),
+				    fdt_index_subnode_offset(fdt, parent, name));
+
+			/* without the unit address */
+			at = strchr(name, '@');
+			if (at) {
+				strlcpy(path, name, at - name + 1);
+				ut_asserteq(fdt_subnode_offset(fdt, parent, path),
+					    fdt_index_subnode_offset(fdt, parent,
+								     path));
+			}
+		}
+
+		count = fdt_stringlist_count(fdt, offset, "compatible");
+		for (i = 0; i < count; i++) {
+			compat = fdt_stringlist_get(fdt, offset, "compatible", i,
+						    NULL);
+			ut_asserteq(fdt_node_offset_by_compatible(fdt, -1,
+								  compat),
+				    fdt_index_node_offset_by_compatible(fdt, -1,
+									compat));
+			ut_asserteq(fdt_node_offset_by_compatible(fdt, offset,
+								  compat),
+				    fdt_index_node_offset_by_compatible(fdt,
+									offset,
+									compat));
+		}
+	}
+
+	offset = fdt_path_offset(fdt, "/aliases");
+	ut_assert(offset > 0);
+	for (i = fdt_first_property_offset(fdt, offset); i >= 0;
+	     i = fdt_next_property_offset(fdt, i)) {
+		fdt_getprop_by_offset(fdt, i, &name, NULL);
+		ut_asserteq(fdt_path_offset(fdt, name),
+			    fdt_index_path_offset(fdt, name));
+	}
+
+	for (i = 0; i < ARRAY_SIZE(paths); i++)
+		ut_asserteq(fdt_path_offset(fdt, paths[i]),
+			    fdt_index_path_offset(fdt, paths[i]));
+	ut_asserteq(-FDT_ERR_BADPHANDLE,
+		    fdt_index_node_offset_by_phandle(fdt, 0));
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdt_index_node_offset_by_phandle(fdt, 0xfffffffe));
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdt_index_node_offset_by_compatible(fdt, -1, "nonexistent"));
+
+	return 0;
+}
+
+/* Test the index gives the same results as libfdt, as the tree changes */
+static int dm_test_fdt_index(struct unit_test_state *uts)
+{
+	int size, offset;
+	u32 phandle;
+	void *fdt;
+
+	size = fdt_totalsize(gd->fdt_blob) + 4096;
+	fdt = malloc(size);
+	ut_assertnonnull(fdt);
+	ut_assertok(fdt_open_into(gd->fdt_blob, fdt, size));
+	ut_assertok(fdt_index_build(fdt));
+	ut_assertok(check_lookups(uts, fdt));
+
+	/* adding a node moves the ones after it, so libfdt must be used */
+	ut_assert(fdt_add_subnode(fdt, 0, "aaa-new") > 0);
+	offset = fdt_index_path_offset(fdt, "/aaa-new");
+	ut_assert(offset > 0);
+	ut_assertok(fdt_setprop_string(fdt, offset, "compatible", "new"));
+	ut_asserteq(offset, fdt_index_node_offset_by_compatible(fdt, -1,
+								"new"));
+	ut_assertok(check_lookups(uts, fdt));
+
+	/* changes which keep the size need the index to be dropped */
+	phandle = fdt_get_max_phandle(fdt) + 1;
+	ut_assertok(fdt_setprop_u32(fdt, offset, "phandle", phandle));
+	ut_assertok(fdt_index_build(fdt));
+	ut_asserteq(offset, fdt_index_node_offset_by_phandle(fdt, phandle));
+	ut_assertok(fdt_setprop_inplace_u32(fdt, offset, "phandle",
+					    phandle + 1));
+	fdt_index_invalidate(fdt);
+	ut_asserteq(offset, fdt_index_node_offset_by_phandle(fdt, phandle + 1));
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdt_index_node_offset_by_phandle(fdt, phandle));
+	ut_assertok(fdt_index_build(fdt));
+	ut_assertok(check_lookups(uts, fdt));
+
+	/* fdt_set_phandle() drops the index itself */
+	ut_assertok(fdt_set_phandle(fdt, offset, phandle + 2));
+	ut_asserteq(offset, fdt_index_node_offset_by_phandle(fdt, phandle + 2));
+	ut_assertok(fdt_index_build(fdt));
+	ut_assertok(check_lookups(uts, fdt));
+
+	/* so do the 'fdt' commands which change the tree */
+	if (IS_ENABLED(CONFIG_CMD_FDT)) {
+		struct fdt_header *old_fdt = working_fdt;
+
+		working_fdt = fdt;
+		ut_assertok(run_commandf("fdt set /aaa-new phandle <%#x>",
+					 phandle + 3));
+		ut_asserteq(offset,
+			    fdt_index_node_offset_by_phandle(fdt, phandle + 3));
+		ut_assertok(fdt_index_build(fdt));
+		ut_assertok(run_command("fdt set /aaa-new compatible old", 0));
+		ut_asserteq(offset,
+			    fdt_index_node_offset_by_compatible(fdt, -1, "old"));
+		ut_asserteq(-FDT_ERR_NOTFOUND,
+			    fdt_index_node_offset_by_compatible(fdt, -1, "new"));
+		ut_assertok(fdt_index_build(fdt));
+		ut_assertok(run_command("fdt rm /aaa-new", 0));
+		ut_assert(fdt_index_path_offset(fdt, "/aaa-new") < 0);
+		ut_assertok(check_lookups(uts, fdt));
+		working_fdt = old_fdt;
+	}
+
+	/* index the control FDT again for the tests which follow */
+	ut_assertok(fdt_index_build(gd->fdt_blob));
+	ut_assertok(check_lookups(uts, gd->fdt_blob));
+	free(fdt);
+
+	return 0;
+}
+DM_TEST(dm_test_fdt_index, 0);
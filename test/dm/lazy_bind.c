@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for binding devicetree devices when first needed
+ */
+
+#include <dm.h>
+#include <dm/lists.h>
+#include <dm/root.h>
+#include <dm/test.h>
+#include <dm/uclass-internal.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Test that devices are bound when their uclass or node is looked up */
+static int dm_test_lazy_bind(struct unit_test_state *uts)
+{
+	struct udevice *dev;
+	enum uclass_id id;
+	int pending;
+	ofnode node;
+
+	ut_assertok(dm_uninit());
+	ut_assertok(dm_init_and_scan(false));
+	pending = dm_lazy_pending();
+	ut_assert(pending > 0);
+
+	/* GPIOs may have hogs, so are bound at the start */
+	ut_assertnonnull(uclass_find(UCLASS_GPIO));
+	ut_assertnull(uclass_find(UCLASS_TEST_FDT));
+
+	ut_assertok(uclass_first_device_err(UCLASS_TEST_FDT, &dev));
+	ut_asserteq(9, uclass_id_count(UCLASS_TEST_FDT));
+	ut_assert(dm_lazy_pending() < pending);
+	pending = dm_lazy_pending();
+
+	/*
+	 * simple-bus nodes are bound at the start, but not their children,
+	 * which keep the sequence numbers they would have had in tree order
+	 */
+	ut_assertnull(uclass_find(UCLASS_TEST_PROBE));
+	node = ofnode_path("/probing/test4");
+	ut_assertok(lists_find_fdt_uclass(node, &id));
+	ut_asserteq(UCLASS_TEST_PROBE, id);
+	ut_assertok(device_find_global_by_ofnode(node, &dev));
+	ut_asserteq(3, dev_seq(dev));
+	ut_asserteq(pending - 1, dm_lazy_pending());
+	pending = dm_lazy_pending();
+
+	/* walking the children of a bus binds the rest of them */
+	ut_asserteq_str("probing", dev->parent->name);
+	ut_asserteq(4, device_get_child_count(dev->parent));
+	ut_asserteq(pending - 3, dm_lazy_pending());
+	pending = dm_lazy_pending();
+	node = ofnode_path("/probing/test1");
+	ut_assertok(device_find_global_by_ofnode(node, &dev));
+	ut_asserteq(0, dev_seq(dev));
+	ut_asserteq(4, uclass_id_count(UCLASS_TEST_PROBE));
+	ut_asserteq(pending, dm_lazy_pending());
+
+	/* a node under a simple-bus is bound when it is looked up */
+	node = ofnode_path("/bind-test/bind-test-child1");
+	ut_assert(ofnode_valid(node));
+	ut_assertok(device_find_global_by_ofnode(node, &dev));
+	ut_asserteq_str("bind-test", dev->parent->name);
+	ut_asserteq(pending - 1, dm_lazy_pending());
+	ut_assertok(device_find_child_by_name(dev->parent, "bind-test-child2",
+					      &dev));
+
+	/* block devices are created by other devices, so bind everything */
+	ut_assertok(uclass_first_device_err(UCLASS_BLK, &dev));
+	ut_asserteq(0, dm_lazy_pending());
+
+	return 0;
+}
+DM_TEST(dm_test_lazy_bind, 0);
@@ -14,6 +14,7 @@
 #include <asm/test.h>
 #include <dm/test.h>
 #include <dm/util.h>
+#include <linux/sizes.h>
 #include <test/test.h>
 #include <test/ut.h>
 
@@ -74,6 +75,46 @@ static int dm_test_spi_flash(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_spi_flash, UTF_SCAN_PDATA | UTF_SCAN_FDT);
 
+/* Test that a large read is not split up when using the direct mapping */
+static int dm_test_spi_flash_dirmap(struct unit_test_state *uts)
+{
+	struct udevice *dev, *emul;
+	struct spi_flash *flash;
+	int full_size = 0x200000;
+	int size = 0x100000;
+	u8 *src, *dst;
+	uint ops;
+
+	src = map_sysmem(0x20000, full_size);
+	ut_assertok(os_write_file("spi.bin", src, full_size));
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_EMUL, &emul));
+	flash = dev_get_uclass_priv(dev);
+
+	/* Pretend the controller can only move 4KiB in each transfer */
+	flash->spi->max_read_size = SZ_4K;
+
+	sandbox_sf_reset_op_count(emul);
+	dst = map_sysmem(0x20000 + full_size, full_size);
+	ut_assertok(spi_flash_read_dm(dev, 0, size, dst));
+	ut_asserteq_mem(src, dst, size);
+
+	/* Without the mapping, the read is done one FIFO-full at a time */
+	ops = CONFIG_IS_ENABLED(SPI_DIRMAP) ? 1 : size / SZ_4K;
+	ut_asserteq(ops, sandbox_sf_get_op_count(emul, flash->read_opcode));
+
+	flash->spi->max_read_size = 0;
+
+	/*
+	 * Since we are about to destroy all devices, we must tell sandbox
+	 * to forget the emulation device
+	 */
+	sandbox_sf_unbind_emul(state_get_current(), 0, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_dirmap, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
 /* Functional test that sandbox SPI flash works correctly */
 static int dm_test_spi_flash_func(struct unit_test_state *uts)
 {
@@ -6,6 +6,7 @@
 #include <dm.h>
 #include <fdtdec.h>
 #include <spi.h>
+#include <spi-mem.h>
 #include <spi_flash.h>
 #include <asm/state.h>
 #include <asm/test.h>
@@ -200,3 +201,52 @@ static int dm_test_spi_xfer(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_spi_xfer, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Test splitting a transfer around the part which can use DMA */
+static int dm_test_spi_mem_dma_split(struct unit_test_state *uts)
+{
+	struct spi_mem_dma_split split;
+	void *buf = (void *)0x1000;
+
+	if (!IS_ENABLED(CONFIG_SPI_MEM))
+		return -EAGAIN;
+
+	/* Aligned buffer and length, so it can all use DMA */
+	spi_mem_dma_split(buf, 0x100000, 4, 1, &split);
+	ut_asserteq(0, split.head);
+	ut_asserteq(0x100000, split.body);
+	ut_asserteq(0, split.tail);
+
+	/* Only the unaligned ends are left over */
+	spi_mem_dma_split(buf + 1, 0x100000, 4, 1, &split);
+	ut_asserteq(3, split.head);
+	ut_asserteq(0xffffc, split.body);
+	ut_asserteq(1, split.tail);
+
+	/* Striped, where an even misalignment leaves whole byte pairs */
+	spi_mem_dma_split(buf + 2, 0x1000, 4, 2, &split);
+	ut_asserteq(2, split.head);
+	ut_asserteq(0xffc, split.body);
+	ut_asserteq(2, split.tail);
+
+	/* Striped, where an odd misalignment cannot be fixed up */
+	spi_mem_dma_split(buf + 1, 0x1000, 4, 2, &split);
+	ut_asserteq(0x1000, split.head);
+	ut_asserteq(0, split.body);
+	ut_asserteq(0, split.tail);
+
+	/* Too short to reach an aligned part */
+	spi_mem_dma_split(buf + 1, 3, 4, 1, &split);
+	ut_asserteq(3, split.head);
+	ut_asserteq(0, split.body);
+	ut_asserteq(0, split.tail);
+
+	/* Aligned, but shorter than one DMA word */
+	spi_mem_dma_split(buf, 3, 4, 1, &split);
+	ut_asserteq(3, split.head);
+	ut_asserteq(0, split.body);
+	ut_asserteq(0, split.tail);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_mem_dma_split, 0);
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for attaching UBI on sandbox SPI flash
+ */
+
+#include <command.h>
+#include <dm.h>
+#include <os.h>
+#include <spi_flash.h>
+#include <time.h>
+#include <ubi_uboot.h>
+#include <asm/state.h>
+#include <asm/test.h>
+#include <dm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define FLASH_SIZE	0x200000
+#define DATA_SIZE	0x18000
+
+/*
+ * ubi_part() calls mtd_probe_devices(), which looks at the OF partitions of
+ * every MTD device, including the NAND devices registered before the test
+ * started, whose nodes are in the live tree. So these tests only run with
+ * the live tree.
+ */
+
+/* Set up an erased SPI flash and return the time taken to attach UBI to it */
+static int ubi_test_setup(struct unit_test_state *uts, ulong *usp)
+{
+	struct udevice *dev;
+	ulong start;
+	void *buf;
+
+	buf = malloc(FLASH_SIZE);
+	ut_assertnonnull(buf);
+	memset(buf, 0xff, FLASH_SIZE);
+	ut_assertok(os_write_file("spi.bin", buf, FLASH_SIZE));
+	free(buf);
+
+	/* Probing the flash registers the "nor0" MTD device */
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
+
+	start = timer_get_us();
+	ut_assertok(ubi_part("nor0", NULL));
+	*usp = timer_get_us() - start;
+	ut_assertnonnull(ubi_devices[0]);
+
+	return 0;
+}
+
+static void ubi_test_teardown(void)
+{
+	run_command("ubi detach", 0);
+
+	/*
+	 * Since we are about to destroy all devices, we must tell sandbox
+	 * to forget the emulation device
+	 */
+	sandbox_sf_unbind_emul(state_get_current(), 0, 0);
+}
+
+/* Create volumes, then check them after attaching again */
+static int dm_test_ubi_attach(struct unit_test_state *uts)
+{
+	ulong attach_us, reattach_us, start;
+	char *src, *dst;
+	int i;
+
+	ut_assertok(ubi_test_setup(uts, &attach_us));
+
+	src = malloc(DATA_SIZE);
+	ut_assertnonnull(src);
+	dst = malloc(DATA_SIZE);
+	ut_assertnonnull(dst);
+	for (i = 0; i < DATA_SIZE; i++)
+		src[i] = i * 7 + (i >> 8);
+
+	ut_assertok(run_command("ubi create dyn 0x40000 d", 0));
+	ut_assertok(run_command("ubi create stat 0x40000 s", 0));
+	ut_assertok(ubi_volume_write("dyn", src, 0, DATA_SIZE));
+	ut_assertok(ubi_volume_write("stat", src + 1, 0, DATA_SIZE - 1));
+
+	/* Attach again, so the volumes are found by scanning the flash */
+	ut_assertok(run_command("ubi detach", 0));
+	start = timer_get_us();
+	ut_assertok(ubi_part("nor0", NULL));
+	reattach_us = timer_get_us() - start;
+
+	ut_assertok(ubi_volume_read("dyn", dst, 0, DATA_SIZE));
+	ut_asserteq_mem(src, dst, DATA_SIZE);
+	memset(dst, '\0', DATA_SIZE);
+	ut_assertok(ubi_volume_read("stat", dst, 0, DATA_SIZE - 1));
+	ut_asserteq_mem(src + 1, dst, DATA_SIZE - 1);
+
+	printf("UBI attach: empty %lu us, with volumes %lu us, %d PEBs\n",
+	       attach_us, reattach_us, ubi_devices[0]->peb_count);
+
+	free(dst);
+	free(src);
+	ubi_test_teardown();
+
+	return 0;
+}
+DM_TEST(dm_test_ubi_attach, UTF_SCAN_PDATA | UTF_SCAN_FDT | UTF_LIVE_TREE);
+
+/* Check that erasing or writing a PEB drops its prefetched headers */
+static int dm_test_ubi_prefetch(struct unit_test_state *uts)
+{
+	struct ubi_device *ubi;
+	struct ubi_ec_hdr *ech;
+	ulong attach_us;
+	int pnum;
+	u64 ec;
+
+	ut_assertok(ubi_test_setup(uts, &attach_us));
+	ubi = ubi_devices[0];
+
+	/* Only NOR, or a small min. I/O unit, reads both headers at once */
+	ut_assert(ubi->nor_flash);
+	ut_assertnull(ubi->hdrs_buf);
+	ubi->hdrs_buf = kmalloc(ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize,
+				GFP_KERNEL);
+	ut_assertnonnull(ubi->hdrs_buf);
+	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+	ut_assertnonnull(ech);
+
+	/* The last PEB is free, so only has an EC header */
+	pnum = ubi->peb_count - 1;
+	ubi_io_prefetch_hdrs(ubi, pnum);
+	ut_asserteq(pnum, ubi->hdrs_pnum);
+	ut_assertok(ubi_io_read_ec_hdr(ubi, pnum, ech, 0));
+	ec = be64_to_cpu(ech->ec);
+
+	/* After an erase the headers must be read from the flash again */
+	ut_asserteq(1, ubi_io_sync_erase(ubi, pnum, 0));
+	ut_asserteq(-1, ubi->hdrs_pnum);
+	ut_asserteq(UBI_IO_FF, ubi_io_read_ec_hdr(ubi, pnum, ech, 0));
+
+	/* Likewise after a write */
+	ubi_io_prefetch_hdrs(ubi, pnum);
+	ut_asserteq(pnum, ubi->hdrs_pnum);
+	ech->ec = cpu_to_be64(ec + 5);
+	ut_assertok(ubi_io_write_ec_hdr(ubi, pnum, ech));
+	ut_asserteq(-1, ubi->hdrs_pnum);
+	memset(ech, '\0', ubi->ec_hdr_alsize);
+	ut_assertok(ubi_io_read_ec_hdr(ubi, pnum, ech, 0));
+	ut_asserteq(ec + 5, be64_to_cpu(ech->ec));
+
+	/* The new header is served from the buffer once prefetched again */
+	ubi_io_prefetch_hdrs(ubi, pnum);
+	ut_asserteq(pnum, ubi->hdrs_pnum);
+	memset(ech, '\0', ubi->ec_hdr_alsize);
+	ut_assertok(ubi_io_read_ec_hdr(ubi, pnum, ech, 0));
+	ut_asserteq(ec + 5, be64_to_cpu(ech->ec));
+
+	kfree(ech);
+	kfree(ubi->hdrs_buf);
+	ubi->hdrs_buf = NULL;
+	ubi->hdrs_pnum = -1;
+
+	/* The device still attaches with the rewritten PEB */
+	ut_assertok(run_command("ubi detach", 0));
+	ut_assertok(ubi_part("nor0", NULL));
+	ubi_test_teardown();
+
+	return 0;
+}
+DM_TEST(dm_test_ubi_prefetch, UTF_SCAN_PDATA | UTF_SCAN_FDT |
+	UTF_LIVE_TREE);
@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the uclass lookup tables
+ */
+
+#include <dm.h>
+#include <malloc.h>
+#include <time.h>
+#include <dm/device-internal.h>
+#include <dm/lists.h>
+#include <dm/root.h>
+#include <dm/test.h>
+#include <dm/uclass-internal.h>
+#include <test/ut.h>
+
+#define SPEED_LOOPS	10000
+
+/* Check that each device is found by its sequence number and node */
+static int check_devs(struct unit_test_state *uts, struct udevice **devs,
+		      int count)
+{
+	struct udevice *dev;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (!devs[i])
+			continue;
+		ut_assertok(uclass_find_device_by_seq(UCLASS_TEST,
+						      dev_seq(devs[i]), &dev));
+		ut_asserteq_ptr(devs[i], dev);
+		ut_assertok(uclass_find_device_by_ofnode(UCLASS_TEST,
+							 dev_ofnode(devs[i]),
+							 &dev));
+		ut_asserteq_ptr(devs[i], dev);
+	}
+
+	return 0;
+}
+
+/* Test finding devices which share a sequence number or node */
+static int dm_test_uclass_index(struct unit_test_state *uts)
+{
+	struct udevice *a, *b, *c, *dev, **devs;
+	ofnode node, node1, node2;
+	struct uclass *uc;
+	int count, i;
+
+	ut_assertok(device_bind_driver(dm_root(), "test_drv", "a", &a));
+	ut_assertok(device_bind_driver(dm_root(), "test_drv", "b", &b));
+	ut_assertok(device_bind_driver(dm_root(), "test_drv", "c", &c));
+	ut_asserteq(2, dev_seq(c));
+	uc = a->uclass;
+
+	/* the first device in the uclass wins */
+	device_set_seq(c, 0);
+	ut_assertok(uclass_find_device_by_seq(UCLASS_TEST, 0, &dev));
+	ut_asserteq_ptr(a, dev);
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST, 2, &dev));
+	ut_asserteq(2, uclass_find_next_free_seq(uc));
+
+	/* a negative sequence number never matches */
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST, -2, &dev));
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST, INT_MIN,
+						       &dev));
+	ut_asserteq(-ENODEV, uclass_index_find_seq(uc, -2, &dev));
+
+	node1 = ofnode_path("/a-test");
+	node2 = ofnode_path("/b-test");
+	dev_set_ofnode(c, node1);
+	dev_set_ofnode(b, node1);
+	ut_assertok(uclass_find_device_by_ofnode(UCLASS_TEST, node1, &dev));
+	ut_asserteq_ptr(b, dev);
+	dev_set_ofnode(b, node2);
+	ut_assertok(uclass_find_device_by_ofnode(UCLASS_TEST, node1, &dev));
+	ut_asserteq_ptr(c, dev);
+	ut_assertok(uclass_find_device_by_ofnode(UCLASS_TEST, node2, &dev));
+	ut_asserteq_ptr(b, dev);
+
+	/* the next device takes over when one is unbound */
+	ut_assertok(device_unbind(a));
+	ut_assertok(uclass_find_device_by_seq(UCLASS_TEST, 0, &dev));
+	ut_asserteq_ptr(c, dev);
+	ut_assertok(device_unbind(c));
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST, 0, &dev));
+	ut_asserteq(-ENODEV, uclass_find_device_by_ofnode(UCLASS_TEST, node1,
+							  &dev));
+	ut_assertok(device_unbind(b));
+	ut_asserteq(0, uclass_find_next_free_seq(uc));
+
+	/* enough devices to fill the tables a few times over */
+	count = 0;
+	ofnode_for_each_subnode(node, ofnode_root())
+		count++;
+	devs = calloc(count, sizeof(*devs));
+	ut_assertnonnull(devs);
+	i = 0;
+	ofnode_for_each_subnode(node, ofnode_root()) {
+		ut_assertok(device_bind_driver(dm_root(), "test_drv", "dev",
+					       &devs[i]));
+		dev_set_ofnode(devs[i++], node);
+	}
+	ut_assertok(check_devs(uts, devs, count));
+
+	/* remove every other one, so that entries must move in the tables */
+	for (i = 0; i < count; i += 2) {
+		node = dev_ofnode(devs[i]);
+		ut_assertok(device_unbind(devs[i]));
+		devs[i] = NULL;
+		ut_asserteq(-ENODEV, uclass_find_device_by_ofnode(UCLASS_TEST,
+								  node, &dev));
+	}
+	ut_assertok(check_devs(uts, devs, count));
+	free(devs);
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_index, 0);
+
+/* Print how long a lookup takes as the number of devices grows */
+static int dm_test_uclass_index_speed_norun(struct unit_test_state *uts)
+{
+	static const int counts[] = { 10, 100, 1000 };
+	struct udevice *dev, *last;
+	ulong seq_ns, node_ns, start;
+	int i, j, n, seq;
+	ofnode node;
+
+	node = ofnode_path("/a-test");
+	ut_assert(ofnode_valid(node));
+	for (i = 0, n = 0; i < ARRAY_SIZE(counts); i++) {
+		for (; n < counts[i]; n++) {
+			ut_assertok(device_bind_driver(dm_root(), "test_drv",
+						       "dev", &last));
+		}
+
+		/* look up the last device, the worst case for a list walk */
+		dev_set_ofnode(last, node);
+		seq = dev_seq(last);
+		start = timer_get_us();
+		for (j = 0; j < SPEED_LOOPS; j++)
+			uclass_find_device_by_seq(UCLASS_TEST, seq, &dev);
+		seq_ns = (timer_get_us() - start) * 1000 / SPEED_LOOPS;
+		ut_asserteq_ptr(last, dev);
+
+		start = timer_get_us();
+		for (j = 0; j < SPEED_LOOPS; j++)
+			uclass_find_device_by_ofnode(UCLASS_TEST, node, &dev);
+		node_ns = (timer_get_us() - start) * 1000 / SPEED_LOOPS;
+		ut_asserteq_ptr(last, dev);
+		dev_set_ofnode(last, ofnode_null());
+
+		printf("%5d devices: by seq %5lu ns, by ofnode %5lu ns\n",
+		       counts[i], seq_ns, node_ns);
+	}
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_index_speed_norun, UTF_MANUAL);
@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the sampling profiler
+ */
+
+#include <malloc.h>
+#include <profile.h>
+#include <time.h>
+#include <trace.h>
+#include <asm/global_data.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define TEST_FREQ	10000
+
+/* Count the samples taken so far */
+static uint sample_count(void)
+{
+	size_t needed;
+
+	profile_list_samples(NULL, 0, &needed);
+
+	return (needed - sizeof(struct trace_output_hdr)) /
+		sizeof(struct trace_sample);
+}
+
+/* Keep the CPU busy until @count samples are taken, or a second has passed */
+static uint spin(uint count)
+{
+	ulong start = get_timer(0);
+	volatile uint val = 0;
+	uint found;
+	int i;
+
+	do {
+		for (i = 0; i < 10000; i++)
+			val++;
+		found = sample_count();
+	} while (found < count && get_timer(start) < 1000);
+
+	return found;
+}
+
+/* Test taking samples and writing them out */
+static int lib_test_profile(struct unit_test_state *uts)
+{
+	struct trace_output_hdr *hdr;
+	struct trace_sample *sample;
+	size_t needed, size;
+	int i, callers;
+	uint count;
+	void *buf;
+
+	ut_asserteq(-EINVAL, profile_start(0));
+	ut_assertok(profile_start(TEST_FREQ));
+	ut_asserteq(-EALREADY, profile_start(TEST_FREQ));
+	count = spin(20);
+	ut_assertok(profile_stop());
+	ut_asserteq(-EALREADY, profile_stop());
+	ut_assert(count >= 20);
+
+	ut_asserteq(-ENOSPC, profile_list_samples(NULL, 0, &needed));
+	buf = malloc(needed);
+	ut_assertnonnull(buf);
+	ut_assertok(profile_list_samples(buf, needed, &size));
+	ut_asserteq(needed, size);
+
+	hdr = buf;
+	ut_asserteq(TRACE_CHUNK_SAMPLES, hdr->type);
+	ut_asserteq(TRACE_VERSION, hdr->version);
+	ut_asserteq(TEST_FREQ, hdr->spare);
+	ut_assert(hdr->rec_count >= count);
+
+	/* the samples are all in U-Boot and the frame pointer gives callers */
+	sample = (struct trace_sample *)(hdr + 1);
+	for (i = callers = 0; i < hdr->rec_count; i++, sample++) {
+		ut_assert(sample->pc < gd->mon_len);
+		if (sample->caller == TRACE_SAMPLE_NO_CALLER)
+			continue;
+		ut_assert(sample->caller < gd->mon_len);
+		callers++;
+	}
+	ut_assert(callers > 0);
+
+	/* a short buffer gets the header and as many samples as fit */
+	size = sizeof(*hdr) + sizeof(*sample);
+	ut_asserteq(-ENOSPC, profile_list_samples(buf, size, &needed));
+	ut_assert(needed > size);
+	ut_asserteq(1, hdr->rec_count);
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_profile, 0);
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Known-answer and throughput tests for the hashes and CRCs, which may use
+ * CPU-specific instructions chosen at runtime
+ */
+
+#include <command.h>
+#include <hash.h>
+#include <malloc.h>
+#include <time.h>
+#include <vsprintf.h>
+#include <linux/sizes.h>
+#include <test/lib.h>
+#include <test/ut.h>
+#include <u-boot/crc.h>
+
+#define KAT_OFFSET	3
+#define KAT_SIZE	4099
+#define SPEED_SIZE	SZ_1M
+#define SPEED_LOOPS	4
+
+static const struct {
+	const char *algo;
+	const char *digest;
+} hash_kat[] = {
+	{ "crc32", "bb8fc55b" },
+	{ "sha1", "1a40dd05c14cf62bd40336a938e0ccd22ef81640" },
+	{ "sha256",
+	  "02f7727f0026bc3b97d5ed7642c6c34ef02920c923f43c357323c44c7857ba9e" },
+	{ "sha384",
+	  "ec9b80c294e8f63b5416977bc1d4d5531cb0373683434263c72b8a4dcb7a0fd8"
+	  "6aaf7ed81d27be7f3ef3c7c18dc4ed4a" },
+	{ "sha512",
+	  "3304a85c4a73864902b3b8cf59ae4ccdd01a8da62fc019374cfbe8b0e235596d"
+	  "a4aabd2bd5917cc81d2ff6e35c6f127fb5113312235542084353e112d701079f" },
+};
+
+static u32 crc32c_table[256];
+
+static u32 test_crc32c(const void *buf, uint len)
+{
+	return ~crc32c_cal(~0U, buf, len, crc32c_table);
+}
+
+/* Check digests of unaligned data which does not fill the last block */
+static int lib_test_hash(struct unit_test_state *uts)
+{
+	char digest[HASH_MAX_DIGEST_SIZE * 2 + 1];
+	u8 value[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo;
+	u8 *buf;
+	int i, j;
+
+	buf = malloc(KAT_OFFSET + KAT_SIZE);
+	ut_assertnonnull(buf);
+	for (i = 0; i < KAT_OFFSET + KAT_SIZE; i++)
+		buf[i] = i * 7 + (i >> 8);
+
+	for (i = 0; i < ARRAY_SIZE(hash_kat); i++) {
+		if (hash_lookup_algo(hash_kat[i].algo, &algo))
+			continue;
+		algo->hash_func_ws(buf + KAT_OFFSET, KAT_SIZE, value,
+				   algo->chunk_size);
+		for (j = 0; j < algo->digest_size; j++)
+			sprintf(digest + j * 2, "%02x", value[j]);
+		ut_asserteq_str(hash_kat[i].digest, digest);
+	}
+
+	if (IS_ENABLED(CONFIG_CRC32C)) {
+		crc32c_init(crc32c_table, 0x82f63b78);
+		ut_asserteq(0xe3069283, test_crc32c("123456789", 9));
+		ut_asserteq(0xfd712ff2, test_crc32c(buf + KAT_OFFSET, KAT_SIZE));
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_hash, 0);
+
+/* Print the throughput of a hash, or of crc32c if @algo is NULL */
+static void hash_speed(const char *name, struct hash_algo *algo, const u8 *buf)
+{
+	ulong kib = SPEED_LOOPS * SPEED_SIZE / SZ_1K;
+	u8 value[HASH_MAX_DIGEST_SIZE];
+	ulong start, us;
+	int i;
+
+	start = timer_get_us();
+	for (i = 0; i < SPEED_LOOPS; i++) {
+		if (algo)
+			algo->hash_func_ws(buf, SPEED_SIZE, value,
+					   algo->chunk_size);
+		else
+			test_crc32c(buf, SPEED_SIZE);
+	}
+	us = max(timer_get_us() - start, 1UL);
+	printf("%-8s %6lu MiB/s\n", name, kib * 1000 / 1024 * 1000 / us);
+}
+
+/* Print the throughput of each hash, e.g. to compare CPUs or configs */
+static int lib_test_hash_speed_norun(struct unit_test_state *uts)
+{
+	struct hash_algo *algo;
+	u8 *buf;
+	int i;
+
+	buf = malloc(SPEED_SIZE);
+	ut_assertnonnull(buf);
+	memset(buf, 0xa5, SPEED_SIZE);
+
+	for (i = 0; i < ARRAY_SIZE(hash_kat); i++) {
+		if (!hash_lookup_algo(hash_kat[i].algo, &algo))
+			hash_speed(hash_kat[i].algo, algo, buf);
+	}
+	if (IS_ENABLED(CONFIG_CRC32C)) {
+		crc32c_init(crc32c_table, 0x82f63b78);
+		hash_speed("crc32c", NULL, buf);
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_hash_speed_norun, UTF_MANUAL);
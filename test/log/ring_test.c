@@ -0,0 +1,246 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the log ring buffer
+ */
+
+#include <bloblist.h>
+#include <command.h>
+#include <malloc.h>
+#include <asm/global_data.h>
+#include <test/log.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Check the next line of a dump, skipping the time at the start */
+static int check_line(struct unit_test_state *uts, char **bufp,
+		      const char *expect)
+{
+	char *ptr = *bufp, *end;
+
+	ut_asserteq('[', *ptr);
+	ptr = strstr(ptr, "] ");
+	ut_assertnonnull(ptr);
+	ptr += 2;
+	end = strchr(ptr, '\n');
+	ut_assertnonnull(end);
+	*end = '\0';
+	ut_asserteq_str(expect, ptr);
+	*bufp = end + 1;
+
+	return 0;
+}
+
+/* Test that records are kept and formatted when they are written out */
+static int log_test_ring(struct unit_test_state *uts)
+{
+	enum log_category_t cat_list[] = { LOGC_EFI, LOGC_END };
+	u8 mac[6] = { 0x02, 0x00, 0x11, 0x22, 0x33, 0x44 };
+	int log_fmt = gd->log_fmt;
+	char str[] = "before";
+	char buf[512], *ptr;
+	int len;
+
+	gd->log_fmt = BIT(LOGF_CAT) | BIT(LOGF_LEVEL) | BIT(LOGF_MSG);
+	log_ring_clear();
+
+	/* debug records are not shown on the console, only kept */
+	log(LOGC_ARCH, LOGL_DEBUG, "%d %5x %-3s| %c %lld %zu %hd %dE\n", -3, 0x1f,
+	    "ab", 'q', -5LL, (size_t)7, (short)-2, -EIO);
+	log(LOGC_EFI, LOGL_DEBUG, "%*d|%.*s|%-*s|%p\n", 4, 7, 2, "xyz", -3,
+	    "z", (void *)0x1234);
+	log(LOGC_EFI, LOGL_DEBUG, "%s %%\n", str);
+	strcpy(str, "after");
+	log(LOGC_ARCH, LOGL_DEBUG, "a%d ", 1);
+	log(LOGC_CONT, LOGL_CONT, "b%d\n", 2);
+
+	/* this one needs the data pointed to, so is formatted straight away */
+	log(LOGC_EFI, LOGL_DEBUG, "mac %pM\n", mac);
+
+	/* above the level for the ring */
+	log(LOGC_EFI, LOGL_DEBUG_CONTENT, "content\n");
+
+	/* this one is formatted for the console, so the message is kept */
+	log(LOGC_BOARD, LOGL_INFO, "info %d\n", 5);
+	ut_assert_nextline("INFO.board, info 5");
+	ut_assert_console_end();
+
+	len = log_ring_dump(LOGL_MAX, NULL, buf, sizeof(buf));
+	ut_asserteq(strlen(buf), len);
+	ptr = buf;
+	ut_assertok(check_line(uts, &ptr,
+			       "DEBUG.arch, -3    1f ab | q -5 7 -2 -5: I/O error"));
+	ut_assertok(check_line(uts, &ptr, "DEBUG.efi,    7|xy|z  |0000000000001234"));
+	ut_assertok(check_line(uts, &ptr, "DEBUG.efi, before %"));
+	ut_assertok(check_line(uts, &ptr, "DEBUG.arch, a1 b2"));
+	ut_assertok(check_line(uts, &ptr, "DEBUG.efi, mac 02:00:11:22:33:44"));
+	ut_assertok(check_line(uts, &ptr, "INFO.board, info 5"));
+	ut_asserteq_str("", ptr);
+
+	/* filter by level and category */
+	log_ring_dump(LOGL_INFO, NULL, buf, sizeof(buf));
+	ptr = buf;
+	ut_assertok(check_line(uts, &ptr, "INFO.board, info 5"));
+	ut_asserteq_str("", ptr);
+
+	log_ring_dump(LOGL_MAX, cat_list, buf, sizeof(buf));
+	ptr = buf;
+	ut_assertok(check_line(uts, &ptr, "DEBUG.efi,    7|xy|z  |0000000000001234"));
+	ut_assertok(check_line(uts, &ptr, "DEBUG.efi, before %"));
+	ut_assertok(check_line(uts, &ptr, "DEBUG.efi, mac 02:00:11:22:33:44"));
+	ut_asserteq_str("", ptr);
+
+	/* the text is cut short if the buffer is too small */
+	ut_asserteq(len, log_ring_dump(LOGL_MAX, NULL, buf, 10));
+	ut_asserteq(9, strlen(buf));
+
+	/* write to the console */
+	log_ring_dump(LOGL_INFO, NULL, NULL, 0);
+	ut_assert_nextlinen("[");
+	ut_assert_console_end();
+
+	log_ring_clear();
+	ut_asserteq(0, log_ring_dump(LOGL_MAX, NULL, NULL, 0));
+	gd->log_fmt = log_fmt;
+
+	return 0;
+}
+LOG_TEST(log_test_ring);
+
+/* Test that the file and function names are kept with the record */
+static int log_test_ring_names(struct unit_test_state *uts)
+{
+	char file[] = "myfile.c", func[] = "myfunc";
+	int log_fmt = gd->log_fmt;
+	char buf[128], expect[80];
+	char *ptr;
+
+	gd->log_fmt = BIT(LOGF_FILE) | BIT(LOGF_LINE) | BIT(LOGF_FUNC) |
+		BIT(LOGF_MSG);
+	log_ring_clear();
+	ut_assertok(_log(LOGC_ARCH, LOGL_DEBUG, file, 123, func, "%s\n",
+			 "hello"));
+	strcpy(file, "other.c");
+	strcpy(func, "other");
+
+	log_ring_dump(LOGL_MAX, NULL, buf, sizeof(buf));
+	ptr = buf;
+	snprintf(expect, sizeof(expect), "myfile.c:123-%*s() hello",
+		 CONFIG_LOGF_FUNC_PAD, "myfunc");
+	ut_assertok(check_line(uts, &ptr, expect));
+	ut_asserteq_str("", ptr);
+
+	log_ring_clear();
+	gd->log_fmt = log_fmt;
+
+	return 0;
+}
+LOG_TEST(log_test_ring_names);
+
+/* Test that 'log rec' records outlive the command's arguments */
+static int log_test_ring_cmd(struct unit_test_state *uts)
+{
+	int log_fmt = gd->log_fmt;
+	char expect[80];
+	char *ptr;
+
+	if (!IS_ENABLED(CONFIG_CMD_LOG))
+		return -EAGAIN;
+
+	gd->log_fmt = BIT(LOGF_FILE) | BIT(LOGF_LINE) | BIT(LOGF_FUNC) |
+		BIT(LOGF_MSG);
+	log_ring_clear();
+	ut_assertok(run_command("log rec arch debug myfile.c 123 myfunc hello",
+				0));
+	ut_assert_console_end();
+
+	/* the command line is reused for this command */
+	ut_assertok(run_command("log dump -c arch", 0));
+	ut_assert_nextlinen("[");
+	ptr = strstr(uts->actual_str, "] ");
+	ut_assertnonnull(ptr);
+	snprintf(expect, sizeof(expect), "myfile.c:123-%*s() hello",
+		 CONFIG_LOGF_FUNC_PAD, "myfunc");
+	ut_asserteq_str(expect, ptr + 2);
+	ut_assert_console_end();
+
+	log_ring_clear();
+	gd->log_fmt = log_fmt;
+
+	return 0;
+}
+LOG_TEST_FLAGS(log_test_ring_cmd, UTF_CONSOLE);
+
+/* Test that the oldest records are dropped when the ring is full */
+static int log_test_ring_full(struct unit_test_state *uts)
+{
+	const int count = CONFIG_LOG_RING_SIZE / 32;
+	int log_fmt = gd->log_fmt;
+	char expect[40];
+	char *buf, *ptr;
+	int first, i, len;
+
+	gd->log_fmt = BIT(LOGF_MSG);
+	log_ring_clear();
+	for (i = 0; i < count; i++)
+		log_debug("record %d of %s\n", i, "many");
+
+	len = log_ring_dump(LOGL_MAX, NULL, expect, 0);
+	buf = malloc(len + 1);
+	ut_assertnonnull(buf);
+	ut_asserteq(len, log_ring_dump(LOGL_MAX, NULL, buf, len + 1));
+
+	/* the newest records are kept, in order */
+	ptr = strchr(buf, '\n') + 1;
+	first = dectoul(strstr(ptr, "record ") + 7, NULL);
+	ut_assert(first > 0);
+	snprintf(expect, sizeof(expect), "(%d older records lost)\n", first);
+	ut_asserteq_strn(expect, buf);
+	for (i = first; i < count; i++) {
+		snprintf(expect, sizeof(expect), "record %d of many", i);
+		ut_assertok(check_line(uts, &ptr, expect));
+	}
+	ut_asserteq_str("", ptr);
+	free(buf);
+	log_ring_clear();
+	gd->log_fmt = log_fmt;
+
+	return 0;
+}
+LOG_TEST(log_test_ring_full);
+
+/* Test writing the records into the bloblist */
+static int log_test_ring_bloblist(struct unit_test_state *uts)
+{
+	int log_fmt = gd->log_fmt;
+	char buf[128];
+	char *blob;
+	int size;
+
+	gd->log_fmt = BIT(LOGF_MSG);
+	log_ring_clear();
+	log_debug("first %d\n", 1);
+	log_debug("second %s\n", "two");
+	ut_assertok(log_ring_to_bloblist(LOGL_MAX, NULL));
+	blob = bloblist_get_blob(BLOBLISTT_U_BOOT_LOG, &size);
+	ut_assertnonnull(blob);
+	log_ring_dump(LOGL_MAX, NULL, buf, sizeof(buf));
+	ut_asserteq(strlen(buf) + 1, size);
+	ut_asserteq_str(buf, blob);
+
+	/* a second write replaces the blob */
+	log_debug("third\n");
+	ut_assertok(log_ring_to_bloblist(LOGL_MAX, NULL));
+	blob = bloblist_get_blob(BLOBLISTT_U_BOOT_LOG, &size);
+	ut_assertnonnull(blob);
+	log_ring_dump(LOGL_MAX, NULL, buf, sizeof(buf));
+	ut_asserteq(strlen(buf) + 1, size);
+	ut_asserteq_str(buf, blob);
+
+	log_ring_clear();
+	gd->log_fmt = log_fmt;
+
+	return 0;
+}
+LOG_TEST(log_test_ring_bloblist);
@@ -2,9 +2,11 @@
 # Copyright (c) 2018, Linaro Limited
 # Author: Takahiro Akashi <takahiro.akashi@linaro.org>
 
+import hashlib
 import os
 import os.path
 import pytest
+import random
 import re
 from subprocess import call, check_call, check_output, CalledProcessError
 from fstest_defs import *
@@ -14,9 +16,11 @@ from tests import fs_helper
 supported_fs_basic = ['fat16', 'fat32', 'exfat', 'ext4', 'fs_generic']
 supported_fs_ext = ['fat12', 'fat16', 'fat32', 'exfat', 'fs_generic']
 supported_fs_fat = ['fat12', 'fat16']
+supported_fs_fat_frag = ['fat16', 'fat32']
 supported_fs_mkdir = ['fat12', 'fat16', 'fat32', 'exfat', 'fs_generic']
 supported_fs_unlink = ['fat12', 'fat16', 'fat32', 'exfat', 'fs_generic']
 supported_fs_symlink = ['ext4']
+supported_fs_extents = ['ext4']
 supported_fs_rename = ['fat12', 'fat16', 'fat32', 'exfat', 'fs_generic']
 
 #
@@ -52,9 +56,11 @@ def pytest_configure(config):
     global supported_fs_basic
     global supported_fs_ext
     global supported_fs_fat
+    global supported_fs_fat_frag
     global supported_fs_mkdir
     global supported_fs_unlink
     global supported_fs_symlink
+    global supported_fs_extents
     global supported_fs_rename
 
     def intersect(listA, listB):
@@ -66,9 +72,11 @@ def pytest_configure(config):
         supported_fs_basic =  intersect(supported_fs, supported_fs_basic)
         supported_fs_ext =  intersect(supported_fs, supported_fs_ext)
         supported_fs_fat =  intersect(supported_fs, supported_fs_fat)
+        supported_fs_fat_frag =  intersect(supported_fs, supported_fs_fat_frag)
         supported_fs_mkdir =  intersect(supported_fs, supported_fs_mkdir)
         supported_fs_unlink =  intersect(supported_fs, supported_fs_unlink)
         supported_fs_symlink =  intersect(supported_fs, supported_fs_symlink)
+        supported_fs_extents =  intersect(supported_fs, supported_fs_extents)
         supported_fs_rename =  intersect(supported_fs, supported_fs_rename)
 
 def pytest_generate_tests(metafunc):
@@ -92,6 +100,9 @@ def pytest_generate_tests(metafunc):
     if 'fs_obj_fat' in metafunc.fixturenames:
         metafunc.parametrize('fs_obj_fat', supported_fs_fat,
             indirect=True, scope='module')
+    if 'fs_obj_fat_frag' in metafunc.fixturenames:
+        metafunc.parametrize('fs_obj_fat_frag', supported_fs_fat_frag,
+            indirect=True, scope='module')
     if 'fs_obj_mkdir' in metafunc.fixturenames:
         metafunc.parametrize('fs_obj_mkdir', supported_fs_mkdir,
             indirect=True, scope='module')
@@ -101,6 +112,9 @@ def pytest_generate_tests(metafunc):
     if 'fs_obj_symlink' in metafunc.fixturenames:
         metafunc.parametrize('fs_obj_symlink', supported_fs_symlink,
             indirect=True, scope='module')
+    if 'fs_obj_extents' in metafunc.fixturenames:
+        metafunc.parametrize('fs_obj_extents', supported_fs_extents,
+            indirect=True, scope='module')
     if 'fs_obj_rename' in metafunc.fixturenames:
         metafunc.parametrize('fs_obj_rename', supported_fs_rename,
             indirect=True, scope='module')
@@ -558,6 +572,108 @@ def fs_obj_symlink(request, u_boot_config):
         call('rm -rf %s' % scratch_dir, shell=True)
         call('rm -f %s' % fs_img, shell=True)
 
+#
+# Fixture for extents test
+#
+@pytest.fixture()
+def fs_obj_extents(request, u_boot_config):
+    """Set up a file system to be used in extents test.
+
+    Args:
+        request: Pytest request object.
+        u_boot_config: U-Boot configuration.
+
+    Return:
+        A fixture for extents test, i.e. a triplet of file system type,
+        volume file name and a list of (file, offset, length, MD5 hash) of
+        the reads to check, where a length of 0 means the whole file.
+    """
+    fs_type = request.param
+    fs_img = ''
+
+    fs_ubtype = fstype_to_ubname(fs_type)
+    check_ubconfig(u_boot_config, fs_ubtype)
+    if not tool_is_in_path('debugfs'):
+        pytest.skip('debugfs not found')
+
+    scratch_dir = u_boot_config.persistent_data_dir + '/scratch'
+
+    def extents(fname):
+        """Get (depth, first physical block, length, flags) for each leaf"""
+        out = check_output('debugfs -R "ex /%s" %s 2> /dev/null'
+            % (fname, fs_img), shell=True).decode()
+        return [(int(m.group(1)), int(m.group(2)), int(m.group(3)),
+                 m.group(4)) for m in re.finditer(
+                     r'^\s*\d+/\s*(\d+)\s+\d+/\s*\d+\s+\d+\s*-\s*\d+\s+'
+                     r'(\d+)\s*-\s*\d+\s+(\d+)\s*(\w*)$', out, re.M)]
+
+    try:
+        check_call('mkdir -p %s' % scratch_dir, shell=True)
+
+        # Write the files, leaving holes which mkfs keeps
+        data = {}
+        with open(scratch_dir + '/' + FRAG_FILE, 'wb') as f:
+            for i in range(1000):
+                f.seek(i * 0x2000)
+                f.write(os.urandom(0x1000))
+        with open(scratch_dir + '/' + SPARSE_FILE, 'wb') as f:
+            f.write(os.urandom(5000))
+            f.seek(0x300000 + 100)
+            f.write(os.urandom(7000))
+        with open(scratch_dir + '/' + PREALLOC_FILE, 'wb') as f:
+            f.write(os.urandom(0x2000))
+            f.seek(0x4000)
+            f.write(os.urandom(0x2000))
+        for fname in [FRAG_FILE, SPARSE_FILE, PREALLOC_FILE]:
+            with open(scratch_dir + '/' + fname, 'rb') as f:
+                data[fname] = f.read()
+
+        # 64MiB volume
+        fs_img = fs_helper.mk_fs(u_boot_config, fs_type, 0x4000000, '64MB',
+                                 scratch_dir)
+        out = check_output('dumpe2fs -h %s 2> /dev/null' % fs_img,
+                           shell=True).decode()
+        blksz = int(re.search(r'Block size:\s+(\d+)', out).group(1))
+
+        # Fill the hole with an unwritten extent, over blocks holding junk
+        check_call('debugfs -w -R "fallocate /%s %d %d" %s'
+            % (PREALLOC_FILE, 0x2000 // blksz, 0x4000 // blksz - 1, fs_img),
+            shell=True)
+        uninit = [ext for ext in extents(PREALLOC_FILE) if ext[3] == 'Uninit']
+        assert len(uninit) == 1
+        check_call('dd if=/dev/urandom of=%s bs=%d seek=%d count=%d '
+            'conv=notrunc 2> /dev/null'
+            % (fs_img, blksz, uninit[0][1], uninit[0][2]), shell=True)
+
+        # The tree must have index nodes as well as leaves
+        assert extents(FRAG_FILE)[0][0] >= 1
+
+        reads = [
+            (FRAG_FILE, 0, 0),
+            (SPARSE_FILE, 0, 0),
+            (PREALLOC_FILE, 0, 0),
+            # unaligned, across holes, extents and index nodes
+            (FRAG_FILE, 0x1801, 0x3000),
+            (FRAG_FILE, 0x1fffff, 0x10003),
+            (FRAG_FILE, len(data[FRAG_FILE]) - 0x1235, 0x1235),
+            (SPARSE_FILE, 4999, 0x300000),
+            (PREALLOC_FILE, 0x1ffe, 0x2004),
+        ]
+        md5val = []
+        for fname, offset, length in reads:
+            chunk = data[fname][offset:offset + length if length else None]
+            md5val.append((fname, offset, length,
+                           hashlib.md5(chunk).hexdigest()))
+
+    except CalledProcessError:
+        pytest.skip('Setup failed for filesystem: ' + fs_type)
+        return
+    else:
+        yield [fs_ubtype, fs_img, md5val]
+    finally:
+        call('rm -rf %s' % scratch_dir, shell=True)
+        call('rm -f %s' % fs_img, shell=True)
+
 #
 # Fixture for rename test
 #
@@ -713,3 +829,100 @@ def fs_obj_fat(request, u_boot_config):
     else:
         yield [fs_ubtype, fs_img]
     call('rm -f %s' % fs_img, shell=True)
+
+#
+# Fixture for fat fragmented file test
+#
+@pytest.fixture()
+def fs_obj_fat_frag(request, u_boot_config):
+    """Set up a file system with a badly fragmented file.
+
+    The clusters of the file are scattered in short runs over the whole
+    volume, in random order, so that following its chain keeps moving
+    backwards and forwards between distant parts of the FAT.
+
+    Args:
+        request: Pytest request object.
+        u_boot_config: U-Boot configuration.
+
+    Return:
+        A fixture for fat fragmented file test, i.e. a triplet of file
+        system type, volume file name and MD5 hash of the file.
+    """
+    fs_type = request.param
+    fs_img = ''
+
+    fs_ubtype = fstype_to_ubname(fs_type)
+    check_ubconfig(u_boot_config, fs_ubtype)
+
+    fs_size = 32 * 1024 * 1024 if fs_type == 'fat16' else 64 * 1024 * 1024
+
+    try:
+        fs_img = fs_helper.mk_fs(u_boot_config, fs_type, fs_size, 'frag')
+    except CalledProcessError:
+        pytest.skip('Setup failed for filesystem: ' + fs_type)
+        return
+
+    try:
+        with open(fs_img, 'r+b') as img:
+            bs = img.read(512)
+            sect_size = int.from_bytes(bs[11:13], 'little')
+            clust_size = bs[13] * sect_size
+            reserved = int.from_bytes(bs[14:16], 'little')
+            fats = bs[16]
+            root_entries = int.from_bytes(bs[17:19], 'little')
+            total_sect = (int.from_bytes(bs[19:21], 'little') or
+                          int.from_bytes(bs[32:36], 'little'))
+            fat_length = (int.from_bytes(bs[22:24], 'little') or
+                          int.from_bytes(bs[36:40], 'little'))
+
+            fat_start = reserved * sect_size
+            root_start = fat_start + fats * fat_length * sect_size
+            data_start = root_start + root_entries * 32
+            nclust = (total_sect * sect_size - data_start) // clust_size
+            if fs_type == 'fat32':
+                entry_size, eoc = 4, 0x0fffffff
+                root_clust = int.from_bytes(bs[44:48], 'little')
+                root_start = data_start + (root_clust - 2) * clust_size
+                first_free = 3
+            else:
+                entry_size, eoc = 2, 0xffff
+                first_free = 2
+
+            # Use runs of 1 to 4 adjacent clusters, one per 4-cluster slot
+            rng = random.Random(0)
+            nslots = (nclust + 2 - first_free) // 4
+            nruns = min(nslots // 2, 0x200000 // clust_size * 2 // 5)
+            chain = []
+            for i, slot in enumerate(rng.sample(range(nslots), nruns)):
+                first = first_free + slot * 4
+                chain += range(first, first + 1 + i % 4)
+
+            # Do not end on a cluster boundary
+            data = os.urandom(len(chain) * clust_size - 123)
+            md5val = hashlib.md5(data).hexdigest()
+
+            for i, clust in enumerate(chain):
+                img.seek(data_start + (clust - 2) * clust_size)
+                img.write(data[i * clust_size:(i + 1) * clust_size])
+                nxt = chain[i + 1] if i + 1 < len(chain) else eoc
+                for fat in range(fats):
+                    img.seek(fat_start + fat * fat_length * sect_size +
+                             clust * entry_size)
+                    img.write(nxt.to_bytes(entry_size, 'little'))
+
+            # Add the directory entry in the first free slot of the root
+            img.seek(root_start)
+            while img.read(32)[0] not in (0, 0xe5):
+                pass
+            img.seek(-32, os.SEEK_CUR)
+            name = FAT_FRAG_FILE.upper().split('.')
+            img.write(name[0].ljust(8).encode() + name[1].ljust(3).encode() +
+                      bytes([0x20]) + bytes(8) +
+                      (chain[0] >> 16).to_bytes(2, 'little') + bytes(4) +
+                      (chain[0] & 0xffff).to_bytes(2, 'little') +
+                      len(data).to_bytes(4, 'little'))
+
+        yield [fs_ubtype, fs_img, md5val]
+    finally:
+        call('rm -f %s' % fs_img, shell=True)
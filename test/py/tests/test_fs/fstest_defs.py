@@ -12,5 +12,17 @@ MEDIUM_FILE='10MB.file'
 # $BIG_FILE is the name of the 2.5GB file in the file system image
 BIG_FILE='2.5GB.file'
 
+# $FRAG_FILE has data in every other 4KB, so needs a multi-level extent tree
+FRAG_FILE='frag.file'
+
+# $SPARSE_FILE is a 3MB file with data only at the start and the end
+SPARSE_FILE='sparse.file'
+
+# $PREALLOC_FILE has an unwritten (fallocate'd) range between two written ones
+PREALLOC_FILE='prealloc.file'
+
+# $FAT_FRAG_FILE has its clusters scattered over the whole FAT volume
+FAT_FRAG_FILE='frag.bin'
+
 ADDR=0x01000008
 LENGTH=0x00100000
@@ -0,0 +1,52 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System:extents Test
+
+"""
+This test verifies reading files whose blocks are described by extents,
+including a multi-level extent tree, holes, unwritten extents and reads
+which do not start or end on a block boundary.
+"""
+
+import pytest
+from fstest_defs import *
+from fstest_helpers import assert_fs_integrity
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.slow
+class TestExtents(object):
+    def test_extents1(self, ubman, fs_obj_extents):
+        """
+        Test Case 1 - read whole files: multi-level tree, sparse, unwritten
+        """
+        fs_type, fs_img, md5val = fs_obj_extents
+        with ubman.log.section('Test Case 1 - read whole files'):
+            ubman.run_command('host bind 0 %s' % fs_img)
+            for fname, offset, length, md5 in md5val:
+                if length:
+                    continue
+                output = ubman.run_command_list([
+                    '%sload host 0:0 %x /%s' % (fs_type, ADDR, fname),
+                    'md5sum %x $filesize' % ADDR,
+                    'setenv filesize'])
+                assert(md5 in ''.join(output))
+
+    def test_extents2(self, ubman, fs_obj_extents):
+        """
+        Test Case 2 - read parts of files at unaligned offsets
+        """
+        fs_type, fs_img, md5val = fs_obj_extents
+        with ubman.log.section('Test Case 2 - unaligned reads'):
+            ubman.run_command('host bind 0 %s' % fs_img)
+            for fname, offset, length, md5 in md5val:
+                if not length:
+                    continue
+                output = ubman.run_command_list([
+                    '%sload host 0:0 %x /%s %x %x'
+                        % (fs_type, ADDR, fname, length, offset),
+                    'printenv filesize',
+                    'md5sum %x %x' % (ADDR, length),
+                    'setenv filesize'])
+                assert('filesize=%x' % length in ''.join(output))
+                assert(md5 in ''.join(output))
+            assert_fs_integrity(fs_type, fs_img)
@@ -10,6 +10,7 @@ This test verifies fat specific file system behaviour.
 
 import pytest
 import re
+from fstest_defs import *
 
 @pytest.mark.boardspec('sandbox')
 @pytest.mark.slow
@@ -23,3 +24,36 @@ class TestFsFat(object):
                 'host bind 0 %s' % fs_img,
                 'fatinfo host 0:0'])
             assert(re.search('Filesystem: %s' % fs_type.upper(), ''.join(output)))
+
+    def test_fs_fat2(self, ubman, fs_obj_fat_frag):
+        """Test reading and copying a file whose chain spans the whole FAT."""
+        fs_type,fs_img,md5val = fs_obj_fat_frag
+        with ubman.log.section('Test Case 2a - read fragmented file'):
+            output = ubman.run_command_list([
+                'host bind 0 %s' % fs_img,
+                '%sload host 0:0 %x /%s' % (fs_type, ADDR, FAT_FRAG_FILE),
+                'md5sum %x $filesize' % ADDR])
+            assert(md5val in ''.join(output))
+
+        with ubman.log.section('Test Case 2b - read at an unaligned offset'):
+            # Compare with the same range of the whole file loaded above
+            output = ubman.run_command_list([
+                '%sload host 0:0 %x /%s 12345 6789' %
+                    (fs_type, ADDR + 0x800000, FAT_FRAG_FILE),
+                'cmp.b %x %x 12345' % (ADDR + 0x6789, ADDR + 0x800000)])
+            assert('Total of 74565 byte(s) were the same' in ''.join(output))
+
+        with ubman.log.section('Test Case 2c - write into the gaps'):
+            # The copy is allocated in the free clusters between the runs
+            # of the original, so its chain also spans the whole FAT
+            output = ubman.run_command_list([
+                '%sload host 0:0 %x /%s' % (fs_type, ADDR, FAT_FRAG_FILE),
+                '%swrite host 0:0 %x /copy.bin $filesize' % (fs_type, ADDR),
+                'host bind 0 %s' % fs_img,
+                'mw.b %x 0 $filesize' % ADDR,
+                '%sload host 0:0 %x /copy.bin' % (fs_type, ADDR),
+                'md5sum %x $filesize' % ADDR,
+                'mw.b %x 0 $filesize' % ADDR,
+                '%sload host 0:0 %x /%s' % (fs_type, ADDR, FAT_FRAG_FILE),
+                'md5sum %x $filesize' % ADDR])
+            assert(''.join(output).count(md5val) == 2)
@@ -106,6 +106,42 @@ def sqfs_load_non_existent_file(ubman):
     out = ubman.run_command('sqfsload host 0 {} {}'.format(address, file))
     assert 'Failed to load' in out
 
+def sqfs_cache_stats(ubman, name):
+    """ Runs sqfscache show, which also resets the statistics.
+
+    Args:
+        ubman: provides the means to interact with U-Boot's console.
+        name: the line of statistics to return (e.g.: 'tables').
+    Returns:
+        The number of hits and misses on that line, as integers.
+    """
+    out = ubman.run_command('sqfscache show')
+    for line in out.splitlines():
+        fields = line.split()
+        if fields and fields[0] == name:
+            return int(fields[1]), int(fields[2])
+    raise AssertionError('no %s in sqfscache output' % name)
+
+def sqfs_check_cache(ubman):
+    """ Checks that the metadata cache is used, and is refilled once dropped.
+
+    This runs after the other tests, so the inode and directory tables of the
+    image are already in the cache.
+
+    Args:
+        ubman: provides the means to interact with U-Boot's console.
+    """
+    sqfs_cache_stats(ubman, 'tables')
+    sqfs_load_files_at_root(ubman)
+    hits, misses = sqfs_cache_stats(ubman, 'tables')
+    assert hits > 0
+    assert misses == 0
+
+    ubman.run_command('sqfscache drop')
+    sqfs_load_files_at_subdir(ubman)
+    hits, misses = sqfs_cache_stats(ubman, 'tables')
+    assert misses == 1
+
 def sqfs_run_all_load_tests(ubman):
     """ Runs all the previously defined test cases.
 
@@ -115,6 +151,8 @@ def sqfs_run_all_load_tests(ubman):
     sqfs_load_files_at_root(ubman)
     sqfs_load_files_at_subdir(ubman)
     sqfs_load_non_existent_file(ubman)
+    if ubman.config.buildconfig.get('config_squashfs_cache', 'n') == 'y':
+        sqfs_check_cache(ubman)
 
 @pytest.mark.boardspec('sandbox')
 @pytest.mark.buildconfigspec('cmd_fs_generic')
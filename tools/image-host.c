@@ -54,11 +54,59 @@ static int fit_set_hash_value(void *fit, int noffset, uint8_t *value,
 	return 0;
 }
 
+/**
+ * fit_set_hash_tree - calculate a hash tree and set its chunk hashes
+ * @fit: pointer to the FIT format image header
+ * @noffset: hash node offset
+ * @data: data to process
+ * @size: size of data in bytes
+ * @algo: hash algorithm name
+ * @chunk_size: chunk size in bytes
+ * @value: returns the root hash, to be set as the hash value
+ * @value_len: returns the root hash length
+ *
+ * returns
+ *     0, on success
+ *     -ve error code, on failure
+ */
+static int fit_set_hash_tree(void *fit, int noffset, const void *data,
+			     size_t size, const char *algo, ulong chunk_size,
+			     uint8_t *value, int *value_len)
+{
+	uint8_t *leaves;
+	int leaves_len;
+	int ret;
+
+	leaves = malloc((size / chunk_size + 1) * FIT_MAX_HASH_LEN);
+	if (!leaves)
+		return -ENOMEM;
+	if (fit_calc_hash_tree(data, size, algo, chunk_size, leaves,
+			       &leaves_len, value, value_len)) {
+		free(leaves);
+		return -EPROTONOSUPPORT;
+	}
+
+	ret = fdt_setprop(fit, noffset, FIT_CHUNK_HASHES_PROP, leaves,
+			  leaves_len);
+	free(leaves);
+	if (ret) {
+		if (ret == -FDT_ERR_NOSPACE)
+			return -ENOSPC;
+		fprintf(stderr, "Can't set hash '%s' property for '%s' node(%s)\n",
+			FIT_CHUNK_HASHES_PROP, fit_get_name(fit, noffset, NULL),
+			fdt_strerror(ret));
+		return -EIO;
+	}
+
+	return 0;
+}
+
 /**
  * fit_image_process_hash - Process a single subnode of the images/ node
  *
  * Check each subnode and process accordingly. For hash nodes we generate
- * a hash of the supplied data and store it in the node.
+ * a hash of the supplied data and store it in the node. If the node has a
+ * 'chunk-size' property, a hash tree is generated instead.
  *
  * @fit:	pointer to the FIT format image header
  * @image_name:	name of image being processed (used to display errors)
@@ -72,6 +120,7 @@ static int fit_image_process_hash(void *fit, const char *image_name,
 {
 	uint8_t value[FIT_MAX_HASH_LEN];
 	const char *node_name;
+	ulong chunk_size;
 	int value_len;
 	const char *algo;
 	int ret;
@@ -85,7 +134,23 @@ static int fit_image_process_hash(void *fit, const char *image_name,
 		return -ENOENT;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
+	ret = fit_image_hash_get_chunk_size(fit, noffset, &chunk_size);
+	if (ret == -EINVAL) {
+		fprintf(stderr,
+			"Invalid chunk size for '%s' hash node in '%s' image node\n",
+			node_name, image_name);
+		return ret;
+	}
+	if (!ret) {
+		ret = fit_set_hash_tree(fit, noffset, data, size, algo,
+					chunk_size, value, &value_len);
+		if (ret == -EPROTONOSUPPORT)
+			fprintf(stderr,
+				"Unsupported hash algorithm (%s) for '%s' hash node in '%s' image node\n",
+				algo, node_name, image_name);
+		if (ret)
+			return ret;
+	} else if (calculate_hash(data, size, algo, value, &value_len)) {
 		fprintf(stderr,
 			"Unsupported hash algorithm (%s) for '%s' hash node in '%s' image node\n",
 			algo, node_name, image_name);
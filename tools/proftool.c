@@ -180,6 +180,31 @@ struct func_info {
 	unsigned flags;
 };
 
+/**
+ * struct stage_rec - a record from the output of 'bootstage export'
+ *
+ * @type: 'm' for a mark, 'a' for an accumulator, 'p' for a device probe
+ * @id: Bootstage ID
+ * @parent: ID of the accumulator this one was started inside, or 0 if none
+ * @start_us: Time of a mark, or of the first start of an accumulator
+ * @total_us: Total time of an accumulator, including the ones inside it
+ * @self_us: Time of an accumulator, leaving out the ones inside it
+ * @count: Number of times the accumulator was run
+ * @func: Name to use in the flame graph
+ * @node: Flame-graph node for this record, or NULL if not created yet
+ */
+struct stage_rec {
+	char type;
+	int id;
+	int parent;
+	ulong start_us;
+	ulong total_us;
+	ulong self_us;
+	int count;
+	struct func_info func;
+	struct flame_node *node;
+};
+
 /**
  * enum trace_line_type - whether to include or exclude a function
  *
@@ -254,6 +279,11 @@ struct func_info *func_list;
 int func_count;			/* number of functions */
 struct trace_call *call_list;	/* list of all calls in the input trace file */
 int call_count;			/* number of calls */
+struct stage_rec *stage_list;	/* list of records in the bootstage file */
+int stage_count;		/* number of bootstage records */
+struct trace_sample *sample_list; /* list of samples in the input trace file */
+int sample_count;		/* number of samples */
+uint sample_freq;		/* samples per second, or 0 if not known */
 int verbose;	/* Verbosity level 0=none, 1=warn, 2=notice, 3=info, 4=debug */
 ulong text_offset;		/* text address of first function */
 ulong text_base;		/* CONFIG_TEXT_BASE from trace file */
@@ -281,18 +311,21 @@ static void outf(int level, const char *fmt, ...)
 static void usage(void)
 {
 	fprintf(stderr,
-		"Usage: proftool [-cmtv] <cmd> <profdata>\n"
+		"Usage: proftool [-bcmtv] <cmd> <profdata>\n"
 		"\n"
 		"Commands\n"
 		"   dump-ftrace\t\tDump out records in ftrace format for use by trace-cmd\n"
 		"   dump-flamegraph\tWrite a file for use with flamegraph.pl\n"
+		"   dump-profile\tWrite the number of samples in each function\n"
 		"\n"
 		"Options:\n"
+		"   -b <fname>\tSpecify bootstage data file (from U-Boot 'bootstage export')\n"
 		"   -c <cfg>\tSpecify config file\n"
 		"   -f <subtype>\tSpecify output subtype\n"
 		"   -m <map>\tSpecify System.map file\n"
 		"   -o <fname>\tSpecify output file\n"
-		"   -t <fname>\tSpecify trace data file (from U-Boot 'trace calls')\n"
+		"   -t <fname>\tSpecify trace data file (from U-Boot 'trace calls'\n"
+		"\t\tand/or 'profile samples')\n"
 		"   -v <0-4>\tSpecify verbosity\n"
 		"\n"
 		"Subtypes for dump-ftrace:\n"
@@ -301,7 +334,11 @@ static void usage(void)
 		"\n"
 		"Subtypes for dump-flamegraph\n"
 		"   calls - create a flamegraph of stack frames\n"
-		"   timing - create a flamegraph of microseconds for each stack frame\n");
+		"   timing - create a flamegraph of microseconds for each stack frame\n"
+		"\n"
+		"With -b, dump-flamegraph uses the bootstage data instead of the trace\n"
+		"If the trace data has samples but no calls, dump-flamegraph uses the\n"
+		"samples\n");
 	exit(EXIT_FAILURE);
 }
 
@@ -453,6 +490,27 @@ static struct func_info *find_caller_by_offset(uint offset)
 	return low >= 0 ? &func_list[low] : NULL;
 }
 
+/**
+ * find_sampled_func() - find the function containing a sampled address
+ *
+ * find_caller_by_offset() only looks at the offset in units of FUNC_SITE_SIZE,
+ * which is enough for function entry points, but a sample can be anywhere in
+ * a function, including just before the next one starts
+ *
+ * @offset: Offset to search for, from text_base
+ * Returns: function, if found, else NULL
+ */
+static struct func_info *find_sampled_func(uint offset)
+{
+	struct func_info *func;
+
+	func = find_caller_by_offset(offset);
+	if (func && func > func_list && func->offset > offset)
+		func--;
+
+	return func;
+}
+
 /**
  * read_calls() - Read the list of calls from the trace data
  *
@@ -483,6 +541,33 @@ static int read_calls(FILE *fin, size_t count)
 	return 0;
 }
 
+/**
+ * read_samples() - Read the list of samples from the trace data
+ *
+ * @fin: File to read from
+ * @count: Number of samples to read
+ * Returns: 0 if OK, -1 on error
+ */
+static int read_samples(FILE *fin, size_t count)
+{
+	struct trace_sample *sample;
+	int i;
+
+	notice("sample count: %zu\n", count);
+	sample_list = calloc(count, sizeof(*sample));
+	if (!sample_list) {
+		error("Cannot allocate sample_list\n");
+		return -1;
+	}
+	sample_count = count;
+
+	for (i = 0, sample = sample_list; i < count; i++, sample++) {
+		if (read_data(fin, sample, sizeof(*sample)))
+			return -1;
+	}
+	return 0;
+}
+
 /**
  * read_trace() - Read the U-Boot trace file
  *
@@ -515,6 +600,12 @@ static int read_trace(FILE *fin)
 			if (read_calls(fin, hdr.rec_count))
 				return 1;
 			break;
+
+		case TRACE_CHUNK_SAMPLES:
+			sample_freq = hdr.spare;
+			if (read_samples(fin, hdr.rec_count))
+				return 1;
+			break;
 		}
 	}
 	return 0;
@@ -573,6 +664,83 @@ static int read_trace_file(const char *fname)
 	return 0;
 }
 
+/**
+ * read_stage_file() - Read the records written by 'bootstage export'
+ *
+ * Each line has the record type, ID, parent ID, start time, total time, self
+ * time, count, uclass and name, separated by spaces. The name runs to the end
+ * of the line. Lines starting with '#' are ignored.
+ *
+ * @fname: Filename to read
+ * Returns 0 if OK, non-zero on error
+ */
+static int read_stage_file(const char *fname)
+{
+	char line[MAX_LINE_LEN], uclass[MAX_LINE_LEN];
+	int linenum = 0, alloced = 0;
+	FILE *fin;
+
+	fin = fopen(fname, "r");
+	if (!fin) {
+		error("Cannot open bootstage file '%s'\n", fname);
+		return 1;
+	}
+	while (fgets(line, sizeof(line), fin)) {
+		struct stage_rec *rec;
+		char *name, *p;
+		int pos = 0;
+
+		linenum++;
+		if (*line == '#' || *line == '\n')
+			continue;
+		if (stage_count == alloced) {
+			alloced = alloced * 2 + 64;
+			stage_list = realloc(stage_list,
+					     alloced * sizeof(*stage_list));
+			if (!stage_list) {
+				error("Out of memory for bootstage records\n");
+				fclose(fin);
+				return 1;
+			}
+		}
+		rec = &stage_list[stage_count];
+		memset(rec, '\0', sizeof(*rec));
+		if (sscanf(line, "%c %d %d %lu %lu %lu %d %s %n", &rec->type,
+			   &rec->id, &rec->parent, &rec->start_us,
+			   &rec->total_us, &rec->self_us, &rec->count, uclass,
+			   &pos) < 8 || !pos || !strchr("map", rec->type)) {
+			error("Invalid bootstage record at line %d\n",
+			      linenum);
+			fclose(fin);
+			return 1;
+		}
+		name = line + pos;
+		name[strcspn(name, "\r\n")] = '\0';
+		if (rec->type == 'p') {
+			p = malloc(strlen(uclass) + strlen(name) + 2);
+			if (p)
+				sprintf(p, "%s:%s", uclass, name);
+		} else {
+			p = strdup(name);
+		}
+		if (!p) {
+			error("Out of memory for bootstage names\n");
+			fclose(fin);
+			return 1;
+		}
+		/* ';' separates the stack frames in the flame graph */
+		for (rec->func.name = p; *p; p++) {
+			if (*p == ';')
+				*p = '_';
+		}
+		stage_count++;
+	}
+	fclose(fin);
+	notice("%d bootstage records\n", stage_count);
+
+	return 0;
+}
+
 static int regex_report_error(regex_t *regex, int err, const char *op,
 			      const char *name)
 {
@@ -1777,6 +1945,195 @@ static int make_flame_tree(enum out_format_t out_format,
 	return 0;
 }
 
+/* Find the child of @parent for @func, creating it if needed */
+static struct flame_node *find_child_node(struct flame_node *parent,
+					  struct func_info *func)
+{
+	struct flame_node *child;
+
+	list_for_each_entry(child, &parent->child_head, sibling_node) {
+		if (child->func == func)
+			return child;
+	}
+	child = create_node("sample");
+	if (!child)
+		return NULL;
+	list_add_tail(&child->sibling_node, &parent->child_head);
+	child->func = func;
+	child->parent = parent;
+
+	return child;
+}
+
+/**
+ * make_sample_tree() - Create a tree of the samples from the sampling profiler
+ *
+ * A sample only tells us the function being run and the one it returns to, so
+ * the call stacks in the tree are at most two functions deep. The time for
+ * each sample is the sampling period
+ *
+ * @treep: Returns the resulting flamegraph tree
+ * Returns: 0 on success, -ve on error
+ */
+static int make_sample_tree(struct flame_node **treep)
+{
+	struct trace_sample *sample, *end = sample_list + sample_count;
+	ulong period = sample_freq ? 1000000 / sample_freq : 1;
+	struct flame_node *tree, *node;
+
+	if (!func_count) {
+		error("No functions to look up samples\n");
+		return -1;
+	}
+	tree = create_node("tree");
+	if (!tree)
+		return -1;
+	for (sample = sample_list; sample < end; sample++) {
+		node = tree;
+		if (sample->caller != TRACE_SAMPLE_NO_CALLER) {
+			node = find_child_node(node,
+				find_sampled_func(sample->caller));
+			if (!node)
+				return -1;
+		}
+		node = find_child_node(node, find_sampled_func(sample->pc));
+		if (!node)
+			return -1;
+		node->count++;
+		node->duration += period;
+	}
+	*treep = tree;
+
+	return 0;
+}
+
+/* Add a flamegraph node for @rec below @parent */
+static struct flame_node *add_stage_node(struct flame_node *parent,
+					 struct stage_rec *rec)
+{
+	struct flame_node *node;
+
+	node = create_node("stage");
+	if (!node)
+		return NULL;
+	list_add_tail(&node->sibling_node, &parent->child_head);
+	node->parent = parent;
+	node->func = &rec->func;
+	rec->node = node;
+
+	return node;
+}
+
+static struct stage_rec *find_stage(int id)
+{
+	int i;
+
+	for (i = 0; i < stage_count; i++) {
+		if (stage_list[i].id == id && stage_list[i].type != 'm')
+			return &stage_list[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * add_stage_scope() - Add an accumulator to the bootstage flamegraph tree
+ *
+ * The accumulator goes inside the accumulator it was started in, if any, or
+ * else inside the stage during which it was first started. A stage is the
+ * time between one mark and the next, named after the mark at its end, as
+ * with 'bootstage report'
+ *
+ * @tree: Root of the tree
+ * @rec: Accumulator to add
+ * @depth: Number of accumulators being added already, to catch loops
+ * Returns: node for @rec, or NULL on error
+ */
+static struct flame_node *add_stage_scope(struct flame_node *tree,
+					  struct stage_rec *rec, int depth)
+{
+	struct stage_rec *parent = NULL, *mark;
+	struct flame_node *node = tree;
+	int i;
+
+	if (rec->node)
+		return rec->node;
+	if (rec->parent && depth < MAX_STACK_DEPTH)
+		parent = find_stage(rec->parent);
+	if (parent) {
+		node = add_stage_scope(tree, parent, depth + 1);
+		if (!node)
+			return NULL;
+	} else {
+		for (i = 0, mark = stage_list; i < stage_count; i++, mark++) {
+			if (mark->type == 'm' && mark->start_us >= rec->start_us) {
+				node = mark->node;
+				break;
+			}
+		}
+	}
+	node = add_stage_node(node, rec);
+	if (!node)
+		return NULL;
+	node->count = rec->count;
+	node->duration = rec->self_us;
+
+	return node;
+}
+
+/**
+ * make_stage_tree() - Create a tree of boot stages
+ *
+ * The top level of the tree has the stages between each mark in the bootstage
+ * data. Accumulators go inside the stage or accumulator which was running when
+ * they were first started. The time for each stage leaves out the time of the
+ * accumulators inside it.
+ *
+ * @treep: Returns the resulting flamegraph tree
+ * Returns: 0 on success, -ve on error
+ */
+static int make_stage_tree(struct flame_node **treep)
+{
+	struct stage_rec *rec, *end = stage_list + stage_count;
+	struct flame_node *tree, *child;
+	ulong prev = 0;
+
+	tree = create_node("tree");
+	if (!tree)
+		return -1;
+	for (rec = stage_list; rec < end; rec++) {
+		if (rec->type != 'm')
+			continue;
+		if (!add_stage_node(tree, rec))
+			return -1;
+		rec->node->count = 1;
+		rec->node->duration = rec->start_us - MIN(prev, rec->start_us);
+		prev = rec->start_us;
+	}
+	for (rec = stage_list; rec < end; rec++) {
+		if (rec->type != 'm' && !add_stage_scope(tree, rec, 0))
+			return -1;
+	}
+
+	/* leave the accumulators out of the time for each stage */
+	for (rec = stage_list; rec < end; rec++) {
+		if (rec->type != 'm')
+			continue;
+		list_for_each_entry(child, &rec->node->child_head,
+				    sibling_node) {
+			struct stage_rec *srec;
+
+			srec = container_of(child->func, struct stage_rec,
+					    func);
+			rec->node->duration -= MIN(rec->node->duration,
+						   srec->total_us);
+		}
+	}
+	*treep = tree;
+
+	return 0;
+}
+
 /**
  * output_tree() - Output a flamegraph tree
  *
@@ -1878,8 +2235,15 @@ static int make_flamegraph(FILE *fout, enum out_format_t out_format)
 	char *str;
 	int ret = 0;
 
-	if (make_flame_tree(out_format, &tree))
+	if (stage_count) {
+		if (make_stage_tree(&tree))
+			return -1;
+	} else if (sample_count && !call_count) {
+		if (make_sample_tree(&tree))
+			return -1;
+	} else if (make_flame_tree(out_format, &tree)) {
 		return -1;
+	}
 
 	abuf_init(&str_buf);
 	if (!abuf_realloc(&str_buf, 500))
@@ -1894,31 +2258,117 @@ static int make_flamegraph(FILE *fout, enum out_format_t out_format)
 	return ret;
 }
 
+/**
+ * struct func_samples - number of samples for a function
+ *
+ * @func: Function
+ * @self: Number of samples taken in the function
+ * @total: Number of samples taken in the function or in a function which
+ * returns to it
+ */
+struct func_samples {
+	struct func_info *func;
+	int self;
+	int total;
+};
+
+static int h_cmp_samples(const void *v1, const void *v2)
+{
+	const struct func_samples *s1 = v1, *s2 = v2;
+
+	if (s1->self != s2->self)
+		return s2->self - s1->self;
+
+	return s2->total - s1->total;
+}
+
+/**
+ * make_profile() - Write out the number of samples in each function
+ *
+ * @fout: Output file
+ * Returns 0 if OK, -1 on error
+ */
+static int make_profile(FILE *fout)
+{
+	struct trace_sample *sample, *end = sample_list + sample_count;
+	struct func_samples *counts, *cnt;
+	int i;
+
+	if (!func_count) {
+		error("No functions to look up samples\n");
+		return -1;
+	}
+	counts = calloc(func_count, sizeof(*counts));
+	if (!counts) {
+		error("Cannot allocate sample counts\n");
+		return -1;
+	}
+	for (i = 0; i < func_count; i++)
+		counts[i].func = &func_list[i];
+
+	for (sample = sample_list; sample < end; sample++) {
+		struct func_info *func, *caller;
+
+		func = find_sampled_func(sample->pc);
+		cnt = &counts[func - func_list];
+		cnt->self++;
+		cnt->total++;
+		if (sample->caller == TRACE_SAMPLE_NO_CALLER)
+			continue;
+		caller = find_sampled_func(sample->caller);
+		if (caller != func)
+			counts[caller - func_list].total++;
+	}
+	qsort(counts, func_count, sizeof(*counts), h_cmp_samples);
+
+	fprintf(fout, "# %d samples", sample_count);
+	if (sample_freq)
+		fprintf(fout, " at %u Hz", sample_freq);
+	fprintf(fout, "\n%8s %7s %8s  %s\n", "Self", "Self%", "Total",
+		"Function");
+	for (cnt = counts; cnt < counts + func_count && cnt->total; cnt++) {
+		fprintf(fout, "%8d %6.2f%% %8d  %s\n", cnt->self,
+			cnt->self * 100.0 / sample_count, cnt->total,
+			cnt->func->name);
+	}
+	free(counts);
+
+	return 0;
+}
+
 /**
  * prof_tool() - Performs requested action
  *
  * @argc: Number of arguments (used to obtain the command
  * @argv: List of arguments
- * @trace_fname: Filename of input file (trace data from U-Boot)
+ * @trace_fname: Filename of input file (trace data from U-Boot), or NULL if
+ * none
+ * @stage_fname: Filename of bootstage data (from 'bootstage export'), or NULL
+ * if none
  * @map_fname: Filename of map file (System.map from U-Boot)
  * @trace_config_fname: Trace-configuration file, or NULL if none
  * @out_fname: Output filename
  */
 static int prof_tool(int argc, char *const argv[],
-		     const char *trace_fname, const char *map_fname,
-		     const char *trace_config_fname, const char *out_fname,
-		     enum out_format_t out_format)
+		     const char *trace_fname, const char *stage_fname,
+		     const char *map_fname, const char *trace_config_fname,
+		     const char *out_fname, enum out_format_t out_format)
 {
 	int err = 0;
 
-	if (read_map_file(map_fname))
-		return -1;
-	if (trace_fname && read_trace_file(trace_fname))
-		return -1;
-	if (trace_config_fname && read_trace_config_file(trace_config_fname))
-		return -1;
+	if (trace_fname) {
+		if (read_map_file(map_fname))
+			return -1;
+		if (read_trace_file(trace_fname))
+			return -1;
+		if (trace_config_fname &&
+		    read_trace_config_file(trace_config_fname))
+			return -1;
 
-	check_trace_config();
+		check_trace_config();
+	}
+	if (stage_fname && read_stage_file(stage_fname))
+		return -1;
 
 	for (; argc; argc--, argv++) {
 		const char *cmd = *argv;
@@ -1926,6 +2376,10 @@ static int prof_tool(int argc, char *const argv[],
 		if (!strcmp(cmd, "dump-ftrace")) {
 			FILE *fout;
 
+			if (!trace_fname) {
+				fprintf(stderr, "dump-ftrace needs trace data\n");
+				return -1;
+			}
 			if (out_format != OUT_FMT_FUNCTION &&
 			    out_format != OUT_FMT_FUNCGRAPH)
 				out_format = OUT_FMT_FUNCTION;
@@ -1951,6 +2405,21 @@ static int prof_tool(int argc, char *const argv[],
 			}
 			err = make_flamegraph(fout, out_format);
 			fclose(fout);
+		} else if (!strcmp(cmd, "dump-profile")) {
+			FILE *fout;
+
+			if (!sample_count) {
+				fprintf(stderr, "dump-profile needs samples in the trace data\n");
+				return -1;
+			}
+			fout = fopen(out_fname, "w");
+			if (!fout) {
+				fprintf(stderr, "Cannot write file '%s'\n",
+					out_fname);
+				return -1;
+			}
+			err = make_profile(fout);
+			fclose(fout);
 		} else {
 			warn("Unknown command '%s'\n", cmd);
 		}
@@ -1964,13 +2433,17 @@ int main(int argc, char *argv[])
 	enum out_format_t out_format = OUT_FMT_DEFAULT;
 	const char *map_fname = "System.map";
 	const char *trace_fname = NULL;
+	const char *stage_fname = NULL;
 	const char *config_fname = NULL;
 	const char *out_fname = NULL;
 	int opt;
 
 	verbose = 2;
-	while ((opt = getopt(argc, argv, "c:f:m:o:t:v:")) != -1) {
+	while ((opt = getopt(argc, argv, "b:c:f:m:o:t:v:")) != -1) {
 		switch (opt) {
+		case 'b':
+			stage_fname = optarg;
+			break;
 		case 'c':
 			config_fname = optarg;
 			break;
@@ -2009,13 +2482,13 @@ int main(int argc, char *argv[])
 	if (argc < 1)
 		usage();
 
-	if (!out_fname || !map_fname || !trace_fname) {
+	if (!out_fname || (!stage_fname && (!map_fname || !trace_fname))) {
 		fprintf(stderr,
-			"Must provide trace data, System.map file and output file\n");
+			"Must provide trace data and System.map file, or bootstage data, and output file\n");
 		usage();
 	}
 
 	debug("Debug enabled\n");
-	return prof_tool(argc, argv, trace_fname, map_fname, config_fname,
-			 out_fname, out_format);
+	return prof_tool(argc, argv, trace_fname, stage_fname, map_fname,
+			 config_fname, out_fname, out_format);
 }